@@ -1,6 +1,5 @@
 #include <stdlib.h>
-#include <unistd.h>
-#include <time.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
@@ -8,107 +7,365 @@
 #include <sys/stat.h>
 #include <dirent.h>
 
-#define HEADERS_MAX 64
-#define HEADER_MAGIC 0xBF
+//must match src/kernel/util/vfs/initrd.h
+#define INITRD_MAGIC		0x44525841 //"AXRD"
+#define INITRD_VERSION		2
+#define INITRD_NODE_STORED	0x100
+#define INITRD_BLOCK_STORED	0x80000000
+#define FS_FILE			0x01
+#define FS_DIRECTORY		0x02
 
-typedef struct initrd_header {
-	unsigned char magic;	//magic number
-	char name[64];
-	unsigned int offset;	//offset in initrd that the file starts
-	unsigned int length;	//length of file
+#define BLOCK_SIZE 0x8000
+#define NAME_MAX_LEN 127
+
+//directories always present in the root, so there's somewhere to mount devfs, tmpfs and disks
+static const char* mountpoints[] = {"dev", "tmp", "mnt"};
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t node_count;
+	uint32_t hash_size;
+	uint32_t block_size;
+	uint32_t nodes_offset;
+	uint32_t hash_offset;
+	uint32_t blocks_offset;
+	uint32_t names_offset;
 } rd_header;
 
-FILE* openfile(const char* dirname, struct dirent* dir, const char* mode) {
-	char pathname[1024]; //should be big enough
-	FILE *fp;
+typedef struct {
+	uint32_t name;
+	uint32_t flags;
+	uint32_t parent;
+	uint32_t length;
+	uint32_t first_block;
+	uint32_t first_child;
+	uint32_t next_sibling;
+	uint32_t hash_next;
+} rd_node;
+
+typedef struct {
+	uint32_t offset;
+	uint32_t size;
+} rd_block;
+
+//growable byte buffer
+typedef struct {
+	unsigned char* data;
+	uint32_t len;
+	uint32_t cap;
+} buffer;
+
+static rd_node* nodes;
+static uint32_t node_count, node_cap;
+static rd_block* blocks;
+static uint32_t block_count, block_cap;
+static buffer names;
+static buffer data;
 
-	sprintf(pathname, "%s/%s", dirname, dir->d_name);
-	printf("trying to open file %s\n", pathname);
-	fp = fopen(pathname, mode);
-	return fp;
+static uint32_t total_in, total_out;
+
+static void buffer_append(buffer* buf, const void* bytes, uint32_t len) {
+	if (buf->len + len > buf->cap) {
+		while (buf->len + len > buf->cap) {
+			buf->cap = buf->cap ? buf->cap * 2 : 4096;
+		}
+		buf->data = realloc(buf->data, buf->cap);
+	}
+	memcpy(buf->data + buf->len, bytes, len);
+	buf->len += len;
 }
 
-void write_dir(const char* dirname) {
-	rd_header headers[HEADERS_MAX];
-	//initial file offset is size of initrd header * max headers + actual header count
-	unsigned int off = sizeof(rd_header) * HEADERS_MAX + sizeof(int);
-	
-	DIR* dp = opendir(dirname);
-	if (!dp) {
-		perror("Couldn't find directory");
-		return;
+static uint32_t name_hash(uint32_t parent, const char* name) {
+	uint32_t hash = 2166136261u ^ parent;
+	while (*name) {
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619u;
 	}
+	return hash;
+}
 
-	int nheaders = 0;
-	struct dirent* ep;
-	while ((ep = readdir(dp))) {	
-		if (ep->d_type != DT_REG) {
-			printf("Found non-file (directory?) %s, skipping for now\n", ep->d_name);
-			continue;
+//LZ4 block compression, greedy with a single hash table
+#define LZ4_HASH_BITS 14
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MFLIMIT 12
+
+static uint32_t read32(const unsigned char* p) {
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static unsigned char* write_length(unsigned char* op, uint32_t len) {
+	while (len >= 255) {
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = len;
+	return op;
+}
+
+//emits literals [lit, lit + lit_len) followed by a match, or just the literals if match_len is 0
+static unsigned char* write_sequence(unsigned char* op, const unsigned char* lit, uint32_t lit_len, uint32_t offset, uint32_t match_len) {
+	unsigned char* token = op++;
+	*token = (lit_len >= 15 ? 15 : lit_len) << 4;
+	if (lit_len >= 15) op = write_length(op, lit_len - 15);
+	memcpy(op, lit, lit_len);
+	op += lit_len;
+
+	if (!match_len) return op;
+
+	*op++ = offset & 0xFF;
+	*op++ = offset >> 8;
+	uint32_t ml = match_len - LZ4_MIN_MATCH;
+	*token |= ml >= 15 ? 15 : ml;
+	if (ml >= 15) op = write_length(op, ml - 15);
+	return op;
+}
+
+//dst must hold len + len / 255 + 16 bytes
+static uint32_t lz4_compress(const unsigned char* src, uint32_t len, unsigned char* dst) {
+	static int32_t table[1 << LZ4_HASH_BITS];
+	for (int i = 0; i < (1 << LZ4_HASH_BITS); i++) table[i] = -1;
+
+	unsigned char* op = dst;
+	uint32_t anchor = 0;
+	uint32_t ip = 0;
+	if (len >= LZ4_MFLIMIT + 1) {
+		uint32_t mflimit = len - LZ4_MFLIMIT;
+		uint32_t matchlimit = len - LZ4_LAST_LITERALS;
+		while (ip < mflimit) {
+			uint32_t seq = read32(src + ip);
+			uint32_t h = (seq * 2654435761u) >> (32 - LZ4_HASH_BITS);
+			int32_t ref = table[h];
+			table[h] = ip;
+
+			if (ref < 0 || ip - ref > 0xFFFF || read32(src + ref) != seq) {
+				ip++;
+				continue;
+			}
+
+			uint32_t match_len = LZ4_MIN_MATCH;
+			while (ip + match_len < matchlimit && src[ref + match_len] == src[ip + match_len]) {
+				match_len++;
+			}
+			op = write_sequence(op, src + anchor, ip - anchor, ip - ref, match_len);
+			ip += match_len;
+			anchor = ip;
 		}
-		
-		char pathname[1024];
-		sprintf(pathname, "%s", ep->d_name);
-		printf("writing file %s at 0x%x\n", pathname, off);
+	}
+	op = write_sequence(op, src + anchor, len - anchor, 0, 0);
+	return op - dst;
+}
 
-		strcpy(headers[nheaders].name, pathname);
-		//add null byte to end of filename
-		headers[nheaders].name[strlen(pathname)] = 0;
+static uint32_t add_node(const char* name, uint32_t flags, uint32_t parent) {
+	if (node_count == node_cap) {
+		node_cap = node_cap ? node_cap * 2 : 64;
+		nodes = realloc(nodes, node_cap * sizeof(rd_node));
+	}
+	uint32_t idx = node_count++;
+	rd_node* node = &nodes[idx];
+	memset(node, 0, sizeof(rd_node));
+	node->name = names.len;
+	buffer_append(&names, name, strlen(name) + 1);
+	node->flags = flags;
+	node->parent = parent;
 
-		//write offset into initrd
-		headers[nheaders].offset = off;
+	//append to the parent's entries, keeping them in sorted order
+	if (idx) {
+		uint32_t* link = &nodes[parent].first_child;
+		while (*link) link = &nodes[*link].next_sibling;
+		*link = idx;
+	}
+	return idx;
+}
+
+static void add_block(uint32_t offset, uint32_t size) {
+	if (block_count == block_cap) {
+		block_cap = block_cap ? block_cap * 2 : 256;
+		blocks = realloc(blocks, block_cap * sizeof(rd_block));
+	}
+	blocks[block_count].offset = offset;
+	blocks[block_count].size = size;
+	block_count++;
+}
+
+static void write_file(const char* pathname, uint32_t idx) {
+	FILE* stream = fopen(pathname, "rb");
+	if (!stream) {
+		printf("Error: couldn't open %s: %s\n", pathname, strerror(errno));
+		exit(1);
+	}
+	fseek(stream, 0, SEEK_END);
+	uint32_t length = ftell(stream);
+	fseek(stream, 0, SEEK_SET);
+	unsigned char* buf = malloc(length ? length : 1);
+	if (fread(buf, 1, length, stream) != length) {
+		printf("Error: couldn't read %s\n", pathname);
+		exit(1);
+	}
+	fclose(stream);
 
-		//open file so we can write binary data to initrd
-		//FILE* stream = openfile(dirname, ep, "rb");
-		FILE* stream = fopen(pathname, "rb");
-		if (!stream) {
-			printf("Error: file not found: %s\n", pathname);
+	nodes[idx].length = length;
+	nodes[idx].first_block = block_count;
+
+	//compress every block, remembering whether any of it was worth it
+	uint32_t nblocks = (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	unsigned char** packed = malloc((nblocks ? nblocks : 1) * sizeof(unsigned char*));
+	uint32_t* packed_len = malloc((nblocks ? nblocks : 1) * sizeof(uint32_t));
+	uint32_t total = 0;
+	for (uint32_t b = 0; b < nblocks; b++) {
+		uint32_t off = b * BLOCK_SIZE;
+		uint32_t len = length - off < BLOCK_SIZE ? length - off : BLOCK_SIZE;
+		packed[b] = malloc(len + len / 255 + 16);
+		packed_len[b] = lz4_compress(buf + off, len, packed[b]);
+		total += packed_len[b] < len ? packed_len[b] : len;
+	}
+
+	//files which barely compress are kept as is, so the kernel can map them in place
+	int stored = total + total / 8 >= length;
+	if (stored) {
+		nodes[idx].flags |= INITRD_NODE_STORED;
+	}
+
+	for (uint32_t b = 0; b < nblocks; b++) {
+		uint32_t off = b * BLOCK_SIZE;
+		uint32_t len = length - off < BLOCK_SIZE ? length - off : BLOCK_SIZE;
+		if (stored || packed_len[b] >= len) {
+			add_block(data.len, len | INITRD_BLOCK_STORED);
+			buffer_append(&data, buf + off, len);
+		}
+		else {
+			add_block(data.len, packed_len[b]);
+			buffer_append(&data, packed[b], packed_len[b]);
+		}
+		free(packed[b]);
+	}
+	printf("%s: %u bytes, %s %u\n", pathname, length, stored ? "stored" : "compressed to", stored ? length : total);
+	total_in += length;
+	total_out += stored ? length : total;
+
+	free(packed);
+	free(packed_len);
+	free(buf);
+}
+
+static int is_mountpoint(uint32_t parent, const char* name) {
+	if (parent) return 0;
+	for (unsigned i = 0; i < sizeof(mountpoints) / sizeof(mountpoints[0]); i++) {
+		if (!strcmp(mountpoints[i], name)) return 1;
+	}
+	return 0;
+}
+
+static void write_dir(const char* dirname, uint32_t parent) {
+	struct dirent** entries;
+	int count = scandir(dirname, &entries, NULL, alphasort);
+	if (count < 0) {
+		perror("Couldn't find directory");
+		exit(1);
+	}
+
+	for (int i = 0; i < count; i++) {
+		const char* name = entries[i]->d_name;
+		if (!strcmp(name, ".") || !strcmp(name, "..")) continue;
+		if (strlen(name) > NAME_MAX_LEN) {
+			printf("Skipping %s, name is too long\n", name);
+			continue;
+		}
+
+		char pathname[1024];
+		snprintf(pathname, sizeof(pathname), "%s/%s", dirname, name);
+		struct stat st;
+		if (stat(pathname, &st)) {
+			perror(pathname);
 			exit(1);
 		}
-	
-		//find length of file 
-		fseek(stream, 0, SEEK_END);
-		headers[nheaders].length = ftell(stream);
-		printf("length is %d\n", headers[nheaders].length);
-		
-		fclose(stream);
-
-		off += headers[nheaders].length;
-		headers[nheaders].magic = HEADER_MAGIC;
-
-		//prepare to write next file
-		nheaders++;	
-	}
-	
-	FILE* wstream = fopen("./initrd.img", "w");
-	//write number of headers first
-	fwrite(&nheaders, sizeof(int), 1, wstream);
-	//write header info
-	fwrite(headers, sizeof(rd_header), HEADERS_MAX, wstream);
-
-	//write actual file data to initrd
-	printf("writing %d headers to initrd\n", nheaders);
-	for (int i = 0; i < nheaders; i++) {
-		FILE* stream = fopen(headers[i].name, "r");
-		if (!stream) {
-			printf("Couldn't find file %s!\n", headers[i].name);
+
+		if (is_mountpoint(parent, name)) {
+			printf("Skipping %s, name is reserved for a mountpoint\n", pathname);
 			continue;
 		}
 
-		unsigned char* buf = (unsigned char*)malloc(headers[i].length);
-		fread(buf, 1, headers[i].length, stream);
-		fwrite(buf, 1, headers[i].length, wstream);
+		if (S_ISDIR(st.st_mode)) {
+			uint32_t idx = add_node(name, FS_DIRECTORY, parent);
+			write_dir(pathname, idx);
+		}
+		else if (S_ISREG(st.st_mode)) {
+			uint32_t idx = add_node(name, FS_FILE, parent);
+			write_file(pathname, idx);
+		}
+		else {
+			printf("Skipping %s, not a file or directory\n", pathname);
+		}
+	}
 
-		fclose(stream);
-		free(buf);
+	for (int i = 0; i < count; i++) free(entries[i]);
+	free(entries);
+}
+
+static void write_image(const char* outname) {
+	//name index with at least twice as many buckets as nodes
+	uint32_t hash_size = 16;
+	while (hash_size < node_count * 2) hash_size *= 2;
+	uint32_t* index = calloc(hash_size, sizeof(uint32_t));
+	for (uint32_t i = 1; i < node_count; i++) {
+		uint32_t bucket = name_hash(nodes[i].parent, (char*)names.data + nodes[i].name) & (hash_size - 1);
+		nodes[i].hash_next = index[bucket];
+		index[bucket] = i;
+	}
+
+	rd_header header;
+	memset(&header, 0, sizeof(header));
+	header.magic = INITRD_MAGIC;
+	header.version = INITRD_VERSION;
+	header.node_count = node_count;
+	header.hash_size = hash_size;
+	header.block_size = BLOCK_SIZE;
+	header.nodes_offset = sizeof(header);
+	header.hash_offset = header.nodes_offset + node_count * sizeof(rd_node);
+	header.blocks_offset = header.hash_offset + hash_size * sizeof(uint32_t);
+	header.names_offset = header.blocks_offset + block_count * sizeof(rd_block);
+	//keep file data 4 byte aligned
+	uint32_t data_offset = (header.names_offset + names.len + 3) & ~3;
+	for (uint32_t i = 0; i < block_count; i++) {
+		blocks[i].offset += data_offset;
 	}
 
+	FILE* wstream = fopen(outname, "wb");
+	if (!wstream) {
+		perror(outname);
+		exit(1);
+	}
+	fwrite(&header, sizeof(header), 1, wstream);
+	fwrite(nodes, sizeof(rd_node), node_count, wstream);
+	fwrite(index, sizeof(uint32_t), hash_size, wstream);
+	fwrite(blocks, sizeof(rd_block), block_count, wstream);
+	fwrite(names.data, 1, names.len, wstream);
+	static const unsigned char pad[4];
+	fwrite(pad, 1, data_offset - (header.names_offset + names.len), wstream);
+	fwrite(data.data, 1, data.len, wstream);
 	fclose(wstream);
+
+	printf("wrote %u nodes, %u bytes of files in %u bytes to %s\n", node_count, total_in, data_offset + data.len, outname);
+	free(index);
 }
 
 int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("Usage: %s <directory>...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	add_node("", FS_DIRECTORY, 0);
+	for (unsigned i = 0; i < sizeof(mountpoints) / sizeof(mountpoints[0]); i++) {
+		add_node(mountpoints[i], FS_DIRECTORY, 0);
+	}
+	//contents of every directory given are merged into the root
 	for (int arg = 1; arg < argc; arg++) {
-		write_dir(argv[arg]);
+		write_dir(argv[arg], 0);
 	}
+	write_image("./initrd.img");
 	return EXIT_SUCCESS;
 }
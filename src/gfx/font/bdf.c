@@ -0,0 +1,196 @@
+#include "bdf.h"
+#include <std/std.h>
+#include <std/kheap.h>
+#include <std/ctype.h>
+
+//BDF gives sizes in points at a resolution, this many points make an inch
+#define POINTS_PER_INCH 72
+
+//true if line is keyword followed by whitespace or nothing
+//args is pointed past the keyword
+static bool bdf_keyword(char* line, char* keyword, char** args) {
+	int len = strlen(keyword);
+	for (int i = 0; i < len; i++) {
+		if (line[i] != keyword[i]) return false;
+	}
+	if (line[len] && !isspace(line[len])) return false;
+	*args = line + len;
+	return true;
+}
+
+//reads the next decimal number from *p and moves past it
+static int bdf_int(char** p) {
+	while (**p && isspace(**p)) (*p)++;
+	int value = atoi(*p);
+	if (**p == '-' || **p == '+') (*p)++;
+	while (isdigit(**p)) (*p)++;
+	return value;
+}
+
+static int hex_digit(char ch) {
+	if (ch >= '0' && ch <= '9') return ch - '0';
+	if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+	if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+	return 0;
+}
+
+//splits off the line at *p, returns it or NULL at the end of the file
+static char* bdf_next_line(char** p) {
+	if (!**p) return NULL;
+	char* line = *p;
+	while (**p && **p != '\n') (*p)++;
+	if (**p) {
+		**p = '\0';
+		(*p)++;
+	}
+	//drop a trailing carriage return
+	int len = strlen(line);
+	if (len && line[len - 1] == '\r') line[len - 1] = '\0';
+	return line;
+}
+
+//adds a kerning pair, keeping them sorted
+static void bdf_add_kerning(Font* font, int* capacity, int left, int right, int adjust) {
+	if (left < 0 || left >= FONT_GLYPH_COUNT || right < 0 || right >= FONT_GLYPH_COUNT) return;
+
+	if (font->kerning_count == *capacity) {
+		*capacity = *capacity ? *capacity * 2 : 64;
+		kern_pair* grown = kmalloc(*capacity * sizeof(kern_pair));
+		if (font->kerning) {
+			memcpy(grown, font->kerning, font->kerning_count * sizeof(kern_pair));
+			kfree(font->kerning);
+		}
+		font->kerning = grown;
+	}
+
+	uint16_t key = (left << 8) | right;
+	int i = font->kerning_count;
+	while (i > 0 && ((font->kerning[i - 1].left << 8) | font->kerning[i - 1].right) > key) {
+		font->kerning[i] = font->kerning[i - 1];
+		i--;
+	}
+	font->kerning[i].left = left;
+	font->kerning[i].right = right;
+	font->kerning[i].adjust = adjust;
+	font->kerning_count++;
+}
+
+bool bdf_detect(char* data, uint32_t size) {
+	char* args;
+	return size > 9 && bdf_keyword(data, "STARTFONT", &args);
+}
+
+Font* bdf_load(char* data, uint32_t UNUSED(size)) {
+	Font* font = kmalloc(sizeof(Font));
+	memset(font, 0, sizeof(Font));
+	int kerning_capacity = 0;
+	int descent = 0;
+	bool has_ascent = false;
+
+	//state of the character being read
+	int encoding = -1;
+	int advance = 0;
+	int bbx_w = 0, bbx_h = 0, bbx_x = 0, bbx_y = 0;
+
+	char* p = data;
+	char* line;
+	char* args;
+	while ((line = bdf_next_line(&p)) != NULL) {
+		if (bdf_keyword(line, "FONT", &args)) {
+			while (*args && isspace(*args)) args++;
+			int i = 0;
+			for (; args[i] && i < (int)sizeof(font->name) - 1; i++) {
+				font->name[i] = args[i];
+			}
+			font->name[i] = '\0';
+		}
+		else if (bdf_keyword(line, "SIZE", &args)) {
+			int points = bdf_int(&args);
+			bdf_int(&args);
+			int y_resolution = bdf_int(&args);
+			if (!font->size) font->size = (points * y_resolution) / POINTS_PER_INCH;
+		}
+		else if (bdf_keyword(line, "PIXEL_SIZE", &args)) {
+			//more precise than SIZE
+			font->size = bdf_int(&args);
+		}
+		else if (bdf_keyword(line, "FONTBOUNDINGBOX", &args)) {
+			bdf_int(&args);
+			int h = bdf_int(&args);
+			bdf_int(&args);
+			int y = bdf_int(&args);
+			//FONT_ASCENT and FONT_DESCENT are optional, the box is the fallback
+			if (!has_ascent) {
+				font->ascent = h + y;
+				descent = -y;
+			}
+		}
+		else if (bdf_keyword(line, "FONT_ASCENT", &args)) {
+			font->ascent = bdf_int(&args);
+			has_ascent = true;
+		}
+		else if (bdf_keyword(line, "FONT_DESCENT", &args)) {
+			descent = bdf_int(&args);
+		}
+		else if (bdf_keyword(line, "KPX", &args)) {
+			int left = bdf_int(&args);
+			int right = bdf_int(&args);
+			bdf_add_kerning(font, &kerning_capacity, left, right, bdf_int(&args));
+		}
+		else if (bdf_keyword(line, "STARTCHAR", &args)) {
+			encoding = -1;
+			advance = 0;
+			bbx_w = bbx_h = bbx_x = bbx_y = 0;
+		}
+		else if (bdf_keyword(line, "ENCODING", &args)) {
+			encoding = bdf_int(&args);
+		}
+		else if (bdf_keyword(line, "DWIDTH", &args)) {
+			advance = bdf_int(&args);
+		}
+		else if (bdf_keyword(line, "BBX", &args)) {
+			bbx_w = bdf_int(&args);
+			bbx_h = bdf_int(&args);
+			bbx_x = bdf_int(&args);
+			bbx_y = bdf_int(&args);
+		}
+		else if (bdf_keyword(line, "BITMAP", &args)) {
+			int stride = (bbx_w + 7) / 8;
+			bool wanted = encoding >= 0 && encoding < FONT_GLYPH_COUNT && bbx_w > 0 && bbx_h > 0;
+			uint8_t* bitmap = wanted ? kmalloc(stride * bbx_h) : NULL;
+			if (bitmap) memset(bitmap, 0, stride * bbx_h);
+
+			//one line of hex per row, two digits a byte
+			for (int row = 0; row < bbx_h; row++) {
+				char* hex = bdf_next_line(&p);
+				if (!hex) break;
+				if (!bitmap) continue;
+				for (int i = 0; i < stride && isxdigit(hex[i * 2]); i++) {
+					bitmap[(row * stride) + i] = (hex_digit(hex[i * 2]) << 4) | hex_digit(hex[(i * 2) + 1]);
+				}
+			}
+
+			if (wanted) {
+				font_glyph* glyph = &font->glyphs[encoding];
+				kfree(glyph->bitmap);
+				glyph->bitmap = bitmap;
+				glyph->width = bbx_w;
+				glyph->height = bbx_h;
+				glyph->x_offset = bbx_x;
+				//the box's offset is from the baseline up to its bottom edge
+				glyph->y_offset = font->ascent - (bbx_h + bbx_y);
+			}
+			if (encoding >= 0 && encoding < FONT_GLYPH_COUNT) {
+				font->glyphs[encoding].advance = advance;
+			}
+		}
+	}
+
+	font->line_height = font->ascent + descent;
+	if (!font->line_height || !font->size) {
+		printf_err("bdf_load(): font has no size");
+		font_destroy(font);
+		return NULL;
+	}
+	return font;
+}
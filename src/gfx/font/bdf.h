@@ -0,0 +1,17 @@
+#ifndef BDF_H
+#define BDF_H
+
+#include "font.h"
+
+//Glyph Bitmap Distribution Format, X11's text bitmap format
+//every glyph has its own bounding box and advance, so fonts can be proportional
+//BDF has no kerning, so as an extension, lines of the form
+//	KPX <left encoding> <right encoding> <adjustment>
+//before CHARS give kerning pairs, named after the same line in AFM files
+
+bool bdf_detect(char* data, uint32_t size);
+//builds a font from the NUL terminated BDF file in data, NULL if it's malformed
+//data is modified while parsing
+Font* bdf_load(char* data, uint32_t size);
+
+#endif
@@ -1,188 +1,371 @@
-#include <std/std.h>
-#include <gfx/lib/gfx.h>
-#include <gfx/lib/view.h>
+#include "font.h"
 #include "font8x8.h"
+#include "psf.h"
+#include "bdf.h"
+#include "text_layout.h"
+#include <std/std.h>
 #include <std/math.h>
+#include <std/kheap.h>
+#include <std/array_m.h>
+#include <gfx/lib/gfx.h>
+#include <gfx/lib/pixels.h>
+#include <kernel/util/mutex/mutex.h>
+#include <kernel/util/vfs/fs.h>
+
+//most fonts which can be loaded at once
+#define FONT_MAX 16
 
-//TODO configurable SSAA factor?
-#define SSAA_FACTOR 4
+static Font* builtin_font = NULL;
+static array_m* fonts = NULL;
 
-//check if a given pixel at x/y is set in character bitmap of font
-static bool font_px_on(char ch, int x, int y) {
-	char font_row = font8x8_basic[(int)ch][y];
-	//is pixel at idx x in row at y on?
-	if ((font_row >> x) & 1) {
-		return true;
+//the 8x8 table stores the leftmost pixel in the low bit, fonts store it in the high bit
+static uint8_t reverse_bits(uint8_t byte) {
+	uint8_t reversed = 0;
+	for (int i = 0; i < 8; i++) {
+		if (byte & (1 << i)) reversed |= 0x80 >> i;
 	}
-	return false;
+	return reversed;
 }
 
-//generate supersampled bitmap of font character
-static void generate_supersampled_map(uint32_t* supersample, char ch) {
-	//memset(supersample, 0, sizeof(supersample));
+static Font* builtin_font_create() {
+	Font* font = kmalloc(sizeof(Font));
+	memset(font, 0, sizeof(Font));
+	strcpy(font->name, "builtin 8x8");
+	font->size = CHAR_HEIGHT;
+	font->ascent = CHAR_HEIGHT;
+	font->line_height = CHAR_HEIGHT + CHAR_PADDING_H;
 
-	//for every col in SS bitmap
-	for (int y = 0; y < CHAR_HEIGHT * SSAA_FACTOR; y++) {
-		uint32_t ssaa_row = 0;
+	for (int ch = 0; ch < FONT_GLYPH_COUNT; ch++) {
+		font_glyph* glyph = &font->glyphs[ch];
+		glyph->bitmap = kmalloc(CHAR_HEIGHT);
+		for (int y = 0; y < CHAR_HEIGHT; y++) {
+			glyph->bitmap[y] = reverse_bits(font8x8_basic[ch][y]);
+		}
+		glyph->width = CHAR_WIDTH;
+		glyph->height = CHAR_HEIGHT;
+		glyph->advance = CHAR_WIDTH + CHAR_PADDING_W;
+	}
+	return font;
+}
 
-		//get row from sampled bitmap
-		int font_row = font8x8_basic[(int)ch][y / SSAA_FACTOR];
+static void fonts_init() {
+	if (fonts) return;
+	builtin_font = builtin_font_create();
+	fonts = array_m_create(FONT_MAX);
+	array_m_insert(fonts, builtin_font);
+}
 
-		//for every row in SS bitmap
-		for (int x = 0; x < CHAR_WIDTH * SSAA_FACTOR; x++) {
-			//copy state of sampled bitmap
-			if ((font_row >> (x / SSAA_FACTOR)) & 1) {
-				ssaa_row |= (1 << x);
-			}
+static bool has_suffix(char* str, char* suffix) {
+	int len = strlen(str);
+	int suffix_len = strlen(suffix);
+	if (len < suffix_len) return false;
+	return !strcmp(str + len - suffix_len, suffix);
+}
+
+void font_install() {
+	printf_info("Loading fonts...");
+	fonts_init();
+
+	fs_node_t* dir = fs_lookup(fs_root, FONT_DIRECTORY);
+	if (!dir || (dir->flags & 0x7) != FS_DIRECTORY) {
+		printf_info("No %s, using the built in font", FONT_DIRECTORY);
+		return;
+	}
+
+	struct dirent* entry;
+	for (int i = 0; (entry = readdir_fs(dir, i)) != 0; i++) {
+		if (!has_suffix(entry->name, ".bdf") && !has_suffix(entry->name, ".psf") && !has_suffix(entry->name, ".psfu")) continue;
+		if (fonts->size >= FONT_MAX) {
+			printf_err("font_install(): more than %d fonts, skipping %s", FONT_MAX, entry->name);
+			break;
 		}
-		supersample[y] = ssaa_row;
+
+		char path[192];
+		strcpy(path, FONT_DIRECTORY "/");
+		strcat(path, entry->name);
+		Font* font = font_load(path);
+		if (!font) continue;
+
+		array_m_insert(fonts, font);
+		printf_info("Loaded font %s, %dpx", font->name, font->size);
 	}
 }
 
-void draw_char(ca_layer* layer, char ch, int x, int y, Color color, Size font_size) {
-	Point p = point_make(x, y);
-	if (p.x < 0 || p.y < 0 || p.x >= layer->size.width || p.y >= layer->size.height) return;
+Font* font_load(char* path) {
+	fs_node_t* node = fs_lookup(fs_root, path);
+	if (!node || !node->length) {
+		printf_err("font_load(): couldn't find %s", path);
+		return NULL;
+	}
 
-	//find scale factor of default font size to size requested
-	int scale_x = font_size.width / CHAR_WIDTH;
-	int scale_y = font_size.height / CHAR_HEIGHT;
+	//parsers get the whole file, NUL terminated so BDF's text can be walked as strings
+	uint32_t size = node->length;
+	uint8_t* data = kmalloc(size + 1);
+	if (read_fs(node, 0, size, data) != size) {
+		printf_err("font_load(): couldn't read %s", path);
+		kfree(data);
+		return NULL;
+	}
+	data[size] = '\0';
 
-	uint32_t supersample[CHAR_HEIGHT * SSAA_FACTOR] = {0};
-	generate_supersampled_map(supersample, ch);
+	Font* font = NULL;
+	if (psf_detect(data, size)) {
+		font = psf_load(data, size);
+	}
+	else if (bdf_detect((char*)data, size)) {
+		font = bdf_load((char*)data, size);
+	}
+	else {
+		printf_err("font_load(): %s isn't a PSF2 or BDF font", path);
+	}
+	kfree(data);
 
-	//TODO bg_color should adapt to actual background color of dest layer
-	Color bg_color = color_white();
+	if (font && !font->name[0]) {
+		strcpy(font->name, node->name);
+	}
+	return font;
+}
+
+void font_destroy(Font* font) {
+	if (!font) return;
+	for (int i = 0; i < FONT_GLYPH_COUNT; i++) {
+		kfree(font->glyphs[i].bitmap);
+	}
+	kfree(font->kerning);
+	kfree(font);
+}
+
+Font* font_find(int pixel_size) {
+	fonts_init();
+
+	Font* best = NULL;
+	Font* smallest = NULL;
+	for (int i = 0; i < fonts->size; i++) {
+		Font* font = array_m_lookup(fonts, i);
+		if (!smallest || font->size < smallest->size) {
+			smallest = font;
+		}
+		if (font->size <= pixel_size && (!best || font->size > best->size)) {
+			best = font;
+		}
+	}
+	return best ?: smallest;
+}
+
+int font_scale(Font* font, int pixel_size) {
+	return MAX(pixel_size / font->size, 1);
+}
+
+font_glyph* font_glyph_get(Font* font, char ch) {
+	//blank characters like the space have an advance but no bitmap
+	int idx = (uint8_t)ch;
+	if (idx < FONT_GLYPH_COUNT && (font->glyphs[idx].bitmap || font->glyphs[idx].advance)) {
+		return &font->glyphs[idx];
+	}
+	if (font->glyphs['?'].bitmap) {
+		return &font->glyphs['?'];
+	}
+	return &font->glyphs[' '];
+}
+
+int font_kerning(Font* font, char left, char right) {
+	//binary search of the sorted pairs
+	int low = 0;
+	int high = font->kerning_count - 1;
+	uint16_t key = ((uint8_t)left << 8) | (uint8_t)right;
+	while (low <= high) {
+		int mid = (low + high) / 2;
+		kern_pair* pair = &font->kerning[mid];
+		uint16_t mid_key = (pair->left << 8) | pair->right;
+		if (mid_key == key) return pair->adjust;
+		if (mid_key < key) {
+			low = mid + 1;
+		}
+		else {
+			high = mid - 1;
+		}
+	}
+	return 0;
+}
+
+//is the pixel at x/y of glyph's bitmap set?
+//pixels outside the bitmap are off
+static bool glyph_px_on(font_glyph* glyph, int x, int y) {
+	if (x < 0 || y < 0 || x >= glyph->width || y >= glyph->height) return false;
+	int stride = (glyph->width + 7) / 8;
+	return (glyph->bitmap[(y * stride) + (x / 8)] >> (7 - (x % 8))) & 1;
+}
+
+//rasterized glyphs are kept so that drawing text is a masked copy
+//direct mapped, a glyph which lands on a taken slot replaces what was there
+#define GLYPH_CACHE_SLOTS 256
+
+typedef struct glyph_raster {
+	//what the glyph was rasterized for
+	Font* font;
+	char ch;
+	int scale;
+	uint32_t fg;
+	uint32_t bg;
+	pixel_format format;
+
+	//size.width * size.height of each
+	Size size;
+	uint32_t* pixels; //text color blended over background by coverage, already in format
+	uint8_t* mask; //nonzero where the character covers
+} glyph_raster;
 
-	for (int y = 0; y < font_size.height; y++) {
-		//get the corresponding y of default font size
-		int font_y = y / scale_y;
-		if (font_y >= CHAR_HEIGHT) continue;
+static glyph_raster* glyph_cache[GLYPH_CACHE_SLOTS];
+static lock_t* glyph_lock = NULL;
 
-		for (int x = 0; x < font_size.width; x++) {
-			//corresponding x of default font size
-			int font_x = x / scale_x;
+static uint32_t glyph_hash(Font* font, char ch, int scale, uint32_t fg, uint32_t bg) {
+	uint32_t hash = (uint32_t)font;
+	hash = hash * 31 + (uint8_t)ch;
+	hash = hash * 31 + scale;
+	hash = hash * 31 + fg;
+	hash = hash * 31 + bg;
+	return hash % GLYPH_CACHE_SLOTS;
+}
+
+static void glyph_raster_destroy(glyph_raster* raster) {
+	kfree(raster->pixels);
+	kfree(raster->mask);
+	kfree(raster);
+}
+
+static glyph_raster* glyph_rasterize(Font* font, char ch, int scale, Color color, Color bg_color, pixel_format format) {
+	font_glyph* glyph = font_glyph_get(font, ch);
+
+	glyph_raster* raster = kmalloc(sizeof(glyph_raster));
+	raster->font = font;
+	raster->ch = ch;
+	raster->scale = scale;
+	raster->fg = color_hex(color);
+	raster->bg = color_hex(bg_color);
+	raster->format = format;
+	raster->size = size_make(glyph->bitmap ? glyph->width * scale : 0, glyph->bitmap ? glyph->height * scale : 0);
+
+	int area = raster->size.width * raster->size.height;
+	raster->pixels = kmalloc(MAX(area, 1) * sizeof(uint32_t));
+	raster->mask = kmalloc(MAX(area, 1));
+	memset(raster->mask, 0, MAX(area, 1));
 
-			//skip this pixel if it isn't set in font
-			if (!font_px_on(ch, font_x, font_y)) continue;
+	for (int font_y = 0; font_y < raster->size.height / scale; font_y++) {
+		for (int font_x = 0; font_x < raster->size.width / scale; font_x++) {
+			if (!glyph_px_on(glyph, font_x, font_y)) continue;
 
 			//antialiasing
-			//holds number of 'on' pixels in supersampled region
-			//'on' pixels / total pixel count in SSAA region = alpha of pixel to draw
-			int on_count = 0;
-			int total_count = 0;
-
-			//go around all supersampled pixels adjacent to current and
-			//(square of 9 pixels)
-			//record any 'on' pixels in supersample
-			for (int dx = -1; dx <= 1; dx++) {
-				for (int dy = -1; dy <= 1; dy++) {
-					int ssaa_x = (font_x * SSAA_FACTOR) + dx;
-					int ssaa_y = (font_y * SSAA_FACTOR) + dy;
-
-					uint32_t ssaa_row = supersample[ssaa_y];
-					total_count++;
-					if ((ssaa_row >> ssaa_x) & 1) {
-						on_count++;
-					}
-				}
+			//coverage of a 3x3 sample around the top left of this pixel, with the bitmap supersampled 4x
+			//so this pixel counts 4 samples, those left and above 2 each, and the one diagonally 1
+			int on_count = 4;
+			int total_count = 9;
+			on_count += glyph_px_on(glyph, font_x - 1, font_y) * 2;
+			on_count += glyph_px_on(glyph, font_x, font_y - 1) * 2;
+			on_count += glyph_px_on(glyph, font_x - 1, font_y - 1);
+
+			//lerp of background color to text color, at alpha
+			Color avg_color = color;
+			for (int i = 0; i < 3; i++) {
+				int from = bg_color.val[i];
+				int to = color.val[i];
+				avg_color.val[i] = ((from * total_count) + ((to - from) * on_count)) / total_count;
 			}
+			uint32_t shade = (format == PIXEL_FORMAT_INDEXED8) ? avg_color.val[0] : pixel_format_opaque(format, color_hex(avg_color));
 
-			//'on' pixels / total pixel count in SSAA region = alpha of pixel to draw
-			float alpha = (float)on_count / (float)total_count;
-			//if (alpha) {
-				Color avg_color = color;
-				//set avg_color to color * alpha
-				//this is a lerp of background color to text color, at alpha
-				for (int i = 0; i < gfx_bpp(); i++) {
-					avg_color.val[i] = lerp(bg_color.val[i], avg_color.val[i], alpha);
+			//every pixel scaled up from one font pixel gets the same color
+			for (int y = font_y * scale; y < (font_y + 1) * scale; y++) {
+				for (int x = font_x * scale; x < (font_x + 1) * scale; x++) {
+					int idx = (y * raster->size.width) + x;
+					raster->mask[idx] = 1;
+					raster->pixels[idx] = shade;
 				}
-				putpixel(layer, p.x + x, p.y + y, avg_color);
-			//}
+			}
 		}
 	}
+	return raster;
 }
 
-//returns first pointer to a string that looks like a web link in 'str', 
-//or NULL if none is found
-static char* link_hueristic(char* str) {
-	static char link_stubs[2][16] = {"http",
-									 "www",
-	};
-	char* test = NULL;
-	//check if this matches any link hints
-	for (uint32_t i = 0; i < sizeof(link_stubs) / sizeof(link_stubs[0]); i++) {
-		test = strstr(str, link_stubs[i]);
-		//match?
-		if (test) {
-			break;
-		}
+//returns the cached raster for these parameters, rasterizing it if needed
+//glyph_lock must be held, the raster stays valid until it's released
+static glyph_raster* glyph_lookup(Font* font, char ch, int scale, Color color, Color bg_color, pixel_format format) {
+	uint32_t fg = color_hex(color);
+	uint32_t bg = color_hex(bg_color);
+	glyph_raster** slot = &glyph_cache[glyph_hash(font, ch, scale, fg, bg)];
+	glyph_raster* raster = *slot;
+	if (raster && raster->font == font && raster->ch == ch && raster->scale == scale &&
+		raster->fg == fg && raster->bg == bg && raster->format == format) {
+		return raster;
 	}
-	return test;
+
+	if (raster) glyph_raster_destroy(raster);
+	*slot = glyph_rasterize(font, ch, scale, color, bg_color, format);
+	return *slot;
 }
 
-void draw_string(ca_layer* dest, char* str, Point origin, Color color, Size font_size) {
-	//get a pointer to location of a web link in this string, if any
-	char* link_loc = link_hueristic(str);
-
-	int idx = 0;
-	int x = origin.x;
-	int y = origin.y;
-
-	//scale font parameters to size requested
-	int scale_x = font_size.width / CHAR_WIDTH;
-	int scale_y = font_size.height / CHAR_HEIGHT;
-	int padding_w = CHAR_PADDING_W * scale_x;
-	int padding_h = CHAR_PADDING_H * scale_y;
-
-	while (str[idx]) {
-		bool inserting_hyphen = false;
-		//do we need to break a word onto 2 lines?
-		if ((x + font_size.width + padding_w + 1) >= dest->size.width) {
-			//don't bother if it was puncutation anyways
-			if (str[idx] != ' ') {
-				inserting_hyphen = true;
-			}
-		}
-		else if (str[idx] == '\n') {
-			x = 0;
+//copies the covered pixels of raster to layer at x, y, clipped to layer
+static void glyph_blit(ca_layer* layer, glyph_raster* raster, int x, int y) {
+	int bpp = layer_bpp(layer);
+	int left = MAX(-x, 0);
+	int top = MAX(-y, 0);
+	int width = MIN(raster->size.width, layer->size.width - x);
+	int height = MIN(raster->size.height, layer->size.height - y);
 
-			//quit if going to next line would exceed view bounds
-			if ((y + font_size.height + padding_h + 1) >= dest->size.height) break;
-			y += font_size.height + padding_h;
-		}
+	for (int row = top; row < height; row++) {
+		uint32_t* src = raster->pixels + (row * raster->size.width);
+		uint8_t* mask = raster->mask + (row * raster->size.width);
+		uint8_t* dst = layer->raw + ((((y + row) * layer->size.width) + x) * bpp);
 
-		//if this is a link, draw blue
-		Color draw_color = color;
-		//are we currently drawing a link?
-		if (link_loc && idx >= (link_loc - str)) {
-			//reset link state on whitespace, newline, or if this is the last line
-			if (isspace(str[idx]) || str[idx] == '\n' || str[idx+1] == '\0') {
-				link_loc = NULL;
+		//copy each run of covered pixels at once
+		int col = left;
+		while (col < width) {
+			if (!mask[col]) {
+				col++;
+				continue;
+			}
+			int run = col;
+			while (run < width && mask[run]) run++;
+
+			if (bpp == 1) {
+				for (int i = col; i < run; i++) {
+					dst[i] = src[i];
+				}
 			}
 			else {
-				//blue for link!
-				draw_color = color_make(0, 0, 0xEE);
-				//underline
-				//draw_hline_fast(dest, line_make(point_make(x, y), point_make(x+1, y)), draw_color, 1);
+				pixels_copy((uint32_t*)dst + col, src + col, run - col);
 			}
+			col = run;
 		}
+	}
+}
+
+void font_draw_glyph(ca_layer* layer, Font* font, int scale, char ch, Point pen, Color color) {
+	font_glyph* glyph = font_glyph_get(font, ch);
+	if (!glyph->bitmap) return;
 
-		if (inserting_hyphen) {
-			draw_char(dest, '-', x, y, draw_color, font_size);
-			//drew hyphen, continue without drawing current character in input string
-			
-			x = 0;
+	//TODO bg_color should adapt to actual background color of dest layer
+	Color bg_color = color_white();
 
-			//quit if going to next line would exceed view bounds
-			if ((y + font_size.height + padding_h + 1) >= dest->size.height) break;
-			y += font_size.height + padding_h;
+	if (!glyph_lock) glyph_lock = lock_create();
+	lock(glyph_lock);
+	glyph_raster* raster = glyph_lookup(font, ch, scale, color, bg_color, layer->format);
+	glyph_blit(layer, raster, pen.x + (glyph->x_offset * scale), pen.y + (glyph->y_offset * scale));
+	unlock(glyph_lock);
+}
 
-			continue;
-		}
+void draw_char(ca_layer* layer, char ch, int x, int y, Color color, Size font_size) {
+	Point p = point_make(x, y);
+	if (p.x < 0 || p.y < 0 || p.x >= layer->size.width || p.y >= layer->size.height) return;
 
-		draw_char(dest, str[idx], x, y, draw_color, font_size);
+	Font* font = font_find(font_size.height);
+	font_draw_glyph(layer, font, font_scale(font, font_size.height), ch, p, color);
+}
 
-		x += font_size.width + padding_w;
-		idx++;
-	}
+void draw_string(ca_layer* dest, char* str, Point origin, Color color, Size font_size) {
+	Font* font = font_find(font_size.height);
+	Size bounds = size_make(dest->size.width - origin.x, dest->size.height - origin.y);
+	if (bounds.width <= 0 || bounds.height <= 0) return;
+
+	text_layout* layout = text_layout_create(str, font, font_scale(font, font_size.height), bounds);
+	text_layout_draw(dest, layout, origin, color);
+	text_layout_destroy(layout);
 }
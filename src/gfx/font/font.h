@@ -10,10 +10,69 @@
 #define CHAR_PADDING_W 0
 #define CHAR_PADDING_H 6
 
+//fonts cover ASCII
+#define FONT_GLYPH_COUNT 128
+//directory of the initrd fonts are loaded from
+#define FONT_DIRECTORY "/fonts"
+
+typedef struct font_glyph {
+	//rows of (width + 7) / 8 bytes, the high bit of each byte is leftmost
+	//NULL if the font has no such character
+	uint8_t* bitmap;
+	int width;
+	int height;
+	int x_offset; //from the pen to the left edge of the bitmap
+	int y_offset; //from the top of the line to the top of the bitmap
+	int advance; //how far the pen moves past this character
+} font_glyph;
+
+//adjustment to the advance between two characters
+typedef struct kern_pair {
+	uint8_t left;
+	uint8_t right;
+	int8_t adjust;
+} kern_pair;
+
+//a bitmap font at one pixel size
+typedef struct font {
+	char name[64];
+	int size; //pixel size the font was drawn for
+	int ascent; //pixels from the top of a line to the baseline
+	int line_height; //pixels from the top of one line to the next
+	font_glyph glyphs[FONT_GLYPH_COUNT];
+
+	kern_pair* kerning; //sorted by left then right character
+	int kerning_count;
+} Font;
+
+//sets up the built in 8x8 font and loads every PSF2 or BDF font in FONT_DIRECTORY
+//needs the initrd mounted, text drawn before then uses the built in font only
+void font_install();
+
+//reads a PSF2 or BDF font from path, NULL if it isn't one
+Font* font_load(char* path);
+void font_destroy(Font* font);
+
+//the loaded font best suited to drawing text pixel_size tall
+//that's the largest no bigger than pixel_size, or the smallest there is
+Font* font_find(int pixel_size);
+//integer factor to scale font by for text pixel_size tall
+int font_scale(Font* font, int pixel_size);
+
+//glyph to draw ch with, falling back to '?' and then a blank space
+font_glyph* font_glyph_get(Font* font, char ch);
+//change in advance when right is drawn after left
+int font_kerning(Font* font, char left, char right);
+
+//draws ch with the pen at pen, the top left of where the line starts at this character
+//characters are rasterized once per font, scale and color, then copied from a cache
+void font_draw_glyph(ca_layer* layer, Font* font, int scale, char ch, Point pen, Color color);
+
 //write an ASCII character to a ca_layer with given origin and color
 void draw_char(ca_layer* layer, char ch, int x, int y, Color color, Size font_size);
 //write the string pointed to by str to ca_layer starting at given origin
-//draw_string natively provides hyphen and hyperlink formatting support
+//words are wrapped to fit dest, or hyphenated if they can't fit a line, and web links are drawn blue
+//text drawn repeatedly should keep a text_layout instead, see text_layout.h
 void draw_string(ca_layer* dest, char* str, Point origin, Color color, Size font_size);
 
 #endif
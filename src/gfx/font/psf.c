@@ -0,0 +1,71 @@
+#include "psf.h"
+#include <std/std.h>
+#include <std/kheap.h>
+
+//unicode table separators
+#define PSF2_SEPARATOR	0xFF //ends a glyph's entry
+#define PSF2_SEQUENCE	0xFE //starts a sequence of combining characters
+
+bool psf_detect(uint8_t* data, uint32_t size) {
+	return size >= sizeof(psf2_header) && ((psf2_header*)data)->magic == PSF2_MAGIC;
+}
+
+static void psf_set_glyph(Font* font, psf2_header* header, uint8_t* data, uint32_t glyph, uint8_t ch) {
+	if (ch >= FONT_GLYPH_COUNT || glyph >= header->glyph_count) return;
+	//the first glyph listed for a character wins
+	if (font->glyphs[ch].bitmap) return;
+
+	font_glyph* dest = &font->glyphs[ch];
+	dest->bitmap = kmalloc(header->glyph_size);
+	memcpy(dest->bitmap, data + header->header_size + (glyph * header->glyph_size), header->glyph_size);
+	dest->width = header->width;
+	dest->height = header->height;
+	dest->advance = header->width;
+}
+
+Font* psf_load(uint8_t* data, uint32_t size) {
+	psf2_header* header = (psf2_header*)data;
+	uint32_t stride = (header->width + 7) / 8;
+	if (!header->width || !header->height || header->glyph_size < stride * header->height) {
+		printf_err("psf_load(): bad glyph size %dx%d in %d bytes", header->width, header->height, header->glyph_size);
+		return NULL;
+	}
+	uint32_t glyphs_end = header->header_size + (header->glyph_count * header->glyph_size);
+	if (header->header_size < sizeof(psf2_header) || glyphs_end > size) {
+		printf_err("psf_load(): glyphs run past the end of the file");
+		return NULL;
+	}
+
+	Font* font = kmalloc(sizeof(Font));
+	memset(font, 0, sizeof(Font));
+	font->size = header->height;
+	font->ascent = header->height;
+	font->line_height = header->height;
+
+	if (!(header->flags & PSF2_HAS_UNICODE_TABLE)) {
+		//glyphs are in character order
+		for (uint32_t i = 0; i < FONT_GLYPH_COUNT; i++) {
+			psf_set_glyph(font, header, data, i, i);
+		}
+		return font;
+	}
+
+	//each glyph's entry lists the UTF-8 characters it draws, then any combining sequences
+	//only single byte characters are ASCII, multibyte ones and sequences are skipped
+	uint8_t* table = data + glyphs_end;
+	uint8_t* end = data + size;
+	for (uint32_t glyph = 0; glyph < header->glyph_count && table < end; glyph++) {
+		bool in_sequence = false;
+		while (table < end && *table != PSF2_SEPARATOR) {
+			uint8_t byte = *table++;
+			if (byte == PSF2_SEQUENCE) {
+				in_sequence = true;
+			}
+			else if (!in_sequence && byte < 0x80) {
+				psf_set_glyph(font, header, data, glyph, byte);
+			}
+		}
+		table++;
+	}
+	return font;
+}
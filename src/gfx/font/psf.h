@@ -0,0 +1,28 @@
+#ifndef PSF_H
+#define PSF_H
+
+#include "font.h"
+
+//PC Screen Font version 2, the Linux console's bitmap format
+//every glyph shares one size, so the font is monospaced and has no kerning
+
+#define PSF2_MAGIC 0x864AB572
+//the file ends with a table mapping each glyph to the characters it draws
+#define PSF2_HAS_UNICODE_TABLE 0x01
+
+typedef struct psf2_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size; //offset of the first glyph
+	uint32_t flags;
+	uint32_t glyph_count;
+	uint32_t glyph_size; //bytes per glyph
+	uint32_t height;
+	uint32_t width;
+} psf2_header;
+
+bool psf_detect(uint8_t* data, uint32_t size);
+//builds a font from the PSF2 file in data, NULL if it's malformed
+Font* psf_load(uint8_t* data, uint32_t size);
+
+#endif
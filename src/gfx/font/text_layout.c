@@ -0,0 +1,179 @@
+#include "text_layout.h"
+#include <std/std.h>
+#include <std/math.h>
+#include <std/kheap.h>
+
+//returns first pointer to a string that looks like a web link in 'str', 
+//or NULL if none is found
+static char* link_hueristic(char* str) {
+	static char link_stubs[2][16] = {"http",
+									 "www",
+	};
+	char* test = NULL;
+	//check if this matches any link hints
+	for (uint32_t i = 0; i < sizeof(link_stubs) / sizeof(link_stubs[0]); i++) {
+		test = strstr(str, link_stubs[i]);
+		//match?
+		if (test) {
+			break;
+		}
+	}
+	return test;
+}
+
+//pen movement for ch, with the kerning against the character before it
+static int char_advance(Font* font, int scale, char prev, char ch) {
+	int advance = font_glyph_get(font, ch)->advance;
+	if (prev) advance += font_kerning(font, prev, ch);
+	return advance * scale;
+}
+
+//width of the word starting at str, up to the next space or newline
+static int word_width(Font* font, int scale, char* str) {
+	int width = 0;
+	char prev = 0;
+	for (; *str && !isspace(*str); str++) {
+		width += char_advance(font, scale, prev, *str);
+		prev = *str;
+	}
+	return width;
+}
+
+//state while laying out
+typedef struct layout_pen {
+	text_layout* layout;
+	int line_height;
+	int glyph_height;
+	Point pos;
+	char prev; //character before this one on the line, for kerning
+} layout_pen;
+
+//moves pen to the start of the next line
+//returns false if that line wouldn't fit in the layout's bounds
+static bool layout_newline(layout_pen* pen) {
+	int y = pen->pos.y + pen->line_height;
+	if (y + pen->glyph_height > pen->layout->bounds.height) return false;
+	pen->pos = point_make(0, y);
+	pen->prev = 0;
+	return true;
+}
+
+static void layout_place(layout_pen* pen, char ch, bool link) {
+	text_layout* layout = pen->layout;
+	//kerning against the character before moves this one
+	if (pen->prev) {
+		pen->pos.x += font_kerning(layout->font, pen->prev, ch) * layout->scale;
+	}
+
+	if (!isspace(ch)) {
+		text_glyph* glyph = &layout->glyphs[layout->count++];
+		glyph->ch = ch;
+		glyph->pen = pen->pos;
+		glyph->link = link;
+	}
+
+	pen->pos.x += font_glyph_get(layout->font, ch)->advance * layout->scale;
+	pen->prev = ch;
+	layout->size.width = MAX(layout->size.width, pen->pos.x);
+	layout->size.height = MAX(layout->size.height, pen->pos.y + pen->glyph_height);
+}
+
+text_layout* text_layout_create(char* str, Font* font, int scale, Size bounds) {
+	text_layout* layout = kmalloc(sizeof(text_layout));
+	memset(layout, 0, sizeof(text_layout));
+	layout->font = font;
+	layout->scale = scale;
+	layout->bounds = bounds;
+	//every character, plus at most a hyphen each
+	layout->glyphs = kmalloc(((strlen(str) * 2) + 1) * sizeof(text_glyph));
+
+	layout_pen pen;
+	pen.layout = layout;
+	pen.line_height = font->line_height * scale;
+	pen.glyph_height = font->size * scale;
+	pen.pos = point_zero();
+	pen.prev = 0;
+
+	//get a pointer to location of a web link in this string, if any
+	char* link_loc = link_hueristic(str);
+	int hyphen_width = char_advance(font, scale, 0, '-');
+
+	for (char* ch = str; *ch; ch++) {
+		if (*ch == '\n') {
+			if (!layout_newline(&pen)) break;
+			continue;
+		}
+
+		//are we currently drawing a link?
+		bool link = false;
+		if (link_loc && ch >= link_loc) {
+			//reset link state on whitespace, or if this is the last character
+			if (isspace(*ch) || ch[1] == '\0') {
+				link_loc = NULL;
+			}
+			else {
+				link = true;
+			}
+		}
+
+		//spaces which would end a line are dropped along with the break
+		if (isspace(*ch)) {
+			if (pen.pos.x + char_advance(font, scale, pen.prev, *ch) > bounds.width) {
+				if (!layout_newline(&pen)) break;
+				continue;
+			}
+			layout_place(&pen, *ch, link);
+			continue;
+		}
+
+		//move a word that doesn't fit the rest of this line onto the next, if it'd fit there
+		bool word_start = ch == str || isspace(ch[-1]);
+		if (word_start && pen.pos.x > 0) {
+			int width = word_width(font, scale, ch);
+			if (pen.pos.x + width > bounds.width && width <= bounds.width) {
+				if (!layout_newline(&pen)) break;
+			}
+		}
+
+		//a word too long for any line is broken with a hyphen, once the rest of it won't fit
+		int advance = char_advance(font, scale, pen.prev, *ch);
+		if (pen.pos.x > 0 && pen.pos.x + advance + hyphen_width > bounds.width &&
+			pen.pos.x + word_width(font, scale, ch) > bounds.width) {
+			if (!word_start) {
+				pen.prev = 0;
+				layout_place(&pen, '-', link);
+			}
+			if (!layout_newline(&pen)) break;
+		}
+		layout_place(&pen, *ch, link);
+	}
+	return layout;
+}
+
+void text_layout_destroy(text_layout* layout) {
+	if (!layout) return;
+	kfree(layout->glyphs);
+	kfree(layout);
+}
+
+bool text_layout_matches(text_layout* layout, Font* font, int scale, Size bounds) {
+	return layout->font == font && layout->scale == scale &&
+		   layout->bounds.width == bounds.width && layout->bounds.height == bounds.height;
+}
+
+Size text_measure(char* str, Font* font, int scale, Size bounds) {
+	text_layout* layout = text_layout_create(str, font, scale, bounds);
+	Size size = layout->size;
+	text_layout_destroy(layout);
+	return size;
+}
+
+void text_layout_draw(ca_layer* dest, text_layout* layout, Point origin, Color color) {
+	//blue for link!
+	Color link_color = color_make(0, 0, 0xEE);
+	for (int i = 0; i < layout->count; i++) {
+		text_glyph* glyph = &layout->glyphs[i];
+		Point pen = point_make(origin.x + glyph->pen.x, origin.y + glyph->pen.y);
+		font_draw_glyph(dest, layout->font, layout->scale, glyph->ch, pen, glyph->link ? link_color : color);
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef TEXT_LAYOUT_H
+#define TEXT_LAYOUT_H
+
+#include "font.h"
+
+//where each character of a string goes once it's been wrapped to fit an area
+//laying out is the costly part of drawing text, so anything drawn repeatedly keeps its layout
+
+typedef struct text_glyph {
+	char ch;
+	Point pen; //top left of the line where the character starts, relative to the layout's origin
+	bool link; //part of a web link, drawn blue
+} text_glyph;
+
+typedef struct text_layout {
+	//what the layout was made for
+	Font* font;
+	int scale;
+	Size bounds;
+
+	Size size; //area the placed characters take up
+	int count;
+	text_glyph* glyphs; //visible characters only, spaces just move the pen
+} text_layout;
+
+//wraps str to bounds, breaking lines at spaces and newlines
+//words too long for a line are hyphenated, and lines which wouldn't fit below bounds are dropped
+text_layout* text_layout_create(char* str, Font* font, int scale, Size bounds);
+void text_layout_destroy(text_layout* layout);
+
+//true if layout was made with these parameters, so it can be reused rather than laid out again
+bool text_layout_matches(text_layout* layout, Font* font, int scale, Size bounds);
+
+//size str would take up wrapped to bounds
+Size text_measure(char* str, Font* font, int scale, Size bounds);
+
+//draws layout with its origin at origin in dest
+void text_layout_draw(ca_layer* dest, text_layout* layout, Point origin, Color color);
+
+#endif
@@ -29,9 +29,14 @@ Bmp* load_bmp(Rect frame, char* filename) {
 	}
 
 	unsigned char header[54];
-	fread(&header, sizeof(char), 54, file);
+	if (fread(&header, sizeof(char), 54, file) != 54) {
+		printk_err("%s is too short to be a BMP", filename);
+		fclose(file);
+		return NULL;
+	}
 
-	//get width and height from header
+	//get pixel data offset, width and height from header
+	uint32_t data_offset = *(uint32_t*)&header[10];
 	int file_width, file_height;
 	int width = file_width = *(int*)&header[18];
 	int height = file_height = *(int*)&header[22];
@@ -41,40 +46,57 @@ Bmp* load_bmp(Rect frame, char* filename) {
 	height = MIN(height, frame.size.height);
 	printk_info("loading BMP %s with dimensions (%d,%d)", filename, width, height);
 
-	int bpp = gfx_bpp();
 	ca_layer* layer = create_layer(size_make(width, height));
+	int bpp = layer_bpp(layer);
 	printk_dbg("load_bmp() got layer %x", layer);
-	//image is upside down in memory so build array from bottom up
-	for (int y = file_height; y >= 0; y--) {
-		if (y >= height) {
-			//y is too large to fit in layer
-			//eat bytes of this pixel
-			fgetc(file);
-			fgetc(file);
-			fgetc(file);
-			continue;
-		}
-		for (int x = file_width; x >= 0; x--) {
-			if (x >= width) {
-				//x is too large to fit in layer
-				//eat bytes of this pixel
-				fgetc(file);
-				fgetc(file);
-				fgetc(file);
-				continue;
-			}
 
-			if (y == file_height && x == file_width) continue;
+	//rows are 24bpp BGR, padded to a multiple of 4 bytes
+	int row_size = ((file_width * 3) + 3) & ~3;
+
+	//use the file's memory in place if the filesystem can map it,
+	//otherwise read each row into a bounce buffer
+	uint32_t map_size = file->node->length;
+	uint8_t* mapped = mmap_fs(file->node, 0, map_size);
+	if (mapped && data_offset + (uint32_t)(row_size * file_height) > map_size) {
+		munmap_fs(mapped, map_size);
+		mapped = NULL;
+	}
+	uint8_t* row = mapped ? NULL : kmalloc(row_size);
 
-			int idx = (y * width * bpp) + (x * bpp);
-			if (idx >= width * height * bpp) break;
+	//image is upside down in memory so build array from bottom up
+	fseek(file, data_offset, SEEK_SET);
+	for (int y = file_height - 1; y >= 0; y--) {
+		uint8_t* src;
+		if (mapped) {
+			src = mapped + data_offset + (file_height - 1 - y) * row_size;
+		}
+		else {
+			if (fread(row, row_size, 1, file) != 1) break;
+			src = row;
+		}
+		//rows past the bottom of the frame are dropped
+		if (y >= height) continue;
 
-			//we process 3 bytes at a time because image is stored in BGR, we need RGB
-			layer->raw[idx + 0] = fgetc(file);
-			layer->raw[idx + 1] = fgetc(file);
-			layer->raw[idx + 2] = fgetc(file);
+		uint8_t* dest = layer->raw + (y * width * bpp);
+		if (layer->format == PIXEL_FORMAT_INDEXED8) {
+			//no palette mapping, keep the first channel like the rest of VGA drawing does
+			for (int x = 0; x < width; x++) {
+				dest[x] = src[x * 3];
+			}
+			continue;
+		}
+		//BGR bytes widen to little endian XRGB words
+		uint32_t* dest_px = (uint32_t*)dest;
+		for (int x = 0; x < width; x++) {
+			dest_px[x] = src[x * 3 + 0] | (src[x * 3 + 1] << 8) | (src[x * 3 + 2] << 16);
 		}
 	}
+	if (mapped) {
+		munmap_fs(mapped, map_size);
+	}
+	else {
+		kfree(row);
+	}
 
 	Bmp* bmp = create_bmp(frame, layer);
 	printk_dbg("load_bmp() made bmp %x", bmp);
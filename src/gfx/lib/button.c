@@ -5,6 +5,7 @@
 
 void button_handle_mousedown(Button* button) {
 	button->toggled = true;
+	mark_needs_redraw((View*)button);
 
 	if (button->mousedown_handler) {
 		event_handler handler = button->mousedown_handler;
@@ -14,6 +15,7 @@ void button_handle_mousedown(Button* button) {
 
 void button_handle_mouseup(Button* button) {
 	button->toggled = false;
+	mark_needs_redraw((View*)button);
 
 	if (button->mouseup_handler) {
 		event_handler handler = button->mouseup_handler;
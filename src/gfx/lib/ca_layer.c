@@ -2,6 +2,7 @@
 #include <std/kheap.h>
 #include "gfx.h"
 #include "rect.h"
+#include "pixels.h"
 #include <std/math.h>
 #include <std/memory.h>
 
@@ -12,118 +13,92 @@ void layer_teardown(ca_layer* layer) {
 	kfree(layer);
 }
 
-ca_layer* create_layer(Size size) {
+ca_layer* create_layer_format(Size size, pixel_format format) {
 	ca_layer* ret = (ca_layer*)kmalloc(sizeof(ca_layer));
 	ret->size = size;
+	ret->format = format;
 
-	ret->raw = kmalloc(size.width * size.height * gfx_bpp());
+	ret->raw = kmalloc(size.width * size.height * pixel_format_bpp(format));
 
 	ret->alpha = 1.0;
 	return ret;
 }
 
-void blit_layer_alpha_fast(ca_layer* dest, ca_layer* src, Rect dest_frame, Rect src_frame) {
-	//for every pixel in dest, calculate what the pixel should be based on 
-	//dest's pixel, src's pixel, and the alpha
-	//
-	//offset into dest that we start writing
-	uint8_t* dest_row_start = dest->raw + (rect_min_y(dest_frame) * dest->size.width * gfx_bpp()) + (rect_min_x(dest_frame) * gfx_bpp());
+ca_layer* create_layer(Size size) {
+	return create_layer_format(size, gfx_pixel_format());
+}
 
-	//data from source to write to dest
-	uint8_t* row_start = src->raw + (rect_min_y(src_frame) * src->size.width * gfx_bpp()) + rect_min_x(src_frame) * gfx_bpp();
-	
-	for (int i = 0; i < src_frame.size.height; i++) {
-		uint8_t* dest_px = dest_row_start;
-		uint8_t* row_px = row_start;
-
-		for (int j = 0; j < src_frame.size.width; j++) {
-			//R
-			*dest_px = (*dest_px + *row_px++) / 2;
-			dest_px++;
-			//G
-			*dest_px = (*dest_px + *row_px++) / 2;
-			dest_px++;
-			//B
-			*dest_px = (*dest_px + *row_px++) / 2;
-			dest_px++;
-		}
+//address of pixel at p in layer
+static uint8_t* layer_px(ca_layer* layer, Point p) {
+	return layer->raw + (((p.y * layer->size.width) + p.x) * layer_bpp(layer));
+}
 
-		//next iteration, start at the next row
-		dest_row_start += (dest->size.width * gfx_bpp());
-		row_start += (src->size.width * gfx_bpp());
-	}
+//processes one row of 32bpp pixels, the signature of the pixels_* Porter-Duff loops
+typedef void (*row_func)(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha);
+
+static void copy_row(uint32_t* dst, const uint32_t* src, int count, uint32_t UNUSED(alpha), uint32_t UNUSED(src_alpha)) {
+	pixels_copy(dst, src, count);
 }
 
-void blit_layer_alpha(ca_layer* dest, ca_layer* src, Rect dest_frame, Rect src_frame) {
-	//for every pixel in dest, calculate what the pixel should be based on 
-	//dest's pixel, src's pixel, and the alpha
-	
-	if (src->alpha == 0.5) {
-		blit_layer_alpha_fast(dest, src, dest_frame, src_frame);
-		return;
-	}
+static void blend_row(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t UNUSED(src_alpha)) {
+	pixels_blend(dst, src, count, alpha);
+}
 
+//runs func over each row of src_frame in src and the matching row of dest at dest_frame
+static void composite_rows(ca_layer* dest, ca_layer* src, Rect dest_frame, Rect src_frame, row_func func, uint32_t alpha, uint32_t src_alpha) {
 	//offset into dest that we start writing
-	uint8_t* dest_row_start = dest->raw + (rect_min_y(dest_frame) * dest->size.width * gfx_bpp()) + (rect_min_x(dest_frame) * gfx_bpp());
+	uint32_t* dest_row_start = (uint32_t*)layer_px(dest, dest_frame.origin);
 
 	//data from source to write to dest
-	uint8_t* row_start = src->raw + (rect_min_y(src_frame) * src->size.width * gfx_bpp()) + rect_min_x(src_frame) * gfx_bpp();
-	
-	int alpha = (1 - src->alpha) * 255;
-	for (int i = 0; i < src_frame.size.height; i++) {
-		uint8_t* dest_px = dest_row_start;
-		uint8_t* row_px = row_start;
+	uint32_t* row_start = (uint32_t*)layer_px(src, src_frame.origin);
 
-		for (int j = 0; j < src_frame.size.width; j++) {
-			uint32_t* wide_dest = (uint32_t*)dest_px;
-			uint32_t* wide_row = (uint32_t*)row_px;
-
-			uint32_t rb = *wide_row & 0xFF00FF;
-			uint32_t g = *wide_row & 0x00FF00;
-			rb += ((*wide_dest & 0xFF00FF) - rb) * alpha >> 8;
-			g += ((*wide_dest & 0x00FF00) - g) * alpha >> 8;
-			*wide_dest = (rb & 0xFF00FF) | (g & 0x00FF00) | (*wide_dest & 0xFF000000);
-
-			dest_px += 3;
-			row_px += 3;
-		}
+	for (int i = 0; i < src_frame.size.height; i++) {
+		func(dest_row_start, row_start, src_frame.size.width, alpha, src_alpha);
 
 		//next iteration, start at the next row
-		dest_row_start += (dest->size.width * gfx_bpp());
-		row_start += (src->size.width * gfx_bpp());
+		dest_row_start += dest->size.width;
+		row_start += src->size.width;
 	}
 }
 
+void blit_layer_alpha_fast(ca_layer* dest, ca_layer* src, Rect dest_frame, Rect src_frame) {
+	//an even mix of src and dest, the vector blend makes this no cheaper than any other alpha
+	composite_rows(dest, src, dest_frame, src_frame, blend_row, 128, 0);
+}
+
+void blit_layer_alpha(ca_layer* dest, ca_layer* src, Rect dest_frame, Rect src_frame) {
+	//weight of src, out of 256
+	composite_rows(dest, src, dest_frame, src_frame, blend_row, src->alpha * 256, 0);
+}
+
 void blit_layer_filled(ca_layer* dest, ca_layer* src, Rect dest_frame, Rect src_frame) {
 	//copy row by row
+	int bpp = layer_bpp(src);
 	
 	//offset into dest that we start writing
-	uint8_t* dest_row_start = dest->raw + (rect_min_y(dest_frame) * dest->size.width * gfx_bpp()) + (rect_min_x(dest_frame) * gfx_bpp());
+	uint8_t* dest_row_start = layer_px(dest, dest_frame.origin);
 
 	//data from source to write to dest
-	uint8_t* row_start = src->raw + (rect_min_y(src_frame) * src->size.width * gfx_bpp()) + rect_min_x(src_frame) * gfx_bpp();
+	uint8_t* row_start = layer_px(src, src_frame.origin);
 
 	//copy height - y origin rows
 	for (int i = 0; i < src_frame.size.height; i++) {
 		if (i >= rect_max_y(dest_frame)) break;
 
-		//figure out how many px we can actually transfer over,
-		//in case src_frame exceeds dest
-		int transferabble_px = src_frame.size.width * gfx_bpp();
-		int overhang = (uint32_t)dest_row_start + (uint32_t)row_start + transferabble_px - rect_max_x(dest_frame);
-		//shrink line if necessary
-		if (overhang > 0) {
-			transferabble_px -= overhang;
+		//blit_layer already clipped src_frame to fit in dest
+		if (bpp == 4) {
+			pixels_copy((uint32_t*)dest_row_start, (uint32_t*)row_start, src_frame.size.width);
+		}
+		else {
+			memcpy(dest_row_start, row_start, src_frame.size.width * bpp);
 		}
 
-		memcpy(dest_row_start, row_start, transferabble_px);
-
-		dest_row_start += (dest->size.width * gfx_bpp());
-		row_start += (src->size.width * gfx_bpp());
+		dest_row_start += (dest->size.width * bpp);
+		row_start += (src->size.width * bpp);
 	}
 }
 
-void blit_layer(ca_layer* dest, ca_layer* src, Rect dest_frame, Rect src_frame) {
+void composite_layer(ca_layer* dest, ca_layer* src, Rect dest_frame, Rect src_frame, composite_op op) {
 	//make sure we don't write outside dest's frame
 	rect_min_x(dest_frame) = MAX(0, rect_min_x(dest_frame));
 	rect_min_y(dest_frame) = MAX(0, rect_min_y(dest_frame));
@@ -146,26 +121,71 @@ void blit_layer(ca_layer* dest, ca_layer* src, Rect dest_frame, Rect src_frame)
 	}
 
 	//clip src_frame within dest_frame
-	if (rect_max_x(src_frame) + rect_min_x(dest_frame) >= dest->size.width) {
-		float overhang = rect_max_x(src_frame) + rect_min_x(dest_frame) - dest->size.width;
+	//only its size matters here, src_frame's origin is in src's coordinate space
+	if (src_frame.size.width + rect_min_x(dest_frame) >= dest->size.width) {
+		float overhang = src_frame.size.width + rect_min_x(dest_frame) - dest->size.width;
 		src_frame.size.width -= overhang;
 	}
-	if (rect_max_y(src_frame) + rect_min_y(dest_frame) >= dest->size.height) {
-		float overhang = rect_max_y(src_frame) + rect_min_y(dest_frame) - dest->size.height;
+	if (src_frame.size.height + rect_min_y(dest_frame) >= dest->size.height) {
+		float overhang = src_frame.size.height + rect_min_y(dest_frame) - dest->size.height;
 		src_frame.size.height -= overhang;
 	}
+	if (src_frame.size.width <= 0 || src_frame.size.height <= 0) return;
 
-	if (src->alpha >= 1.0) {
-		//best case, we can just copy rows directly from src to dest
+	//palette indices can't be blended, so indexed layers are always copied as if opaque
+	if (src->format == PIXEL_FORMAT_INDEXED8 || dest->format == PIXEL_FORMAT_INDEXED8) {
 		blit_layer_filled(dest, src, dest_frame, src_frame);
-	}
-	else if (src->alpha <= 0) {
-		//do nothing
 		return;
 	}
-	else {
-		blit_layer_alpha(dest, src, dest_frame, src_frame);
+
+	//the whole layer's opacity, out of 256
+	uint32_t alpha = MAX(MIN(src->alpha, 1.0), 0.0) * 256;
+	//XRGB sources have no alpha of their own, every pixel is opaque
+	uint32_t src_alpha = (src->format == PIXEL_FORMAT_XRGB32) ? PIXEL_ALPHA_OPAQUE : 0;
+	//and neither do XRGB destinations, so src lands on them whole
+	if (dest->format == PIXEL_FORMAT_XRGB32 && op == COMPOSITE_OP_IN) {
+		op = COMPOSITE_OP_SRC;
+	}
+
+	row_func func = NULL;
+	switch (op) {
+		case COMPOSITE_OP_SRC:
+			//only a straight copy if nothing about the pixels needs changing on the way
+			if (alpha == 256 && (src->format == dest->format || dest->format == PIXEL_FORMAT_XRGB32)) {
+				func = copy_row;
+			}
+			else {
+				func = pixels_src;
+			}
+			break;
+		case COMPOSITE_OP_OVER:
+			if (!alpha) {
+				//do nothing
+				return;
+			}
+			if (src->format == PIXEL_FORMAT_XRGB32) {
+				//opaque pixels cover whatever they're over
+				if (alpha == 256) {
+					func = (dest->format == PIXEL_FORMAT_XRGB32) ? copy_row : pixels_src;
+				}
+				else {
+					//an XRGB dest doesn't keep alpha, so the plain blend does
+					func = (dest->format == PIXEL_FORMAT_XRGB32) ? blend_row : pixels_over;
+				}
+			}
+			else {
+				func = pixels_over;
+			}
+			break;
+		case COMPOSITE_OP_IN:
+			func = pixels_in;
+			break;
 	}
+	composite_rows(dest, src, dest_frame, src_frame, func, alpha, src_alpha);
+}
+
+void blit_layer(ca_layer* dest, ca_layer* src, Rect dest_frame, Rect src_frame) {
+	composite_layer(dest, src, dest_frame, src_frame, COMPOSITE_OP_OVER);
 }
 
 ca_layer* layer_snapshot(ca_layer* src, Rect frame) {
@@ -181,19 +201,20 @@ ca_layer* layer_snapshot(ca_layer* src, Rect frame) {
 		frame.size.height -= overhang;
 	}
 
-	ca_layer* snapshot = create_layer(frame.size);
+	ca_layer* snapshot = create_layer_format(frame.size, src->format);
+	int bpp = layer_bpp(src);
 
 	//pointer to current row of snapshot to write to
 	uint8_t* snapshot_row = snapshot->raw;
 	//pointer to start of row currently writing to snapshot
-	uint8_t* row_start = src->raw + (rect_min_y(frame) * src->size.width * gfx_bpp()) + (rect_min_x(frame) * gfx_bpp());
+	uint8_t* row_start = layer_px(src, frame.origin);
 
 	//copy row by row
 	for (int i = 0; i < frame.size.height; i++) {
-		memcpy(snapshot_row, row_start, frame.size.width * gfx_bpp());
+		memcpy(snapshot_row, row_start, frame.size.width * bpp);
 
-		snapshot_row += (snapshot->size.width * gfx_bpp());
-		row_start += (src->size.width * gfx_bpp());
+		snapshot_row += (snapshot->size.width * bpp);
+		row_start += (src->size.width * bpp);
 	}
 
 	return snapshot;
@@ -7,14 +7,51 @@
 
 __BEGIN_DECLS
 
+typedef enum pixel_format {
+	PIXEL_FORMAT_INDEXED8 = 0,	//one VGA palette index per byte
+	PIXEL_FORMAT_XRGB32,		//one 0x00RRGGBB word per pixel, top byte unused
+	PIXEL_FORMAT_ARGB32,		//one 0xAARRGGBB word per pixel, colors premultiplied by alpha
+} pixel_format;
+
+//Porter-Duff operators for putting one layer onto another
+//src's pixels are first scaled by its layer's alpha
+typedef enum composite_op {
+	COMPOSITE_OP_SRC = 0,	//src replaces dest
+	COMPOSITE_OP_OVER,		//src is drawn over dest, dest shows through src's transparent parts
+	COMPOSITE_OP_IN,		//src replaces dest, but only as much of it as dest's alpha covers
+} composite_op;
+
 typedef struct ca_layer_t {
        	Size size;
        	uint8_t* raw;
 		float alpha;
+		pixel_format format;
 } ca_layer;
 
+__attribute__((always_inline))
+inline int pixel_format_bpp(pixel_format format) {
+	return (format == PIXEL_FORMAT_INDEXED8) ? 1 : 4;
+}
+
+//word to store in a 32bpp layer of format for the opaque color 0xRRGGBB
+__attribute__((always_inline))
+inline uint32_t pixel_format_opaque(pixel_format format, uint32_t rgb) {
+	return (format == PIXEL_FORMAT_ARGB32) ? (rgb | 0xFF000000) : rgb;
+}
+
+//bytes per pixel of layer
+__attribute__((always_inline))
+inline int layer_bpp(ca_layer* layer) {
+	return pixel_format_bpp(layer->format);
+}
+
+//creates a layer in the format of the current graphics mode
 struct ca_layer_t* create_layer(Size size);
+struct ca_layer_t* create_layer_format(Size size, pixel_format format);
 void layer_teardown(ca_layer* layer);
+//composites the src_frame part of src onto dest at dest_frame with op
+void composite_layer(ca_layer* dest, ca_layer* src, Rect dest_frame, Rect src_frame, composite_op op);
+//composite_layer with COMPOSITE_OP_OVER
 void blit_layer(ca_layer* dest, ca_layer* src, Rect dest_frame, Rect src_frame);
 ca_layer* layer_snapshot(ca_layer* src, Rect frame);
 
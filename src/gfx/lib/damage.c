@@ -0,0 +1,64 @@
+#include "damage.h"
+#include "gfx.h"
+
+static int rect_area(Rect r) {
+	return r.size.width * r.size.height;
+}
+
+void damage_add(Damage* damage, Rect r) {
+	if (rect_empty(r)) return;
+
+	int i = 0;
+	while (i < damage->count) {
+		Rect existing = damage->rects[i];
+		if (rect_empty(rect_intersect(existing, r))) {
+			i++;
+			continue;
+		}
+		//absorb the overlapping rect, then rescan since the union may now reach rects already passed
+		r = rect_union(existing, r);
+		damage->rects[i] = damage->rects[--damage->count];
+		i = 0;
+	}
+
+	if (damage->count == DAMAGE_MAX_RECTS) {
+		//out of room, fold r into whichever rect it grows the least
+		int best = 0;
+		int best_cost = -1;
+		for (i = 0; i < damage->count; i++) {
+			int cost = rect_area(rect_union(damage->rects[i], r)) - rect_area(damage->rects[i]);
+			if (best_cost < 0 || cost < best_cost) {
+				best = i;
+				best_cost = cost;
+			}
+		}
+		Rect merged = rect_union(damage->rects[best], r);
+		damage->rects[best] = damage->rects[--damage->count];
+		damage_add(damage, merged);
+		return;
+	}
+
+	damage->rects[damage->count++] = r;
+}
+
+void damage_clear(Damage* damage) {
+	damage->count = 0;
+}
+
+bool damage_intersects(Damage* damage, Rect r) {
+	for (int i = 0; i < damage->count; i++) {
+		if (!rect_empty(rect_intersect(damage->rects[i], r))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void mark_damaged(Rect r) {
+	Screen* screen = gfx_screen();
+	if (!screen) return;
+
+	//nothing offscreen ever needs flushing
+	r = rect_intersect(r, rect_make(point_zero(), screen->vmem->size));
+	damage_add(&screen->damage, r);
+}
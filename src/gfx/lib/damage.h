@@ -0,0 +1,31 @@
+#ifndef DAMAGE_H
+#define DAMAGE_H
+
+#include <std/std_base.h>
+#include <stdbool.h>
+#include "rect.h"
+
+__BEGIN_DECLS
+
+//past this many separate rects, new damage is folded into an existing one
+#define DAMAGE_MAX_RECTS 16
+
+//areas of the screen whose contents changed since they were last flushed
+//rects in the list never overlap each other
+typedef struct damage {
+	Rect rects[DAMAGE_MAX_RECTS];
+	int count;
+} Damage;
+
+void damage_add(Damage* damage, Rect r);
+void damage_clear(Damage* damage);
+//true if any damaged area overlaps r
+bool damage_intersects(Damage* damage, Rect r);
+
+//records r, in screen coordinates, as needing to be recomposited
+//and flushed on the current screen
+void mark_damaged(Rect r);
+
+__END_DECLS
+
+#endif
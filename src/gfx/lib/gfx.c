@@ -10,6 +10,7 @@
 #include <kernel/drivers/vga/vga.h>
 #include <kernel/drivers/vesa/vesa.h>
 #include "color.h"
+#include "pixels.h"
 
 //private Window function to create root window
 Window* create_window_int(Rect frame, bool root);
@@ -29,13 +30,14 @@ inline int gfx_depth() {
 	return current_depth;
 }
 
+pixel_format gfx_pixel_format() {
+	//VESA layers are 32bpp whatever the framebuffer's depth, so every pixel is an aligned word
+	//they're only packed down to the framebuffer's format when written to it
+	return (gfx_depth() == VGA_DEPTH) ? PIXEL_FORMAT_INDEXED8 : PIXEL_FORMAT_XRGB32;
+}
+
 inline int gfx_bpp() {
-	if (!current_depth) {
-		//fall back on assuming VESA
-		current_depth = VESA_DEPTH;
-	}
-	//each px component is 8 bits
-	return current_depth / 8;
+	return pixel_format_bpp(gfx_pixel_format());
 }
 
 Screen* gfx_screen() {
@@ -52,6 +54,9 @@ Vec2d vec2d(double x, float y) {
 Screen* screen_create(Size dimensions, uint32_t* physbase, uint8_t depth) {
 			Screen* screen = kmalloc(sizeof(Screen));
 
+			//layers made below have to be in the format of this screen's mode
+			process_gfx_switch(current_screen, depth);
+
 			//linear frame buffer (LFB) address
 			screen->physbase = physbase;
 			screen->window = create_window_int(rect_make(point_make(0, 0), dimensions), true);
@@ -59,7 +64,18 @@ Screen* screen_create(Size dimensions, uint32_t* physbase, uint8_t depth) {
 			screen->depth = depth;
 			//8 bits in a byte
 			screen->bpp = depth / 8;
+			//assume rows are packed unless the mode says otherwise
+			screen->pitch = dimensions.width * screen->bpp;
 			screen->vmem = create_layer(dimensions);
+			//nothing has been pushed to the framebuffer yet
+			damage_clear(&screen->damage);
+			damage_add(&screen->damage, rect_make(point_zero(), dimensions));
+			//the driver raises this if the card can flip pages
+			screen->page_count = 1;
+			screen->front_page = 0;
+			for (int i = 0; i < SCREEN_MAX_PAGES; i++) {
+				damage_clear(&screen->page_damage[i]);
+			}
 
 			return screen;
 }
@@ -96,12 +112,103 @@ void vsync() {
 }
 
 void fill_screen(Screen* screen, Color color) {
-	memset(screen->vmem->raw, color.val[0], screen->window->size.width * screen->window->size.height * gfx_bpp());
+	int count = screen->vmem->size.width * screen->vmem->size.height;
+	if (screen->vmem->format == PIXEL_FORMAT_INDEXED8) {
+		memset(screen->vmem->raw, color.val[0], count);
+		return;
+	}
+	pixels_fill((uint32_t*)screen->vmem->raw, color_hex(color), count);
+}
+
+//packs XRGB words down to the 3 byte pixels of a 24bpp framebuffer
+static void pack_rgb24(uint8_t* dst, uint32_t* src, int count) {
+	//4 pixels fit exactly in 3 words
+	for (; count >= 4; count -= 4) {
+		uint32_t* out = (uint32_t*)dst;
+		out[0] = (src[0] & 0xFFFFFF) | (src[1] << 24);
+		out[1] = ((src[1] >> 8) & 0xFFFF) | (src[2] << 16);
+		out[2] = ((src[2] >> 16) & 0xFF) | (src[3] << 8);
+		src += 4;
+		dst += 12;
+	}
+	for (; count > 0; count--) {
+		*dst++ = *src & 0xFF;
+		*dst++ = (*src >> 8) & 0xFF;
+		*dst++ = (*src >> 16) & 0xFF;
+		src++;
+	}
+}
+
+//copies r of vmem into framebuffer page
+static void write_screen_rect(Screen* screen, Rect r, int page) {
+	r = rect_intersect(r, rect_make(point_zero(), screen->vmem->size));
+	if (rect_empty(r)) return;
+
+	int bpp = layer_bpp(screen->vmem);
+	int pitch = screen->vmem->size.width * bpp;
+	uint8_t* src = screen->vmem->raw + (rect_min_y(r) * pitch) + (rect_min_x(r) * bpp);
+	//pages are stacked one after another in the framebuffer
+	uint8_t* dst = (uint8_t*)screen->physbase + (page * screen->vmem->size.height * screen->pitch);
+	dst += (rect_min_y(r) * screen->pitch) + (rect_min_x(r) * screen->bpp);
+
+	//copy row by row, converting if the framebuffer isn't in vmem's format
+	for (int i = 0; i < r.size.height; i++) {
+		if (bpp != screen->bpp) {
+			pack_rgb24(dst, (uint32_t*)src, r.size.width);
+		}
+		else if (screen->vmem->format == PIXEL_FORMAT_XRGB32) {
+			pixels_copy((uint32_t*)dst, (uint32_t*)src, r.size.width);
+		}
+		else {
+			memcpy(dst, src, r.size.width * bpp);
+		}
+		src += pitch;
+		dst += screen->pitch;
+	}
 }
 
 void write_screen(Screen* screen) {
-	vsync();
-	memcpy(screen->physbase, screen->vmem->raw, screen->vmem->size.width * screen->vmem->size.height * gfx_bpp());
+	damage_add(&screen->damage, rect_make(point_zero(), screen->vmem->size));
+	write_screen_damage(screen);
+}
+
+//draws the frame into a hidden page and shows it
+//the pages hold older frames, so each gets every change made since it was last drawn to, not just this frame's
+static void flip_screen_damage(Screen* screen) {
+	for (int i = 0; i < screen->page_count; i++) {
+		for (int j = 0; j < screen->damage.count; j++) {
+			damage_add(&screen->page_damage[i], screen->damage.rects[j]);
+		}
+	}
+
+	int back = (screen->front_page + 1) % screen->page_count;
+	Damage* stale = &screen->page_damage[back];
+	for (int i = 0; i < stale->count; i++) {
+		write_screen_rect(screen, stale->rects[i], back);
+	}
+	damage_clear(stale);
+
+	//the flip is done by the time this returns, either because the card waited for the retrace itself
+	//or because it's emulated and reads the whole page at once, so the old front page is free to draw into next
+	vesa_flip(screen, back);
+	screen->front_page = back;
+}
+
+void write_screen_damage(Screen* screen) {
+	//idle frames don't even wait for the retrace
+	if (!screen->damage.count) return;
+
+	if (screen->page_count > 1) {
+		flip_screen_damage(screen);
+	}
+	else {
+		//only the shown page exists, so copy during the retrace to avoid tearing
+		vsync();
+		for (int i = 0; i < screen->damage.count; i++) {
+			write_screen_rect(screen, screen->damage.rects[i], 0);
+		}
+	}
+	damage_clear(&screen->damage);
 }
 
 void rainbow_animation(Screen* screen, Rect r, int animationStep) {
@@ -7,6 +7,7 @@
 typedef void (*event_handler)(void* obj, void* context);
 
 #include "rect.h"
+#include "damage.h"
 #include "view.h"
 #include "button.h"
 #include <gfx/font/font.h>
@@ -17,15 +18,25 @@ typedef struct __attribute__((packed)) {
 } regs16_t;
 
 typedef struct window Window;
+//most framebuffer pages a screen flips between
+#define SCREEN_MAX_PAGES 3
+
 typedef struct screen_t {
 	Window* window; //root window
-	uint16_t pitch; //redundant?
+	uint16_t pitch; //bytes per framebuffer row
 	uint16_t depth; //bits per pixel
-	uint8_t bpp; //bytes per pixel
+	uint8_t bpp; //bytes per pixel of framebuffer, vmem may use more
 	uint16_t pixelwidth; //redundant?
 	uint32_t* physbase; //address of beginning of framebuffer
 	volatile int finished_drawing; //are we currently rendering a frame?
 	ca_layer* vmem; //raw framebuffer pushed to screen
+	Damage damage; //areas of vmem which must be recomposited and pushed this frame
+
+	//the framebuffer is page_count screens tall, one page is shown while the next is drawn
+	//1 if the card can't flip, then frames are copied to the shown page after a retrace
+	int page_count;
+	int front_page; //page being displayed
+	Damage page_damage[SCREEN_MAX_PAGES]; //areas of vmem changed since each page was last drawn to
 } Screen;
 
 typedef struct Vec2d {
@@ -43,10 +54,15 @@ void vga_boot_screen(Screen* screen);
 
 void fill_screen(Screen* screen, Color color);
 void write_screen(Screen* screen);
+//copies only the damaged areas of vmem to the framebuffer, then clears the damage
+//if the screen can flip, they go to the back page which is then shown
+void write_screen_damage(Screen* screen);
 
 void process_gfx_switch(Screen* screen, int new_depth);
 int gfx_depth();
+//bytes per pixel of layers in the current mode
 int gfx_bpp();
+pixel_format gfx_pixel_format();
 Screen* gfx_screen();
 
 Vec2d vec2d(double x, float y);
@@ -58,19 +74,13 @@ inline void putpixel(ca_layer* layer, int x, int y, Color color) {
 	//don't attempt writing a pixel outside of screen bounds
 	if (x < 0 || y < 0 || x >= layer->size.width || y >= layer->size.height) return;
 
-	int depth = gfx_depth();
-	if (depth == VGA_DEPTH) {
+	if (layer->format == PIXEL_FORMAT_INDEXED8) {
 		//VGA mode
-		uint16_t loc = ((y * layer->size.width * gfx_bpp()) + (x * gfx_bpp()));
-		layer->raw[loc] = color.val[0];
+		layer->raw[(y * layer->size.width) + x] = color.val[0];
 	}
 	else {
 		//VESA mode
-		int offset = (x * gfx_bpp()) + (y * layer->size.width * gfx_bpp());
-		//we have to write the pixels in BGR, not RGB
-		layer->raw[offset + 0] = color.val[2];
-		layer->raw[offset + 1] = color.val[1];
-		layer->raw[offset + 2] = color.val[0];
+		((uint32_t*)layer->raw)[(y * layer->size.width) + x] = pixel_format_opaque(layer->format, color_hex(color));
 	}
 }
 __attribute__((always_inline))
@@ -78,16 +88,14 @@ inline void addpixel(ca_layer* layer, int x, int y, Color color) {
 	//don't attempt writing a pixel outside of screen bounds
 	if (x < 0 || y < 0 || x >= layer->size.width || y >= layer->size.height) return;
 
-	int depth = gfx_depth();
-	if (depth == VGA_DEPTH) {
+	if (layer->format == PIXEL_FORMAT_INDEXED8) {
 		//VGA mode
 		uint16_t loc = ((y * layer->size.width) + x);
 		layer->raw[loc] += color.val[0];
 	}
 	else {
 		//VESA mode
-		int bpp = 24 / 8;
-		int offset = x * bpp + y * layer->size.width * bpp;
+		int offset = ((y * layer->size.width) + x) * layer_bpp(layer);
 		//we have to write the pixels in BGR, not RGB
 		layer->raw[offset + 0] += color.val[0];
 		layer->raw[offset + 1] += color.val[1];
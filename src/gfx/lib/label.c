@@ -1,11 +1,13 @@
 #include "label.h"
 #include "view.h"
 #include <std/std.h>
+#include <gfx/font/text_layout.h>
 
 void label_teardown(Label* label) {
 	if (!label) return;
 
 	layer_teardown(label->layer);
+	text_layout_destroy(label->layout);
 	kfree(label->text);
 	kfree(label);
 }
@@ -13,6 +15,8 @@ void label_teardown(Label* label) {
 void set_text(Label* label, char* text) {
 	kfree(label->text);
 	label->text = strdup(text);
+	text_layout_destroy(label->layout);
+	label->layout = NULL;
 	mark_needs_redraw((View*)label);
 }
 
@@ -24,6 +28,7 @@ Label* create_label(Rect frame, char* text) {
 	label->text_color = color_black();
 	label->needs_redraw = 1;
 	label->font_size = size_make(CHAR_WIDTH, CHAR_HEIGHT);
+	label->layout = NULL;
 
 	label->text = strdup(text);
 	return label;
@@ -19,6 +19,8 @@ typedef struct label {
 	char* text;
 	Color text_color;
 	Size font_size;
+	//text laid out when last drawn, reused until the text, font size or frame change
+	struct text_layout* layout;
 } Label;
 
 Label* create_label(Rect frame, char* text);
@@ -0,0 +1,304 @@
+#include "pixels.h"
+#include <std/memory.h>
+#include <std/math.h>
+#include <kernel/util/fpu/fpu.h>
+
+//the rest of the kernel is built without SSE, so only functions marked as SSE2 below may use these
+//may_alias as they're loaded from and stored to uint32_t buffers
+typedef uint32_t v4u32 __attribute__((vector_size(16), may_alias));
+typedef uint16_t v8u16 __attribute__((vector_size(16), may_alias));
+//for loads that are only word aligned
+typedef uint32_t v4u32_u __attribute__((vector_size(16), may_alias, aligned(4)));
+
+//weight of a pixel's top byte, out of 256 so 0xFF is fully opaque
+static inline uint32_t px_alpha(uint32_t px) {
+	uint32_t a = px >> 24;
+	return a + (a >> 7);
+}
+
+//every channel of px, alpha included, scaled by weight out of 256
+//rounded to nearest, so an opaque pixel stays opaque under anything translucent
+static inline uint32_t px_scale(uint32_t px, uint32_t weight) {
+	uint32_t rb = ((((px & 0xFF00FF) * weight) + 0x800080) >> 8) & 0xFF00FF;
+	uint32_t ag = ((((px >> 8) & 0xFF00FF) * weight) + 0x800080) & 0xFF00FF00;
+	return rb | ag;
+}
+
+static inline uint32_t px_blend(uint32_t s, uint32_t d, uint32_t alpha) {
+	//red and blue are blended together, there's room between them for the products
+	uint32_t inv_alpha = 256 - alpha;
+	uint32_t rb = (((s & 0xFF00FF) * alpha) + ((d & 0xFF00FF) * inv_alpha)) >> 8;
+	uint32_t g = (((s & 0x00FF00) * alpha) + ((d & 0x00FF00) * inv_alpha)) >> 8;
+	return (rb & 0xFF00FF) | (g & 0x00FF00);
+}
+
+void pixels_fill_scalar(uint32_t* dst, uint32_t color, int count) {
+	for (int i = 0; i < count; i++) {
+		dst[i] = color;
+	}
+}
+
+void pixels_copy_scalar(uint32_t* dst, const uint32_t* src, int count) {
+	if (count <= 0) return;
+	memcpy(dst, src, count * sizeof(uint32_t));
+}
+
+void pixels_blend_scalar(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha) {
+	for (int i = 0; i < count; i++) {
+		dst[i] = px_blend(src[i], dst[i], alpha);
+	}
+}
+
+void pixels_src_scalar(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha) {
+	for (int i = 0; i < count; i++) {
+		dst[i] = px_scale(src[i] | src_alpha, alpha);
+	}
+}
+
+void pixels_over_scalar(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha) {
+	for (int i = 0; i < count; i++) {
+		uint32_t s = px_scale(src[i] | src_alpha, alpha);
+		//premultiplied, so src is added as is and only dst is weighted
+		dst[i] = s + px_scale(dst[i], 256 - px_alpha(s));
+	}
+}
+
+void pixels_in_scalar(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha) {
+	for (int i = 0; i < count; i++) {
+		uint32_t s = px_scale(src[i] | src_alpha, alpha);
+		dst[i] = px_scale(s, px_alpha(dst[i]));
+	}
+}
+
+//pixels to handle one at a time before dst is 16 byte aligned
+static inline int align_head(uint32_t* dst, int count) {
+	int head = ((16 - ((uint32_t)dst & 15)) & 15) / sizeof(uint32_t);
+	return MIN(head, count);
+}
+
+//4 pixels of px_blend, alpha and inv_alpha hold the weight for each pixel in both of its 16 bit halves
+//every product fits in 16 bits, as channels are at most 255 and the weights add up to 256
+__attribute__((target("sse2"), always_inline)) static inline v4u32 blend4(v4u32 s, v4u32 d, v8u16 alpha, v8u16 inv_alpha) {
+	const v4u32 rb_mask = {0xFF00FF, 0xFF00FF, 0xFF00FF, 0xFF00FF};
+	const v4u32 g_mask = {0x00FF00, 0x00FF00, 0x00FF00, 0x00FF00};
+
+	//blue and red in the low byte of each half
+	v8u16 s_rb = (v8u16)(s & rb_mask);
+	v8u16 d_rb = (v8u16)(d & rb_mask);
+	//green and the top byte, shifted down into the low byte of each half
+	v8u16 s_g = (v8u16)s >> 8;
+	v8u16 d_g = (v8u16)d >> 8;
+
+	v4u32 rb = (v4u32)(((s_rb * alpha) + (d_rb * inv_alpha)) >> 8);
+	//green lands back where it started, the top byte's result is dropped
+	v4u32 g = (v4u32)((s_g * alpha) + (d_g * inv_alpha)) & g_mask;
+	return rb | g;
+}
+
+//4 pixels of px_scale
+__attribute__((target("sse2"), always_inline)) static inline v4u32 scale4(v4u32 px, v8u16 weight) {
+	const v4u32 ag_mask = {0xFF00FF00, 0xFF00FF00, 0xFF00FF00, 0xFF00FF00};
+	const v4u32 rb_mask = {0xFF00FF, 0xFF00FF, 0xFF00FF, 0xFF00FF};
+	const v8u16 half = {128, 128, 128, 128, 128, 128, 128, 128};
+
+	v4u32 rb = (v4u32)((((v8u16)(px & rb_mask) * weight) + half) >> 8);
+	v4u32 ag = (v4u32)((((v8u16)px >> 8) * weight) + half) & ag_mask;
+	return rb | ag;
+}
+
+//px_alpha of 4 pixels, copied into both 16 bit halves of each word
+__attribute__((target("sse2"), always_inline)) static inline v8u16 alpha4(v4u32 px) {
+	v4u32 a = px >> 24;
+	a += a >> 7;
+	return (v8u16)(a | (a << 16));
+}
+
+__attribute__((target("sse2"))) void pixels_fill_sse2(uint32_t* dst, uint32_t color, int count) {
+	int head = align_head(dst, count);
+	pixels_fill_scalar(dst, color, head);
+	dst += head;
+	count -= head;
+
+	v4u32 c = {color, color, color, color};
+	for (; count >= 16; count -= 16) {
+		v4u32* out = (v4u32*)dst;
+		out[0] = c;
+		out[1] = c;
+		out[2] = c;
+		out[3] = c;
+		dst += 16;
+	}
+	for (; count >= 4; count -= 4) {
+		*(v4u32*)dst = c;
+		dst += 4;
+	}
+	pixels_fill_scalar(dst, color, count);
+}
+
+__attribute__((target("sse2"))) void pixels_copy_sse2(uint32_t* dst, const uint32_t* src, int count) {
+	int head = align_head(dst, count);
+	pixels_copy_scalar(dst, src, head);
+	dst += head;
+	src += head;
+	count -= head;
+
+	for (; count >= 16; count -= 16) {
+		const v4u32_u* in = (const v4u32_u*)src;
+		v4u32* out = (v4u32*)dst;
+		v4u32 a = in[0];
+		v4u32 b = in[1];
+		v4u32 c = in[2];
+		v4u32 d = in[3];
+		out[0] = a;
+		out[1] = b;
+		out[2] = c;
+		out[3] = d;
+		dst += 16;
+		src += 16;
+	}
+	for (; count >= 4; count -= 4) {
+		*(v4u32*)dst = *(const v4u32_u*)src;
+		dst += 4;
+		src += 4;
+	}
+	pixels_copy_scalar(dst, src, count);
+}
+
+__attribute__((target("sse2"))) void pixels_blend_sse2(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha) {
+	int head = align_head(dst, count);
+	pixels_blend_scalar(dst, src, head, alpha);
+	dst += head;
+	src += head;
+	count -= head;
+
+	uint16_t a = alpha;
+	uint16_t ia = 256 - alpha;
+	v8u16 va = {a, a, a, a, a, a, a, a};
+	v8u16 via = {ia, ia, ia, ia, ia, ia, ia, ia};
+	for (; count >= 4; count -= 4) {
+		v4u32* out = (v4u32*)dst;
+		*out = blend4(*(const v4u32_u*)src, *out, va, via);
+		dst += 4;
+		src += 4;
+	}
+	pixels_blend_scalar(dst, src, count, alpha);
+}
+
+__attribute__((target("sse2"))) void pixels_src_sse2(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha) {
+	int head = align_head(dst, count);
+	pixels_src_scalar(dst, src, head, alpha, src_alpha);
+	dst += head;
+	src += head;
+	count -= head;
+
+	uint16_t a = alpha;
+	v8u16 va = {a, a, a, a, a, a, a, a};
+	v4u32 sa = {src_alpha, src_alpha, src_alpha, src_alpha};
+	for (; count >= 4; count -= 4) {
+		*(v4u32*)dst = scale4(*(const v4u32_u*)src | sa, va);
+		dst += 4;
+		src += 4;
+	}
+	pixels_src_scalar(dst, src, count, alpha, src_alpha);
+}
+
+__attribute__((target("sse2"))) void pixels_over_sse2(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha) {
+	int head = align_head(dst, count);
+	pixels_over_scalar(dst, src, head, alpha, src_alpha);
+	dst += head;
+	src += head;
+	count -= head;
+
+	uint16_t a = alpha;
+	v8u16 va = {a, a, a, a, a, a, a, a};
+	v4u32 sa = {src_alpha, src_alpha, src_alpha, src_alpha};
+	const v8u16 full = {256, 256, 256, 256, 256, 256, 256, 256};
+	for (; count >= 4; count -= 4) {
+		v4u32 s = scale4(*(const v4u32_u*)src | sa, va);
+		v4u32* out = (v4u32*)dst;
+		*out = s + scale4(*out, full - alpha4(s));
+		dst += 4;
+		src += 4;
+	}
+	pixels_over_scalar(dst, src, count, alpha, src_alpha);
+}
+
+__attribute__((target("sse2"))) void pixels_in_sse2(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha) {
+	int head = align_head(dst, count);
+	pixels_in_scalar(dst, src, head, alpha, src_alpha);
+	dst += head;
+	src += head;
+	count -= head;
+
+	uint16_t a = alpha;
+	v8u16 va = {a, a, a, a, a, a, a, a};
+	v4u32 sa = {src_alpha, src_alpha, src_alpha, src_alpha};
+	for (; count >= 4; count -= 4) {
+		v4u32 s = scale4(*(const v4u32_u*)src | sa, va);
+		v4u32* out = (v4u32*)dst;
+		*out = scale4(s, alpha4(*out));
+		dst += 4;
+		src += 4;
+	}
+	pixels_in_scalar(dst, src, count, alpha, src_alpha);
+}
+
+typedef struct pixel_ops {
+	void (*fill)(uint32_t* dst, uint32_t color, int count);
+	void (*copy)(uint32_t* dst, const uint32_t* src, int count);
+	void (*blend)(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha);
+	void (*src)(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha);
+	void (*over)(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha);
+	void (*in)(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha);
+} pixel_ops;
+
+static const pixel_ops scalar_ops = {
+	pixels_fill_scalar,
+	pixels_copy_scalar,
+	pixels_blend_scalar,
+	pixels_src_scalar,
+	pixels_over_scalar,
+	pixels_in_scalar,
+};
+
+static const pixel_ops sse2_ops = {
+	pixels_fill_sse2,
+	pixels_copy_sse2,
+	pixels_blend_sse2,
+	pixels_src_sse2,
+	pixels_over_sse2,
+	pixels_in_sse2,
+};
+
+static const pixel_ops* ops() {
+	//fpu_install runs long before anything is drawn, so the cpu's features are known by now
+	static const pixel_ops* selected = NULL;
+	if (!selected) {
+		selected = cpu_has(CPUID_FEAT_EDX_SSE2) ? &sse2_ops : &scalar_ops;
+	}
+	return selected;
+}
+
+void pixels_fill(uint32_t* dst, uint32_t color, int count) {
+	ops()->fill(dst, color, count);
+}
+
+void pixels_copy(uint32_t* dst, const uint32_t* src, int count) {
+	ops()->copy(dst, src, count);
+}
+
+void pixels_blend(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha) {
+	ops()->blend(dst, src, count, alpha);
+}
+
+void pixels_src(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha) {
+	ops()->src(dst, src, count, alpha, src_alpha);
+}
+
+void pixels_over(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha) {
+	ops()->over(dst, src, count, alpha, src_alpha);
+}
+
+void pixels_in(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha) {
+	ops()->in(dst, src, count, alpha, src_alpha);
+}
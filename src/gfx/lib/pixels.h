@@ -0,0 +1,45 @@
+#ifndef PIXELS_H
+#define PIXELS_H
+
+#include <std/std.h>
+
+//inner loops for runs of XRGB or premultiplied ARGB words
+//each has a plain C version and an SSE2 one, picked once the cpu's features are known
+//both give exactly the same words, the C versions are the reference
+
+//dst[0..count) = color
+void pixels_fill(uint32_t* dst, uint32_t color, int count);
+//dst and src mustn't overlap
+void pixels_copy(uint32_t* dst, const uint32_t* src, int count);
+//dst = (src * alpha + dst * (256 - alpha)) / 256 per channel, alpha is out of 256
+void pixels_blend(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha);
+
+//Porter-Duff operators on premultiplied ARGB
+//src is first scaled by alpha, out of 256, and has src_alpha OR'd into every pixel
+//pass PIXEL_ALPHA_OPAQUE as src_alpha when src is XRGB, so its pixels count as opaque
+#define PIXEL_ALPHA_OPAQUE 0xFF000000
+
+//dst = src
+void pixels_src(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha);
+//dst = src + dst * (1 - src alpha)
+void pixels_over(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha);
+//dst = src * dst alpha
+void pixels_in(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha);
+
+//the two implementations behind the above, so they can be checked against each other
+//the SSE2 ones must only be called if cpu_has(CPUID_FEAT_EDX_SSE2)
+void pixels_fill_scalar(uint32_t* dst, uint32_t color, int count);
+void pixels_copy_scalar(uint32_t* dst, const uint32_t* src, int count);
+void pixels_blend_scalar(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha);
+void pixels_src_scalar(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha);
+void pixels_over_scalar(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha);
+void pixels_in_scalar(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha);
+
+void pixels_fill_sse2(uint32_t* dst, uint32_t color, int count);
+void pixels_copy_sse2(uint32_t* dst, const uint32_t* src, int count);
+void pixels_blend_sse2(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha);
+void pixels_src_sse2(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha);
+void pixels_over_sse2(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha);
+void pixels_in_sse2(uint32_t* dst, const uint32_t* src, int count, uint32_t alpha, uint32_t src_alpha);
+
+#endif
@@ -29,125 +29,63 @@ Rect rect_zero() {
 	return rect_make(point_zero(), size_zero());
 }
 
-Rect* rect_clip(Rect subject, Rect cutting) {
-	//maximum possible 4 rectangles
-	static Rect clipped[4];
-	//array_m* clipped = array_m_create(4);
-
-	//if these rectangles don't intersect, do nothing
-	if (!rect_intersects(subject, cutting)) {
-		return NULL;
-	}
+int rect_clip(Rect subject, Rect cutting, Rect out[4]) {
+	Rect overlap = rect_intersect(subject, cutting);
 
-	//if subject is completely occluded by cutting, do nothing
-	if (rect_min_x(subject) >= rect_min_x(cutting) &&
-		rect_min_y(subject) >= rect_min_y(cutting) &&
-		rect_max_x(subject) <= rect_max_x(cutting) &&
-		rect_max_y(subject) <= rect_max_y(cutting)) {
-		return NULL;
+	//if these rectangles don't intersect, subject is entirely visible
+	if (rect_empty(overlap)) {
+		out[0] = subject;
+		return 1;
 	}
 
-	memset(clipped, 0, sizeof(clipped));
 	int count = 0;
-
-	//holds new rects before they get added to clipped
 	Rect tmp;
 
-	//splitting
-	//split by left edge if edge is between subject's left & right edges
-	if (rect_min_x(cutting) <= rect_max_x(subject) && rect_min_x(cutting) >= rect_min_x(subject)) {
-		//make new rect from subject's left to cutting rect's left
-		tmp = rect_make(subject.origin, size_make(rect_min_x(cutting) - rect_min_x(subject), subject.size.height));
-
-		//add to output list
-		clipped[count++] = tmp;
-
-		//shrink subject to exclude split portion
-		//subject.size.width = cutting.size.width;
-		int diff = rect_min_x(cutting) - rect_min_x(subject);
-		subject.origin.x = cutting.origin.x;
-		subject.size.width -= diff;
-	}
-
-	//split by top edge if edge is between subject's top and bottom edges
-	if (rect_min_y(cutting) >= rect_min_y(subject) && rect_min_y(cutting) <= rect_max_y(subject)) {
-		//make new rect from subject's top to cutting rect's top 
-		tmp = rect_make(subject.origin, size_make(subject.size.width, rect_min_y(cutting) - rect_min_y(subject)));
-
-		//add to output list
-		clipped[count++] = tmp;
-
-		//shrink subject to exclude split portion
-		int diff = cutting.origin.y - subject.origin.y;
-		subject.origin.y = cutting.origin.y;
-		subject.size.height -= diff;
-	}
-
-	//split by right edge if edge is between subject's left and right edges
-	if (rect_max_x(cutting) <= rect_max_x(subject) && rect_max_x(cutting) >= rect_min_x(subject)) {
-		//make new rect from cutting's right to subject rect's right 
-		tmp = rect_make(point_make(rect_max_x(cutting), subject.origin.y), size_make(rect_max_x(subject) - rect_max_x(cutting), subject.size.height));
-
-		//add to output list
-		clipped[count++] = tmp;
+	//full width strip above the occluded area
+	tmp = rect_make(subject.origin, size_make(subject.size.width, rect_min_y(overlap) - rect_min_y(subject)));
+	if (!rect_empty(tmp)) out[count++] = tmp;
 
-		//shrink subject to exclude split portion
-		int diff = rect_max_x(subject) - rect_max_x(cutting);
-		subject.size.width -= diff;
-	}
-
-	//split by bottom edge if edge is between subject's top and bottom edges
-	if (rect_max_y(cutting) >= rect_min_y(subject) && rect_max_y(cutting) <= rect_max_y(subject)) {
-		//make new rect from cutting's bottom to subject rect's bottom 
-		tmp = rect_make(point_make(rect_min_x(subject), rect_max_y(cutting)), size_make(subject.size.width, rect_max_y(subject) - rect_max_y(cutting)));
+	//full width strip below the occluded area
+	tmp = rect_make(point_make(rect_min_x(subject), rect_max_y(overlap)), size_make(subject.size.width, rect_max_y(subject) - rect_max_y(overlap)));
+	if (!rect_empty(tmp)) out[count++] = tmp;
 
-		//add to output list
-		clipped[count++] = tmp;
+	//left and right of the occluded area, only spanning its rows so they don't overlap the strips
+	tmp = rect_make(point_make(rect_min_x(subject), rect_min_y(overlap)), size_make(rect_min_x(overlap) - rect_min_x(subject), overlap.size.height));
+	if (!rect_empty(tmp)) out[count++] = tmp;
 
-		//shrink subject to exclude split portion
-		int diff = rect_max_y(subject) - rect_max_y(cutting);
-		subject.size.height -= diff;
-	}
+	tmp = rect_make(point_make(rect_max_x(overlap), rect_min_y(overlap)), size_make(rect_max_x(subject) - rect_max_x(overlap), overlap.size.height));
+	if (!rect_empty(tmp)) out[count++] = tmp;
 
-	//finally, return output rects
-	return clipped;
+	return count;
 }
 
 Rect rect_intersect(Rect a, Rect b) {
-	Rect result;
+	int min_x = MAX(rect_min_x(a), rect_min_x(b));
+	int min_y = MAX(rect_min_y(a), rect_min_y(b));
+	int max_x = MIN(rect_max_x(a), rect_max_x(b));
+	int max_y = MIN(rect_max_y(a), rect_max_y(b));
 
 	//check for no overlap
-	if (!(rect_min_x(a) <= rect_max_x(b)) &&
-		  rect_max_x(a) >= rect_min_x(b) &&
-		  rect_min_y(a) <= rect_max_y(b) &&
-		  rect_max_y(a) >= rect_min_y(b)) {
+	if (max_x <= min_x || max_y <= min_y) {
 		return rect_zero();
 	}
+	return rect_make(point_make(min_x, min_y), size_make(max_x - min_x, max_y - min_y));
+}
 
-	//result starts as copy of first rect
-	result = a;
-	
-	//shrink to rightmost left edge
-	if (rect_min_x(b) >= rect_min_x(result) && rect_min_x(b) <= rect_max_x(result)) {
-		result.origin.x = b.origin.x;
-	}
-
-	//shrink to bottommost top edge
-	if (rect_min_y(b) >= rect_min_y(result) && rect_min_y(b) <= rect_max_y(result)) {
-		result.origin.y = b.origin.y;
-	}
-
-	//shrink to leftmost right edge
-	if (rect_max_x(b) >= rect_min_x(result) && rect_max_x(b) <= rect_max_x(result)) {
-		result.size.width = b.size.width;
-	}
+Rect rect_union(Rect a, Rect b) {
+	//an empty rect shouldn't stretch the result out to its origin
+	if (rect_empty(a)) return b;
+	if (rect_empty(b)) return a;
 
-	//shrink to topmost bottom edge
-	if (rect_max_x(b) >= rect_min_y(result) && rect_max_y(b) <= rect_max_y(result)) {
-		result.size.height = b.size.height;
-	}
+	int min_x = MIN(rect_min_x(a), rect_min_x(b));
+	int min_y = MIN(rect_min_y(a), rect_min_y(b));
+	int max_x = MAX(rect_max_x(a), rect_max_x(b));
+	int max_y = MAX(rect_max_y(a), rect_max_y(b));
+	return rect_make(point_make(min_x, min_y), size_make(max_x - min_x, max_y - min_y));
+}
 
-	return result;
+bool rect_empty(Rect r) {
+	return r.size.width <= 0 || r.size.height <= 0;
 }
 
 bool rect_contains_point(Rect r, Point p) {
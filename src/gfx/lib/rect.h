@@ -21,12 +21,19 @@ Rect rect_zero();
 
 bool rect_intersects(Rect A, Rect B);
 
-//explode subject rect into array of contiguous rects which are
-//not occluded by cutting rect
-Rect* rect_clip(Rect subject, Rect cutting);
+//explode subject rect into at most 4 non-overlapping rects which together
+//cover the parts of subject not occluded by cutting rect
+//returns how many were written to out, 0 if subject is entirely occluded
+//for anything more involved than one cut, see region.h
+int rect_clip(Rect subject, Rect cutting, Rect out[4]);
 
 //find the intersecting rect of a and b
+//returns an empty rect if they don't overlap
 Rect rect_intersect(Rect a, Rect b);
+//smallest rect containing both a and b
+Rect rect_union(Rect a, Rect b);
+//true if r covers no pixels
+bool rect_empty(Rect r);
 //returns true if point is bounded by rect
 bool rect_contains_point(Rect r, Point p);
 
@@ -0,0 +1,322 @@
+#include "region.h"
+#include <std/kheap.h>
+#include <std/memory.h>
+#include <std/math.h>
+
+//receives the boxes of one band of each operand, over the rows [y1, y2) both bands cover
+typedef void (*band_op)(Region* dest, region_box* r1, region_box* r1_end, region_box* r2, region_box* r2_end, int y1, int y2);
+
+void region_init(Region* region) {
+	memset(region, 0, sizeof(Region));
+}
+
+static void region_reserve(Region* region, int count) {
+	if (count <= region->capacity) return;
+
+	int capacity = MAX(region->capacity * 2, 8);
+	capacity = MAX(capacity, count);
+	region_box* boxes = kmalloc(capacity * sizeof(region_box));
+	if (region->count) {
+		memcpy(boxes, region->boxes, region->count * sizeof(region_box));
+	}
+	kfree(region->boxes);
+	region->boxes = boxes;
+	region->capacity = capacity;
+}
+
+static void region_append(Region* region, int x1, int y1, int x2, int y2) {
+	region_reserve(region, region->count + 1);
+	region_box* box = &region->boxes[region->count++];
+	box->x1 = x1;
+	box->y1 = y1;
+	box->x2 = x2;
+	box->y2 = y2;
+}
+
+void region_init_rect(Region* region, Rect r) {
+	region_init(region);
+	if (rect_empty(r)) return;
+
+	region_append(region, rect_min_x(r), rect_min_y(r), rect_max_x(r), rect_max_y(r));
+	region->extents = region->boxes[0];
+}
+
+void region_free(Region* region) {
+	kfree(region->boxes);
+	region_init(region);
+}
+
+void region_copy(Region* dest, Region* src) {
+	if (dest == src) return;
+
+	dest->count = 0;
+	region_reserve(dest, src->count);
+	if (src->count) {
+		memcpy(dest->boxes, src->boxes, src->count * sizeof(region_box));
+	}
+	dest->count = src->count;
+	dest->extents = src->extents;
+}
+
+bool region_empty(Region* region) {
+	return !region->count;
+}
+
+static Rect box_rect(region_box box) {
+	return rect_make(point_make(box.x1, box.y1), size_make(box.x2 - box.x1, box.y2 - box.y1));
+}
+
+Rect region_extents(Region* region) {
+	return box_rect(region->extents);
+}
+
+Rect region_rect(Region* region, int i) {
+	return box_rect(region->boxes[i]);
+}
+
+//first box past the band r starts
+static region_box* band_end(region_box* r, region_box* end) {
+	int y1 = r->y1;
+	while (r != end && r->y1 == y1) {
+		r++;
+	}
+	return r;
+}
+
+//copies a band's boxes with their rows replaced by [y1, y2)
+static void append_band(Region* dest, region_box* r, region_box* end, int y1, int y2) {
+	for (; r != end; r++) {
+		region_append(dest, r->x1, y1, r->x2, y2);
+	}
+}
+
+//merges each band into the one above it if they touch and have identical boxes
+static void region_coalesce(Region* region) {
+	int out = 0;
+	int prev = -1;
+	int prev_count = 0;
+
+	region_box* end = region->boxes + region->count;
+	region_box* band = region->boxes;
+	while (band != end) {
+		region_box* next = band_end(band, end);
+		int count = next - band;
+
+		bool same = prev >= 0 && count == prev_count && region->boxes[prev].y2 == band->y1;
+		for (int i = 0; same && i < count; i++) {
+			region_box* above = &region->boxes[prev + i];
+			same = above->x1 == band[i].x1 && above->x2 == band[i].x2;
+		}
+
+		if (same) {
+			for (int i = 0; i < count; i++) {
+				region->boxes[prev + i].y2 = band->y2;
+			}
+		}
+		else {
+			//boxes only ever move towards the front, so copying forwards is safe
+			for (int i = 0; i < count; i++) {
+				region->boxes[out + i] = band[i];
+			}
+			prev = out;
+			prev_count = count;
+			out += count;
+		}
+		band = next;
+	}
+	region->count = out;
+}
+
+static void region_compute_extents(Region* region) {
+	memset(&region->extents, 0, sizeof(region_box));
+	if (!region->count) return;
+
+	region->extents.y1 = region->boxes[0].y1;
+	region->extents.y2 = region->boxes[region->count - 1].y2;
+	region->extents.x1 = region->boxes[0].x1;
+	region->extents.x2 = region->boxes[0].x2;
+	for (int i = 1; i < region->count; i++) {
+		region->extents.x1 = MIN(region->extents.x1, region->boxes[i].x1);
+		region->extents.x2 = MAX(region->extents.x2, region->boxes[i].x2);
+	}
+}
+
+//walks the bands of a and b top to bottom, calling op on rows they both cover
+//rows only one of them covers are copied through if append_a/append_b is set
+static void region_op(Region* dest, Region* a, Region* b, band_op op, bool append_a, bool append_b) {
+	Region result;
+	region_init(&result);
+
+	region_box* r1 = a->boxes;
+	region_box* r1_last = a->boxes + a->count;
+	region_box* r2 = b->boxes;
+	region_box* r2_last = b->boxes + b->count;
+
+	//bottom of the rows handled so far
+	int ybot = INT32_MIN;
+
+	while (r1 != r1_last && r2 != r2_last) {
+		region_box* r1_band = band_end(r1, r1_last);
+		region_box* r2_band = band_end(r2, r2_last);
+
+		//rows of the higher band above the top of the other one
+		int ytop;
+		if (r1->y1 < r2->y1) {
+			int top = MAX(r1->y1, ybot);
+			int bot = MIN(r1->y2, r2->y1);
+			if (append_a && top < bot) {
+				append_band(&result, r1, r1_band, top, bot);
+			}
+			ytop = r2->y1;
+		}
+		else if (r2->y1 < r1->y1) {
+			int top = MAX(r2->y1, ybot);
+			int bot = MIN(r2->y2, r1->y1);
+			if (append_b && top < bot) {
+				append_band(&result, r2, r2_band, top, bot);
+			}
+			ytop = r1->y1;
+		}
+		else {
+			ytop = r1->y1;
+		}
+
+		//rows both bands cover
+		ybot = MIN(r1->y2, r2->y2);
+		if (ytop < ybot) {
+			op(&result, r1, r1_band, r2, r2_band, ytop, ybot);
+		}
+
+		//move past whichever bands are finished
+		if (r1->y2 == ybot) r1 = r1_band;
+		if (r2->y2 == ybot) r2 = r2_band;
+	}
+
+	//only one region has rows left, the first of its bands may be partly done
+	if (append_a) {
+		while (r1 != r1_last) {
+			region_box* r1_band = band_end(r1, r1_last);
+			append_band(&result, r1, r1_band, MAX(r1->y1, ybot), r1->y2);
+			r1 = r1_band;
+		}
+	}
+	if (append_b) {
+		while (r2 != r2_last) {
+			region_box* r2_band = band_end(r2, r2_last);
+			append_band(&result, r2, r2_band, MAX(r2->y1, ybot), r2->y2);
+			r2 = r2_band;
+		}
+	}
+
+	region_coalesce(&result);
+	region_compute_extents(&result);
+
+	//operands may alias dest, so it's only replaced once they're no longer needed
+	kfree(dest->boxes);
+	*dest = result;
+}
+
+static void union_bands(Region* dest, region_box* r1, region_box* r1_end, region_box* r2, region_box* r2_end, int y1, int y2) {
+	int x1 = 0;
+	int x2 = 0;
+	bool started = false;
+
+	//take boxes from both bands in order of left edge, merging any that overlap or touch
+	while (r1 != r1_end || r2 != r2_end) {
+		region_box* next;
+		if (r2 == r2_end || (r1 != r1_end && r1->x1 < r2->x1)) {
+			next = r1++;
+		}
+		else {
+			next = r2++;
+		}
+
+		if (started && next->x1 <= x2) {
+			x2 = MAX(x2, next->x2);
+			continue;
+		}
+		if (started) {
+			region_append(dest, x1, y1, x2, y2);
+		}
+		x1 = next->x1;
+		x2 = next->x2;
+		started = true;
+	}
+	if (started) {
+		region_append(dest, x1, y1, x2, y2);
+	}
+}
+
+static void intersect_bands(Region* dest, region_box* r1, region_box* r1_end, region_box* r2, region_box* r2_end, int y1, int y2) {
+	while (r1 != r1_end && r2 != r2_end) {
+		int x1 = MAX(r1->x1, r2->x1);
+		int x2 = MIN(r1->x2, r2->x2);
+		if (x1 < x2) {
+			region_append(dest, x1, y1, x2, y2);
+		}
+
+		//whichever box ends first can't overlap anything further right
+		if (r1->x2 < r2->x2) {
+			r1++;
+		}
+		else if (r2->x2 < r1->x2) {
+			r2++;
+		}
+		else {
+			r1++;
+			r2++;
+		}
+	}
+}
+
+static void subtract_bands(Region* dest, region_box* r1, region_box* r1_end, region_box* r2, region_box* r2_end, int y1, int y2) {
+	for (; r1 != r1_end; r1++) {
+		//left edge of what's left of this box
+		int x1 = r1->x1;
+		for (region_box* cut = r2; cut != r2_end && x1 < r1->x2; cut++) {
+			if (cut->x2 <= x1) continue;
+			if (cut->x1 >= r1->x2) break;
+
+			if (cut->x1 > x1) {
+				region_append(dest, x1, y1, cut->x1, y2);
+			}
+			x1 = cut->x2;
+		}
+		if (x1 < r1->x2) {
+			region_append(dest, x1, y1, r1->x2, y2);
+		}
+	}
+}
+
+void region_union(Region* dest, Region* a, Region* b) {
+	region_op(dest, a, b, union_bands, true, true);
+}
+
+void region_intersect(Region* dest, Region* a, Region* b) {
+	region_op(dest, a, b, intersect_bands, false, false);
+}
+
+void region_subtract(Region* dest, Region* a, Region* b) {
+	region_op(dest, a, b, subtract_bands, true, false);
+}
+
+void region_union_rect(Region* dest, Region* src, Rect r) {
+	Region other;
+	region_init_rect(&other, r);
+	region_union(dest, src, &other);
+	region_free(&other);
+}
+
+void region_intersect_rect(Region* dest, Region* src, Rect r) {
+	Region other;
+	region_init_rect(&other, r);
+	region_intersect(dest, src, &other);
+	region_free(&other);
+}
+
+void region_subtract_rect(Region* dest, Region* src, Rect r) {
+	Region other;
+	region_init_rect(&other, r);
+	region_subtract(dest, src, &other);
+	region_free(&other);
+}
@@ -0,0 +1,53 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <std/std_base.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "rect.h"
+
+__BEGIN_DECLS
+
+//rect stored as its edges, x2 and y2 are exclusive
+typedef struct region_box {
+	int x1, y1, x2, y2;
+} region_box;
+
+//arbitrary set of pixels, stored as y-x banded boxes like X11 and pixman regions:
+//boxes are sorted top to bottom, then left to right
+//boxes in the same band share y1 and y2, and never overlap or touch each other
+//vertically adjacent bands with identical boxes are merged, so every set has exactly one representation
+typedef struct region {
+	region_box* boxes;
+	int count;
+	int capacity;
+	region_box extents; //bounding box, all zero if region is empty
+} Region;
+
+//empty region
+void region_init(Region* region);
+//region covering r
+void region_init_rect(Region* region, Rect r);
+//frees region's boxes, leaving it empty
+void region_free(Region* region);
+void region_copy(Region* dest, Region* src);
+
+bool region_empty(Region* region);
+Rect region_extents(Region* region);
+//i'th rect of region, in banded order
+Rect region_rect(Region* region, int i);
+
+//dest may be the same region as either operand
+void region_union(Region* dest, Region* a, Region* b);
+void region_intersect(Region* dest, Region* a, Region* b);
+//pixels of a which aren't in b
+void region_subtract(Region* dest, Region* a, Region* b);
+
+//same as above, with r as the second operand
+void region_union_rect(Region* dest, Region* src, Rect r);
+void region_intersect_rect(Region* dest, Region* src, Rect r);
+void region_subtract_rect(Region* dest, Region* src, Rect r);
+
+__END_DECLS
+
+#endif
@@ -1,7 +1,9 @@
 #include "shapes.h"
 #include "gfx.h"
 #include <std/math.h>
+#include <std/memory.h>
 #include "color.h"
+#include "pixels.h"
 
 static void draw_rect_int(ca_layer* layer, Rect rect, Color color);
 
@@ -73,26 +75,24 @@ static void draw_rect_int_fast(ca_layer* layer, Rect rect, Color color) {
 		rect.size.height -= (rect.origin.y + rect.size.height - layer->size.height);
 	}
 
-	bool rgb = (gfx_depth() == VESA_DEPTH);
-	int bpp = (rgb ? 3 : 1);
-
-	int offset = rect.origin.x * bpp + rect.origin.y * layer->size.width * bpp;
-	int row_start = offset;
-	for (int y = rect.origin.y; y < rect.origin.y + rect.size.height; y++) {
-		for (int x = rect.origin.x; x < rect.origin.x + rect.size.width; x++) {
-			if (rgb) {
-				//we have to write the pixels in BGR, not RGB
-				layer->raw[offset++] = color.val[2];
-				layer->raw[offset++] = color.val[1];
-				layer->raw[offset++] = color.val[0];
-			}
-			else {
-				layer->raw[offset++] = color.val[0];
-			}
+	if (rect.size.width <= 0 || rect.size.height <= 0) return;
+
+	if (layer->format == PIXEL_FORMAT_INDEXED8) {
+		uint8_t* row = layer->raw + rect.origin.x + (rect.origin.y * layer->size.width);
+		for (int y = 0; y < rect.size.height; y++) {
+			memset(row, color.val[0], rect.size.width);
+			//move down 1 row
+			row += layer->size.width;
 		}
+		return;
+	}
+
+	uint32_t px = pixel_format_opaque(layer->format, color_hex(color));
+	uint32_t* row = (uint32_t*)layer->raw + rect.origin.x + (rect.origin.y * layer->size.width);
+	for (int y = 0; y < rect.size.height; y++) {
+		pixels_fill(row, px, rect.size.width);
 		//move down 1 row
-		row_start += layer->size.width * bpp;
-		offset = row_start;
+		row += layer->size.width;
 	}
 }
 
@@ -137,26 +137,24 @@ void draw_hline_fast(ca_layer* layer, Line line, Color color, int thickness) {
 	normalize_coordinate(layer, &line.p1);
 	normalize_coordinate(layer, &line.p2);
 
-	int bpp = gfx_bpp();
+	//normalize_coordinate lets y reach one past the last row
+	if (line.p1.y >= layer->size.height) return;
 
 	//calculate starting point
-	int offset = (line.p1.x * bpp) + (line.p1.y * bpp * layer->size.width);
+	int offset = line.p1.x + (line.p1.y * layer->size.width);
 	int length = line.p2.x - line.p1.x;
 	int overhang = length + line.p1.x - layer->size.width;
 	if (overhang > 0) {
 		length -= overhang;
 	}
-	for (int i = 0; i < length; i++) {
-		if (bpp > 1) {
-			//we have to write the pixels in BGR, not RGB
-			layer->raw[offset++] = color.val[2];
-			layer->raw[offset++] = color.val[1];
-			layer->raw[offset++] = color.val[0];
-		}
-		else {
-			layer->raw[offset++] = color.val[0];
-		}
+	if (length <= 0) return;
+
+	if (layer->format == PIXEL_FORMAT_INDEXED8) {
+		memset(layer->raw + offset, color.val[0], length);
+		return;
 	}
+	uint32_t px = pixel_format_opaque(layer->format, color_hex(color));
+	pixels_fill((uint32_t*)layer->raw + offset, px, length);
 }
 
 void draw_vline_fast(ca_layer* layer, Line line, Color color, int thickness) {
@@ -164,25 +162,21 @@ void draw_vline_fast(ca_layer* layer, Line line, Color color, int thickness) {
 	normalize_coordinate(layer, &line.p1);
 	normalize_coordinate(layer, &line.p2);
 
-	bool rgb = (gfx_depth() == VESA_DEPTH);
-	int bpp = (rgb ? 3 : 1);
+	//normalize_coordinate lets x reach one past the last column
+	if (line.p1.x >= layer->size.width) return;
 
 	//calculate starting point
-	int offset = (line.p1.x * bpp) + (line.p1.y * bpp * layer->size.width);
-	int row_start = offset;
+	int offset = line.p1.x + (line.p1.y * layer->size.width);
+	uint32_t px = pixel_format_opaque(layer->format, color_hex(color));
 	for (int i = 0; i < line.p2.y - line.p1.y; i++) {
-		if (rgb) {
-			//we have to write the pixels in BGR, not RGB
-			layer->raw[offset++] = color.val[2];
-			layer->raw[offset++] = color.val[1];
+		if (layer->format == PIXEL_FORMAT_INDEXED8) {
 			layer->raw[offset] = color.val[0];
 		}
 		else {
-			layer->raw[offset] = color.val[0];
+			((uint32_t*)layer->raw)[offset] = px;
 		}
 		//go to next row
-		row_start += layer->size.width * bpp;
-		offset = row_start;
+		offset += layer->size.width;
 	}
 }
 #pragma GCC diagnostic pop
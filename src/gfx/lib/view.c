@@ -1,5 +1,7 @@
 #include "view.h"
 #include "button.h"
+#include "util.h"
+#include "window.h"
 #include <std/kheap.h>
 #include <gfx/lib/shapes.h>
 #include <stddef.h>
@@ -52,15 +54,47 @@ View* create_view(Rect frame) {
 	return view;
 }
 
-void mark_needs_redraw(View* view) {
-	if (!view) return;
+//views are only repainted along with their window, so make sure it gets redrawn too
+static void mark_window_needs_redraw(View* view) {
+	if (!gfx_screen()) return;
+
+	Window* window = containing_window(view);
+	//containing_window falls back on the root window for views which aren't in a window yet
+	if (window->title_view == view || window->content_view == view) {
+		window->needs_redraw = 1;
+	}
+}
 
+//windows are composited over the window beneath them, not drawn into its layer
+static bool is_window(View* view) {
+	Screen* screen = gfx_screen();
+	if (!screen) return false;
+	return view == (View*)screen->window || window_presented((Window*)view);
+}
+
+static void set_needs_redraw(View* view) {
 	//if this view has already been marked, quit
+	//its superviews were marked along with it
 	if (view->needs_redraw) return;
 
 	view->needs_redraw = 1;
-	if (view->superview && view->superview->superview) {
-		mark_needs_redraw(view->superview);
+	if (!view->superview) {
+		mark_window_needs_redraw(view);
+	}
+	else if (!is_window(view)) {
+		//superview's layer holds a copy of this view's, so it's stale too
+		set_needs_redraw(view->superview);
+	}
+}
+
+void mark_needs_redraw(View* view) {
+	if (!view || view->needs_redraw) return;
+
+	set_needs_redraw(view);
+
+	//only the area this view covers has to be put back on screen
+	if (gfx_screen()) {
+		mark_damaged(absolute_frame(view));
 	}
 }
 
@@ -135,13 +169,49 @@ void set_background_color(View* view, Color color) {
 	if (!view) return;
 
 	view->background_color = color;
+	//labels fill their background with their superview's color
+	for (int i = 0; i < view->labels->size; i++) {
+		Label* label = (Label*)array_m_lookup(view->labels, i);
+		label->needs_redraw = 1;
+	}
+	mark_needs_redraw(view);
+}
+
+static void set_tree_needs_redraw(View* view) {
+	view->needs_redraw = 1;
+	for (int i = 0; i < view->labels->size; i++) {
+		Label* label = (Label*)array_m_lookup(view->labels, i);
+		label->needs_redraw = 1;
+	}
+	for (int i = 0; i < view->subviews->size; i++) {
+		set_tree_needs_redraw((View*)array_m_lookup(view->subviews, i));
+	}
+}
+
+void mark_tree_needs_redraw(View* view) {
+	if (!view) return;
+
+	//marks superviews and damages the area first, everything inside just needs flagging
 	mark_needs_redraw(view);
+	set_tree_needs_redraw(view);
+}
+
+//marks the screen area view covers as changed, including the drop shadow if it's a window on screen
+static void damage_view_area(View* view) {
+	mark_damaged(absolute_frame(view));
+	if (window_presented((Window*)view)) {
+		mark_damaged(window_shadow_frame((Window*)view));
+	}
 }
 
 void set_frame(View* view, Rect frame) {
 	if (!view) return;
 
 	Rect old_frame = view->frame;
+	if (gfx_screen()) {
+		//uncover whatever was beneath the old position
+		damage_view_area(view);
+	}
 	view->frame = frame;
 
 	//resize layer
@@ -152,6 +222,10 @@ void set_frame(View* view, Rect frame) {
 	if (old_frame.size.width != frame.size.width || old_frame.size.height != frame.size.height) {
 		mark_needs_redraw(view);
 	}
+	if (gfx_screen()) {
+		//whether or not its contents changed, it has to be composited at the new position
+		damage_view_area(view);
+	}
 }
 
 void set_alpha(View* view, float alpha) {
@@ -161,6 +235,9 @@ void set_alpha(View* view, float alpha) {
 	alpha = MAX(MIN(alpha, 1), 0);
 
 	view->layer->alpha = alpha;
+	if (gfx_screen()) {
+		damage_view_area(view);
+	}
 }
 
 Rect convert_frame(View* view, Rect frame) {
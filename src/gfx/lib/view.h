@@ -47,7 +47,11 @@ typedef struct button Button;
 void add_button(View* view, Button* button);
 void remove_button(View* view, Button* button);
 
+//views keep what they drew in their layer, and are only drawn again once marked
+//marking a view marks its superviews too, as their layers hold a copy of it
 void mark_needs_redraw(View* view);
+//marks view and everything in it, so none of it is drawn from what was kept
+void mark_tree_needs_redraw(View* view);
 
 //convert frame to view's coordinate space
 Rect convert_frame(View* view, Rect frame);
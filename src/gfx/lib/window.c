@@ -41,18 +41,13 @@ static View* create_title_view(Window* window) {
 	add_sublabel(title_view, title_label);
 
 	Bmp* dots = create_bmp(title_view_frame, create_layer(title_view_frame.size));
-	uint8_t* ref = dots->layer->raw;
 	for (int y = 0; y < dots->frame.size.height; y++) {
 		for (int x = 0; x < dots->frame.size.width; x++) {
 			if (!((x + y) % 2)) {
-				*ref++ = 50;
-				*ref++ = 50;
-				*ref++ = 50;
+				putpixel(dots->layer, x, y, color_make(50, 50, 50));
 			}
 			else {
-				*ref++ = 200;
-				*ref++ = 160;
-				*ref++ = 90;
+				putpixel(dots->layer, x, y, color_make(90, 160, 200));
 			}
 		}
 	}
@@ -109,7 +104,9 @@ void add_subwindow(Window* window, Window* subwindow) {
 
 	array_m_insert(window->subviews, subwindow);
 	subwindow->superview = window;
-	mark_needs_redraw((View*)window);
+	//window's own contents are unaffected, only the area subwindow now covers changes
+	mark_damaged(subwindow->frame);
+	mark_damaged(window_shadow_frame(subwindow));
 }
 
 void remove_subwindow(Window* window, Window* subwindow) {
@@ -120,7 +117,8 @@ void remove_subwindow(Window* window, Window* subwindow) {
 		array_m_remove(window->subviews, idx);
 	}
 	subwindow->superview = NULL;
-	mark_needs_redraw((View*)window);
+	mark_damaged(subwindow->frame);
+	mark_damaged(window_shadow_frame(subwindow));
 }
 
 void present_window(Window* window) {
@@ -179,11 +177,60 @@ void window_teardown(Window* window) {
 
 	//free backing layer
 	layer_teardown(window->layer);
+	layer_teardown(window->shadow);
 
 	//finally, free window itself
 	kfree(window);
 }
 
+Rect window_shadow_frame(Window* window) {
+	Rect r = window->frame;
+	r.origin.x -= WINDOW_SHADOW_RADIUS;
+	r.origin.y += WINDOW_SHADOW_OFFSET - WINDOW_SHADOW_RADIUS;
+	r.size.width += WINDOW_SHADOW_RADIUS * 2;
+	r.size.height += WINDOW_SHADOW_RADIUS * 2;
+	return r;
+}
+
+//how dark a shadow of length pixels is at each of them, out of 256
+//fades in over 2 radii from either end, so it's at full strength from a radius inside the window's edge
+static void shadow_ramp(int* ramp, int length) {
+	int fade = WINDOW_SHADOW_RADIUS * 2;
+	for (int i = 0; i < length; i++) {
+		int edge = MIN(i, length - 1 - i);
+		ramp[i] = (edge >= fade) ? 256 : ((edge * 256) / fade);
+	}
+}
+
+ca_layer* window_shadow(Window* window) {
+	if (gfx_pixel_format() == PIXEL_FORMAT_INDEXED8) return NULL;
+
+	Size size = window_shadow_frame(window).size;
+	if (window->shadow && window->shadow->size.width == size.width && window->shadow->size.height == size.height) {
+		return window->shadow;
+	}
+	layer_teardown(window->shadow);
+	window->shadow = create_layer_format(size, PIXEL_FORMAT_ARGB32);
+
+	//edges fade independently, which rounds off the corners
+	int* ramp_x = kmalloc(size.width * sizeof(int));
+	int* ramp_y = kmalloc(size.height * sizeof(int));
+	shadow_ramp(ramp_x, size.width);
+	shadow_ramp(ramp_y, size.height);
+
+	//black premultiplied by any alpha is still black, so only the alpha byte is set
+	uint32_t* px = (uint32_t*)window->shadow->raw;
+	for (int y = 0; y < size.height; y++) {
+		uint32_t row_alpha = WINDOW_SHADOW_OPACITY * ramp_y[y];
+		for (int x = 0; x < size.width; x++) {
+			*px++ = ((row_alpha * ramp_x[x]) >> 16) << 24;
+		}
+	}
+	kfree(ramp_x);
+	kfree(ramp_y);
+	return window->shadow;
+}
+
 bool window_presented(Window* w) {
 	Screen* s = gfx_screen();
 	return (array_m_index(s->window->subviews, w) != ARR_NOT_FOUND);
@@ -13,6 +13,12 @@ __BEGIN_DECLS
 
 #define WINDOW_TITLE_VIEW_HEIGHT 25
 
+//how far below its window a drop shadow falls, and how far its edges fade out over
+#define WINDOW_SHADOW_OFFSET 6
+#define WINDOW_SHADOW_RADIUS 10
+//alpha of the shadow where it's darkest
+#define WINDOW_SHADOW_OPACITY 0x60
+
 typedef struct window {
 	//common
 	Rect frame;
@@ -30,6 +36,7 @@ typedef struct window {
 	array_m* animations;
 	event_handler teardown_handler;
 	event_handler redraw_handler;
+	ca_layer* shadow; //premultiplied drop shadow, NULL until it's first drawn
 } Window;
 
 Window* create_window(Rect frame);
@@ -46,6 +53,12 @@ void kill_window(Window* window);
 
 void set_border_width(Window* window, int width);
 
+//area covered by window's drop shadow, in the same coordinates as its frame
+Rect window_shadow_frame(Window* window);
+//window's drop shadow, sized to window_shadow_frame
+//remade whenever the window has changed size, NULL if the screen can't show alpha
+ca_layer* window_shadow(Window* window);
+
 //is xserv displaying this window?
 bool window_presented(Window* w);
 
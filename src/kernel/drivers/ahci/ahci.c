@@ -0,0 +1,377 @@
+#include "ahci.h"
+#include <std/kheap.h>
+#include <std/math.h>
+#include <kernel/drivers/pci/pci_detect.h>
+#include <kernel/util/paging/paging.h>
+#include <kernel/util/interrupts/isr.h>
+#include <kernel/util/mutex/mutex.h>
+#include <kernel/util/syscall/sysfuncs.h>
+#include <kernel/util/vfs/block.h>
+
+//a batch of commands whose completion a caller is waiting on
+//kept on the heap, the interrupt completing it can arrive in any task's address space
+typedef struct ahci_request {
+	volatile uint32_t pending;	//slots still in flight
+	volatile bool failed;
+} ahci_request_t;
+
+typedef struct ahci_port {
+	hba_port_t* regs;
+	hba_cmd_header_t* cmd_list;
+	hba_cmd_tbl_t* cmd_tables[AHCI_MAX_SLOTS];
+	ahci_request_t* slot_request[AHCI_MAX_SLOTS];
+
+	uint32_t slot_mask;			//command slots we are allowed to use
+	bool ncq;					//issue FPDMA QUEUED commands
+	volatile uint32_t issued;	//slots currently owned by the device
+	lock_t* lock;				//held while claiming and issuing slots
+
+	block_device_t dev;
+} ahci_port_t;
+
+static hba_mem_t* hba = 0;
+static ahci_port_t* ports[AHCI_MAX_PORTS];
+
+static ahci_request_t* ahci_request_create() {
+	ahci_request_t* request = kmalloc(sizeof(ahci_request_t));
+	request->pending = 0;
+	request->failed = false;
+	return request;
+}
+
+static void ahci_port_stop(hba_port_t* port) {
+	port->cmd &= ~HBA_PxCMD_ST;
+	port->cmd &= ~HBA_PxCMD_FRE;
+	//wait until FIS receive and command list engines have stopped
+	while (port->cmd & (HBA_PxCMD_FR | HBA_PxCMD_CR))
+		;
+}
+
+static void ahci_port_start(hba_port_t* port) {
+	while (port->cmd & HBA_PxCMD_CR)
+		;
+	port->cmd |= HBA_PxCMD_FRE;
+	port->cmd |= HBA_PxCMD_ST;
+}
+
+//completes every slot the device has finished with
+//NCQ commands are retired when their SActive bit clears, others when their CI bit clears
+static void ahci_port_reap(ahci_port_t* port) {
+	hba_port_t* regs = port->regs;
+	uint32_t status = regs->is;
+	regs->is = status;
+
+	bool error = status & HBA_PxIS_ERRORS;
+	uint32_t busy = regs->sact | regs->ci;
+	uint32_t done = port->issued & ~busy;
+	if (error) {
+		//a failed NCQ command aborts the whole queue, so fail everything in flight
+		printf_err("AHCI: %s error, IS %x TFD %x SERR %x", port->dev.name, status, regs->tfd, regs->serr);
+		done = port->issued;
+		ahci_port_stop(regs);
+		regs->serr = regs->serr;
+		regs->is = regs->is;
+		ahci_port_start(regs);
+	}
+
+	for (int slot = 0; slot < AHCI_MAX_SLOTS; slot++) {
+		if (!(done & (1 << slot))) continue;
+
+		ahci_request_t* request = port->slot_request[slot];
+		port->slot_request[slot] = NULL;
+		port->issued &= ~(1 << slot);
+		if (request) {
+			if (error) request->failed = true;
+			request->pending &= ~(1 << slot);
+		}
+	}
+}
+
+static void ahci_irq(registers_t UNUSED(regs)) {
+	uint32_t status = hba->is;
+	for (int i = 0; i < AHCI_MAX_PORTS; i++) {
+		if ((status & (1 << i)) && ports[i]) {
+			ahci_port_reap(ports[i]);
+		}
+	}
+	hba->is = status;
+}
+
+//completes whatever the port has finished without waiting for its interrupt
+//waiters check this themselves, so a lost or misrouted interrupt can't hang them
+static void ahci_port_poll(ahci_port_t* port) {
+	kernel_begin_critical();
+	ahci_port_reap(port);
+	kernel_end_critical();
+}
+
+//waits for every command of request and frees it
+//returns 0 on success, -1 if any command failed
+static int ahci_wait(ahci_port_t* port, ahci_request_t* request) {
+	while (request->pending) {
+		//let other tasks run while the disk works
+		sys_yield(RUNNABLE);
+		ahci_port_poll(port);
+	}
+	int ret = request->failed ? -1 : 0;
+	kfree(request);
+	return ret;
+}
+
+//claims a free command slot, waiting for one if the queue is full
+//returns with port->lock held
+static int ahci_claim_slot(ahci_port_t* port) {
+	while (1) {
+		lock(port->lock);
+		uint32_t free = port->slot_mask & ~port->issued;
+		if (free) {
+			for (int slot = 0; slot < AHCI_MAX_SLOTS; slot++) {
+				if (free & (1 << slot)) return slot;
+			}
+		}
+		unlock(port->lock);
+		sys_yield(RUNNABLE);
+		ahci_port_poll(port);
+	}
+}
+
+//fills the PRDT of table with the physical pages backing buf
+//returns number of entries used
+static int ahci_build_prdt(hba_cmd_tbl_t* table, uint8_t* buf, uint32_t size) {
+	int count = 0;
+	while (size) {
+		uint32_t virt = (uint32_t)buf;
+		uint32_t phys = virt_to_phys(virt);
+		//bytes until the end of this page
+		uint32_t chunk = MIN(size, 0x1000 - (virt & 0xFFF));
+
+		hba_prdt_entry_t* prev = count ? &table->prdt_entry[count - 1] : NULL;
+		if (prev && prev->dba + prev->dbc + 1 == phys && prev->dbc + chunk < 0x400000) {
+			//physically contiguous with the last entry, extend it
+			prev->dbc += chunk;
+		}
+		else {
+			hba_prdt_entry_t* entry = &table->prdt_entry[count++];
+			entry->dba = phys;
+			entry->dbau = 0;
+			entry->rsv0 = 0;
+			entry->dbc = chunk - 1;
+			entry->rsv1 = 0;
+			entry->i = 0;
+		}
+		buf += chunk;
+		size -= chunk;
+	}
+	return count;
+}
+
+//builds and issues a command in a free slot, tracked by request
+//buf may be NULL for commands without data
+static void ahci_issue(ahci_port_t* port, ahci_request_t* request, uint8_t command, bool write, uint32_t lba, uint32_t count, uint8_t* buf, uint32_t size) {
+	int slot = ahci_claim_slot(port);
+	bool queued = (command == AHCI_CMD_READ_FPDMA_QUEUED || command == AHCI_CMD_WRITE_FPDMA_QUEUED);
+
+	hba_cmd_tbl_t* table = port->cmd_tables[slot];
+	memset(table, 0, sizeof(hba_cmd_tbl_t) - sizeof(table->prdt_entry));
+
+	hba_cmd_header_t* header = &port->cmd_list[slot];
+	header->cfl = sizeof(fis_reg_h2d_t) / sizeof(uint32_t);
+	header->w = write;
+	header->prdbc = 0;
+	header->prdtl = buf ? ahci_build_prdt(table, buf, size) : 0;
+
+	fis_reg_h2d_t* fis = (fis_reg_h2d_t*)table->cfis;
+	fis->fis_type = FIS_TYPE_REG_H2D;
+	fis->c = 1;
+	fis->command = command;
+	fis->lba0 = lba & 0xFF;
+	fis->lba1 = (lba >> 8) & 0xFF;
+	fis->lba2 = (lba >> 16) & 0xFF;
+	fis->lba3 = (lba >> 24) & 0xFF;
+	//LBA mode
+	fis->device = 1 << 6;
+	if (queued) {
+		//FPDMA commands carry the sector count in the features field and the tag in count
+		fis->featurel = count & 0xFF;
+		fis->featureh = (count >> 8) & 0xFF;
+		fis->countl = slot << 3;
+	}
+	else {
+		fis->countl = count & 0xFF;
+		fis->counth = (count >> 8) & 0xFF;
+	}
+
+	//the completion interrupt also updates these, keep it out until the command is issued
+	kernel_begin_critical();
+	request->pending |= (1 << slot);
+	port->slot_request[slot] = request;
+	port->issued |= (1 << slot);
+	if (queued) {
+		port->regs->sact = (1 << slot);
+	}
+	port->regs->ci = (1 << slot);
+	kernel_end_critical();
+
+	unlock(port->lock);
+}
+
+//transfers count sectors, queueing as many commands as needed and waiting for all of them
+static int ahci_transfer(ahci_port_t* port, bool write, uint32_t lba, uint32_t count, uint8_t* buffer) {
+	uint8_t command;
+	if (port->ncq) command = write ? AHCI_CMD_WRITE_FPDMA_QUEUED : AHCI_CMD_READ_FPDMA_QUEUED;
+	else command = write ? AHCI_CMD_WRITE_DMA_EXT : AHCI_CMD_READ_DMA_EXT;
+
+	ahci_request_t* request = ahci_request_create();
+	while (count) {
+		uint32_t chunk = MIN(count, (uint32_t)AHCI_MAX_SECTORS_PER_CMD);
+		uint32_t size = chunk * port->dev.sector_size;
+		ahci_issue(port, request, command, write, lba, chunk, buffer, size);
+
+		lba += chunk;
+		count -= chunk;
+		buffer += size;
+	}
+	return ahci_wait(port, request);
+}
+
+static int ahci_block_read(block_device_t* dev, uint32_t lba, uint32_t count, uint8_t* buffer) {
+	return ahci_transfer(dev->ctx, false, lba, count, buffer);
+}
+
+static int ahci_block_write(block_device_t* dev, uint32_t lba, uint32_t count, uint8_t* buffer) {
+	return ahci_transfer(dev->ctx, true, lba, count, buffer);
+}
+
+static int ahci_block_flush(block_device_t* dev) {
+	ahci_port_t* port = dev->ctx;
+
+	//FLUSH CACHE isn't a queued command, so the queue must be empty when it's issued
+	while (port->issued) {
+		sys_yield(RUNNABLE);
+		ahci_port_poll(port);
+	}
+	ahci_request_t* request = ahci_request_create();
+	ahci_issue(port, request, AHCI_CMD_FLUSH_CACHE_EXT, false, 0, 0, NULL, 0);
+	return ahci_wait(port, request);
+}
+
+static bool ahci_port_identify(ahci_port_t* port, bool hba_ncq) {
+	uint16_t* identify = kmalloc(512);
+	ahci_request_t* request = ahci_request_create();
+	ahci_issue(port, request, AHCI_CMD_IDENTIFY, false, 0, 0, (uint8_t*)identify, 512);
+	if (ahci_wait(port, request)) {
+		kfree(identify);
+		return false;
+	}
+
+	//words 100-103 hold the LBA48 sector count, 60-61 the LBA28 count
+	uint32_t sectors = identify[100] | ((uint32_t)identify[101] << 16);
+	if (!(identify[83] & (1 << 10))) {
+		sectors = identify[60] | ((uint32_t)identify[61] << 16);
+	}
+	port->dev.sector_count = sectors;
+	port->dev.sector_size = 512;
+
+	//word 76 bit 8 is NCQ support, word 75 is the queue depth minus one
+	if (hba_ncq && (identify[76] & (1 << 8))) {
+		uint32_t depth = (identify[75] & 0x1F) + 1;
+		port->ncq = true;
+		port->slot_mask &= (depth == 32) ? 0xFFFFFFFF : ((1u << depth) - 1);
+	}
+	kfree(identify);
+	return true;
+}
+
+static void ahci_port_init(int idx, uint32_t slot_count, bool hba_ncq) {
+	hba_port_t* regs = &hba->ports[idx];
+
+	ahci_port_t* port = kmalloc(sizeof(ahci_port_t));
+	memset(port, 0, sizeof(ahci_port_t));
+	port->regs = regs;
+	port->lock = lock_create();
+	port->slot_mask = (slot_count == 32) ? 0xFFFFFFFF : ((1u << slot_count) - 1);
+
+	ahci_port_stop(regs);
+
+	//command list (1K) and received FIS area (256 bytes) share one page
+	uint32_t phys;
+	uint8_t* page = kmalloc_ap(0x1000, &phys);
+	memset(page, 0, 0x1000);
+	port->cmd_list = (hba_cmd_header_t*)page;
+	regs->clb = phys;
+	regs->clbu = 0;
+	regs->fb = phys + 0x400;
+	regs->fbu = 0;
+
+	//each command table gets its own page so it is physically contiguous
+	for (uint32_t i = 0; i < slot_count; i++) {
+		port->cmd_tables[i] = kmalloc_ap(0x1000, &phys);
+		memset(port->cmd_tables[i], 0, 0x1000);
+		port->cmd_list[i].ctba = phys;
+		port->cmd_list[i].ctbau = 0;
+	}
+
+	regs->serr = regs->serr;
+	regs->is = regs->is;
+	regs->ie = HBA_PxIS_DHRS | HBA_PxIS_PSS | HBA_PxIS_DSS | HBA_PxIS_SDBS | HBA_PxIS_ERRORS;
+	ports[idx] = port;
+	ahci_port_start(regs);
+
+	port->dev.ctx = port;
+	if (!ahci_port_identify(port, hba_ncq)) {
+		printf_err("AHCI: IDENTIFY failed on port %d", idx);
+		return;
+	}
+
+	//sda, sdb...
+	static int disk_count = 0;
+	strcpy(port->dev.name, "sda");
+	port->dev.name[2] += disk_count++;
+	port->dev.read = ahci_block_read;
+	port->dev.write = ahci_block_write;
+	port->dev.flush = ahci_block_flush;
+
+	printf_info("AHCI: port %d %dMB disk, %s", idx, port->dev.sector_count / 1024 / 2, port->ncq ? "NCQ" : "no NCQ");
+	block_device_register(&port->dev);
+}
+
+void ahci_install() {
+	pci_device* device = pci_find_class(AHCI_PCI_CLASS, AHCI_PCI_SUBCLASS, 0);
+	if (!device) return;
+
+	printf_info("Initializing AHCI controller %x:%x...", device->vendor, device->device);
+	pci_enable_bus_master(device);
+
+	//ABAR is BAR5, registers span at most 0x1100 bytes
+	hba = map_mmio(device->bar[5] & 0xFFFFFFF0, sizeof(hba_mem_t));
+	if (!hba) return;
+
+	hba->ghc |= HBA_GHC_AE;
+	memset(ports, 0, sizeof(ports));
+	//the line may be shared with other PCI devices, IS tells us which ports interrupted
+	register_shared_interrupt_handler(IRQ0 + device->irq, &ahci_irq);
+
+	//number of command slots is stored minus one
+	uint32_t slot_count = ((hba->cap >> 8) & 0x1F) + 1;
+	bool ncq = hba->cap & HBA_CAP_SNCQ;
+
+	hba->is = hba->is;
+	hba->ghc |= HBA_GHC_IE;
+
+	uint32_t implemented = hba->pi;
+	for (int i = 0; i < AHCI_MAX_PORTS; i++) {
+		if (!(implemented & (1 << i))) continue;
+
+		hba_port_t* port = &hba->ports[i];
+		//device detected and phy communication established, interface active
+		uint8_t det = port->ssts & 0x0F;
+		uint8_t ipm = (port->ssts >> 8) & 0x0F;
+		if (det != 3 || ipm != 1) continue;
+
+		if (port->sig != SATA_SIG_ATA) {
+			//ATAPI, enclosure bridges, and port multipliers aren't supported
+			continue;
+		}
+		ahci_port_init(i, slot_count, ncq);
+	}
+}
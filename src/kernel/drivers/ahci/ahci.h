@@ -0,0 +1,179 @@
+#ifndef AHCI_H
+#define AHCI_H
+
+#include <std/std.h>
+
+//PCI class of an AHCI host bus adapter (mass storage, SATA)
+#define AHCI_PCI_CLASS		0x01
+#define AHCI_PCI_SUBCLASS	0x06
+
+#define AHCI_MAX_PORTS	32
+#define AHCI_MAX_SLOTS	32
+//physical region descriptors per command table
+//a table then fits in one page
+#define AHCI_MAX_PRDS	130
+//largest transfer issued as a single command (512KB)
+//even a buffer with no two physically contiguous pages fits in AHCI_MAX_PRDS
+#define AHCI_MAX_SECTORS_PER_CMD 1024
+
+//port signatures
+#define SATA_SIG_ATA	0x00000101
+#define SATA_SIG_ATAPI	0xEB140101
+#define SATA_SIG_SEMB	0xC33C0101
+#define SATA_SIG_PM		0x96690101
+
+//generic host control bits
+#define HBA_GHC_HR	(1 << 0)	//HBA reset
+#define HBA_GHC_IE	(1 << 1)	//interrupt enable
+#define HBA_GHC_AE	(1u << 31)	//AHCI enable
+
+#define HBA_CAP_SNCQ (1 << 30)	//supports native command queuing
+
+//port command and status bits
+#define HBA_PxCMD_ST	(1 << 0)	//start processing command list
+#define HBA_PxCMD_FRE	(1 << 4)	//FIS receive enable
+#define HBA_PxCMD_FR	(1 << 14)	//FIS receive running
+#define HBA_PxCMD_CR	(1 << 15)	//command list running
+
+//port interrupt status bits
+#define HBA_PxIS_DHRS	(1 << 0)	//device to host register FIS
+#define HBA_PxIS_PSS	(1 << 1)	//PIO setup FIS
+#define HBA_PxIS_DSS	(1 << 2)	//DMA setup FIS
+#define HBA_PxIS_SDBS	(1 << 3)	//set device bits FIS, signals NCQ completion
+#define HBA_PxIS_TFES	(1 << 30)	//task file error
+#define HBA_PxIS_ERRORS	0x7D800010	//any fatal or non-fatal error
+
+#define ATA_DEV_BUSY	0x80
+#define ATA_DEV_DRQ		0x08
+
+#define AHCI_CMD_IDENTIFY			0xEC
+#define AHCI_CMD_READ_DMA_EXT		0x25
+#define AHCI_CMD_WRITE_DMA_EXT		0x35
+#define AHCI_CMD_READ_FPDMA_QUEUED	0x60
+#define AHCI_CMD_WRITE_FPDMA_QUEUED	0x61
+#define AHCI_CMD_FLUSH_CACHE_EXT	0xEA
+
+typedef enum {
+	FIS_TYPE_REG_H2D	= 0x27,	//register FIS, host to device
+	FIS_TYPE_REG_D2H	= 0x34,	//register FIS, device to host
+	FIS_TYPE_DMA_ACT	= 0x39,	//DMA activate FIS, device to host
+	FIS_TYPE_DMA_SETUP	= 0x41,	//DMA setup FIS, bidirectional
+	FIS_TYPE_DATA		= 0x46,	//data FIS, bidirectional
+	FIS_TYPE_BIST		= 0x58,	//BIST activate FIS, bidirectional
+	FIS_TYPE_PIO_SETUP	= 0x5F,	//PIO setup FIS, device to host
+	FIS_TYPE_DEV_BITS	= 0xA1,	//set device bits FIS, device to host
+} fis_type_t;
+
+typedef struct fis_reg_h2d {
+	uint8_t fis_type;		//FIS_TYPE_REG_H2D
+	uint8_t pmport	: 4;	//port multiplier
+	uint8_t rsv0	: 3;
+	uint8_t c		: 1;	//1: command, 0: control
+	uint8_t command;
+	uint8_t featurel;
+
+	uint8_t lba0;
+	uint8_t lba1;
+	uint8_t lba2;
+	uint8_t device;
+
+	uint8_t lba3;
+	uint8_t lba4;
+	uint8_t lba5;
+	uint8_t featureh;
+
+	uint8_t countl;
+	uint8_t counth;
+	uint8_t icc;			//isochronous command completion
+	uint8_t control;
+
+	uint8_t rsv1[4];
+} __attribute__((packed)) fis_reg_h2d_t;
+
+//port registers, one set per port
+typedef volatile struct hba_port {
+	uint32_t clb;		//command list base address, 1K aligned
+	uint32_t clbu;		//upper 32 bits
+	uint32_t fb;		//FIS base address, 256 byte aligned
+	uint32_t fbu;		//upper 32 bits
+	uint32_t is;		//interrupt status
+	uint32_t ie;		//interrupt enable
+	uint32_t cmd;		//command and status
+	uint32_t rsv0;
+	uint32_t tfd;		//task file data
+	uint32_t sig;		//signature
+	uint32_t ssts;		//SATA status (SCR0:SStatus)
+	uint32_t sctl;		//SATA control (SCR2:SControl)
+	uint32_t serr;		//SATA error (SCR1:SError)
+	uint32_t sact;		//SATA active (SCR3:SActive)
+	uint32_t ci;		//command issue
+	uint32_t sntf;		//SATA notification
+	uint32_t fbs;		//FIS-based switch control
+	uint32_t rsv1[11];
+	uint32_t vendor[4];
+} __attribute__((packed)) hba_port_t;
+
+//memory mapped registers found at ABAR (BAR5)
+typedef volatile struct hba_mem {
+	uint32_t cap;		//host capability
+	uint32_t ghc;		//global host control
+	uint32_t is;		//interrupt status, one bit per port
+	uint32_t pi;		//ports implemented
+	uint32_t vs;		//version
+	uint32_t ccc_ctl;	//command completion coalescing control
+	uint32_t ccc_pts;	//command completion coalescing ports
+	uint32_t em_loc;	//enclosure management location
+	uint32_t em_ctl;	//enclosure management control
+	uint32_t cap2;		//extended host capabilities
+	uint32_t bohc;		//BIOS/OS handoff control and status
+
+	uint8_t rsv[0xA0 - 0x2C];
+	uint8_t vendor[0x100 - 0xA0];
+
+	hba_port_t ports[AHCI_MAX_PORTS];
+} __attribute__((packed)) hba_mem_t;
+
+typedef struct hba_cmd_header {
+	uint8_t cfl		: 5;	//command FIS length in dwords
+	uint8_t a		: 1;	//ATAPI
+	uint8_t w		: 1;	//write, 1: host to device
+	uint8_t p		: 1;	//prefetchable
+
+	uint8_t r		: 1;	//reset
+	uint8_t b		: 1;	//BIST
+	uint8_t c		: 1;	//clear busy upon R_OK
+	uint8_t rsv0	: 1;
+	uint8_t pmp		: 4;	//port multiplier port
+
+	uint16_t prdtl;			//physical region descriptor table length in entries
+
+	volatile uint32_t prdbc;	//bytes transferred
+
+	uint32_t ctba;			//command table base address, 128 byte aligned
+	uint32_t ctbau;			//upper 32 bits
+
+	uint32_t rsv1[4];
+} __attribute__((packed)) hba_cmd_header_t;
+
+typedef struct hba_prdt_entry {
+	uint32_t dba;			//data base address
+	uint32_t dbau;			//upper 32 bits
+	uint32_t rsv0;
+
+	uint32_t dbc	: 22;	//byte count minus one, must describe an even count
+	uint32_t rsv1	: 9;
+	uint32_t i		: 1;	//interrupt on completion
+} __attribute__((packed)) hba_prdt_entry_t;
+
+typedef struct hba_cmd_tbl {
+	uint8_t cfis[64];		//command FIS
+	uint8_t acmd[16];		//ATAPI command
+	uint8_t rsv[48];
+	hba_prdt_entry_t prdt_entry[AHCI_MAX_PRDS];
+} __attribute__((packed)) hba_cmd_tbl_t;
+
+//probes for AHCI controllers on the PCI bus and registers
+//a block device for each SATA disk attached
+void ahci_install();
+
+#endif
@@ -1,7 +1,19 @@
 #include "ide.h"
-/*
-unsigned char ide_read(unsigned char channel, unsigned char reg) {
-	unsigned char result;
+#include <std/math.h>
+#include <kernel/util/interrupts/isr.h>
+#include <kernel/util/vfs/block.h>
+
+static ide_channel_t channels[2];
+static ide_device_t ide_devices[4];
+
+static uint8_t ide_buf[2048] = {0};
+static volatile uint8_t ide_irq_invoked = 0;
+static uint8_t atapi_packet[12] = {ATAPI_CMD_READ, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+static void ide_write(uint8_t channel, uint8_t reg, uint8_t data);
+
+static uint8_t ide_read(uint8_t channel, uint8_t reg) {
+	uint8_t result = 0;
 	if (reg > 0x07 && reg < 0x0C) {
 		ide_write(channel, ATA_REG_CONTROL, 0x80 | channels[channel].nIEN);
 	}
@@ -12,7 +24,7 @@ unsigned char ide_read(unsigned char channel, unsigned char reg) {
 		result = inb(channels[channel].base + reg - 0x06);
 	}
 	else if (reg < 0x0E) {
-		result = inb(channels[channel].ctrl + reg - 0x0A);
+		result = inb(channels[channel].ctrl + reg - 0x0C);
 	}
 	else if (reg < 0x16) {
 		result = inb(channels[channel].bmide + reg - 0x0E);
@@ -23,7 +35,7 @@ unsigned char ide_read(unsigned char channel, unsigned char reg) {
 	return result;
 }
 
-void ide_write(unsigned char channel, unsigned char reg, unsigned char data) {
+static void ide_write(uint8_t channel, uint8_t reg, uint8_t data) {
 	if (reg > 0x07 && reg < 0x0C) {
 		ide_write(channel, ATA_REG_CONTROL, 0x80 | channels[channel].nIEN);
 	}
@@ -34,7 +46,7 @@ void ide_write(unsigned char channel, unsigned char reg, unsigned char data) {
 		outb(channels[channel].base + reg - 0x06, data);
 	}
 	else if (reg < 0x0E) {
-		outb(channels[channel].ctrl + reg - 0x0A, data);
+		outb(channels[channel].ctrl + reg - 0x0C, data);
 	}
 	else if (reg < 0x16) {
 		outb(channels[channel].bmide + reg - 0x0E, data);
@@ -44,33 +56,47 @@ void ide_write(unsigned char channel, unsigned char reg, unsigned char data) {
 	}
 }
 
-void ide_read_buffer(unsigned char channel, unsigned char reg, unsigned int buffer, unsigned int quads) {
-	//TODO fix bug in this!
-	//inline asm trashes ES and ESP for all of the code the
-	//compiler generates between the inline asm blocks
+static void ide_read_buffer(uint8_t channel, uint8_t reg, uint32_t buffer, uint32_t quads) {
 	if (reg > 0x07 && reg < 0x0C) {
 		ide_write(channel, ATA_REG_CONTROL, 0x80 | channels[channel].nIEN);
 	}
-	asm("pushw %es; movw %ds, %ax; movw %ax, %es");
+	uint16_t port = 0;
 	if (reg < 0x08) {
-		insl(channels[channel].base + reg - 0x00, buffer, quads);
+		port = channels[channel].base + reg - 0x00;
 	}
 	else if (reg < 0x0C) {
-		insl(channels[channel].base + reg - 0x06, buffer, quads);
+		port = channels[channel].base + reg - 0x06;
 	}
 	else if (reg < 0x0E) {
-		insl(channels[channel].ctrl + reg - 0x0A, buffer, quads);
+		port = channels[channel].ctrl + reg - 0x0C;
 	}
 	else if (reg < 0x16) {
-		insl(channels[channel].bmide + reg - 0x0E, buffer, quads);
+		port = channels[channel].bmide + reg - 0x0E;
 	}
-	asm("popw %es;");
+	//everything happens in one asm block so the compiler can't
+	//generate code between setting up the registers and the transfer
+	asm volatile("cld; rep insl" : "+D"(buffer), "+c"(quads) : "d"(port) : "memory");
 	if (reg > 0x07 && reg < 0x0C) {
 		ide_write(channel, ATA_REG_CONTROL, channels[channel].nIEN);
 	}
 }
 
-unsigned char ide_polling(unsigned char channel, unsigned int advanced_check) {
+//transfer words 16-bit words between data port and selector:edi
+static void ide_pio_in(uint16_t bus, uint16_t selector, uint32_t edi, uint32_t words) {
+	asm volatile("pushw %%es; movw %%ax, %%es; cld; rep insw; popw %%es"
+				 : "+D"(edi), "+c"(words)
+				 : "d"(bus), "a"(selector)
+				 : "memory");
+}
+
+static void ide_pio_out(uint16_t bus, uint16_t selector, uint32_t esi, uint32_t words) {
+	asm volatile("pushw %%ds; movw %%ax, %%ds; cld; rep outsw; popw %%ds"
+				 : "+S"(esi), "+c"(words)
+				 : "d"(bus), "a"(selector)
+				 : "memory");
+}
+
+static uint8_t ide_polling(uint8_t channel, uint32_t advanced_check) {
 	//delay 400ns for BSY to be set
 	for (int i = 0; i < 4; i++) {
 		//reading alternate status port wastes 100ns
@@ -83,7 +109,7 @@ unsigned char ide_polling(unsigned char channel, unsigned int advanced_check) {
 
 	if (advanced_check) {
 		//read status register
-		unsigned char state = ide_read(channel, ATA_REG_STATUS);
+		uint8_t state = ide_read(channel, ATA_REG_STATUS);
 
 		//check for errors
 		if (state & ATA_SR_ERR) {
@@ -109,7 +135,7 @@ unsigned char ide_polling(unsigned char channel, unsigned int advanced_check) {
 	return 0;
 }
 
-unsigned char ide_print_error(unsigned int drive, unsigned char err) {
+static uint8_t ide_print_error(uint32_t drive, uint8_t err) {
 	if (err == 0)
 		return err;
 
@@ -119,7 +145,7 @@ unsigned char ide_print_error(unsigned int drive, unsigned char err) {
 		err = 19;
 	}
 	else if (err == 2) {
-		unsigned char st = ide_read(ide_devices[drive].Channel, ATA_REG_ERROR);
+		uint8_t st = ide_read(ide_devices[drive].channel, ATA_REG_ERROR);
 		if (st & ATA_ER_AMNF) {
 			printf("- No Address Mark Found\n");
 			err = 7;
@@ -163,24 +189,132 @@ unsigned char ide_print_error(unsigned int drive, unsigned char err) {
 	}
 	printf("- [%s %s] %s\n",
 		//use the channel as an index into array
-		(const char*[]){"Primary", "Secondary"}[ide_devices[drive].Channel],
+		(const char*[]){"Primary", "Secondary"}[ide_devices[drive].channel],
 		//same as above, using drive
-		(const char*[]){"Master", "Slave"}[ide_devices[drive].Drive],
-		ide_devices[drive].Model);
+		(const char*[]){"Master", "Slave"}[ide_devices[drive].drive],
+		ide_devices[drive].model);
 
 	return err;
 }
 
-void ide_initialize(unsigned int BAR0, unsigned int BAR1, unsigned int BAR2, unsigned int BAR3, unsigned int BAR4) {
-	int j, k, count = 0;
+static void ide_wait_irq() {
+	while (!ide_irq_invoked)
+		;
+	ide_irq_invoked = 0;
+}
+
+static void ide_irq(registers_t UNUSED(regs)) {
+	ide_irq_invoked = 1;
+}
+
+static uint16_t data_selector() {
+	uint16_t ds;
+	asm volatile("mov %%ds, %0" : "=r"(ds));
+	return ds;
+}
+
+static bool ide_supports_lba48(uint8_t drive) {
+	return ide_devices[drive].command_sets & (1 << 26);
+}
+
+//largest number of sectors a single command can move on drive
+static uint32_t ide_max_sectors(uint8_t drive) {
+	if (ide_devices[drive].type != IDE_ATA) {
+		//ATAPI reads are issued one sector at a time
+		return 255;
+	}
+	return ide_supports_lba48(drive) ? ATA_MAX_SECTORS_LBA48 : ATA_MAX_SECTORS_LBA28;
+}
+
+static int ide_block_read(block_device_t* dev, uint32_t lba, uint32_t count, uint8_t* buffer) {
+	uint8_t drive = (uint32_t)dev->ctx;
+	//split requests larger than a single command can carry
+	while (count) {
+		uint32_t chunk = MIN(count, ide_max_sectors(drive));
+		uint8_t err = ide_read_sectors(drive, chunk, lba, data_selector(), (uint32_t)buffer);
+		if (err) return err;
+
+		lba += chunk;
+		count -= chunk;
+		buffer += chunk * dev->sector_size;
+	}
+	return 0;
+}
+
+static int ide_block_write(block_device_t* dev, uint32_t lba, uint32_t count, uint8_t* buffer) {
+	uint8_t drive = (uint32_t)dev->ctx;
+	while (count) {
+		uint32_t chunk = MIN(count, ide_max_sectors(drive));
+		uint8_t err = ide_write_sectors(drive, chunk, lba, data_selector(), (uint32_t)buffer);
+		if (err) return err;
+
+		lba += chunk;
+		count -= chunk;
+		buffer += chunk * dev->sector_size;
+	}
+	return 0;
+}
+
+static int ide_block_flush(block_device_t* dev) {
+	return ide_flush((uint32_t)dev->ctx);
+}
+
+static void ide_register_block_device(uint8_t drive) {
+	block_device_t* dev = kmalloc(sizeof(block_device_t));
+	memset(dev, 0, sizeof(block_device_t));
+
+	//name devices by position on the bus, like hda for primary master
+	strcpy(dev->name, "hda");
+	dev->name[2] += drive;
+
+	dev->ctx = (void*)(uint32_t)drive;
+	dev->sector_count = ide_devices[drive].size;
+	dev->read = ide_block_read;
+	if (ide_devices[drive].type == IDE_ATA) {
+		dev->sector_size = ATA_SECTOR_SIZE;
+		dev->write = ide_block_write;
+		dev->flush = ide_block_flush;
+	}
+	else {
+		//ATAPI drives are read only
+		dev->sector_size = ATAPI_SECTOR_SIZE;
+	}
+	block_device_register(dev);
+}
+
+//enable READ/WRITE MULTIPLE so the drive asks for data once per block of sectors
+//instead of once per sector
+static void ide_set_multiple_mode(uint8_t drive) {
+	uint8_t max = ide_devices[drive].multiple;
+	ide_devices[drive].multiple = 1;
+	if (ide_devices[drive].type != IDE_ATA || max < 2) return;
+
+	uint32_t channel = ide_devices[drive].channel;
+	while (ide_read(channel, ATA_REG_STATUS) & ATA_SR_BSY) {
+		;
+	}
+	ide_write(channel, ATA_REG_HDDEVSEL, 0xA0 | (ide_devices[drive].drive << 4));
+	ide_write(channel, ATA_REG_SECCOUNT0, max);
+	ide_write(channel, ATA_REG_COMMAND, ATA_CMD_SET_MULTIPLE_MODE);
+	ide_polling(channel, 0);
+
+	if (ide_read(channel, ATA_REG_STATUS) & (ATA_SR_ERR | ATA_SR_DF)) {
+		printf_err("IDE: drive %d rejected multiple mode, using single sector PIO", drive);
+		return;
+	}
+	ide_devices[drive].multiple = max;
+}
+
+void ide_initialize(uint32_t bar0, uint32_t bar1, uint32_t bar2, uint32_t bar3, uint32_t bar4) {
+	int k, count = 0;
 
 	//detect I/O ports which interface IDE controller
-	channels[ATA_PRIMARY	].base 	= (BAR0 & 0xFFFFFFFC) + 0x1F0 * (!BAR0);
-	channels[ATA_PRIMARY	].ctrl 	= (BAR1 & 0xFFFFFFFC) + 0x3F6 * (!BAR1);
-	channels[ATA_SECONDARY	].base 	= (BAR0 & 0xFFFFFFFC) + 0x170 * (!BAR2);
-	channels[ATA_PRIMARY	].ctrl 	= (BAR1 & 0xFFFFFFFC) + 0x376 * (!BAR3);
-	channels[ATA_PRIMARY	].bmide	= (BAR0 & 0xFFFFFFFC) + 0; //bus master IDE
-	channels[ATA_SECONDARY	].bmide = (BAR1 & 0xFFFFFFFC) + 8; //bus master IDE
+	channels[ATA_PRIMARY	].base 	= (bar0 & 0xFFFFFFFC) + 0x1F0 * (!bar0);
+	channels[ATA_PRIMARY	].ctrl 	= (bar1 & 0xFFFFFFFC) + 0x3F6 * (!bar1);
+	channels[ATA_SECONDARY	].base 	= (bar2 & 0xFFFFFFFC) + 0x170 * (!bar2);
+	channels[ATA_SECONDARY	].ctrl 	= (bar3 & 0xFFFFFFFC) + 0x376 * (!bar3);
+	channels[ATA_PRIMARY	].bmide	= (bar4 & 0xFFFFFFFC) + 0; //bus master IDE
+	channels[ATA_SECONDARY	].bmide = (bar4 & 0xFFFFFFFC) + 8; //bus master IDE
 
 	//disable IRQs
 	ide_write(ATA_PRIMARY	, ATA_REG_CONTROL, 2);
@@ -189,9 +323,9 @@ void ide_initialize(unsigned int BAR0, unsigned int BAR1, unsigned int BAR2, uns
 	//detect ATA-ATAPI devices
 	for (int i = 0; i < 2; i++) {
 		for (int j = 0; j < 2; j++) {
-			unsigned char err = 0, type = IDE_ATA, status;
+			uint8_t err = 0, type = IDE_ATA, status;
 			//assuming no drive here
-			ide_devices[count].Reserved = 0;
+			ide_devices[count].reserved = 0;
 
 			//select drive
 			ide_write(i, ATA_REG_HDDEVSEL, 0xA0 | (j << 4));
@@ -204,7 +338,10 @@ void ide_initialize(unsigned int BAR0, unsigned int BAR1, unsigned int BAR2, uns
 
 			//polling
 			//if status == 0, no device
-			if (ide_read(i, ATA_REG_STATUS) == 0) continue;
+			if (ide_read(i, ATA_REG_STATUS) == 0) {
+				count++;
+				continue;
+			}
 
 			while (1) {
 				status = ide_read(i, ATA_REG_STATUS);
@@ -220,8 +357,8 @@ void ide_initialize(unsigned int BAR0, unsigned int BAR1, unsigned int BAR2, uns
 			//probe for ATAPI devices
 
 			if (err != 0) {
-				unsigned char cl = ide_read(i, ATA_REG_LBA1);
-				unsigned char ch = ide_read(i, ATA_REG_LBA2);
+				uint8_t cl = ide_read(i, ATA_REG_LBA1);
+				uint8_t ch = ide_read(i, ATA_REG_LBA2);
 
 				if (cl == 0x14 && ch == 0xEB) {
 					type = IDE_ATAPI;
@@ -231,6 +368,7 @@ void ide_initialize(unsigned int BAR0, unsigned int BAR1, unsigned int BAR2, uns
 				}
 				else {
 					//unknown type (may not be a device)
+					count++;
 					continue;
 				}
 
@@ -239,34 +377,36 @@ void ide_initialize(unsigned int BAR0, unsigned int BAR1, unsigned int BAR2, uns
 			}
 
 			//read identification space of device
-			ide_read_buffer(i, ATA_REG_DATA, (unsigned int)ide_buf, 128);
+			ide_read_buffer(i, ATA_REG_DATA, (uint32_t)ide_buf, 128);
 
 			//read device parameters
-			ide_devices[count].Reserved 	= 1;
-			ide_devices[count].Type 		= type;
-			ide_devices[count].Channel 		= i;
-			ide_devices[count].Drive 		= j;
-			ide_devices[count].Signature 	= *((unsigned short*)(ide_buf + ATA_IDENT_DEVICETYPE));
-			ide_devices[count].Capabilities = *((unsigned short*)(ide_buf + ATA_IDENT_CAPABILITIES));
-			ide_devices[count].CommandSets 	= *((unsigned int*)(ide_buf + ATA_IDENT_COMMANDSETS));
+			ide_devices[count].reserved 	= 1;
+			ide_devices[count].type 		= type;
+			ide_devices[count].channel 		= i;
+			ide_devices[count].drive 		= j;
+			ide_devices[count].signature 	= *((uint16_t*)(ide_buf + ATA_IDENT_DEVICETYPE));
+			ide_devices[count].capabilities = *((uint16_t*)(ide_buf + ATA_IDENT_CAPABILITIES));
+			ide_devices[count].command_sets = *((uint32_t*)(ide_buf + ATA_IDENT_COMMANDSETS));
+			//largest DRQ block the drive supports, 0 if it can't do READ/WRITE MULTIPLE
+			ide_devices[count].multiple 	= ide_buf[ATA_IDENT_MAX_MULTIPLE];
 
 			//get size
-			if (ide_devices[count].CommandSets & (1 << 26)) {
+			if (ide_devices[count].command_sets & (1 << 26)) {
 				//device uses 48-bit addressing
-				ide_devices[count].Size = *((unsigned int*)(ide_buf + ATA_IDENT_MAX_LBA_EXT));
+				ide_devices[count].size = *((uint32_t*)(ide_buf + ATA_IDENT_MAX_LBA_EXT));
 			}
 			else {
 				//device uses CHS or 28-bit addressing
-				ide_devices[count].Size = *((unsigned int*)(ide_buf + ATA_IDENT_MAX_LBA));
+				ide_devices[count].size = *((uint32_t*)(ide_buf + ATA_IDENT_MAX_LBA));
 			}
 
 			//string indicates model of device
 			for (k = 0; k < 40; k += 2) {
-				ide_devices[count].Model[k] = ide_buf[ATA_IDENT_MODEL + k + 1];
-				ide_devices[count].Model[k+1] = ide_buf[ATA_IDENT_MODEL + k];
+				ide_devices[count].model[k] = ide_buf[ATA_IDENT_MODEL + k + 1];
+				ide_devices[count].model[k+1] = ide_buf[ATA_IDENT_MODEL + k];
 			}
 			//terminate string
-			ide_devices[count].Model[40] = 0;
+			ide_devices[count].model[40] = 0;
 
 			count++;
 		}
@@ -274,35 +414,51 @@ void ide_initialize(unsigned int BAR0, unsigned int BAR1, unsigned int BAR2, uns
 
 	//print summary
 	for (int i = 0; i < 4; i++) {
-		if (ide_devices[i].Reserved == 1) {
-			printf(" Found %s Drive %dGB - %s\n",
+		if (ide_devices[i].reserved == 1) {
+			printf_info("Found %s Drive %dMB - %s",
 				//type
-				(const char*[]){"ATA", "ATAPI"}[ide_devices[i].Type],
+				(const char*[]){"ATA", "ATAPI"}[ide_devices[i].type],
 				//size
-				ide_devices[i].Size / 1024 / 1024 / 2,
-				ide_devices[i].Model);
+				ide_devices[i].size / 1024 / 2,
+				ide_devices[i].model);
+
+			ide_set_multiple_mode(i);
+			ide_register_block_device(i);
 		}
 	}
 }
 
-unsigned char ide_ata_access(unsigned char direction, unsigned char drive, unsigned int lba, unsigned char numsects, unsigned short selector, unsigned int edi) {
-	unsigned char lba_mode //0: CHS, 1: LBA28, 2: LBA48 **, dma // 0: No DMA, 1: DMA **, cmd;
-	unsigned char lba_io[6];
+void ide_install() {
+	printf_info("Probing IDE drives...");
+
+	register_interrupt_handler(IRQ14, &ide_irq);
+	register_interrupt_handler(IRQ15, &ide_irq);
+
+	//legacy ISA ports
+	ide_initialize(0x1F0, 0x3F6, 0x170, 0x376, 0x000);
+}
+
+static uint8_t ide_ata_access(uint8_t direction, uint8_t drive, uint32_t lba, uint32_t numsects, uint16_t selector, uint32_t edi) {
+	uint8_t lba_mode /* 0: CHS, 1: LBA28, 2: LBA48 */, dma /* 0: No DMA, 1: DMA */, cmd = 0;
+	uint8_t lba_io[6];
 	//read the channel
-	unsigned int channel 		= ide_devices[drive].Channel;
+	uint32_t channel 		= ide_devices[drive].channel;
 	//read the drive (master/slave)
-	unsigned int slavebit 		= ide_devices[drive].Drive;
+	uint32_t slavebit 		= ide_devices[drive].drive;
 	//bus base, like 0x1F0 which is also a data port
-	unsigned int bus 			= channels[channel].base;
+	uint32_t bus 			= channels[channel].base;
 	//almost every ATA drive has a sector size of 512 bytes
-	unsigned int words 			= 256;
-	unsigned short cyl, i;
-	unsigned char head, sect, err;
+	uint32_t words 			= 256;
+	//sectors transferred per DRQ block
+	uint32_t multiple		= ide_devices[drive].multiple;
+	uint16_t cyl;
+	uint8_t head, sect, err;
 
 	ide_write(channel, ATA_REG_CONTROL, channels[channel].nIEN = (ide_irq_invoked = 0x0) + 0x02);
 
 	//select one from LBA28, LBA48, or CHS
-	if (lba >= 0x10000000) {
+	//LBA48 is also needed for transfers of more than 256 sectors
+	if (ide_supports_lba48(drive) && (lba + numsects > 0x10000000 || numsects > ATA_MAX_SECTORS_LBA28)) {
 		//LBA48:
 		lba_mode  = 2;
 		lba_io[0] = (lba & 0x000000FF) >> 0;
@@ -316,7 +472,7 @@ unsigned char ide_ata_access(unsigned char direction, unsigned char drive, unsig
 		head 	  = 0;
 	}
 	//does drive support LBA?
-	else if (ide_devices[drive].Capabilities & 0x200) {
+	else if (ide_devices[drive].capabilities & 0x200) {
 		//LBA28:
 		lba_mode  = 1;
 		lba_io[0] = (lba & 0x00000FF) >> 0;
@@ -343,6 +499,11 @@ unsigned char ide_ata_access(unsigned char direction, unsigned char drive, unsig
 		head 	  = (lba + 1 - sect) % (16 * 63) / (63);
 	}
 
+	if (numsects == 0 || numsects > (lba_mode == 2 ? ATA_MAX_SECTORS_LBA48 : ATA_MAX_SECTORS_LBA28)) {
+		//caller must split requests larger than one command can carry
+		return 3;
+	}
+
 	//see if drive supports DMA or not
 	dma = 0;
 
@@ -362,13 +523,14 @@ unsigned char ide_ata_access(unsigned char direction, unsigned char drive, unsig
 	}
 
 	//write parameters
+	//a sector count of 0 means the maximum (256 or 65536)
 	if (lba_mode == 2) {
-		ide_write(channel, ATA_REG_SECCOUNT1, 0);
+		ide_write(channel, ATA_REG_SECCOUNT1, (numsects >> 8) & 0xFF);
 		ide_write(channel, ATA_REG_LBA3, lba_io[3]);
 		ide_write(channel, ATA_REG_LBA4, lba_io[4]);
 		ide_write(channel, ATA_REG_LBA5, lba_io[5]);
 	}
-	ide_write(channel, ATA_REG_SECCOUNT0, numsects);
+	ide_write(channel, ATA_REG_SECCOUNT0, numsects & 0xFF);
 	ide_write(channel, ATA_REG_LBA0, lba_io[0]);
 	ide_write(channel, ATA_REG_LBA1, lba_io[1]);
 	ide_write(channel, ATA_REG_LBA2, lba_io[2]);
@@ -385,6 +547,11 @@ unsigned char ide_ata_access(unsigned char direction, unsigned char drive, unsig
 	if (lba_mode == 0 && dma == 1 && direction == 1) cmd = ATA_CMD_WRITE_DMA;
 	if (lba_mode == 1 && dma == 1 && direction == 1) cmd = ATA_CMD_WRITE_DMA;
 	if (lba_mode == 2 && dma == 1 && direction == 1) cmd = ATA_CMD_WRITE_DMA_EXT;
+	//with multiple mode enabled the drive raises DRQ once per block of sectors
+	if (!dma && multiple > 1) {
+		if (direction == 0) cmd = (lba_mode == 2) ? ATA_CMD_READ_MULTIPLE_EXT : ATA_CMD_READ_MULTIPLE;
+		else cmd = (lba_mode == 2) ? ATA_CMD_WRITE_MULTIPLE_EXT : ATA_CMD_WRITE_MULTIPLE;
+	}
 	//send command
 	ide_write(channel, ATA_REG_COMMAND, cmd);
 
@@ -397,60 +564,48 @@ unsigned char ide_ata_access(unsigned char direction, unsigned char drive, unsig
 		}
 	}
 	else {
-		if (direction == 0) {
-			//PIO read
-			for (i = 0; i < numsects; i++) {
-				if (err = ide_polling(channel, 1)) {
-					//polling, set error and exit if there is
-					return err;
-				}
-				asm("pushw %es");
-				asm("mov %%ax, %%es" : : "a"(selector));
-				asm("rep insw" : : "c"(words), "d"(bus), "D"(edi)); //receive data
-				asm("popw %es");
-				edi += (words * 2);
+		//status is only checked at DRQ block boundaries,
+		//each block is moved with a single rep ins/outs
+		uint32_t remaining = numsects;
+		while (remaining) {
+			uint32_t count = MIN(remaining, multiple);
+			//polling, set error and exit if there is
+			if ((err = ide_polling(channel, 1))) {
+				return err;
 			}
-		}
-		else {
-			//PIO write
-			for (int i = 0; i < numsects; i++) {
-				//polling
-				ide_polling(channel, 0);
-				asm("pushw %ds");
-				asm("mov %%ax, %%ds" :: "a"(selector));
-				asm("rep outsw"::"c"(words), "d"(bus), "S"(edi)); //send data
-				asm("popw %ds");
-				edi += (words * 2);
+
+			if (direction == 0) {
+				//PIO read
+				ide_pio_in(bus, selector, edi, words * count);
 			}
-			ide_write(channel, ATA_REG_COMMAND, (char[]){
-				ATA_CMD_CACHE_FLUSH,
-				ATA_CMD_CACHE_FLUSH,
-				ATA_CMD_CACHE_FLUSH_EXT}[lba_mode]);
-			//polling
+			else {
+				//PIO write
+				ide_pio_out(bus, selector, edi, words * count);
+			}
+			edi += words * 2 * count;
+			remaining -= count;
+		}
+
+		if (direction == 1) {
+			//wait for the last block to be accepted
+			//the drive's write cache is only flushed on an explicit barrier, see ide_flush
 			ide_polling(channel, 0);
+			uint8_t state = ide_read(channel, ATA_REG_STATUS);
+			if (state & ATA_SR_ERR) return 2;
+			if (state & ATA_SR_DF) return 1;
 		}
 	}
 
 	return 0;
 }
 
-void ide_wait_irq() {
-	while (ide_irq_invoked)
-		;
-	ide_irq_invoked = 0;
-}
-
-void ide_irq() {
-	ide_irq_invoked = 1;
-}
-
-unsigned char ide_atapi_read(unsigned char drive, unsigned int lba, unsigned char numsects, unsigned short selector, unsigned int edi) {
-	unsigned int 	channel  = ide_devices[drive].Channel;
-	unsigned int 	slavebit = ide_devices[drive].Drive;
-	unsigned int 	bus 	 = channels[channel].base;
+static uint8_t ide_atapi_read(uint8_t drive, uint32_t lba, uint8_t numsects, uint16_t selector, uint32_t edi) {
+	uint32_t 	channel  = ide_devices[drive].channel;
+	uint32_t 	slavebit = ide_devices[drive].drive;
+	uint32_t 	bus 	 = channels[channel].base;
 	//sector size. ATAPI drives have sector size of 2048 bytes
-	unsigned int 	words 	 = 1024;
-	unsigned char 	err;
+	uint32_t 	words 	 = 1024;
+	uint8_t 	err;
 	int i;
 
 	//enable IRQs
@@ -492,23 +647,20 @@ unsigned char ide_atapi_read(unsigned char drive, unsigned int lba, unsigned cha
 	ide_write(channel, ATA_REG_COMMAND, ATA_CMD_PACKET);
 
 	//waiting for driver to finish or return error code
-	if (err = ide_polling(channel, 1)) return err;
+	if ((err = ide_polling(channel, 1))) return err;
 
 	//sending packet data
-	asm("rep outsw" :: "c"(6), "d"(bus), "S"(atapi_packet));
+	ide_pio_out(bus, data_selector(), (uint32_t)atapi_packet, 6);
 
 	//receiving data
 	for (i = 0; i < numsects; i++) {
 		//wait for IRQ
 		ide_wait_irq();
-		if (err = ide_polling(channel, 1)) {
+		if ((err = ide_polling(channel, 1))) {
 			return err;
 		}
-		asm("pushw %es");
-		asm("mov %%ax, %%es"::"a"(selector));
 		//receive data
-		asm("rep insw"::"c"(words), "d"(bus), "D"(edi));
-		asm("popw %es");
+		ide_pio_in(bus, selector, edi, words);
 		edi += (words * 2);
 	}
 
@@ -522,132 +674,140 @@ unsigned char ide_atapi_read(unsigned char drive, unsigned int lba, unsigned cha
 	return 0;
 }
 
-void ide_read_sectors(unsigned char drive, unsigned char numsects, unsigned int lba, unsigned short es, unsigned int edi) {
+uint8_t ide_read_sectors(uint8_t drive, uint32_t numsects, uint32_t lba, uint16_t es, uint32_t edi) {
 	//check if drive present
-	if (drive > 3 || ide_devices[drive].Reserved == 0) {
+	if (drive > 3 || ide_devices[drive].reserved == 0) {
 		//drive not found
-		package[0] = 0x1;
+		return 0x1;
 	}
 
 	//check if inputs are valid
-	else if (((lba + numsects) > ide_devices[drive].Size) && (ide_devices[drive].Type == IDE_ATA)) {
+	if (((lba + numsects) > ide_devices[drive].size) && (ide_devices[drive].type == IDE_ATA)) {
 		//seeking to invalid position
-		package[0] = 0x2;
+		return 0x2;
 	}
 
 	//read in PIO mode through polling and IRQs
-	else {
-		unsigned char err;
-		if (ide_devices[drive].Type == IDE_ATA) {
-			err = ide_ata_access(ATA_READ, drive, lba, numsects, es, edi);
-		}
-		else if (ide_devices[drive].Type == IDE_ATAPI) {
-			for (i = 0; i < numsects; i++) {
-				err = ide_atapi_read(drive, lba + i, 1, es, edi + (i*2048));
-			}
+	uint8_t err = 0;
+	if (ide_devices[drive].type == IDE_ATA) {
+		err = ide_ata_access(ATA_READ, drive, lba, numsects, es, edi);
+	}
+	else if (ide_devices[drive].type == IDE_ATAPI) {
+		for (uint32_t i = 0; i < numsects && !err; i++) {
+			err = ide_atapi_read(drive, lba + i, 1, es, edi + (i*2048));
 		}
-		package[0] = ide_print_error(drive, err);
 	}
+	return ide_print_error(drive, err);
 }
 
-void ide_write_sectors(unsigned char drive, unsigned char numsects, unsigned int lba, unsigned short es, unsigned int edi) {
+uint8_t ide_write_sectors(uint8_t drive, uint32_t numsects, uint32_t lba, uint16_t es, uint32_t edi) {
 	//check if drive is present
-	if (drive > 3 || ide_devices[drive].Reserved == 0) {
+	if (drive > 3 || ide_devices[drive].reserved == 0) {
 		//drive not found!
-		pacakge[0] = 0x1;
+		return 0x1;
 	}
 	//check if inputs are valid
-	else if (((lba + numsects) > ide_devices[drive].Size) && (ide_devices[drive].Type == IDE_ATA)) {
+	if (((lba + numsects) > ide_devices[drive].size) && (ide_devices[drive].type == IDE_ATA)) {
 		//seeking to invalid position
-		package[0] = 0x2;
+		return 0x2;
 	}
-	//read in PIO mode through polling and IRQs
-	else {
-		unsigned char err;
-		if (ide_devices[drive].Type == IDE_ATA) {
-			err = ide_ata_access(ADA_WRITE, drive, lba, numsects, es, edi);
-		}
-		else if (ide_devices[drive].Type == IDE_ATAPI) {
-			//write protected
-			err = 4;
-		}
-		package[0] = ide_print_error(drive, err);
+
+	//write in PIO mode through polling and IRQs
+	uint8_t err = 0;
+	if (ide_devices[drive].type == IDE_ATA) {
+		err = ide_ata_access(ATA_WRITE, drive, lba, numsects, es, edi);
 	}
+	else if (ide_devices[drive].type == IDE_ATAPI) {
+		//write protected
+		err = 4;
+	}
+	return ide_print_error(drive, err);
 }
 
-void ide_atapi_eject(unsigned char drive) {
-	unsigned int 	channel  = ide_devices[drive].Channel;
-	unsigned int 	slavebit = ide_devices[drive].Drive;
-	unsigned int 	bus 	 = channels[channel].Base;
-	//sector size in words
-	unsigned int 	words 	 = 2048 / 2;
-	unsigned char   err 	 = 0;
-	ide_irq_invoked = 0;
-
-	//check if drive present
-	if (drive > 3 || ide_devices[drive].Reserved == 0) {
-		//drive not found
-		package[0] = 0x1;
+uint8_t ide_flush(uint8_t drive) {
+	if (drive > 3 || ide_devices[drive].reserved == 0) {
+		return 0x1;
 	}
-	//check if drive isn't ATAPI
-	else if (ide_devices[drive].type == IDE_ATA) {
-		//command aborted
-		package[0] = 20;
+	if (ide_devices[drive].type != IDE_ATA) {
+		//nothing to flush
+		return 0;
 	}
-	//eject ATAPI driver
-	else {
-		//enable IRQs
-		ide_write(channel, ATA_REG_CONTROL, channels[channel].nIEN = ide_irq_invoked = 0x0);
-
-		//setup SCSI packet
-		atapi_packet[ 0] = ATAPI_CMD_EJECT;
-		atapi_packet[ 1] = 0x00;
-		atapi_packet[ 2] = 0x00;
-		atapi_packet[ 3] = 0x00;
-		atapi_packet[ 4] = 0x02;
-		atapi_packet[ 5] = 0x00;
-		atapi_packet[ 6] = 0x00;
-		atapi_packet[ 7] = 0x00;
-		atapi_packet[ 8] = 0x00;
-		atapi_packet[ 9] = 0x00;
-		atapi_packet[10] = 0x00;
-		atapi_packet[11] = 0x00;
-
-		//select the drive
-		ide_write(channel, ATA_REG_HDDEVSEL, slavebit << 4);
-
-		//delay 400ns for select to complete
-		for (int i = 0; i < 4; i++) {
-			//reading alternate status port wastes 100ns
-			ide_read(channel, ATA_REG_ALTSTATUS);
-		}
 
-		//send packet command
-		ide_write(channel, ATA_REG_COMMAND, ATA_CMD_PACKET);
+	uint32_t channel = ide_devices[drive].channel;
+	bool lba48 = ide_supports_lba48(drive);
 
-		//waiting for the driver to finish/invoke error
-		if (err = ide_polling(channel, 1)) return err;
-		//sending data packet
-		else {
-			asm("rep outsw"::"c"(6), "d"(bus), "S"(atapi_packet));
-			//wait for IRQ
-			ide_wait_irq();
-			//polling and get error code
-			err = ide_polling(channel, 1);
-			//DRQ is not needed here
-			if (err == 3) err = 0;
-		}
-		package[0] = ide_print_error(drive, err);
+	while (ide_read(channel, ATA_REG_STATUS) & ATA_SR_BSY) {
+		;
 	}
-}
-*/
+	ide_write(channel, ATA_REG_HDDEVSEL, 0xE0 | (ide_devices[drive].drive << 4));
+	ide_write(channel, ATA_REG_COMMAND, lba48 ? ATA_CMD_CACHE_FLUSH_EXT : ATA_CMD_CACHE_FLUSH);
+	ide_polling(channel, 0);
 
+	uint8_t err = 0;
+	if (ide_read(channel, ATA_REG_STATUS) & (ATA_SR_ERR | ATA_SR_DF)) {
+		err = 2;
+	}
+	return ide_print_error(drive, err);
+}
 
+uint8_t ide_atapi_eject(uint8_t drive) {
+	uint32_t 	channel  = ide_devices[drive].channel;
+	uint32_t 	slavebit = ide_devices[drive].drive;
+	uint32_t 	bus 	 = channels[channel].base;
+	uint8_t		err 	 = 0;
+	ide_irq_invoked = 0;
 
+	//check if drive present
+	if (drive > 3 || ide_devices[drive].reserved == 0) {
+		//drive not found
+		return 0x1;
+	}
+	//check if drive isn't ATAPI
+	if (ide_devices[drive].type == IDE_ATA) {
+		//command aborted
+		return 20;
+	}
 
+	//eject ATAPI driver
+	//enable IRQs
+	ide_write(channel, ATA_REG_CONTROL, channels[channel].nIEN = ide_irq_invoked = 0x0);
 
+	//setup SCSI packet
+	atapi_packet[ 0] = ATAPI_CMD_EJECT;
+	atapi_packet[ 1] = 0x00;
+	atapi_packet[ 2] = 0x00;
+	atapi_packet[ 3] = 0x00;
+	atapi_packet[ 4] = 0x02;
+	atapi_packet[ 5] = 0x00;
+	atapi_packet[ 6] = 0x00;
+	atapi_packet[ 7] = 0x00;
+	atapi_packet[ 8] = 0x00;
+	atapi_packet[ 9] = 0x00;
+	atapi_packet[10] = 0x00;
+	atapi_packet[11] = 0x00;
 
+	//select the drive
+	ide_write(channel, ATA_REG_HDDEVSEL, slavebit << 4);
 
+	//delay 400ns for select to complete
+	for (int i = 0; i < 4; i++) {
+		//reading alternate status port wastes 100ns
+		ide_read(channel, ATA_REG_ALTSTATUS);
+	}
 
+	//send packet command
+	ide_write(channel, ATA_REG_COMMAND, ATA_CMD_PACKET);
 
-//ide_initialize(0x1F0, 0x36, 0x170, 0x376, 0x000);
+	//waiting for the driver to finish/invoke error
+	if (!(err = ide_polling(channel, 1))) {
+		//sending data packet
+		ide_pio_out(bus, data_selector(), (uint32_t)atapi_packet, 6);
+		//wait for IRQ
+		ide_wait_irq();
+		//polling and get error code
+		err = ide_polling(channel, 1);
+		//DRQ is not needed here
+		if (err == 3) err = 0;
+	}
+	return ide_print_error(drive, err);
+}
@@ -1,3 +1,8 @@
+#ifndef IDE_H
+#define IDE_H
+
+#include <std/std.h>
+
 #define ATA_SR_BSY	0x80 //busy
 #define ATA_SR_DRDY	0x40 //drive ready
 #define ATA_SR_DF	0x20 //drive write fault
@@ -29,6 +34,11 @@
 #define ATA_CMD_PACKET			0xA0
 #define ATA_CMD_IDENTIFY_PACKET	0xA1
 #define ATA_CMD_IDENTIFY 		0xEC
+#define ATA_CMD_READ_MULTIPLE		0xC4
+#define ATA_CMD_READ_MULTIPLE_EXT	0x29
+#define ATA_CMD_WRITE_MULTIPLE		0xC5
+#define ATA_CMD_WRITE_MULTIPLE_EXT	0x39
+#define ATA_CMD_SET_MULTIPLE_MODE	0xC6
 
 #define ATAPI_CMD_READ	0xA8
 #define ATAPI_CMD_EJECT 0x1B
@@ -39,6 +49,7 @@
 #define ATA_IDENT_SECTORS				12
 #define ATA_IDENT_SERIAL				20
 #define ATA_IDENT_MODEL					54
+#define ATA_IDENT_MAX_MULTIPLE			94
 #define ATA_IDENT_CAPABILITIES			98
 #define ATA_IDENT_FIELDVALID			106
 #define ATA_IDENT_MAX_LBA				120
@@ -48,3 +59,76 @@
 #define IDE_ATA		0x00 
 #define IDE_ATAPI	0x01
 
+#define ATA_REG_DATA		0x00
+#define ATA_REG_ERROR		0x01
+#define ATA_REG_FEATURES	0x01
+#define ATA_REG_SECCOUNT0	0x02
+#define ATA_REG_LBA0		0x03
+#define ATA_REG_LBA1		0x04
+#define ATA_REG_LBA2		0x05
+#define ATA_REG_HDDEVSEL	0x06
+#define ATA_REG_COMMAND		0x07
+#define ATA_REG_STATUS		0x07
+#define ATA_REG_SECCOUNT1	0x08
+#define ATA_REG_LBA3		0x09
+#define ATA_REG_LBA4		0x0A
+#define ATA_REG_LBA5		0x0B
+#define ATA_REG_CONTROL		0x0C
+#define ATA_REG_ALTSTATUS	0x0C
+#define ATA_REG_DEVADDRESS	0x0D
+
+#define ATA_PRIMARY		0x00
+#define ATA_SECONDARY	0x01
+
+#define ATA_READ	0x00
+#define ATA_WRITE	0x01
+
+#define ATA_SECTOR_SIZE		512
+#define ATAPI_SECTOR_SIZE	2048
+
+//most sectors a single command can transfer
+#define ATA_MAX_SECTORS_LBA28	256u
+#define ATA_MAX_SECTORS_LBA48	65536u
+
+typedef struct ide_channel {
+	uint16_t base;	//i/o base
+	uint16_t ctrl;	//control base
+	uint16_t bmide;	//bus master ide
+	uint8_t nIEN;	//no interrupt
+} ide_channel_t;
+
+typedef struct ide_device {
+	uint8_t reserved;		//0 (empty) or 1 (drive exists)
+	uint8_t channel;		//0 (primary) or 1 (secondary)
+	uint8_t drive;			//0 (master) or 1 (slave)
+	uint16_t type;			//0: ATA, 1: ATAPI
+	uint16_t signature;		//drive signature
+	uint16_t capabilities;	//features
+	uint32_t command_sets;	//supported command sets
+	uint32_t size;			//size in sectors
+	uint8_t multiple;		//sectors transferred per DRQ block
+	char model[41];			//model string
+} ide_device_t;
+
+//probes the IDE controller whose i/o ports are given by the BARs,
+//and registers a block device for each drive found
+//a BAR of 0 selects the legacy ISA port for that slot
+void ide_initialize(uint32_t bar0, uint32_t bar1, uint32_t bar2, uint32_t bar3, uint32_t bar4);
+
+//probes the IDE controller at its legacy ports
+void ide_install();
+
+//reads/writes numsects sectors starting at lba on drive into/from the buffer at es:edi
+//numsects may be up to 65536 on LBA48 drives, or 256 otherwise
+//writes may sit in the drive's write cache until ide_flush is called
+//returns 0 on success, or an error code which has already been reported
+uint8_t ide_read_sectors(uint8_t drive, uint32_t numsects, uint32_t lba, uint16_t es, uint32_t edi);
+uint8_t ide_write_sectors(uint8_t drive, uint32_t numsects, uint32_t lba, uint16_t es, uint32_t edi);
+
+//write barrier: flushes the on-drive write cache
+uint8_t ide_flush(uint8_t drive);
+
+//ejects the medium in an ATAPI drive
+uint8_t ide_atapi_eject(uint8_t drive);
+
+#endif
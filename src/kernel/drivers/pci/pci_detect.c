@@ -4,7 +4,7 @@
 
 static array_m* devices;
 
-uint16_t pci_config_readw(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset) {
+static uint32_t pci_config_address(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset) {
 	uint32_t long_bus = (uint32_t)bus;
 	uint32_t long_slot = (uint32_t)slot;
 	uint32_t long_func = (uint32_t)function;
@@ -18,10 +18,22 @@ uint16_t pci_config_readw(uint8_t bus, uint8_t slot, uint8_t function, uint8_t o
 	//16-23		bus number
 	//24-30		reserved
 	//31		enable bit
-	uint32_t address = (uint32_t)((long_bus << 16) | (long_slot << 11) | (long_func << 8) | (offset & 0xfc) | ((uint32_t)0x80000000));
+	return (uint32_t)((long_bus << 16) | (long_slot << 11) | (long_func << 8) | (offset & 0xfc) | ((uint32_t)0x80000000));
+}
+
+uint32_t pci_config_readl(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset) {
+	outl(0xCF8, pci_config_address(bus, slot, function, offset));
+	return inl(0xCFC);
+}
 
+void pci_config_writel(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset, uint32_t value) {
+	outl(0xCF8, pci_config_address(bus, slot, function, offset));
+	outl(0xCFC, value);
+}
+
+uint16_t pci_config_readw(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset) {
 	//write out address
-	outl(0xCF8, address);
+	outl(0xCF8, pci_config_address(bus, slot, function, offset));
 
 	//read in data
 	//(offset & 2) * 8) == 0 will choose first word of 32b register
@@ -146,11 +158,31 @@ void pci_traverse_buses(void) {
 				uint16_t vendor = pci_vendor_id(bus, slot, func);
 				if (vendor == 0xFFFF) continue;
 
+				if (devices->size >= MAX_DEVICES) {
+					printf_err("Too many PCI devices, ignoring %x:%x", vendor, pci_device_id(bus, slot, func));
+					return;
+				}
+
 				uint16_t device_id = pci_device_id(bus, slot, func);
 				pci_device* device = (pci_device*)kmalloc(sizeof(pci_device));
+				memset(device, 0, sizeof(pci_device));
 				device->vendor = vendor;
 				device->device = device_id;
 				device->func = func;
+				device->bus = bus;
+				device->slot = slot;
+
+				//class code register holds class, subclass, and programming interface
+				uint32_t class_reg = pci_config_readl(bus, slot, func, 0x08);
+				device->class_code = class_reg >> 24;
+				device->subclass = (class_reg >> 16) & 0xFF;
+				device->prog_if = (class_reg >> 8) & 0xFF;
+
+				for (int i = 0; i < 6; i++) {
+					device->bar[i] = pci_config_readl(bus, slot, func, 0x10 + (i * 4));
+				}
+				device->irq = pci_config_readl(bus, slot, func, 0x3C) & 0xFF;
+
 				array_m_insert(devices, device);
 			}
 		}
@@ -165,20 +197,48 @@ void pci_list() {
 	}
 }
 
-pci_device* pci_get_device(uint16_t vendor_id, uint16_t device_id) {
+pci_device* pci_find_device(uint16_t vendor_id, uint16_t device_id, int index) {
 	//look at all known pci devices
 	for (int i = 0; i < devices->size; i++) {
 		pci_device* tmp = array_m_lookup(devices, i);
 		if (tmp->vendor == vendor_id && tmp->device == device_id) {
 			//found the device they wanted!
-			return tmp;
+			if (index-- == 0) {
+				return tmp;
+			}
 		}
 	}
-	//device not found!
-	printf_err("pci device with vendor %x device %x did not exist.", vendor_id, device_id);
 	return NULL;
 }
 
+pci_device* pci_get_device(uint16_t vendor_id, uint16_t device_id) {
+	pci_device* device = pci_find_device(vendor_id, device_id, 0);
+	if (!device) {
+		//device not found!
+		printf_err("pci device with vendor %x device %x did not exist.", vendor_id, device_id);
+	}
+	return device;
+}
+
+pci_device* pci_find_class(uint8_t class_code, uint8_t subclass, int index) {
+	for (int i = 0; i < devices->size; i++) {
+		pci_device* tmp = array_m_lookup(devices, i);
+		if (tmp->class_code == class_code && tmp->subclass == subclass) {
+			if (index-- == 0) {
+				return tmp;
+			}
+		}
+	}
+	return NULL;
+}
+
+void pci_enable_bus_master(pci_device* device) {
+	uint32_t command = pci_config_readl(device->bus, device->slot, device->func, 0x04);
+	//memory space and bus master enable
+	command |= (1 << 1) | (1 << 2);
+	pci_config_writel(device->bus, device->slot, device->func, 0x04, command);
+}
+
 void pci_install() {
 	printf_info("Registering pci devices...");
 
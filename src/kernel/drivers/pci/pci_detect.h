@@ -7,9 +7,27 @@ typedef struct pci_device {
 	uint16_t vendor;
 	uint16_t device;
 	uint16_t func;
+	uint8_t bus;
+	uint8_t slot;
+	uint8_t class_code;
+	uint8_t subclass;
+	uint8_t prog_if;
+	uint8_t irq;		//legacy PIC line
+	uint32_t bar[6];	//raw base address registers
 } pci_device;
 
 void pci_install(void);
 void pci_list(void);
 
+uint32_t pci_config_readl(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset);
+void pci_config_writel(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset, uint32_t value);
+
+//returns the index'th device with the given vendor and device id, or NULL
+pci_device* pci_find_device(uint16_t vendor_id, uint16_t device_id, int index);
+//returns the index'th device with the given class and subclass, or NULL
+pci_device* pci_find_class(uint8_t class_code, uint8_t subclass, int index);
+
+//allow device to access memory and perform DMA
+void pci_enable_bus_master(pci_device* device);
+
 #endif
@@ -9,10 +9,97 @@
 #include <kernel/kernel.h>
 #include <std/timer.h>
 #include <kernel/drivers/rtc/clock.h>
+#include <std/math.h>
 
 extern page_directory_t* kernel_directory;
 Window* create_window_int(Rect frame, bool root);
 
+//Bochs/QEMU display interface, lets the shown part of video memory be moved without a BIOS call
+#define DISPI_INDEX_PORT	0x01CE
+#define DISPI_DATA_PORT		0x01CF
+#define DISPI_INDEX_ID			0x0
+#define DISPI_INDEX_VIRT_HEIGHT	0x7
+#define DISPI_INDEX_Y_OFFSET	0x9
+//any of these ids means the interface is there
+#define DISPI_ID_MIN		0xB0C0
+#define DISPI_ID_MAX		0xB0CF
+
+//how the shown page is changed
+typedef enum flip_method {
+	FLIP_NONE = 0,
+	FLIP_DISPI,
+	FLIP_VBE,
+} flip_method;
+
+static flip_method flip = FLIP_NONE;
+
+static uint16_t dispi_read(uint16_t index) {
+	outw(DISPI_INDEX_PORT, index);
+	return inw(DISPI_DATA_PORT);
+}
+
+static void dispi_write(uint16_t index, uint16_t value) {
+	outw(DISPI_INDEX_PORT, index);
+	outw(DISPI_DATA_PORT, value);
+}
+
+//works out how many screens of video memory can be flipped between in the current mode
+//total_memory is in 64kb blocks, as VBE reports it
+static int setup_flipping(vbe_mode_info* mode_info, uint32_t total_memory) {
+	flip = FLIP_NONE;
+
+	uint32_t page_bytes = mode_info->bytes_per_scan_line * mode_info->y_res;
+	if (!page_bytes) return 1;
+	int pages = MIN(total_memory * 0x10000 / page_bytes, VESA_LFB_MAP_SIZE / page_bytes);
+	pages = MIN(pages, SCREEN_MAX_PAGES);
+	if (pages < 2) return 1;
+
+	uint16_t id = dispi_read(DISPI_INDEX_ID);
+	if (id >= DISPI_ID_MIN && id <= DISPI_ID_MAX) {
+		//the virtual height bounds the y offset, so it must cover every page
+		uint16_t height = pages * mode_info->y_res;
+		dispi_write(DISPI_INDEX_VIRT_HEIGHT, height);
+		if (dispi_read(DISPI_INDEX_VIRT_HEIGHT) == height) {
+			flip = FLIP_DISPI;
+			return pages;
+		}
+	}
+
+	//fall back to asking the BIOS, if it can set the display start at all
+	regs16_t regs;
+	memset(&regs, 0, sizeof(regs));
+	regs.ax = 0x4F07;
+	regs.bx = 0x00; //set display start
+	int32(0x10, &regs);
+	if (regs.ax == 0x004F) {
+		flip = FLIP_VBE;
+		return pages;
+	}
+	return 1;
+}
+
+void vesa_flip(Screen* screen, int page) {
+	uint16_t y = page * screen->vmem->size.height;
+	switch (flip) {
+		case FLIP_DISPI:
+			dispi_write(DISPI_INDEX_Y_OFFSET, y);
+			break;
+		case FLIP_VBE: {
+			kernel_begin_critical();
+			regs16_t regs;
+			memset(&regs, 0, sizeof(regs));
+			regs.ax = 0x4F07;
+			regs.bx = 0x80; //set display start during vertical retrace
+			regs.dx = y; //first scanline shown
+			int32(0x10, &regs);
+			kernel_end_critical();
+			break;
+		}
+		default:
+			break;
+	}
+}
+
 //sets up VESA for mode
 Screen* switch_to_vesa(uint32_t vesa_mode, bool create) {
 		kernel_begin_critical();
@@ -70,13 +157,68 @@ Screen* switch_to_vesa(uint32_t vesa_mode, bool create) {
 		//and then we can call it normally after the screen is created
 		process_gfx_switch(NULL, mode_info.bpp);
 
+		int pages = setup_flipping(&mode_info, info.total_memory);
+
 		kernel_end_critical();
 
 		if (create) {
 			Screen* screen = screen_create(size_make(mode_info.x_res, mode_info.y_res), (uint32_t*)mode_info.physbase, mode_info.bpp);
+			//rows may be padded past the visible width
+			screen->pitch = mode_info.bytes_per_scan_line;
+			screen->page_count = pages;
+			printf_info("VESA: flipping between %d page(s)", pages);
 			process_gfx_switch(screen, mode_info.bpp);
 			return screen;
 		}
 
 		return 0;
 }
+
+uint32_t vesa_find_mode(int width, int height, int bpp) {
+	kernel_begin_critical();
+
+	vesa_info info;
+	vbe_mode_info mode_info;
+	regs16_t regs;
+
+	//same real mode buffer trick as switch_to_vesa
+	uint32_t buffer = (uint32_t)kmalloc(sizeof(vesa_info)) & 0xFFFFF;
+	memcpy((void*)buffer, "VBE2", 4);
+	memset(&regs, 0, sizeof(regs));
+	regs.ax = 0x4F00;
+	regs.di = buffer & 0xF;
+	regs.es = (buffer >> 4) & 0xFFFF;
+	int32(0x10, &regs);
+	memcpy(&info, (void*)buffer, sizeof(vesa_info));
+
+	//mode list is a real mode far pointer to words, ending in 0xFFFF
+	//copy it out first, it may live in the buffer the mode queries below reuse
+	uint16_t modes[64];
+	int mode_count = 0;
+	uint16_t* list = (uint16_t*)((((info.video_mode_ptr >> 16) & 0xFFFF) << 4) + (info.video_mode_ptr & 0xFFFF));
+	while (mode_count < 64 && list[mode_count] != 0xFFFF) {
+		modes[mode_count] = list[mode_count];
+		mode_count++;
+	}
+
+	uint32_t found = 0;
+	uint32_t mode_buffer = (uint32_t)(kmalloc(sizeof(vbe_mode_info))) & 0xFFFFF;
+	for (int i = 0; i < mode_count && !found; i++) {
+		memset(&regs, 0, sizeof(regs));
+		regs.ax = 0x4F01;
+		regs.di = mode_buffer & 0xF;
+		regs.es = (mode_buffer >> 4) & 0xFFFF;
+		regs.cx = modes[i];
+		int32(0x10, &regs);
+		memcpy(&mode_info, (uint32_t*)mode_buffer, sizeof(vbe_mode_info));
+
+		//bit 7 of the attributes means the mode has a linear frame buffer
+		if (!(mode_info.mode_attributes & 0x80)) continue;
+		if (mode_info.x_res == width && mode_info.y_res == height && mode_info.bpp == bpp) {
+			found = modes[i];
+		}
+	}
+
+	kernel_end_critical();
+	return found;
+}
@@ -57,5 +57,13 @@ typedef struct vesa_info {
 } vesa_info;
 
 Screen* switch_to_vesa(uint32_t mode, bool create);
+//finds a mode with a linear frame buffer of the given resolution and depth
+//returns 0 if the card doesn't offer one
+uint32_t vesa_find_mode(int width, int height, int bpp);
+
+//shows framebuffer page of screen, counting from 0
+//has taken effect by the time it returns, so the page shown before may be drawn into
+//does nothing if the card can't flip, screen->page_count is 1 then
+void vesa_flip(Screen* screen, int page);
 
 #endif
@@ -0,0 +1,150 @@
+#include "virtio.h"
+#include <std/kheap.h>
+#include <kernel/util/paging/paging.h>
+
+//keeps the compiler from reordering ring accesses
+//x86 doesn't reorder stores with other stores, so this is all we need
+#define virtio_barrier() asm volatile("" : : : "memory")
+
+uint32_t virtio_negotiate(uint16_t iobase, uint32_t wanted) {
+	//reset, then announce we've found the device and know how to drive it
+	outb(iobase + VIRTIO_PCI_STATUS, 0);
+	outb(iobase + VIRTIO_PCI_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+	outb(iobase + VIRTIO_PCI_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+	uint32_t features = inl(iobase + VIRTIO_PCI_HOST_FEATURES) & wanted;
+	outl(iobase + VIRTIO_PCI_GUEST_FEATURES, features);
+	return features;
+}
+
+void virtio_driver_ok(uint16_t iobase) {
+	uint8_t status = inb(iobase + VIRTIO_PCI_STATUS);
+	outb(iobase + VIRTIO_PCI_STATUS, status | VIRTIO_STATUS_DRIVER_OK);
+}
+
+static uint32_t virtq_align(uint32_t x) {
+	return (x + VIRTQ_ALIGN - 1) & ~(VIRTQ_ALIGN - 1);
+}
+
+bool virtq_init(virtqueue_t* vq, uint16_t iobase, uint16_t index, bool event_idx) {
+	memset(vq, 0, sizeof(virtqueue_t));
+	vq->iobase = iobase;
+	vq->index = index;
+	vq->event_idx = event_idx;
+
+	outw(iobase + VIRTIO_PCI_QUEUE_SEL, index);
+	//legacy devices dictate the queue size
+	vq->size = inw(iobase + VIRTIO_PCI_QUEUE_SIZE);
+	if (!vq->size) return false;
+
+	//descriptor table and available ring, then the used ring on the next aligned boundary
+	uint32_t avail_end = sizeof(virtq_desc_t) * vq->size + sizeof(uint16_t) * (3 + vq->size);
+	uint32_t used_off = virtq_align(avail_end);
+	uint32_t total = virtq_align(used_off + sizeof(uint16_t) * 3 + sizeof(virtq_used_elem_t) * vq->size);
+
+	uint32_t phys;
+	uint8_t* ring = kmalloc_ap(total, &phys);
+	//the device sees the queue as one physical range
+	for (uint32_t off = 0; off < total; off += 0x1000) {
+		if (virt_to_phys((uint32_t)ring + off) != phys + off) {
+			printf_err("virtio: queue %d memory isn't physically contiguous", index);
+			kfree(ring);
+			return false;
+		}
+	}
+	memset(ring, 0, total);
+
+	vq->desc = (virtq_desc_t*)ring;
+	vq->avail = (virtq_avail_t*)(ring + sizeof(virtq_desc_t) * vq->size);
+	vq->used = (virtq_used_t*)(ring + used_off);
+
+	//every descriptor starts out on the free list
+	for (uint16_t i = 0; i < vq->size; i++) {
+		vq->desc[i].next = i + 1;
+	}
+	vq->free_head = 0;
+	vq->num_free = vq->size;
+
+	outl(iobase + VIRTIO_PCI_QUEUE_PFN, phys / VIRTQ_ALIGN);
+	return true;
+}
+
+int virtq_alloc_chain(virtqueue_t* vq, uint16_t count) {
+	if (!count || count > vq->num_free) return -1;
+
+	uint16_t head = vq->free_head;
+	uint16_t idx = head;
+	for (uint16_t i = 0; i < count - 1; i++) {
+		vq->desc[idx].flags = VIRTQ_DESC_F_NEXT;
+		idx = vq->desc[idx].next;
+	}
+	vq->desc[idx].flags = 0;
+	vq->free_head = vq->desc[idx].next;
+	vq->num_free -= count;
+	return head;
+}
+
+void virtq_free_chain(virtqueue_t* vq, uint16_t head) {
+	uint16_t idx = head;
+	vq->num_free++;
+	while (vq->desc[idx].flags & VIRTQ_DESC_F_NEXT) {
+		idx = vq->desc[idx].next;
+		vq->num_free++;
+	}
+	vq->desc[idx].next = vq->free_head;
+	vq->free_head = head;
+}
+
+void virtq_push(virtqueue_t* vq, uint16_t head) {
+	vq->avail->ring[vq->avail_idx % vq->size] = head;
+	vq->avail_idx++;
+}
+
+//true if the device asked to be told when the index moves past event
+static bool virtq_need_event(uint16_t event, uint16_t new_idx, uint16_t old_idx) {
+	return (uint16_t)(new_idx - event - 1) < (uint16_t)(new_idx - old_idx);
+}
+
+void virtq_kick(virtqueue_t* vq) {
+	uint16_t old_idx = vq->kicked;
+	uint16_t new_idx = vq->avail_idx;
+	if (old_idx == new_idx) return;
+
+	//ring entries must be visible before the index which publishes them
+	virtio_barrier();
+	vq->avail->idx = new_idx;
+	virtio_barrier();
+	vq->kicked = new_idx;
+
+	bool notify;
+	if (vq->event_idx) {
+		uint16_t avail_event = *(volatile uint16_t*)&vq->used->ring[vq->size];
+		notify = virtq_need_event(avail_event, new_idx, old_idx);
+	}
+	else {
+		notify = !(vq->used->flags & VIRTQ_USED_F_NO_NOTIFY);
+	}
+	if (notify) {
+		outw(vq->iobase + VIRTIO_PCI_QUEUE_NOTIFY, vq->index);
+	}
+}
+
+bool virtq_pop(virtqueue_t* vq, uint16_t* head, uint32_t* len) {
+	if (vq->last_used == vq->used->idx) return false;
+	//don't read the entry before seeing the index which published it
+	virtio_barrier();
+
+	virtq_used_elem_t* elem = (virtq_used_elem_t*)&vq->used->ring[vq->last_used % vq->size];
+	*head = elem->id;
+	if (len) *len = elem->len;
+	vq->last_used++;
+	return true;
+}
+
+void virtq_interrupt_after(virtqueue_t* vq, uint16_t count) {
+	if (!vq->event_idx || !count) return;
+	//the device interrupts once it writes the used entry at this index
+	volatile uint16_t* used_event = &vq->avail->ring[vq->size];
+	*used_event = vq->last_used + count - 1;
+	virtio_barrier();
+}
@@ -0,0 +1,107 @@
+#ifndef VIRTIO_H
+#define VIRTIO_H
+
+#include <std/std.h>
+
+#define VIRTIO_VENDOR 0x1AF4
+
+//legacy PCI transport registers, offsets from BAR0 i/o base
+#define VIRTIO_PCI_HOST_FEATURES	0x00
+#define VIRTIO_PCI_GUEST_FEATURES	0x04
+#define VIRTIO_PCI_QUEUE_PFN		0x08
+#define VIRTIO_PCI_QUEUE_SIZE		0x0C
+#define VIRTIO_PCI_QUEUE_SEL		0x0E
+#define VIRTIO_PCI_QUEUE_NOTIFY		0x10
+#define VIRTIO_PCI_STATUS			0x12
+#define VIRTIO_PCI_ISR				0x13
+//device specific configuration starts here when MSI-X is disabled
+#define VIRTIO_PCI_CONFIG			0x14
+
+#define VIRTIO_STATUS_ACKNOWLEDGE	0x01
+#define VIRTIO_STATUS_DRIVER		0x02
+#define VIRTIO_STATUS_DRIVER_OK		0x04
+#define VIRTIO_STATUS_FAILED		0x80
+
+//device and driver publish the ring index they want to be notified at
+#define VIRTIO_RING_F_EVENT_IDX		(1 << 29)
+
+#define VIRTQ_DESC_F_NEXT	1	//chain continues in next field
+#define VIRTQ_DESC_F_WRITE	2	//buffer is written by the device
+
+#define VIRTQ_AVAIL_F_NO_INTERRUPT	1
+#define VIRTQ_USED_F_NO_NOTIFY		1
+
+//legacy rings are aligned to this
+#define VIRTQ_ALIGN 0x1000
+
+typedef struct virtq_desc {
+	uint64_t addr;	//guest physical address
+	uint32_t len;
+	uint16_t flags;
+	uint16_t next;
+} __attribute__((packed)) virtq_desc_t;
+
+typedef struct virtq_avail {
+	uint16_t flags;
+	uint16_t idx;
+	uint16_t ring[];	//followed by used_event
+} virtq_avail_t;
+
+typedef struct virtq_used_elem {
+	uint32_t id;	//head of the completed descriptor chain
+	uint32_t len;	//bytes written into the chain
+} __attribute__((packed)) virtq_used_elem_t;
+
+typedef volatile struct virtq_used {
+	uint16_t flags;
+	uint16_t idx;
+	virtq_used_elem_t ring[];	//followed by avail_event
+} virtq_used_t;
+
+typedef struct virtqueue {
+	uint16_t iobase;
+	uint16_t index;
+	uint16_t size;		//number of descriptors
+	bool event_idx;		//VIRTIO_RING_F_EVENT_IDX was negotiated
+
+	virtq_desc_t* desc;
+	virtq_avail_t* avail;
+	virtq_used_t* used;
+
+	uint16_t free_head;	//chain of unused descriptors
+	uint16_t num_free;
+	uint16_t avail_idx;	//next avail ring entry, published on kick
+	uint16_t last_used;	//next used ring entry to consume
+	uint16_t kicked;	//avail idx when the device was last notified
+} virtqueue_t;
+
+//reads the feature bits offered by the device at iobase, acknowledges it,
+//and accepts the subset in wanted
+//returns the negotiated features
+uint32_t virtio_negotiate(uint16_t iobase, uint32_t wanted);
+//tells the device the driver is ready to use it
+void virtio_driver_ok(uint16_t iobase);
+
+//allocates and registers queue index of the device at iobase
+//returns false if the queue doesn't exist or memory couldn't be found
+bool virtq_init(virtqueue_t* vq, uint16_t iobase, uint16_t index, bool event_idx);
+
+//takes count linked descriptors from the free list
+//returns the head of the chain, or -1 if not enough are free
+int virtq_alloc_chain(virtqueue_t* vq, uint16_t count);
+//returns the chain starting at head to the free list
+void virtq_free_chain(virtqueue_t* vq, uint16_t head);
+
+//places a chain in the available ring
+//the device doesn't see it until virtq_kick
+void virtq_push(virtqueue_t* vq, uint16_t head);
+//publishes every pushed chain and notifies the device, unless it asked not to be
+void virtq_kick(virtqueue_t* vq);
+
+//takes the next completed chain off the used ring
+//returns false if there are none
+bool virtq_pop(virtqueue_t* vq, uint16_t* head, uint32_t* len);
+//asks the device to interrupt only once count more chains have completed
+void virtq_interrupt_after(virtqueue_t* vq, uint16_t count);
+
+#endif
@@ -0,0 +1,249 @@
+#include "virtio_blk.h"
+#include "virtio.h"
+#include <std/kheap.h>
+#include <std/math.h>
+#include <kernel/drivers/pci/pci_detect.h>
+#include <kernel/util/paging/paging.h>
+#include <kernel/util/interrupts/isr.h>
+#include <kernel/util/syscall/sysfuncs.h>
+#include <kernel/util/vfs/block.h>
+
+#define MAX_VIRTIO_BLK_DEVICES 4
+
+//requests a caller is waiting on
+//kept on the heap, the interrupt completing them can arrive in any task's address space
+typedef struct virtio_blk_batch {
+	volatile uint32_t pending;
+	volatile bool failed;
+} virtio_blk_batch_t;
+
+typedef struct virtio_blk {
+	uint16_t iobase;
+	virtqueue_t vq;
+
+	//request headers and status bytes live in one DMA-able page
+	virtio_blk_req_hdr_t* hdrs;
+	volatile uint8_t* status;
+	uint32_t hdrs_phys;
+	uint32_t status_phys;
+
+	uint32_t free_reqs;		//bitmap of unused request slots
+	uint8_t* head_req;		//request slot owning each descriptor chain head
+	virtio_blk_batch_t* req_batch[VIRTIO_BLK_MAX_REQS];
+	uint32_t inflight;
+
+	block_device_t dev;
+} virtio_blk_t;
+
+static virtio_blk_t* blk_devices[MAX_VIRTIO_BLK_DEVICES];
+static int blk_device_count = 0;
+
+//number of physically contiguous runs backing buf
+static uint32_t virtio_blk_segments(uint8_t* buf, uint32_t size) {
+	uint32_t segs = 0;
+	uint32_t last_end = 0;
+	while (size) {
+		uint32_t virt = (uint32_t)buf;
+		uint32_t chunk = MIN(size, 0x1000 - (virt & 0xFFF));
+		uint32_t phys = virt_to_phys(virt);
+		if (!segs || phys != last_end) segs++;
+		last_end = phys + chunk;
+		buf += chunk;
+		size -= chunk;
+	}
+	return segs;
+}
+
+//builds a request chain (header, data segments, status) and places it in the available ring
+//must be called with interrupts disabled
+static void virtio_blk_queue(virtio_blk_t* blk, virtio_blk_batch_t* batch, uint32_t type, uint32_t sector, uint8_t* buf, uint32_t size) {
+	uint16_t descs = 2 + (buf ? virtio_blk_segments(buf, size) : 0);
+	while (!blk->free_reqs || blk->vq.num_free < descs) {
+		//let the device start on what we've queued so far, then wait for room
+		virtq_interrupt_after(&blk->vq, blk->inflight);
+		virtq_kick(&blk->vq);
+		kernel_end_critical();
+		sys_yield(RUNNABLE);
+		kernel_begin_critical();
+	}
+
+	int req = 0;
+	while (!(blk->free_reqs & (1 << req))) req++;
+	blk->free_reqs &= ~(1 << req);
+
+	uint16_t head = virtq_alloc_chain(&blk->vq, descs);
+	virtq_desc_t* desc = blk->vq.desc;
+
+	blk->hdrs[req].type = type;
+	blk->hdrs[req].reserved = 0;
+	blk->hdrs[req].sector = sector;
+	blk->status[req] = 0xFF;
+
+	uint16_t idx = head;
+	desc[idx].addr = blk->hdrs_phys + req * sizeof(virtio_blk_req_hdr_t);
+	desc[idx].len = sizeof(virtio_blk_req_hdr_t);
+	idx = desc[idx].next;
+
+	//data, merging pages which are physically adjacent
+	while (size) {
+		uint32_t virt = (uint32_t)buf;
+		uint32_t phys = virt_to_phys(virt);
+		uint32_t len = 0;
+		while (size && virt_to_phys((uint32_t)buf) == phys + len) {
+			uint32_t chunk = MIN(size, 0x1000 - ((uint32_t)buf & 0xFFF));
+			len += chunk;
+			buf += chunk;
+			size -= chunk;
+		}
+		desc[idx].addr = phys;
+		desc[idx].len = len;
+		if (type == VIRTIO_BLK_T_IN) {
+			desc[idx].flags |= VIRTQ_DESC_F_WRITE;
+		}
+		idx = desc[idx].next;
+	}
+
+	desc[idx].addr = blk->status_phys + req;
+	desc[idx].len = 1;
+	desc[idx].flags |= VIRTQ_DESC_F_WRITE;
+
+	blk->head_req[head] = req;
+	blk->req_batch[req] = batch;
+	blk->inflight++;
+	batch->pending++;
+	virtq_push(&blk->vq, head);
+}
+
+static void virtio_blk_reap(virtio_blk_t* blk) {
+	do {
+		uint16_t head;
+		while (virtq_pop(&blk->vq, &head, NULL)) {
+			int req = blk->head_req[head];
+			virtio_blk_batch_t* batch = blk->req_batch[req];
+			if (blk->status[req] != VIRTIO_BLK_S_OK) {
+				batch->failed = true;
+			}
+			batch->pending--;
+
+			blk->req_batch[req] = NULL;
+			blk->free_reqs |= (1 << req);
+			blk->inflight--;
+			virtq_free_chain(&blk->vq, head);
+		}
+		//coalesce: next interrupt once everything still in flight is done
+		virtq_interrupt_after(&blk->vq, blk->inflight);
+		//pick up anything which completed before the event index was updated
+	} while (blk->vq.last_used != blk->vq.used->idx);
+}
+
+static void virtio_blk_irq(registers_t UNUSED(regs)) {
+	for (int i = 0; i < blk_device_count; i++) {
+		virtio_blk_t* blk = blk_devices[i];
+		//reading ISR acknowledges the interrupt
+		if (inb(blk->iobase + VIRTIO_PCI_ISR) & 1) {
+			virtio_blk_reap(blk);
+		}
+	}
+}
+
+//queues every request needed for the transfer, then notifies the device once
+static int virtio_blk_transfer(virtio_blk_t* blk, uint32_t type, uint32_t lba, uint32_t count, uint8_t* buffer) {
+	virtio_blk_batch_t* batch = kmalloc(sizeof(virtio_blk_batch_t));
+	batch->pending = 0;
+	batch->failed = false;
+
+	kernel_begin_critical();
+	if (type == VIRTIO_BLK_T_FLUSH) {
+		virtio_blk_queue(blk, batch, type, 0, NULL, 0);
+	}
+	while (count) {
+		uint32_t chunk = MIN(count, (uint32_t)VIRTIO_BLK_MAX_SECTORS);
+		uint32_t size = chunk * blk->dev.sector_size;
+		virtio_blk_queue(blk, batch, type, lba, buffer, size);
+
+		lba += chunk;
+		count -= chunk;
+		buffer += size;
+	}
+	virtq_interrupt_after(&blk->vq, blk->inflight);
+	virtq_kick(&blk->vq);
+	kernel_end_critical();
+
+	while (batch->pending) {
+		sys_yield(RUNNABLE);
+	}
+	int ret = batch->failed ? -1 : 0;
+	kfree(batch);
+	return ret;
+}
+
+static int virtio_blk_read(block_device_t* dev, uint32_t lba, uint32_t count, uint8_t* buffer) {
+	return virtio_blk_transfer(dev->ctx, VIRTIO_BLK_T_IN, lba, count, buffer);
+}
+
+static int virtio_blk_write(block_device_t* dev, uint32_t lba, uint32_t count, uint8_t* buffer) {
+	return virtio_blk_transfer(dev->ctx, VIRTIO_BLK_T_OUT, lba, count, buffer);
+}
+
+static int virtio_blk_flush(block_device_t* dev) {
+	return virtio_blk_transfer(dev->ctx, VIRTIO_BLK_T_FLUSH, 0, 0, NULL);
+}
+
+static void virtio_blk_init(pci_device* device) {
+	virtio_blk_t* blk = kmalloc(sizeof(virtio_blk_t));
+	memset(blk, 0, sizeof(virtio_blk_t));
+	blk->iobase = device->bar[0] & 0xFFFFFFFC;
+
+	pci_enable_bus_master(device);
+	uint32_t features = virtio_negotiate(blk->iobase, VIRTIO_RING_F_EVENT_IDX | VIRTIO_BLK_F_RO | VIRTIO_BLK_F_FLUSH);
+	if (!virtq_init(&blk->vq, blk->iobase, 0, features & VIRTIO_RING_F_EVENT_IDX)) {
+		outb(blk->iobase + VIRTIO_PCI_STATUS, VIRTIO_STATUS_FAILED);
+		kfree(blk);
+		return;
+	}
+
+	uint32_t phys;
+	uint8_t* page = kmalloc_ap(0x1000, &phys);
+	memset(page, 0, 0x1000);
+	blk->hdrs = (virtio_blk_req_hdr_t*)page;
+	blk->hdrs_phys = phys;
+	blk->status = page + VIRTIO_BLK_MAX_REQS * sizeof(virtio_blk_req_hdr_t);
+	blk->status_phys = phys + VIRTIO_BLK_MAX_REQS * sizeof(virtio_blk_req_hdr_t);
+	blk->free_reqs = 0xFFFFFFFF;
+	blk->head_req = kmalloc(blk->vq.size);
+
+	//capacity is a 64 bit count of 512 byte sectors
+	uint32_t capacity = inl(blk->iobase + VIRTIO_PCI_CONFIG);
+	if (inl(blk->iobase + VIRTIO_PCI_CONFIG + 4)) {
+		capacity = 0xFFFFFFFF;
+	}
+
+	strcpy(blk->dev.name, "vda");
+	blk->dev.name[2] += blk_device_count;
+	blk->dev.ctx = blk;
+	blk->dev.sector_size = 512;
+	blk->dev.sector_count = capacity;
+	blk->dev.read = virtio_blk_read;
+	if (!(features & VIRTIO_BLK_F_RO)) {
+		blk->dev.write = virtio_blk_write;
+	}
+	if (features & VIRTIO_BLK_F_FLUSH) {
+		blk->dev.flush = virtio_blk_flush;
+	}
+
+	blk_devices[blk_device_count++] = blk;
+	//the line may be shared with other PCI devices, the ISR read tells us if it was ours
+	register_shared_interrupt_handler(IRQ0 + device->irq, &virtio_blk_irq);
+	virtio_driver_ok(blk->iobase);
+
+	printf_info("virtio-blk: %dMB disk, queue size %d%s", capacity / 1024 / 2, blk->vq.size, blk->vq.event_idx ? ", event idx" : "");
+	block_device_register(&blk->dev);
+}
+
+void virtio_blk_install() {
+	pci_device* device;
+	for (int i = 0; (device = pci_find_device(VIRTIO_VENDOR, VIRTIO_BLK_DEVICE, i)); i++) {
+		if (blk_device_count >= MAX_VIRTIO_BLK_DEVICES) break;
+		virtio_blk_init(device);
+	}
+}
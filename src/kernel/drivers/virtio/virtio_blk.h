@@ -0,0 +1,32 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include <std/std.h>
+
+//legacy (transitional) virtio-blk PCI device id
+#define VIRTIO_BLK_DEVICE 0x1001
+
+#define VIRTIO_BLK_F_RO		(1 << 5)	//device is read-only
+#define VIRTIO_BLK_F_FLUSH	(1 << 9)	//device supports cache flush
+
+#define VIRTIO_BLK_T_IN		0
+#define VIRTIO_BLK_T_OUT	1
+#define VIRTIO_BLK_T_FLUSH	4
+
+#define VIRTIO_BLK_S_OK		0
+
+//requests in flight per device
+#define VIRTIO_BLK_MAX_REQS 32
+//largest transfer carried by a single request (64KB)
+#define VIRTIO_BLK_MAX_SECTORS 128
+
+typedef struct virtio_blk_req_hdr {
+	uint32_t type;
+	uint32_t reserved;
+	uint64_t sector;
+} __attribute__((packed)) virtio_blk_req_hdr_t;
+
+//finds virtio-blk devices on the PCI bus and registers each as a block device
+void virtio_blk_install();
+
+#endif
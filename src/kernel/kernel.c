@@ -16,13 +16,22 @@
 #include <kernel/util/multitasking/tasks/task.h>
 #include <kernel/util/multitasking/tasks/record.h>
 #include <kernel/util/mutex/mutex.h>
+#include <kernel/util/fpu/fpu.h>
 #include <kernel/util/vfs/initrd.h>
+#include <kernel/util/vfs/tmpfs.h>
+#include <kernel/util/vfs/mount.h>
+#include <kernel/util/vfs/bcache.h>
+#include <kernel/util/vfs/devfs.h>
+#include <kernel/util/vfs/ext2.h>
 #include <kernel/drivers/rtc/clock.h>
 #include <kernel/drivers/pit/pit.h>
 #include <kernel/drivers/mouse/mouse.h>
 #include <kernel/drivers/vesa/vesa.h>
 #include <kernel/drivers/pci/pci_detect.h>
 #include <kernel/drivers/serial/serial.h>
+#include <kernel/drivers/ide/ide.h>
+#include <kernel/drivers/ahci/ahci.h>
+#include <kernel/drivers/virtio/virtio_blk.h>
 #include <std/klog.h>
 #include <tests/test.h>
 
@@ -90,6 +99,9 @@ void kernel_main(multiboot* mboot_ptr, uint32_t initial_stack) {
 
 	test_interrupts();
 
+	//x87/SSE registers, saved on every task switch from here on
+	fpu_install();
+
 	//serial output for syslog
 	serial_init();
 
@@ -114,9 +126,23 @@ void kernel_main(multiboot* mboot_ptr, uint32_t initial_stack) {
 	kb_install();
 	mouse_install();
 	pci_install();
+	ide_install();
+	ahci_install();
+	virtio_blk_install();
+
+	//block cache sits between filesystems and disk drivers
+	bcache_install();
 
 	//initialize initrd, and set as fs root
 	fs_root = initrd_install(initrd_loc);
+	//expose block devices found above as /dev nodes
+	devfs_install(finddir_fs(fs_root, "dev"));
+	//scratch space in memory
+	vfs_mount(finddir_fs(fs_root, "tmp"), tmpfs_create(), NULL);
+	//on-disk filesystems, mounted from the shell with mount /dev/<disk> /mnt ext2
+	ext2_install();
+	//fonts on the initrd, gfx text falls back to the built in font without them
+	font_install();
 
 	//test facilities
 	/*
@@ -125,6 +151,7 @@ void kernel_main(multiboot* mboot_ptr, uint32_t initial_stack) {
 	test_time_unique();
 	test_malloc();
 	test_crypto();
+	test_bcache();
 	*/
 
 	if (!fork("shell")) {
@@ -0,0 +1,121 @@
+#include "fpu.h"
+#include <std/kheap.h>
+#include <std/memory.h>
+#include <std/printf.h>
+
+#define CR0_MP	(1 << 1)	//wait/fwait honour TS
+#define CR0_EM	(1 << 2)	//no fpu, trap every fpu instruction
+#define CR0_TS	(1 << 3)	//set by hardware task switches, traps the next fpu instruction
+
+#define CR4_OSFXSR		(1 << 9)	//fxsave/fxrstor save SSE state, SSE instructions allowed
+#define CR4_OSXMMEXCPT	(1 << 10)	//unmasked SSE exceptions raise #XM rather than #UD
+
+#define EFLAGS_ID (1 << 21)
+
+//power on value, all SSE exceptions masked
+#define MXCSR_DEFAULT 0x1F80
+
+static uint32_t features = 0;
+static bool use_fxsr = false;
+//captured right after fninit, new tasks start from this
+static fpu_state_t initial_state;
+
+static bool cpuid_supported() {
+	//cpuid exists if the ID bit of eflags can be flipped
+	uint32_t before, after;
+	asm volatile("pushfl\n"
+				 "pushfl\n"
+				 "xorl %2, (%%esp)\n"
+				 "popfl\n"
+				 "pushfl\n"
+				 "popl %0\n"
+				 "movl (%%esp), %1\n"
+				 "popfl\n"
+				 : "=r"(after), "=r"(before)
+				 : "i"(EFLAGS_ID)
+				 : "cc");
+	return (before ^ after) & EFLAGS_ID;
+}
+
+//fxsave wants a 16 byte aligned area
+static uint8_t* state_area(fpu_state_t* state) {
+	return (uint8_t*)(((uint32_t)state->buf + 15) & ~15);
+}
+
+void fpu_install() {
+	printf_info("Initializing FPU...");
+
+	if (cpuid_supported()) {
+		uint32_t eax, ebx, ecx, edx;
+		asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+		features = edx;
+	}
+
+	uint32_t cr0;
+	asm volatile("mov %%cr0, %0" : "=r"(cr0));
+	cr0 &= ~(CR0_EM | CR0_TS);
+	cr0 |= CR0_MP;
+	asm volatile("mov %0, %%cr0" : : "r"(cr0));
+	asm volatile("fninit");
+
+	//SSE registers can only be saved with fxsave, so without it SSE stays off
+	if (features & CPUID_FEAT_EDX_FXSR) {
+		uint32_t cr4;
+		asm volatile("mov %%cr4, %0" : "=r"(cr4));
+		cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+		asm volatile("mov %0, %%cr4" : : "r"(cr4));
+		use_fxsr = true;
+	}
+	else {
+		features &= ~(CPUID_FEAT_EDX_SSE | CPUID_FEAT_EDX_SSE2);
+	}
+
+	if (features & CPUID_FEAT_EDX_SSE) {
+		uint32_t mxcsr = MXCSR_DEFAULT;
+		asm volatile("ldmxcsr %0" : : "m"(mxcsr));
+	}
+
+	fpu_save(&initial_state);
+
+	printf_info("FPU state saved with %s, SSE %s, SSE2 %s",
+				use_fxsr ? "fxsave" : "fnsave",
+				cpu_has(CPUID_FEAT_EDX_SSE) ? "on" : "off",
+				cpu_has(CPUID_FEAT_EDX_SSE2) ? "on" : "off");
+}
+
+bool cpu_has(uint32_t feature) {
+	return (features & feature) == feature;
+}
+
+fpu_state_t* fpu_state_create() {
+	fpu_state_t* state = kmalloc(sizeof(fpu_state_t));
+	memcpy(state_area(state), state_area(&initial_state), FPU_STATE_SIZE);
+	return state;
+}
+
+void fpu_state_destroy(fpu_state_t* state) {
+	kfree(state);
+}
+
+void fpu_save(fpu_state_t* state) {
+	uint8_t* area = state_area(state);
+	if (use_fxsr) {
+		asm volatile("fxsave (%0)" : : "r"(area) : "memory");
+	}
+	else {
+		//fnsave also reinitializes the fpu, so put back what was just saved
+		asm volatile("fnsave (%0)\n"
+					 "frstor (%0)\n"
+					 : : "r"(area) : "memory");
+	}
+}
+
+void fpu_restore(fpu_state_t* state) {
+	uint8_t* area = state_area(state);
+	if (use_fxsr) {
+		asm volatile("fxrstor (%0)" : : "r"(area) : "memory");
+	}
+	else {
+		asm volatile("frstor (%0)" : : "r"(area) : "memory");
+	}
+}
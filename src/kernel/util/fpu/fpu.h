@@ -0,0 +1,39 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include <std/std.h>
+
+//cpuid leaf 1 edx feature bits
+#define CPUID_FEAT_EDX_FPU	(1 << 0)
+#define CPUID_FEAT_EDX_MTRR	(1 << 12)
+#define CPUID_FEAT_EDX_PAT	(1 << 16)
+#define CPUID_FEAT_EDX_FXSR	(1 << 24)
+#define CPUID_FEAT_EDX_SSE	(1 << 25)
+#define CPUID_FEAT_EDX_SSE2	(1 << 26)
+
+//fxsave needs 512 bytes on a 16 byte boundary
+//kmalloc doesn't align that finely, so there's room to align within the buffer
+#define FPU_STATE_SIZE 512
+
+//x87 and SSE registers of a task that isn't running
+typedef struct fpu_state {
+	uint8_t buf[FPU_STATE_SIZE + 15];
+} fpu_state_t;
+
+//turns on the x87 unit, and SSE if the cpu has it
+void fpu_install();
+
+//true if the cpu reports feature (one of CPUID_FEAT_EDX_*) and it's been enabled
+//always false before fpu_install
+bool cpu_has(uint32_t feature);
+
+//state a freshly initialized fpu would have
+fpu_state_t* fpu_state_create();
+void fpu_state_destroy(fpu_state_t* state);
+
+//copy the live fpu registers to state, or load them from it
+//used on every task switch, as any task may use floating point or SSE
+void fpu_save(fpu_state_t* state);
+void fpu_restore(fpu_state_t* state);
+
+#endif
@@ -156,6 +156,7 @@ void handle_virtualization_exception(registers_t regs) {
 }
 
 isr_t interrupt_handlers[256];
+static isr_frame_t frame_handlers[256];
 
 void isr_install_default() {
 	register_interrupt_handler(0, &handle_divide_by_zero);
@@ -179,7 +180,12 @@ void isr_handler(registers_t regs) {
 	uint8_t int_no = regs.int_no;
     pic_acknowledge(int_no);
 
-	if (interrupt_handlers[int_no] != 0) {
+	//regs is the frame pushed by the asm stub, so changes made through this pointer
+	//are restored into the interrupted context
+	if (frame_handlers[int_no] != 0) {
+		frame_handlers[int_no](&regs);
+	}
+	else if (interrupt_handlers[int_no] != 0) {
 		isr_t handler = interrupt_handlers[int_no];
 		handler(regs);
 	}
@@ -193,6 +199,46 @@ void register_interrupt_handler(uint8_t n, isr_t handler) {
 	interrupt_handlers[n] = handler;
 }
 
+static isr_t shared_handlers[16][MAX_SHARED_IRQ_HANDLERS];
+
+static void irq_shared_dispatch(registers_t regs) {
+	isr_t* chain = shared_handlers[regs.int_no - IRQ0];
+	for (int i = 0; i < MAX_SHARED_IRQ_HANDLERS && chain[i]; i++) {
+		chain[i](regs);
+	}
+}
+
+void register_shared_interrupt_handler(uint8_t n, isr_t handler) {
+	if (n < IRQ0 || n > IRQ15) {
+		printf_err("Can't share interrupt %d, only IRQs can be shared", n);
+		return;
+	}
+
+	kernel_begin_critical();
+	isr_t* chain = shared_handlers[n - IRQ0];
+	isr_t existing = interrupt_handlers[n];
+	//a handler registered the exclusive way joins the chain rather than being dropped
+	if (existing && existing != &irq_shared_dispatch) {
+		memset(chain, 0, sizeof(shared_handlers[0]));
+		chain[0] = existing;
+	}
+
+	int i = 0;
+	while (i < MAX_SHARED_IRQ_HANDLERS && chain[i] && chain[i] != handler) i++;
+	if (i == MAX_SHARED_IRQ_HANDLERS) {
+		printf_err("Too many handlers sharing IRQ %d", n - IRQ0);
+	}
+	else {
+		chain[i] = handler;
+		interrupt_handlers[n] = &irq_shared_dispatch;
+	}
+	kernel_end_critical();
+}
+
+void register_interrupt_frame_handler(uint8_t n, isr_frame_t handler) {
+	frame_handlers[n] = handler;
+}
+
 #define PIC1_PORT_A 0x20
 #define PIC2_PORT_A 0xA0
 
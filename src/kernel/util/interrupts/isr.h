@@ -25,6 +25,14 @@
 //as first parameter
 typedef void (*isr_t)(registers_t);
 void register_interrupt_handler(uint8_t n, isr_t handler);
+//PCI devices may share an IRQ line, so their handlers are chained instead of replacing each other
+//every handler on the line runs on each interrupt, and must check whether its device raised it
+#define MAX_SHARED_IRQ_HANDLERS 4
+void register_shared_interrupt_handler(uint8_t n, isr_t handler);
+//handlers which need to change the interrupted context, such as a syscall's return value,
+//are given a pointer to the registers saved on the stack instead of a copy
+typedef void (*isr_frame_t)(registers_t*);
+void register_interrupt_frame_handler(uint8_t n, isr_frame_t handler);
 void isr_install_default();
 void pic_acknowledge(unsigned int interrupt);
 
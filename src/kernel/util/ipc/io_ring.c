@@ -0,0 +1,270 @@
+#include "io_ring.h"
+#include <std/kheap.h>
+#include <kernel/drivers/rtc/clock.h>
+
+extern task_t* current_task;
+
+//every ring, for io_ring_tick
+static io_ring_ctx_t* rings = 0;
+
+//posts a completion for an op that was in flight
+//caller must be in a critical section
+static void io_ring_complete(io_ring_ctx_t* ctx, uint32_t user_data, int result) {
+	io_ring_t* ring = ctx->ring;
+	io_cqe_t* cqe = &ring->cqes[ring->cq_tail & ring->cq_mask];
+	cqe->user_data = user_data;
+	cqe->result = result;
+	//the entry has to be written before the task can see the new tail
+	asm volatile("" : : : "memory");
+	ring->cq_tail++;
+	ctx->pending_count--;
+}
+
+//whether op can finish without blocking
+static bool io_pending_ready(io_pending_t* op) {
+	switch (op->sqe.op) {
+		case IO_OP_READ:
+			return file_poll(op->file, POLL_IN);
+		case IO_OP_WRITE:
+			return file_poll(op->file, POLL_OUT);
+		case IO_OP_POLL:
+			return file_poll(op->file, op->sqe.events);
+		case IO_OP_TIMER:
+			return time() >= op->deadline;
+		default:
+			return true;
+	}
+}
+
+static bool io_pending_needs_owner(io_pending_t* op) {
+	return op->sqe.op == IO_OP_READ || op->sqe.op == IO_OP_WRITE;
+}
+
+static void io_pending_free(io_pending_t* op) {
+	if (op->file) file_release(op->file);
+	kfree(op);
+}
+
+//completes a ready op from the owner's context, where its buffer is mapped
+static void io_ring_finish(io_ring_ctx_t* ctx, io_pending_t* op) {
+	int result = 0;
+	switch (op->sqe.op) {
+		case IO_OP_READ:
+			result = file_read(op->file, (void*)op->sqe.addr, op->sqe.len, op->sqe.offset);
+			break;
+		case IO_OP_WRITE:
+			result = file_write(op->file, (void*)op->sqe.addr, op->sqe.len, op->sqe.offset);
+			break;
+		case IO_OP_POLL:
+			result = file_poll(op->file, op->sqe.events);
+			break;
+		default:
+			break;
+	}
+	kernel_begin_critical();
+	io_ring_complete(ctx, op->sqe.user_data, result);
+	kernel_end_critical();
+	io_pending_free(op);
+}
+
+//finishes whatever of ctx's pending ops is ready
+//the list is taken off ctx while this runs, since reads and writes can't happen in a critical section
+static void io_ring_run_pending(io_ring_ctx_t* ctx) {
+	kernel_begin_critical();
+	io_pending_t* list = ctx->pending;
+	ctx->pending = NULL;
+	kernel_end_critical();
+
+	io_pending_t* remaining = NULL;
+	io_pending_t** tail = &remaining;
+	while (list) {
+		io_pending_t* op = list;
+		list = op->next;
+		op->next = NULL;
+		if (io_pending_ready(op)) {
+			io_ring_finish(ctx, op);
+			continue;
+		}
+		*tail = op;
+		tail = &op->next;
+	}
+
+	kernel_begin_critical();
+	*tail = ctx->pending;
+	ctx->pending = remaining;
+	kernel_end_critical();
+}
+
+static void io_ring_submit(io_ring_ctx_t* ctx, io_sqe_t* sqe) {
+	open_file_t* file = NULL;
+	bool valid = true;
+	switch (sqe->op) {
+		case IO_OP_READ:
+		case IO_OP_WRITE:
+		case IO_OP_POLL:
+			//held until the op completes, so closing fd in the meantime is harmless
+			file = fd_acquire(sqe->fd);
+			valid = file != NULL;
+			break;
+		case IO_OP_NOP:
+		case IO_OP_TIMER:
+			break;
+		default:
+			valid = false;
+			break;
+	}
+
+	kernel_begin_critical();
+	ctx->pending_count++;
+	if (!valid) {
+		io_ring_complete(ctx, sqe->user_data, -1);
+		kernel_end_critical();
+		return;
+	}
+	kernel_end_critical();
+
+	io_pending_t* op = kmalloc(sizeof(io_pending_t));
+	memset(op, 0, sizeof(io_pending_t));
+	op->sqe = *sqe;
+	op->file = file;
+	op->deadline = time() + sqe->len;
+
+	if (io_pending_ready(op)) {
+		io_ring_finish(ctx, op);
+		return;
+	}
+	kernel_begin_critical();
+	op->next = ctx->pending;
+	ctx->pending = op;
+	kernel_end_critical();
+}
+
+//whether the owner, waiting in io_ring_enter, has something to do
+//caller must be in a critical section
+static bool io_ring_should_wake(io_ring_ctx_t* ctx) {
+	io_ring_t* ring = ctx->ring;
+	if (ring->cq_tail - ring->cq_head >= ctx->wait_for) return true;
+	for (io_pending_t* op = ctx->pending; op; op = op->next) {
+		if (io_pending_needs_owner(op) && io_pending_ready(op)) return true;
+	}
+	return false;
+}
+
+io_ring_t* io_ring_setup(uint32_t entries) {
+	if (!current_task || current_task->io_ring) return NULL;
+	if (!entries || entries > IO_RING_MAX_ENTRIES) return NULL;
+
+	uint32_t size = 1;
+	while (size < entries) size <<= 1;
+
+	//one allocation holding the indices and both queues
+	uint32_t bytes = sizeof(io_ring_t) + size * sizeof(io_sqe_t) + size * 2 * sizeof(io_cqe_t);
+	io_ring_t* ring = kmalloc(bytes);
+	memset(ring, 0, bytes);
+	ring->sqes = (io_sqe_t*)(ring + 1);
+	ring->sq_mask = size - 1;
+	ring->cqes = (io_cqe_t*)(ring->sqes + size);
+	ring->cq_mask = size * 2 - 1;
+
+	io_ring_ctx_t* ctx = kmalloc(sizeof(io_ring_ctx_t));
+	memset(ctx, 0, sizeof(io_ring_ctx_t));
+	ctx->ring = ring;
+	ctx->owner = current_task;
+
+	kernel_begin_critical();
+	ctx->next = rings;
+	rings = ctx;
+	current_task->io_ring = ctx;
+	kernel_end_critical();
+	return ring;
+}
+
+int io_ring_enter(uint32_t to_submit, uint32_t min_complete) {
+	io_ring_ctx_t* ctx = current_task ? current_task->io_ring : NULL;
+	if (!ctx) return -1;
+	io_ring_t* ring = ctx->ring;
+	uint32_t cq_size = ring->cq_mask + 1;
+	if (min_complete > cq_size) return -1;
+
+	//reads and writes that became ready since last time
+	io_ring_run_pending(ctx);
+
+	uint32_t submitted = 0;
+	while (submitted < to_submit && ring->sq_head != ring->sq_tail) {
+		//every op in flight is guaranteed a completion slot, so completions are never dropped
+		if (ring->cq_tail - ring->cq_head + ctx->pending_count >= cq_size) break;
+
+		io_sqe_t sqe = ring->sqes[ring->sq_head & ring->sq_mask];
+		ring->sq_head++;
+		submitted++;
+		io_ring_submit(ctx, &sqe);
+	}
+
+	while (ring->cq_tail - ring->cq_head < min_complete && ctx->pending_count) {
+		kernel_begin_critical();
+		ctx->wait_for = min_complete;
+		if (!io_ring_should_wake(ctx)) {
+			//io_ring_tick wakes us
+			wait_queue_sleep(&ctx->waiter);
+		}
+		ctx->wait_for = 0;
+		kernel_end_critical();
+		io_ring_run_pending(ctx);
+	}
+	return submitted;
+}
+
+void io_ring_tick() {
+	io_pending_t* done = NULL;
+
+	kernel_begin_critical();
+	for (io_ring_ctx_t* ctx = rings; ctx; ctx = ctx->next) {
+		io_pending_t** link = &ctx->pending;
+		while (*link) {
+			io_pending_t* op = *link;
+			//reads and writes are left for the owner, which has their buffers mapped
+			if (io_pending_needs_owner(op) || !io_pending_ready(op)) {
+				link = &op->next;
+				continue;
+			}
+			*link = op->next;
+			int result = op->sqe.op == IO_OP_POLL ? (int)file_poll(op->file, op->sqe.events) : 0;
+			io_ring_complete(ctx, op->sqe.user_data, result);
+			op->next = done;
+			done = op;
+		}
+		if (ctx->waiter.head && io_ring_should_wake(ctx)) {
+			wait_queue_wake(&ctx->waiter);
+		}
+	}
+	kernel_end_critical();
+
+	//closing the last reference to a file may need interrupts, so this waits until here
+	while (done) {
+		io_pending_t* next = done->next;
+		io_pending_free(done);
+		done = next;
+	}
+}
+
+void io_ring_destroy(task_t* task) {
+	io_ring_ctx_t* ctx = task->io_ring;
+	if (!ctx) return;
+
+	kernel_begin_critical();
+	io_ring_ctx_t** link = &rings;
+	while (*link && *link != ctx) {
+		link = &(*link)->next;
+	}
+	if (*link) *link = ctx->next;
+	task->io_ring = NULL;
+	kernel_end_critical();
+
+	while (ctx->pending) {
+		io_pending_t* next = ctx->pending->next;
+		io_pending_free(ctx->pending);
+		ctx->pending = next;
+	}
+	kfree(ctx->ring);
+	kfree(ctx);
+}
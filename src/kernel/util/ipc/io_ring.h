@@ -0,0 +1,90 @@
+#ifndef IO_RING_H
+#define IO_RING_H
+
+#include <std/std.h>
+#include <kernel/util/vfs/fd.h>
+#include <kernel/util/multitasking/tasks/wait.h>
+
+//largest ring a task can ask for
+#define IO_RING_MAX_ENTRIES 256
+
+#define IO_OP_NOP	0
+#define IO_OP_READ	1	//fd, addr, len, offset
+#define IO_OP_WRITE	2	//fd, addr, len, offset
+#define IO_OP_TIMER	3	//completes after len ms
+#define IO_OP_POLL	4	//fd, completes once any of events is ready
+
+//submission queue entry, filled in by the task
+typedef struct io_sqe {
+	uint8_t op;
+	uint8_t reserved;
+	uint16_t events;	//POLL_* for IO_OP_POLL
+	int fd;
+	uint32_t addr;		//buffer in the submitting task's address space
+	uint32_t len;
+	uint32_t offset;	//FD_OFFSET_CURRENT to use the descriptor's own offset
+	uint32_t user_data;	//handed back untouched in the completion
+} io_sqe_t;
+
+//completion queue entry, filled in by the kernel
+typedef struct io_cqe {
+	uint32_t user_data;
+	int result;			//bytes transferred, ready POLL_* events, 0 for timers, or -1
+} io_cqe_t;
+
+//the part of a ring shared between a task and the kernel
+//indices run freely and wrap around, entry i lives at i & mask
+//the task writes sqes then advances sq_tail, and reads cqes then advances cq_head
+//the kernel does the reverse, so neither side needs a syscall to look at the other's progress
+typedef struct io_ring {
+	volatile uint32_t sq_head;
+	volatile uint32_t sq_tail;
+	uint32_t sq_mask;
+	io_sqe_t* sqes;
+
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;
+	uint32_t cq_mask;	//twice as many completion slots as submission slots
+	io_cqe_t* cqes;
+} io_ring_t;
+
+//an operation that couldn't complete when it was submitted
+typedef struct io_pending {
+	io_sqe_t sqe;
+	open_file_t* file;	//NULL for timers
+	uint32_t deadline;	//time() at which a timer fires
+	struct io_pending* next;
+} io_pending_t;
+
+typedef struct io_ring_ctx {
+	io_ring_t* ring;
+	task_t* owner;
+	io_pending_t* pending;
+	uint32_t pending_count;
+	uint32_t wait_for;			//completions owner is blocked in io_ring_enter waiting for
+	wait_queue_t waiter;
+	struct io_ring_ctx* next;	//every ring, so they can be checked in the background
+} io_ring_ctx_t;
+
+//creates a ring of entries submission slots for the current task, entries is rounded up to a power of 2
+//the ring lives in memory every address space shares
+//returns it, or NULL if the task already has one
+io_ring_t* io_ring_setup(uint32_t entries);
+
+//consumes up to to_submit entries from the submission queue, then blocks until
+//at least min_complete completions are waiting to be reaped
+//operations that can finish now complete before this returns. timers and polls complete
+//in the background. reads and writes on descriptors that would block are retried on
+//the next io_ring_enter once the descriptor is ready
+//returns the number of entries consumed, or -1
+int io_ring_enter(uint32_t to_submit, uint32_t min_complete);
+
+//completes timers and polls whose time has come, and wakes tasks waiting on their rings
+//called periodically by the iosentinel task. never call it from an interrupt, it polls
+//files and may drop the last reference to one
+void io_ring_tick();
+
+//releases task's ring and cancels whatever it had in flight
+void io_ring_destroy(task_t* task);
+
+#endif
@@ -0,0 +1,137 @@
+#include "ipc.h"
+#include <std/kheap.h>
+
+extern task_t* current_task;
+
+static ipc_port_t* ports[IPC_PORT_MAX];
+
+static ipc_port_t* ipc_port_get(int port) {
+	if (port < 0 || port >= IPC_PORT_MAX) return NULL;
+	return ports[port];
+}
+
+int ipc_port_create(const char* name) {
+	if (!current_task || strlen(name) >= IPC_PORT_NAME_MAX) return -1;
+
+	kernel_begin_critical();
+	int id = -1;
+	for (int i = 0; i < IPC_PORT_MAX; i++) {
+		if (ports[i] && !strcmp(ports[i]->name, name)) {
+			kernel_end_critical();
+			return -1;
+		}
+		if (!ports[i] && id < 0) id = i;
+	}
+	if (id >= 0) {
+		ipc_port_t* port = kmalloc(sizeof(ipc_port_t));
+		memset(port, 0, sizeof(ipc_port_t));
+		strcpy(port->name, name);
+		port->owner = current_task->id;
+		ports[id] = port;
+	}
+	kernel_end_critical();
+	return id;
+}
+
+int ipc_port_lookup(const char* name) {
+	for (int i = 0; i < IPC_PORT_MAX; i++) {
+		if (ports[i] && !strcmp(ports[i]->name, name)) return i;
+	}
+	return -1;
+}
+
+int ipc_port_destroy(int port_id) {
+	ipc_port_t* port = ipc_port_get(port_id);
+	if (!port || !current_task || port->owner != current_task->id) return -1;
+
+	kernel_begin_critical();
+	if (port->queued || port->handled) {
+		kernel_end_critical();
+		return -1;
+	}
+	ports[port_id] = NULL;
+	kernel_end_critical();
+	kfree(port);
+	return 0;
+}
+
+int ipc_send(int port_id, ipc_message_t* msg, ipc_message_t* reply) {
+	ipc_port_t* port = ipc_port_get(port_id);
+	if (!port || !current_task || port->owner == current_task->id) return -1;
+
+	ipc_pending_t* pending = kmalloc(sizeof(ipc_pending_t));
+	memset(pending, 0, sizeof(ipc_pending_t));
+	pending->msg = *msg;
+	pending->msg.sender = current_task->id;
+
+	kernel_begin_critical();
+	ipc_pending_t** tail = &port->queued;
+	while (*tail) tail = &(*tail)->next;
+	*tail = pending;
+
+	//if the owner is already waiting, run it now rather than whatever the scheduler picks next
+	task_t* receiver = port->receiver.head;
+	wait_queue_wake(&port->receiver);
+	while (!pending->replied) {
+		if (receiver && receiver->state == RUNNABLE) {
+			wait_queue_handoff(&pending->sender, receiver);
+			receiver = NULL;
+		}
+		else {
+			wait_queue_sleep(&pending->sender);
+		}
+	}
+	kernel_end_critical();
+
+	*reply = pending->reply;
+	kfree(pending);
+	return 0;
+}
+
+int ipc_receive(int port_id, ipc_message_t* msg) {
+	ipc_port_t* port = ipc_port_get(port_id);
+	if (!port || !current_task || port->owner != current_task->id) return -1;
+
+	kernel_begin_critical();
+	while (!port->queued) {
+		wait_queue_sleep(&port->receiver);
+	}
+	ipc_pending_t* pending = port->queued;
+	port->queued = pending->next;
+	pending->next = port->handled;
+	port->handled = pending;
+	kernel_end_critical();
+
+	*msg = pending->msg;
+	return msg->sender;
+}
+
+int ipc_reply(int port_id, int sender, ipc_message_t* reply) {
+	ipc_port_t* port = ipc_port_get(port_id);
+	if (!port || !current_task || port->owner != current_task->id) return -1;
+
+	kernel_begin_critical();
+	ipc_pending_t** link = &port->handled;
+	while (*link && (*link)->msg.sender != sender) {
+		link = &(*link)->next;
+	}
+	ipc_pending_t* pending = *link;
+	if (!pending) {
+		kernel_end_critical();
+		return -1;
+	}
+	*link = pending->next;
+
+	pending->reply = *reply;
+	pending->reply.sender = current_task->id;
+	pending->replied = true;
+
+	//the sender has been waiting on us, so give it the rest of our time
+	task_t* client = pending->sender.head;
+	wait_queue_wake(&pending->sender);
+	if (client && client->state == RUNNABLE) {
+		goto_pid(client->id);
+	}
+	kernel_end_critical();
+	return 0;
+}
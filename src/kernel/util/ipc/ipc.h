@@ -0,0 +1,56 @@
+#ifndef IPC_H
+#define IPC_H
+
+#include <std/std.h>
+#include <kernel/util/multitasking/tasks/wait.h>
+
+//ports that can exist at once
+#define IPC_PORT_MAX 32
+#define IPC_PORT_NAME_MAX 32
+//payload words carried by each message
+//anything bigger should go through a shm region, with its id in the message
+#define IPC_MESSAGE_WORDS 8
+
+typedef struct ipc_message {
+	int sender;		//PID of sending task, filled in by the kernel
+	uint32_t type;
+	uint32_t data[IPC_MESSAGE_WORDS];
+} ipc_message_t;
+
+//a message sent to a port, from the time it's sent until it's replied to
+//lives on the heap, since sender and receiver are in different address spaces
+typedef struct ipc_pending {
+	ipc_message_t msg;
+	ipc_message_t reply;
+	bool replied;
+	wait_queue_t sender;	//sender sleeps here until replied
+	struct ipc_pending* next;
+} ipc_pending_t;
+
+typedef struct ipc_port {
+	char name[IPC_PORT_NAME_MAX];
+	int owner;				//PID of task receiving on this port
+	ipc_pending_t* queued;	//sent, not yet received, oldest first
+	ipc_pending_t* handled;	//received, not yet replied to
+	wait_queue_t receiver;	//owner sleeps here while queued is empty
+} ipc_port_t;
+
+//makes a port owned by the current task, which is the only one that can receive on it
+//returns its id, or -1 if the name is taken
+int ipc_port_create(const char* name);
+//returns the id of the port called name, or -1
+int ipc_port_lookup(const char* name);
+//removes a port owned by the current task, fails if any message sent to it hasn't been replied to
+int ipc_port_destroy(int port);
+
+//sends msg to port and blocks until it's replied to
+//if the owner is waiting for a message, the cpu goes straight to it, and its reply comes straight back
+//returns 0 with the reply in reply, or -1
+int ipc_send(int port, ipc_message_t* msg, ipc_message_t* reply);
+//blocks until a message arrives on port, and copies it into msg
+//returns the sending PID, which must be passed to ipc_reply
+int ipc_receive(int port, ipc_message_t* msg);
+//answers the message received from sender and wakes it
+int ipc_reply(int port, int sender, ipc_message_t* reply);
+
+#endif
@@ -0,0 +1,179 @@
+#include "shm.h"
+#include <std/kheap.h>
+#include <kernel/util/paging/paging.h>
+#include <kernel/util/mutex/mutex.h>
+
+extern task_t* current_task;
+
+static shm_t* regions[SHM_MAX];
+static lock_t* shm_lock = 0;
+
+static void shm_lock_acquire() {
+	if (!shm_lock) shm_lock = lock_create();
+	lock(shm_lock);
+}
+
+static shm_t* shm_get(int id) {
+	if (id < 0 || id >= SHM_MAX) return NULL;
+	shm_t* shm = regions[id];
+	if (!shm || shm->destroyed) return NULL;
+	return shm;
+}
+
+static void shm_free(int id) {
+	shm_t* shm = regions[id];
+	for (uint32_t i = 0; i < shm->page_count; i++) {
+		page_t page = {0};
+		page.frame = shm->frames[i] / 0x1000;
+		free_frame(&page);
+	}
+	kfree(shm->frames);
+	kfree(shm);
+	regions[id] = NULL;
+}
+
+//drops one mapping of region id, freeing the region if it was the last and it's been destroyed
+//called with shm_lock held
+static void shm_release(int id) {
+	shm_t* shm = regions[id];
+	if (!shm || !shm->mappings) return;
+	shm->mappings--;
+	if (shm->destroyed && !shm->mappings) {
+		shm_free(id);
+	}
+}
+
+static void shm_record(task_t* task, int id, void* addr) {
+	shm_mapping_t* mapping = kmalloc(sizeof(shm_mapping_t));
+	mapping->id = id;
+	mapping->addr = addr;
+	mapping->next = task->shm_mappings;
+	task->shm_mappings = mapping;
+}
+
+int shm_create(uint32_t size) {
+	if (!size) return -1;
+
+	shm_lock_acquire();
+	int id = -1;
+	for (int i = 0; i < SHM_MAX; i++) {
+		if (!regions[i]) {
+			id = i;
+			break;
+		}
+	}
+	if (id < 0) {
+		unlock(shm_lock);
+		printf_err("shm_create(): no free regions");
+		return -1;
+	}
+
+	shm_t* shm = kmalloc(sizeof(shm_t));
+	memset(shm, 0, sizeof(shm_t));
+	shm->size = size;
+	shm->page_count = (size + 0xFFF) / 0x1000;
+	shm->frames = kmalloc(shm->page_count * sizeof(uint32_t));
+	for (uint32_t i = 0; i < shm->page_count; i++) {
+		//frames are owned by the region, not by any page table
+		page_t page = {0};
+		alloc_frame(&page, 0, 1);
+		shm->frames[i] = page.frame * 0x1000;
+	}
+	regions[id] = shm;
+
+	//frames come straight from the allocator, clear out whatever they held
+	void* mapped = map_frames(shm->frames, shm->page_count, true);
+	if (!mapped) {
+		shm_free(id);
+		unlock(shm_lock);
+		return -1;
+	}
+	memset(mapped, 0, shm->page_count * 0x1000);
+	unmap_shared(mapped, shm->page_count * 0x1000);
+
+	unlock(shm_lock);
+	return id;
+}
+
+void* shm_map(int id) {
+	shm_lock_acquire();
+	shm_t* shm = shm_get(id);
+	void* addr = NULL;
+	if (shm) {
+		addr = map_frames(shm->frames, shm->page_count, true);
+		if (addr) {
+			shm->mappings++;
+			if (current_task) shm_record(current_task, id, addr);
+		}
+	}
+	unlock(shm_lock);
+	return addr;
+}
+
+int shm_unmap(int id, void* addr) {
+	shm_lock_acquire();
+	shm_t* shm = (id >= 0 && id < SHM_MAX) ? regions[id] : NULL;
+	if (!shm || !shm->mappings || virt_to_phys((uint32_t)addr) != shm->frames[0]) {
+		unlock(shm_lock);
+		return -1;
+	}
+	//only mappings this task holds can be removed
+	shm_mapping_t* mapping = NULL;
+	if (current_task) {
+		shm_mapping_t** link = &current_task->shm_mappings;
+		while (*link && ((*link)->id != id || (*link)->addr != addr)) {
+			link = &(*link)->next;
+		}
+		mapping = *link;
+		if (!mapping) {
+			unlock(shm_lock);
+			return -1;
+		}
+		*link = mapping->next;
+	}
+	unmap_shared(addr, shm->page_count * 0x1000);
+	shm_release(id);
+	unlock(shm_lock);
+	if (mapping) kfree(mapping);
+	return 0;
+}
+
+int shm_destroy(int id) {
+	shm_lock_acquire();
+	shm_t* shm = shm_get(id);
+	if (!shm) {
+		unlock(shm_lock);
+		return -1;
+	}
+	shm->destroyed = true;
+	if (!shm->mappings) {
+		shm_free(id);
+	}
+	unlock(shm_lock);
+	return 0;
+}
+
+void shm_task_clone(task_t* child, task_t* parent) {
+	if (!parent) return;
+
+	shm_lock_acquire();
+	for (shm_mapping_t* mapping = parent->shm_mappings; mapping; mapping = mapping->next) {
+		//the child's directory was copied from the parent's, so the region is at the same address
+		regions[mapping->id]->mappings++;
+		shm_record(child, mapping->id, mapping->addr);
+	}
+	unlock(shm_lock);
+}
+
+void shm_task_destroy(task_t* task) {
+	shm_lock_acquire();
+	shm_mapping_t* mapping = task->shm_mappings;
+	task->shm_mappings = NULL;
+	while (mapping) {
+		shm_mapping_t* next = mapping->next;
+		shm_release(mapping->id);
+		kfree(mapping);
+		mapping = next;
+	}
+	unlock(shm_lock);
+}
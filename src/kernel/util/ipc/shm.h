@@ -0,0 +1,50 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <std/std.h>
+#include <kernel/util/multitasking/tasks/task.h>
+
+//regions that can exist at once
+#define SHM_MAX 64
+
+//memory that any number of tasks can map into their own address space
+//every mapping refers to the same physical frames, so writes are seen by all of them
+typedef struct shm {
+	uint32_t size;
+	uint32_t page_count;
+	uint32_t* frames;	//physical address of each page
+	int mappings;		//mappings held by live tasks, see shm_mapping_t
+	bool destroyed;		//frames are freed once the last mapping goes
+} shm_t;
+
+//a region mapped into a task's address space
+//kept in a list on the task, so the mapping is dropped when the task dies
+typedef struct shm_mapping {
+	int id;
+	void* addr;
+	struct shm_mapping* next;
+} shm_mapping_t;
+
+//makes a zero-filled region of at least size bytes
+//returns its id, or -1
+int shm_create(uint32_t size);
+
+//maps region id writable into the current address space
+//returns the address it was mapped at, or NULL
+//tasks forked after this inherit the mapping, and hold it until they unmap it or die
+void* shm_map(int id);
+
+//removes a mapping made by shm_map in the current address space
+int shm_unmap(int id, void* addr);
+
+//frees the region once every mapping of it has been removed
+//id can't be mapped again after this
+int shm_destroy(int id);
+
+//gives child its own hold on every mapping it inherited from parent
+void shm_task_clone(task_t* child, task_t* parent);
+//drops every mapping task still holds, freeing destroyed regions nobody else maps
+//task's address space is left alone, it's never switched to again
+void shm_task_destroy(task_t* task);
+
+#endif
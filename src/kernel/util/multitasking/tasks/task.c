@@ -10,6 +10,10 @@
 #include <kernel/drivers/rtc/clock.h>
 #include <std/klog.h>
 #include <kernel/util/mutex/mutex.h>
+#include <kernel/util/vfs/fd.h>
+#include <kernel/util/ipc/io_ring.h>
+#include <kernel/util/ipc/shm.h>
+#include <kernel/util/fpu/fpu.h>
 #include "record.h"
 #include <gfx/lib/gfx.h>
 #include <user/xserv/xserv.h>
@@ -26,7 +30,6 @@ void task_switch_real(uint32_t eip, uint32_t paging_dir, uint32_t ebp, uint32_t
 #define STACK_MAGIC 0xDEADBEEF
 
 #define MAX_TASKS 128
-#define MAX_FILES 32
 
 #define MLFQ_DEFAULT_QUEUE_COUNT 16
 #define MLFQ_MAX_QUEUE_LENGTH 16
@@ -52,13 +55,24 @@ static lock_t* mutex = 0;
 void enqueue_task(task_t* task, int queue);
 void dequeue_task(task_t* task);
 
-void stdin_read(char* buf, uint32_t count);
-void stdout_read(char* buffer, uint32_t count);
-void stderr_read(char* buffer, uint32_t count);
-static void setup_fds(task_t* task) { task->files = array_m_create(MAX_FILES);
-	// array_m_insert(task->files, stdin_read);
-	// array_m_insert(task->files, stdout_read);
-	// array_m_insert(task->files, stderr_read);
+//forked tasks inherit their parent's descriptors
+//the first task starts with stdin/stdout/stderr on the console
+static void setup_fds(task_t* task, task_t* parent) {
+	if (parent && parent->files) {
+		task->files = fd_table_clone(parent->files);
+	}
+	else {
+		task->files = fd_table_create();
+	}
+}
+
+//forked tasks carry on with their parent's fpu registers, as they do its stack
+//parent is always the running task, so its registers are live
+static void setup_fpu(task_t* task, task_t* parent) {
+	task->fpu = fpu_state_create();
+	if (parent) {
+		fpu_save(task->fpu);
+	}
 }
 
 static void kill(task_t* task) {
@@ -117,7 +131,6 @@ void _kill() {
 	kill(current_task);
 }
 
-void goto_pid(int id);
 int getpid() {
 	if (current_task) {
 		return current_task->id;
@@ -199,7 +212,10 @@ task_t* create_process(char* name, uint32_t eip, bool wants_stack) {
 	task->name = strdup(name);
 	task->id = next_pid++;
 	task->page_dir = cloned;
-	setup_fds(task);
+	setup_fds(task, parent);
+	setup_fpu(task, parent);
+	//the cloned directory maps the parent's shared memory too
+	shm_task_clone(task, parent);
 
 	uint32_t current_eip = read_eip();
 	if (current_task == parent) {
@@ -240,6 +256,14 @@ void destroy_task(task_t* task) {
 	//remove task from queues and active list
 	unlist_task(task);
 	printf_info("%s[%d] destroyed.", task->name, task->id);
+	//drop its references to open files
+	fd_table_destroy(task->files);
+	task->files = NULL;
+	io_ring_destroy(task);
+	//and its hold on shared memory, so destroyed regions it had mapped can be freed
+	shm_task_destroy(task);
+	fpu_state_destroy(task->fpu);
+	task->fpu = NULL;
 	//free task's page directory
 	//free_directory(task->page_dir);
 }
@@ -295,6 +319,9 @@ void reap() {
 void iosent() {
 	while (1) {
 		update_blocked_tasks();
+		//io rings poll files and may close them, which can't happen inside the interrupts
+		//that also call update_blocked_tasks(), so they're only checked from this task
+		io_ring_tick();
 		//yield cpu to next task
 		sys_yield(RUNNABLE);
 	}
@@ -434,7 +461,8 @@ void tasking_install(mlfq_option options) {
 	kernel->name = "kax";
 	kernel->id = next_pid++;
 	kernel->page_dir = current_directory;
-	setup_fds(kernel);
+	setup_fds(kernel, NULL);
+	setup_fpu(kernel, NULL);
 
 	current_task = kernel;
 	active_list = kernel;
@@ -702,6 +730,10 @@ void goto_pid(int id) {
 	current_task->eip = eip;
 	current_task->esp = esp;
 	current_task->ebp = ebp;
+	//a task can reap itself, and so already be torn down
+	if (current_task->fpu) {
+		fpu_save(current_task->fpu);
+	}
 
 	//find task with this PID
 	bool found_task = false;
@@ -746,6 +778,7 @@ void goto_pid(int id) {
 	esp = current_task->esp;
 	ebp = current_task->ebp;
 	current_directory = current_task->page_dir;
+	fpu_restore(current_task->fpu);
 	task_switch_real(eip, current_directory->physicalAddr, ebp, esp);
 }
 
@@ -822,6 +855,9 @@ void proc() {
 				case MOUSE_WAIT:
 					printk("(blocked by mouse)");
 					break;
+				case QUEUE_WAIT:
+					printk("(blocked on wait queue)");
+					break;
 				case ZOMBIE:
 					printk("(zombie)");
 					break;
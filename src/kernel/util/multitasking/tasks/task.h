@@ -5,6 +5,11 @@
 #include <kernel/util/paging/paging.h>
 #include <std/array_l.h>
 
+struct fd_table;
+struct io_ring_ctx;
+struct fpu_state;
+struct shm_mapping;
+
 #define KERNEL_STACK_SIZE 2048 //use 2kb kernel stack
 
 typedef enum task_state {
@@ -13,6 +18,7 @@ typedef enum task_state {
     KB_WAIT,
     PIT_WAIT,
 	MOUSE_WAIT,
+	QUEUE_WAIT, //sleeping on a wait_queue_t
 } task_state;
 
 typedef enum mlfq_option {
@@ -41,7 +47,11 @@ typedef struct task {
 
 	page_directory_t* page_dir; //paging directory for this process
 
-	array_m* files;
+	struct fd_table* files; //open file descriptors
+	struct task* wait_next; //next task on the wait queue this one sleeps on
+	struct io_ring_ctx* io_ring; //submission/completion rings, if set up
+	struct fpu_state* fpu; //x87/SSE registers, saved while switched out
+	struct shm_mapping* shm_mappings; //shared memory regions mapped into page_dir
 } task_t;
 
 //initializes tasking system
@@ -49,6 +59,7 @@ void tasking_install();
 bool tasking_installed();
 
 void block_task(task_t* task, task_state reason);
+void unblock_task(task_t* task);
 
 //initialize a new process structure
 //does not add returned process to running queue
@@ -60,6 +71,9 @@ void add_process(task_t* task);
 //changes running process
 uint32_t task_switch();
 
+//switches straight to the runnable task with PID id, bypassing the scheduler
+void goto_pid(int id);
+
 //forks current process
 //spawns new process with different memory space
 int fork();
@@ -0,0 +1,37 @@
+#include "wait.h"
+
+extern task_t* current_task;
+
+void wait_queue_sleep(wait_queue_t* queue) {
+	if (!tasking_installed()) return;
+
+	current_task->wait_next = queue->head;
+	queue->head = current_task;
+	block_task(current_task, QUEUE_WAIT);
+	//switching back to us turned interrupts on again
+	kernel_begin_critical();
+}
+
+void wait_queue_handoff(wait_queue_t* queue, task_t* next) {
+	if (!tasking_installed()) return;
+
+	current_task->wait_next = queue->head;
+	queue->head = current_task;
+	current_task->state = QUEUE_WAIT;
+	goto_pid(next->id);
+	kernel_begin_critical();
+}
+
+void wait_queue_wake(wait_queue_t* queue) {
+	task_t* task = queue->head;
+	queue->head = NULL;
+	while (task) {
+		task_t* next = task->wait_next;
+		task->wait_next = NULL;
+		//tasks killed while asleep stay dead
+		if (task->state == QUEUE_WAIT) {
+			unblock_task(task);
+		}
+		task = next;
+	}
+}
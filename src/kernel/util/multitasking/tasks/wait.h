@@ -0,0 +1,25 @@
+#ifndef WAIT_H
+#define WAIT_H
+
+#include "task.h"
+
+//tasks blocked until some other task signals them
+//the queue is a list threaded through task_t.wait_next
+typedef struct wait_queue {
+	task_t* head;
+} wait_queue_t;
+
+//blocks the current task until wait_queue_wake is called on queue
+//test the condition being waited on and sleep between kernel_begin_critical/kernel_end_critical,
+//and retest it after waking, so a wakeup can't slip in between the test and the sleep
+//returns with interrupts disabled
+void wait_queue_sleep(wait_queue_t* queue);
+
+//like wait_queue_sleep, but runs next, which must be runnable, instead of asking the scheduler
+//lets a task hand the cpu to the one it's waiting on without a trip through the run queues
+void wait_queue_handoff(wait_queue_t* queue, task_t* next);
+
+//makes every task sleeping on queue runnable again
+void wait_queue_wake(wait_queue_t* queue);
+
+#endif
@@ -1,4 +1,5 @@
 #include "paging.h"
+#include "pat.h"
 #include <std/kheap.h>
 #include <std/std.h>
 #include <kernel/kernel.h>
@@ -162,17 +163,18 @@ void free_frame(page_t* page) {
 		//page didn't actually have an allocated frame!
 		return;
 	}
-	clear_frame(frame); //frame is now free again
+	clear_frame(frame * 0x1000); //frame is now free again
 	page->frame = 0x0; //page now doesn't have a frame
 }
 
-#define VESA_WIDTH 1024
-#define VESA_HEIGHT 768
+//where identity_map_lfb put the framebuffer
+static uint32_t lfb_base = 0;
+
 void identity_map_lfb(uint32_t location) { uint32_t j = location;
-	//TODO use screen object instead of these vals
-	while (j < location + (VESA_WIDTH * VESA_HEIGHT * 4)) {
+	//map enough for every page the driver might flip between, not just the shown one
+	while (j < location + VESA_LFB_MAP_SIZE) {
 		//if frame is valid
-		if (j + location + (VESA_WIDTH * VESA_HEIGHT * 4) < memsize) {
+		if (j + location + VESA_LFB_MAP_SIZE < memsize) {
 			set_bit_frame(j); //tell frame bitset this frame is in use
 		}
 		//get page
@@ -184,6 +186,139 @@ void identity_map_lfb(uint32_t location) { uint32_t j = location;
 		page->frame = j / 0x1000;
 		j += 0x1000;
 	}
+
+	lfb_base = location;
+	//nothing reads the framebuffer back, so stores may as well go out in bursts
+	if (pat_enabled()) {
+		lfb_set_cache(CACHE_WRITE_COMBINING);
+	}
+	else if (!mtrr_set_write_combining(location, VESA_LFB_MAP_SIZE)) {
+		printf_info("Framebuffer left uncached");
+	}
+}
+
+void lfb_set_cache(cache_type type) {
+	for (uint32_t j = lfb_base; j < lfb_base + VESA_LFB_MAP_SIZE; j += 0x1000) {
+		page_set_cache(get_page(j, 0, kernel_directory), type);
+		asm volatile("invlpg (%0)" : : "r"(j) : "memory");
+	}
+	//don't leave lines cached under the old type
+	asm volatile("wbinvd" : : : "memory");
+}
+
+//next free address in the MMIO window
+static uint32_t mmio_next = MMIO_WINDOW_START;
+
+void* map_mmio(uint32_t physical, uint32_t size) {
+	uint32_t offset = physical & 0xFFF;
+	uint32_t base = physical & ~0xFFF;
+	uint32_t pages = (offset + size + 0xFFF) / 0x1000;
+
+	if (mmio_next + pages * 0x1000 > MMIO_WINDOW_START + MMIO_WINDOW_SIZE) {
+		printf_err("map_mmio(): MMIO window exhausted mapping %x", physical);
+		return NULL;
+	}
+
+	uint32_t virt = mmio_next;
+	for (uint32_t i = 0; i < pages; i++) {
+		//tables in the window belong to kernel_directory and are linked
+		//into every other directory, so this mapping is visible everywhere
+		page_t* page = get_page(virt + i * 0x1000, 0, kernel_directory);
+		page->present = 1;
+		page->rw = 1;
+		page->user = 0;
+		page->frame = (base / 0x1000) + i;
+		//device registers have side effects, every access must reach them
+		page_set_cache(page, CACHE_UNCACHED);
+		asm volatile("invlpg (%0)" : : "r"(virt + i * 0x1000) : "memory");
+	}
+	mmio_next += pages * 0x1000;
+
+	return (void*)(virt + offset);
+}
+
+static bool mmap_page_free(uint32_t virt) {
+	page_t* page = get_page(virt, 0, current_directory);
+	return !page || !page->present;
+}
+
+//first fit search for a run of pages free pages in the mmap window of the current address space
+//returns 0 if there's no room
+static uint32_t mmap_window_find(uint32_t pages) {
+	if (!pages || pages > MMAP_WINDOW_SIZE / 0x1000) return 0;
+
+	uint32_t virt = 0;
+	uint32_t run = 0;
+	for (uint32_t addr = MMAP_WINDOW_START; addr < MMAP_WINDOW_START + MMAP_WINDOW_SIZE; addr += 0x1000) {
+		if (!mmap_page_free(addr)) {
+			run = 0;
+			continue;
+		}
+		if (!run) virt = addr;
+		if (++run == pages) return virt;
+	}
+	return 0;
+}
+
+static void mmap_window_set(uint32_t virt, uint32_t physical, bool writable) {
+	page_t* page = get_page(virt, 1, current_directory);
+	page->present = 1;
+	page->rw = writable;
+	page->user = 1;
+	page->frame = physical / 0x1000;
+	asm volatile("invlpg (%0)" : : "r"(virt) : "memory");
+}
+
+void* map_shared(uint32_t physical, uint32_t size) {
+	uint32_t offset = physical & 0xFFF;
+	uint32_t base = physical & ~0xFFF;
+	uint32_t pages = (offset + size + 0xFFF) / 0x1000;
+	if (!size) return NULL;
+
+	uint32_t virt = mmap_window_find(pages);
+	if (!virt) {
+		printf_err("map_shared(): no room to map %d pages", pages);
+		return NULL;
+	}
+	for (uint32_t i = 0; i < pages; i++) {
+		mmap_window_set(virt + i * 0x1000, base + i * 0x1000, false);
+	}
+	return (void*)(virt + offset);
+}
+
+void* map_frames(uint32_t* frames, uint32_t count, bool writable) {
+	uint32_t virt = mmap_window_find(count);
+	if (!virt) {
+		printf_err("map_frames(): no room to map %d pages", count);
+		return NULL;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		mmap_window_set(virt + i * 0x1000, frames[i], writable);
+	}
+	return (void*)virt;
+}
+
+void unmap_shared(void* virt, uint32_t size) {
+	uint32_t start = (uint32_t)virt & ~0xFFF;
+	uint32_t end = (uint32_t)virt + size;
+	if (start < MMAP_WINDOW_START || end > MMAP_WINDOW_START + MMAP_WINDOW_SIZE) return;
+
+	for (uint32_t addr = start; addr < end; addr += 0x1000) {
+		page_t* page = get_page(addr, 0, current_directory);
+		if (!page) continue;
+		//frame belongs to whoever we borrowed it from, so don't free it
+		page->present = 0;
+		page->frame = 0;
+		asm volatile("invlpg (%0)" : : "r"(addr) : "memory");
+	}
+}
+
+uint32_t virt_to_phys(uint32_t virt) {
+	page_t* page = get_page(virt, 0, current_directory);
+	if (!page || !page->present) {
+		return 0;
+	}
+	return (page->frame * 0x1000) + (virt & 0xFFF);
 }
 
 static void page_fault(registers_t regs);
@@ -218,16 +353,26 @@ void paging_install() {
 	memset(kernel_directory, 0, sizeof(page_directory_t));
 	kernel_directory->physicalAddr = (uint32_t)kernel_directory->tablesPhysical;
 
+    unsigned int i = 0;
+
+	//must come before any page is given a memory type
+	pat_install();
+
 	//identity map VESA LFB
-	uint32_t vesa_mem_addr = 0xFD000000; //TODO replace with function
+	uint32_t vesa_mem_addr = VESA_LFB_ADDRESS; //TODO replace with function
 	identity_map_lfb(vesa_mem_addr);
 
+	//create the page tables for the MMIO window now, before any directory
+	//is cloned from this one, so that every address space shares them
+	for (i = MMIO_WINDOW_START; i < MMIO_WINDOW_START + MMIO_WINDOW_SIZE; i += 0x1000) {
+		get_page(i, 1, kernel_directory);
+	}
+
 	//map pages in kernel heap area
 	//we call get_page but not alloc_frame
 	//this causes page_table_t's to be created where necessary
 	//don't alloc the frames yet, they need to be identity
 	//mapped below first.
-    unsigned int i = 0;
 	for (i = KHEAP_START; i < KHEAP_START + KHEAP_INITIAL_SIZE; i += 0x1000) {
 		get_page(i, 1, kernel_directory);
 	}
@@ -368,6 +513,9 @@ static page_table_t* clone_table(page_table_t* src, uint32_t* physAddr) {
 		table->pages[i].user = src->pages[i].user;
 		table->pages[i].accessed = src->pages[i].accessed;
 		table->pages[i].dirty = src->pages[i].dirty;
+		table->pages[i].pwt = src->pages[i].pwt;
+		table->pages[i].pcd = src->pages[i].pcd;
+		table->pages[i].pat = src->pages[i].pat;
 
 		//physically copy data across
 		extern void copy_page_physical(uint32_t page, uint32_t dest);
@@ -402,6 +550,13 @@ page_directory_t* clone_directory(page_directory_t* src) {
 			dir->tables[i] = src->tables[i];
 			dir->tablesPhysical[i] = src->tablesPhysical[i];
 		}
+		else if ((uint32_t)i >= MMAP_WINDOW_START / 0x400000 && (uint32_t)i < (MMAP_WINDOW_START + MMAP_WINDOW_SIZE) / 0x400000) {
+			//shared mappings keep pointing at the same frames
+			uint32_t phys;
+			dir->tables[i] = (page_table_t*)kmalloc_ap(sizeof(page_table_t), &phys);
+			memcpy(dir->tables[i], src->tables[i], sizeof(page_table_t));
+			dir->tablesPhysical[i] = phys | 0x07;
+		}
 		else {
 			//copy table
 			uint32_t phys;
@@ -9,9 +9,13 @@ typedef struct page {
 	uint32_t present	:  1; //page present in memory
 	uint32_t rw			:  1; //read-only if clear, readwrite if set
 	uint32_t user 		:  1; //kernel level only if clear
+	uint32_t pwt		:  1; //write-through caching, see pat.h for memory types
+	uint32_t pcd		:  1; //caching disabled
 	uint32_t accessed	:  1; //has page been accessed since last refresh?
 	uint32_t dirty		:  1; //has page been written to since last refresh?
-	uint32_t unused		:  7; //unused/reserved bits
+	uint32_t pat		:  1; //picks the upper half of the page attribute table
+	uint32_t global		:  1; //kept in the TLB across cr3 loads, if CR4.PGE is set
+	uint32_t unused		:  3; //available for our use
 	uint32_t frame		: 20; //frame address, shifted right 12 bits
 } page_t;
 
@@ -52,6 +56,45 @@ page_directory_t* get_cr3();
 //maps physical range to virtual memory
 void vmem_map(uint32_t virt, uint32_t physical);
 
+//where the VESA linear frame buffer is identity mapped at boot, and how many bytes of it
+#define VESA_LFB_ADDRESS	0xFD000000
+//the driver uses no more video memory than this, whatever the card has
+#define VESA_LFB_MAP_SIZE	0x1000000
+
+//virtual range reserved for device memory
+//starts a page table past 0xE0000000, where move_stack() puts the top page of the task stack
+#define MMIO_WINDOW_START	0xE0400000
+#define MMIO_WINDOW_SIZE	0x400000
+
+//maps size bytes of device memory at physical into the MMIO window, uncached
+//the mapping is shared by every address space
+//returns the virtual address of physical, or NULL if the window is full
+void* map_mmio(uint32_t physical, uint32_t size);
+
+//virtual range for shared read-only mappings of file memory
+//unlike the MMIO window, its page tables belong to each address space
+//it ends a page table short of 0xE0000000, the table holding each task's stack
+//must never be shared between address spaces
+#define MMAP_WINDOW_START	0xD0000000
+#define MMAP_WINDOW_SIZE	0x0FC00000
+
+//maps size bytes of memory at physical read-only into the current address space
+//the frames are shared with their owner, nothing is copied or allocated
+//returns the virtual address of physical, or NULL if there's no room
+void* map_shared(uint32_t physical, uint32_t size);
+
+//maps count frames, given by physical address, at consecutive addresses in the mmap window
+//of the current address space. writable mappings let every address space mapping them share writes
+//returns the virtual address of the first, or NULL if there's no room
+void* map_frames(uint32_t* frames, uint32_t count, bool writable);
+
+//removes a mapping made by map_shared or map_frames, the frames themselves aren't freed
+void unmap_shared(void* virt, uint32_t size);
+
+//translates a virtual address in the current address space to a physical one
+//returns 0 if virt isn't mapped
+uint32_t virt_to_phys(uint32_t virt);
+
 bool alloc_frame(page_t* page, int is_kernel, int is_writeable);
 void free_frame(page_t* page);
 
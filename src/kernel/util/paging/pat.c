@@ -0,0 +1,164 @@
+#include "pat.h"
+#include <std/printf.h>
+#include <kernel/util/fpu/fpu.h>
+
+#define MSR_MTRR_CAP		0xFE
+#define MSR_MTRR_PHYSBASE0	0x200	//base and mask of variable range n are at 0x200 + 2n and 0x201 + 2n
+#define MSR_PAT				0x277
+#define MSR_MTRR_DEF_TYPE	0x2FF
+
+#define MTRR_CAP_VCNT		0xFF		//number of variable ranges
+#define MTRR_CAP_WC			(1 << 10)	//write-combining is supported
+#define MTRR_MASK_VALID		(1 << 11)
+#define MTRR_DEF_TYPE_E		(1 << 11)	//MTRRs enabled
+
+//memory type encodings shared by the PAT and MTRRs
+#define MEM_TYPE_UC		0x00
+#define MEM_TYPE_WC		0x01
+#define MEM_TYPE_WT		0x04
+#define MEM_TYPE_WB		0x06
+#define MEM_TYPE_UC_MINUS	0x07
+
+//PAT entry picked by a page's PAT, PCD and PWT bits is (pat << 2) | (pcd << 1) | pwt
+//entries 0-3 keep their power on values, entry 4 becomes write-combining
+#define PAT_ENTRY(index, type) ((uint64_t)(type) << ((index) * 8))
+#define PAT_VALUE	(PAT_ENTRY(0, MEM_TYPE_WB) | PAT_ENTRY(1, MEM_TYPE_WT) | \
+					 PAT_ENTRY(2, MEM_TYPE_UC_MINUS) | PAT_ENTRY(3, MEM_TYPE_UC) | \
+					 PAT_ENTRY(4, MEM_TYPE_WC) | PAT_ENTRY(5, MEM_TYPE_WT) | \
+					 PAT_ENTRY(6, MEM_TYPE_UC_MINUS) | PAT_ENTRY(7, MEM_TYPE_UC))
+
+#define CR0_NW	(1 << 29)	//not write-through
+#define CR0_CD	(1 << 30)	//cache disable
+
+#define EFLAGS_IF (1 << 9)
+
+static bool pat_on = false;
+
+static uint64_t rdmsr(uint32_t msr) {
+	uint32_t lo, hi;
+	asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+static void wrmsr(uint32_t msr, uint64_t value) {
+	asm volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)) : "memory");
+}
+
+//in paging.c
+extern uint32_t get_cr0();
+extern void set_cr0(uint32_t cr0);
+
+static void flush_tlb() {
+	uint32_t cr3;
+	asm volatile("mov %%cr3, %0\n"
+				 "mov %0, %%cr3\n"
+				 : "=r"(cr3) : : "memory");
+}
+
+//memory types mustn't change while lines of the old type are cached
+//so caching is turned off and flushed around the update, as the SDM describes
+static uint32_t cache_update_begin() {
+	uint32_t eflags;
+	asm volatile("pushfl\n"
+				 "popl %0\n"
+				 "cli\n"
+				 : "=r"(eflags));
+	set_cr0((get_cr0() | CR0_CD) & ~CR0_NW);
+	asm volatile("wbinvd" : : : "memory");
+	flush_tlb();
+	return eflags;
+}
+
+static void cache_update_end(uint32_t eflags) {
+	asm volatile("wbinvd" : : : "memory");
+	flush_tlb();
+	set_cr0(get_cr0() & ~(CR0_CD | CR0_NW));
+	if (eflags & EFLAGS_IF) {
+		asm volatile("sti");
+	}
+}
+
+void pat_install() {
+	if (!cpu_has(CPUID_FEAT_EDX_PAT)) {
+		printf_info("No PAT, framebuffer can't be mapped write-combining by page");
+		return;
+	}
+
+	uint32_t eflags = cache_update_begin();
+	wrmsr(MSR_PAT, PAT_VALUE);
+	cache_update_end(eflags);
+	pat_on = true;
+}
+
+bool pat_enabled() {
+	return pat_on;
+}
+
+void page_set_cache(page_t* page, cache_type type) {
+	page->pat = 0;
+	switch (type) {
+		case CACHE_WRITE_BACK:
+			page->pcd = 0;
+			page->pwt = 0;
+			break;
+		case CACHE_WRITE_THROUGH:
+			page->pcd = 0;
+			page->pwt = 1;
+			break;
+		case CACHE_WRITE_COMBINING:
+			//entry 4 with a PAT, otherwise entry 0 leaves the type to the MTRRs
+			page->pat = pat_on;
+			page->pcd = 0;
+			page->pwt = 0;
+			break;
+		case CACHE_UNCACHED:
+		default:
+			page->pcd = 1;
+			page->pwt = 1;
+			break;
+	}
+}
+
+//bits of physical address the cpu implements, for the width of MTRR masks
+static int physical_address_bits() {
+	uint32_t eax, ebx, ecx, edx;
+	asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0x80000000));
+	if (eax < 0x80000008) return 36;
+	asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0x80000008));
+	return eax & 0xFF;
+}
+
+bool mtrr_set_write_combining(uint32_t physical, uint32_t size) {
+	if (!cpu_has(CPUID_FEAT_EDX_MTRR)) return false;
+	if (size < 0x1000 || (size & (size - 1)) || (physical & (size - 1))) return false;
+
+	uint64_t cap = rdmsr(MSR_MTRR_CAP);
+	if (!(cap & MTRR_CAP_WC)) return false;
+
+	//find a range the firmware left unused
+	int count = cap & MTRR_CAP_VCNT;
+	int free = -1;
+	for (int i = 0; i < count; i++) {
+		if (!(rdmsr(MSR_MTRR_PHYSBASE0 + i * 2 + 1) & MTRR_MASK_VALID)) {
+			free = i;
+			break;
+		}
+	}
+	if (free < 0) {
+		printf_err("mtrr_set_write_combining(): all %d variable MTRRs in use", count);
+		return false;
+	}
+
+	uint64_t address_mask = (1ULL << physical_address_bits()) - 1;
+	uint64_t base = physical | MEM_TYPE_WC;
+	uint64_t mask = (~(uint64_t)(size - 1) & address_mask & ~0xFFFULL) | MTRR_MASK_VALID;
+
+	uint32_t eflags = cache_update_begin();
+	uint64_t def_type = rdmsr(MSR_MTRR_DEF_TYPE);
+	wrmsr(MSR_MTRR_DEF_TYPE, def_type & ~MTRR_DEF_TYPE_E);
+	wrmsr(MSR_MTRR_PHYSBASE0 + free * 2, base);
+	wrmsr(MSR_MTRR_PHYSBASE0 + free * 2 + 1, mask);
+	wrmsr(MSR_MTRR_DEF_TYPE, def_type);
+	cache_update_end(eflags);
+	return true;
+}
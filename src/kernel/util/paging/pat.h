@@ -0,0 +1,38 @@
+#ifndef PAT_H
+#define PAT_H
+
+#include <std/std.h>
+#include "paging.h"
+
+//memory types a page can be given
+typedef enum cache_type {
+	CACHE_WRITE_BACK = 0,
+	CACHE_WRITE_THROUGH,
+	CACHE_UNCACHED,
+	//stores are buffered and sent in bursts, reads are uncached
+	//for memory nothing else reads or writes behind the cpu's back, such as framebuffers
+	CACHE_WRITE_COMBINING,
+} cache_type;
+
+//reprograms the page attribute table so pages can be made write-combining
+//the types reachable without the PAT bit are left as they were, so existing mappings keep their meaning
+//does nothing on cpus without a PAT
+void pat_install();
+
+//true once pat_install has made write-combining pages possible
+bool pat_enabled();
+
+//sets the memory type of page, takes effect once its TLB entry is flushed
+//without a PAT, write-combining pages take whatever type the MTRRs give their memory
+void page_set_cache(page_t* page, cache_type type);
+
+//makes size bytes of physical memory from physical write-combining with a variable MTRR, for cpus without a PAT
+//size must be a power of two at least 4kb, and physical a multiple of it
+//returns false if the cpu has no free MTRR which can do write-combining
+bool mtrr_set_write_combining(uint32_t physical, uint32_t size);
+
+//changes the memory type of the whole VESA LFB mapping, defined in paging.c
+//it's write-combining from boot where the cpu allows, this is for comparing against other types
+void lfb_set_cache(cache_type type);
+
+#endif
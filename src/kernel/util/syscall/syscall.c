@@ -8,14 +8,15 @@
 
 #define MAX_SYSCALLS 128 
 
-static void sys_handler(registers_t regs);
+static void sys_handler(registers_t* regs);
 
 array_m* syscalls;
 
 void sys_install() {
 	printf_info("Initializing syscalls...");
 	
-	register_interrupt_handler(0x80, (isr_t)sys_handler);
+	//the return value is passed back in the caller's eax, so this needs the saved frame itself
+	register_interrupt_frame_handler(0x80, sys_handler);
 	syscalls = array_m_create(MAX_SYSCALLS);
 	create_sysfuncs();
 }
@@ -33,34 +34,19 @@ void sys_insert(void* syscall) {
 	array_m_insert(syscalls, syscall);
 }
 
-void sys_handler(registers_t regs) {
+void sys_handler(registers_t* regs) {
 	//check requested syscall number
 	//stored in eax
-	if (!syscalls || regs.eax >= MAX_SYSCALLS) {
-		printf_err("Syscall %d called but not defined", regs.eax);
+	if (!syscalls || regs->eax >= (uint32_t)syscalls->size) {
+		printf_err("Syscall %d called but not defined", regs->eax);
+		regs->eax = -1;
 		return;
 	}
 
 	//location of syscall funcptr
-	int (*location)() = (int(*)())array_m_lookup(syscalls, regs.eax);
-
-	//we don't know how many arguments the function wants.
-	//so just push them all on the stack in correct order
-	//the function will use whatever it wants, and we can just
-	//pop it all back off afterwards
-	int ret;
-	asm volatile("		\
-		push %1;	\
-		push %2;	\
-		push %3;	\
-		push %4;	\
-		push %5;	\
-		call *%6;	\
-		pop %%ebx;	\
-		pop %%ebx;	\
-		pop %%ebx;	\
-		pop %%ebx;	\
-		pop %%ebx;	\
-	" : "=a" (ret) : "r" (regs.edi), "r" (regs.esi), "r" (regs.edx), "r" (regs.ecx), "r" (regs.ebx), "r" (location));
-	regs.eax = ret;
+	//we don't know how many arguments the function wants,
+	//so pass all of them in order. cdecl leaves cleaning up the stack to us,
+	//so the function will use whatever it wants and ignore the rest
+	int (*location)(uint32_t, uint32_t, uint32_t, uint32_t, uint32_t) = array_m_lookup(syscalls, regs->eax);
+	regs->eax = location(regs->ebx, regs->ecx, regs->edx, regs->esi, regs->edi);
 }
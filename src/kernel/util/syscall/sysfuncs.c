@@ -19,10 +19,47 @@ DEFN_SYSCALL1(terminal_writestring, 0, const char*);
 DEFN_SYSCALL1(terminal_putchar, 1, char);
 DEFN_SYSCALL1(yield, 2, task_state);
 DEFN_SYSCALL3(read, 3, int, void*, size_t);
+DEFN_SYSCALL3(write, 4, int, void*, size_t);
+DEFN_SYSCALL2(open, 5, const char*, int);
+DEFN_SYSCALL1(close, 6, int);
+DEFN_SYSCALL3(lseek, 7, int, int, int);
+DEFN_SYSCALL1(dup, 8, int);
+DEFN_SYSCALL1(pipe, 9, int*);
+DEFN_SYSCALL1(shm_create, 10, uint32_t);
+DEFN_SYSCALL1(shm_map, 11, int);
+DEFN_SYSCALL2(shm_unmap, 12, int, void*);
+DEFN_SYSCALL1(shm_destroy, 13, int);
+DEFN_SYSCALL1(ipc_port_create, 14, const char*);
+DEFN_SYSCALL1(ipc_port_lookup, 15, const char*);
+DEFN_SYSCALL3(ipc_send, 16, int, ipc_message_t*, ipc_message_t*);
+DEFN_SYSCALL2(ipc_receive, 17, int, ipc_message_t*);
+DEFN_SYSCALL3(ipc_reply, 18, int, int, ipc_message_t*);
+DEFN_SYSCALL1(ipc_port_destroy, 19, int);
+DEFN_SYSCALL1(io_ring_setup, 20, uint32_t);
+DEFN_SYSCALL2(io_ring_enter, 21, uint32_t, uint32_t);
 
 void create_sysfuncs() {
+	//order must match the numbers given above
 	sys_insert((void*)&terminal_writestring);
 	sys_insert((void*)&terminal_putchar);
 	sys_insert((void*)&yield);
-	// sys_insert((void*)&read);
+	sys_insert((void*)&read);
+	sys_insert((void*)&write);
+	sys_insert((void*)&open);
+	sys_insert((void*)&close);
+	sys_insert((void*)&lseek);
+	sys_insert((void*)&dup);
+	sys_insert((void*)&pipe);
+	sys_insert((void*)&shm_create);
+	sys_insert((void*)&shm_map);
+	sys_insert((void*)&shm_unmap);
+	sys_insert((void*)&shm_destroy);
+	sys_insert((void*)&ipc_port_create);
+	sys_insert((void*)&ipc_port_lookup);
+	sys_insert((void*)&ipc_send);
+	sys_insert((void*)&ipc_receive);
+	sys_insert((void*)&ipc_reply);
+	sys_insert((void*)&ipc_port_destroy);
+	sys_insert((void*)&io_ring_setup);
+	sys_insert((void*)&io_ring_enter);
 }
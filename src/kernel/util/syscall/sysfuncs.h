@@ -4,6 +4,10 @@
 #include "syscall.h"
 #include <kernel/util/multitasking/tasks/task.h>
 #include <kernel/util/vfs/fs.h>
+#include <kernel/util/vfs/fd.h>
+#include <kernel/util/ipc/shm.h>
+#include <kernel/util/ipc/ipc.h>
+#include <kernel/util/ipc/io_ring.h>
 
 //installs common syscalls into syscall table
 void create_sysfuncs();
@@ -22,4 +26,40 @@ DECL_SYSCALL1(yield, task_state);
 //reads at most count characters into buf using file descriptor fd
 DECL_SYSCALL3(read, int, void*, size_t);
 
+//writes count characters from buf to file descriptor fd
+DECL_SYSCALL3(write, int, void*, size_t);
+
+//opens path, flags are O_* from kernel/util/vfs/fd.h
+//returns lowest free file descriptor, or -1
+DECL_SYSCALL2(open, const char*, int);
+
+DECL_SYSCALL1(close, int);
+
+//moves fd's offset, returns the new offset
+DECL_SYSCALL3(lseek, int, int, int);
+
+//returns a new descriptor sharing fd's offset
+DECL_SYSCALL1(dup, int);
+
+//fills in read and write descriptors for a new pipe
+DECL_SYSCALL1(pipe, int*);
+
+//shared memory regions, see kernel/util/ipc/shm.h
+DECL_SYSCALL1(shm_create, uint32_t);
+DECL_SYSCALL1(shm_map, int);
+DECL_SYSCALL2(shm_unmap, int, void*);
+DECL_SYSCALL1(shm_destroy, int);
+
+//synchronous message passing, see kernel/util/ipc/ipc.h
+DECL_SYSCALL1(ipc_port_create, const char*);
+DECL_SYSCALL1(ipc_port_lookup, const char*);
+DECL_SYSCALL3(ipc_send, int, ipc_message_t*, ipc_message_t*);
+DECL_SYSCALL2(ipc_receive, int, ipc_message_t*);
+DECL_SYSCALL3(ipc_reply, int, int, ipc_message_t*);
+DECL_SYSCALL1(ipc_port_destroy, int);
+
+//asynchronous submission/completion rings, see kernel/util/ipc/io_ring.h
+DECL_SYSCALL1(io_ring_setup, uint32_t);
+DECL_SYSCALL2(io_ring_enter, uint32_t, uint32_t);
+
 #endif
@@ -0,0 +1,456 @@
+#include "bcache.h"
+#include <std/math.h>
+#include <std/kheap.h>
+#include <kernel/util/mutex/mutex.h>
+#include <kernel/util/multitasking/tasks/task.h>
+#include <kernel/drivers/rtc/clock.h>
+
+#define BCACHE_HASH_SIZE 1024
+
+//per-device state used to detect sequential access
+typedef struct readahead_state {
+	uint32_t next_block;	//block we expect to be asked for if access is sequential
+	uint32_t window;		//number of blocks fetched on the last miss
+} readahead_state_t;
+
+static bcache_buf_t bufs[BCACHE_MAX_BUFS];
+static bcache_buf_t* hash_table[BCACHE_HASH_SIZE];
+static readahead_state_t readahead[MAX_BLOCK_DEVICES];
+//bounce buffer so a read-ahead is a single device request
+//only one read-ahead uses it at a time, misses meanwhile just read their own block
+static uint8_t* readahead_buf = 0;
+static bool readahead_buf_busy = false;
+static uint32_t clock_hand = 0;
+//guards the buffer table, hash and flags. never held across device I/O,
+//buffers with I/O in flight are marked BCACHE_BUSY or BCACHE_WRITEBACK instead
+static lock_t* bcache_lock = 0;
+
+static uint32_t bcache_hash(block_device_t* dev, uint32_t block) {
+	return ((block * 2654435761u) ^ dev->id) % BCACHE_HASH_SIZE;
+}
+
+static uint32_t sectors_per_block(block_device_t* dev) {
+	return BCACHE_BLOCK_SIZE / dev->sector_size;
+}
+
+static uint32_t block_count(block_device_t* dev) {
+	uint32_t spb = sectors_per_block(dev);
+	return (dev->sector_count + spb - 1) / spb;
+}
+
+//number of sectors backing block, which is less than a full block at the end of the device
+static uint32_t block_sectors(block_device_t* dev, uint32_t block) {
+	uint32_t spb = sectors_per_block(dev);
+	return MIN(spb, dev->sector_count - block * spb);
+}
+
+//partitions are cached as the part of their disk they cover, so each sector has one buffer
+//however it is reached. returns the disk, with *offset moved from the partition's start to the disk's
+static block_device_t* bcache_backing(block_device_t* dev, uint32_t* offset) {
+	while (dev->parent) {
+		*offset += dev->start_lba * dev->sector_size;
+		dev = dev->parent;
+	}
+	return dev;
+}
+
+//whether buf holds any of dev, which may be a partition of the disk buf belongs to
+static bool bcache_buf_of(bcache_buf_t* buf, block_device_t* dev) {
+	uint32_t start = 0;
+	block_device_t* disk = bcache_backing(dev, &start);
+	if (buf->dev != disk) return false;
+	if (disk == dev) return true;
+
+	uint64_t first = (uint64_t)buf->block * BCACHE_BLOCK_SIZE;
+	uint64_t end = (uint64_t)start + (uint64_t)dev->sector_count * dev->sector_size;
+	return first + BCACHE_BLOCK_SIZE > start && first < end;
+}
+
+static bcache_buf_t* bcache_lookup_locked(block_device_t* dev, uint32_t block) {
+	bcache_buf_t* buf = hash_table[bcache_hash(dev, block)];
+	while (buf) {
+		if (buf->dev == dev && buf->block == block) {
+			return buf;
+		}
+		buf = buf->hash_next;
+	}
+	return NULL;
+}
+
+static void bcache_hash_insert(bcache_buf_t* buf) {
+	uint32_t idx = bcache_hash(buf->dev, buf->block);
+	buf->hash_next = hash_table[idx];
+	hash_table[idx] = buf;
+}
+
+static void bcache_hash_remove(bcache_buf_t* buf) {
+	bcache_buf_t** link = &hash_table[bcache_hash(buf->dev, buf->block)];
+	while (*link) {
+		if (*link == buf) {
+			*link = buf->hash_next;
+			break;
+		}
+		link = &(*link)->hash_next;
+	}
+	buf->hash_next = NULL;
+}
+
+//sleeps until the I/O in flight on buf finishes
+//bcache_lock is dropped meanwhile, so anything looked up before must be checked again
+static void bcache_wait_locked(bcache_buf_t* buf) {
+	unlock(bcache_lock);
+	kernel_begin_critical();
+	if (buf->flags & (BCACHE_BUSY | BCACHE_WRITEBACK)) {
+		wait_queue_sleep(&buf->waiters);
+	}
+	kernel_end_critical();
+	lock(bcache_lock);
+}
+
+//clears the I/O flags in done and wakes whoever was waiting on them
+static void bcache_io_done_locked(bcache_buf_t* buf, uint32_t done) {
+	kernel_begin_critical();
+	buf->flags &= ~done;
+	wait_queue_wake(&buf->waiters);
+	kernel_end_critical();
+}
+
+//writes buf back if it's dirty, dropping bcache_lock during the write
+//the buffer is pinned meanwhile, and can be modified again, which just dirties it again
+static int bcache_writeback_locked(bcache_buf_t* buf) {
+	//someone else is already writing it, their write may predate our caller's changes
+	while (buf->flags & BCACHE_WRITEBACK) {
+		bcache_wait_locked(buf);
+	}
+	if (!buf->dev || !(buf->flags & BCACHE_DIRTY)) return 0;
+
+	block_device_t* dev = buf->dev;
+	uint32_t block = buf->block;
+	buf->refcount++;
+	buf->flags |= BCACHE_WRITEBACK;
+	buf->flags &= ~BCACHE_DIRTY;
+	unlock(bcache_lock);
+
+	int err = block_write(dev, block * sectors_per_block(dev), block_sectors(dev, block), buf->data);
+
+	lock(bcache_lock);
+	if (err) {
+		printf_err("bcache: writeback of %s block %d failed (%d)", dev->name, block, err);
+		buf->flags |= BCACHE_DIRTY;
+	}
+	buf->refcount--;
+	bcache_io_done_locked(buf, BCACHE_WRITEBACK);
+	return err;
+}
+
+//find a buffer to reuse with the CLOCK algorithm
+//buffers used since the hand last passed get a second chance
+static bcache_buf_t* bcache_alloc_locked() {
+	for (int i = 0; i < BCACHE_MAX_BUFS * 2; i++) {
+		bcache_buf_t* buf = &bufs[clock_hand];
+		clock_hand = (clock_hand + 1) % BCACHE_MAX_BUFS;
+
+		if (buf->refcount || (buf->flags & (BCACHE_BUSY | BCACHE_WRITEBACK))) continue;
+		if (buf->flags & BCACHE_REFERENCED) {
+			buf->flags &= ~BCACHE_REFERENCED;
+			continue;
+		}
+		//dirty victims must hit the disk before we can reuse them
+		if (buf->flags & BCACHE_DIRTY) {
+			if (bcache_writeback_locked(buf)) continue;
+			//the lock was dropped for the write, someone may have started using it
+			if (buf->refcount || (buf->flags & (BCACHE_BUSY | BCACHE_WRITEBACK | BCACHE_DIRTY | BCACHE_REFERENCED))) continue;
+		}
+
+		if (buf->dev) {
+			bcache_hash_remove(buf);
+		}
+		//pages are only allocated the first time a buffer is used
+		if (!buf->data) {
+			buf->data = kmalloc_a(BCACHE_BLOCK_SIZE);
+		}
+		buf->dev = NULL;
+		buf->flags = 0;
+		buf->dirty_date = 0;
+		return buf;
+	}
+	printf_err("bcache: every buffer is in use!");
+	return NULL;
+}
+
+//decide how many blocks to fetch on a miss of block
+//sequential misses double the window, anything else resets it
+static uint32_t bcache_readahead_window(block_device_t* dev, uint32_t block) {
+	readahead_state_t* ra = &readahead[dev->id];
+	if (block == ra->next_block && ra->window) {
+		ra->window = MIN(ra->window * 2, BCACHE_MAX_READAHEAD);
+	}
+	else {
+		ra->window = 1;
+	}
+
+	//don't read past the end of the device or over blocks we already have
+	uint32_t count = 1;
+	uint32_t max = MIN(ra->window, block_count(dev) - block);
+	while (count < max && !bcache_lookup_locked(dev, block + count)) {
+		count++;
+	}
+	return count;
+}
+
+//sets up the free buffer buf to hold block and pins it
+//if fill is set, the block is read from the device along with any read-ahead
+//the buffer is marked busy and bcache_lock dropped while the read is in flight
+static bcache_buf_t* bcache_fill_locked(bcache_buf_t* buf, block_device_t* dev, uint32_t block, bool fill) {
+	buf->refcount = 1;
+	buf->dev = dev;
+	buf->block = block;
+	buf->flags = BCACHE_VALID | BCACHE_REFERENCED;
+	if (!fill) {
+		bcache_hash_insert(buf);
+		return buf;
+	}
+	//others who want this block wait for it rather than reading it again
+	buf->flags = BCACHE_BUSY | BCACHE_REFERENCED;
+	bcache_hash_insert(buf);
+
+	uint32_t count = bcache_readahead_window(dev, block);
+	if (readahead_buf_busy) count = 1;
+	if (count > 1) readahead_buf_busy = true;
+
+	uint32_t spb = sectors_per_block(dev);
+	uint32_t sectors = (count - 1) * spb + block_sectors(dev, block + count - 1);
+	uint8_t* dest = count > 1 ? readahead_buf : buf->data;
+	unlock(bcache_lock);
+
+	//zero so a short block at the end of the device has no stale data
+	memset(dest, 0, count * BCACHE_BLOCK_SIZE);
+	int err = block_read(dev, block * spb, sectors, dest);
+	if (!err && count > 1) {
+		memcpy(buf->data, readahead_buf, BCACHE_BLOCK_SIZE);
+	}
+
+	lock(bcache_lock);
+	if (err) {
+		printf_err("bcache: read of %s block %d failed (%d)", dev->name, block, err);
+		//waiters see the buffer no longer holds their block and look it up again
+		bcache_hash_remove(buf);
+		buf->dev = NULL;
+		buf->refcount--;
+		if (count > 1) readahead_buf_busy = false;
+		bcache_io_done_locked(buf, BCACHE_BUSY | BCACHE_REFERENCED);
+		return NULL;
+	}
+	buf->flags |= BCACHE_VALID;
+	bcache_io_done_locked(buf, BCACHE_BUSY);
+
+	//populate read-ahead blocks
+	//they aren't marked referenced so they are evicted first if never used
+	for (uint32_t i = 1; i < count; i++) {
+		if (bcache_lookup_locked(dev, block + i)) continue;
+		bcache_buf_t* ahead = bcache_alloc_locked();
+		if (!ahead) break;
+		//the lock may have been dropped to write back a victim
+		if (bcache_lookup_locked(dev, block + i)) continue;
+
+		memcpy(ahead->data, readahead_buf + i * BCACHE_BLOCK_SIZE, BCACHE_BLOCK_SIZE);
+		ahead->dev = dev;
+		ahead->block = block + i;
+		ahead->flags = BCACHE_VALID;
+		bcache_hash_insert(ahead);
+	}
+	if (count > 1) readahead_buf_busy = false;
+	return buf;
+}
+
+static bcache_buf_t* bcache_get_int(block_device_t* dev, uint32_t block, bool fill) {
+	if (!dev || block >= block_count(dev)) return NULL;
+
+	lock(bcache_lock);
+	bcache_buf_t* buf;
+	while (1) {
+		buf = bcache_lookup_locked(dev, block);
+		if (buf) {
+			buf->refcount++;
+			buf->flags |= BCACHE_REFERENCED;
+			//someone else is reading it in, wait for them instead of the device
+			while (buf->flags & BCACHE_BUSY) {
+				bcache_wait_locked(buf);
+			}
+			if (buf->dev == dev && buf->block == block) break;
+			//their read failed, try again ourselves
+			buf->refcount--;
+			continue;
+		}
+
+		buf = bcache_alloc_locked();
+		if (!buf) break;
+		//allocating may have dropped the lock to write back a victim, so look again
+		//the buffer we got stays free for someone else
+		if (bcache_lookup_locked(dev, block)) continue;
+		buf = bcache_fill_locked(buf, dev, block, fill);
+		break;
+	}
+	readahead[dev->id].next_block = block + 1;
+	unlock(bcache_lock);
+
+	return buf;
+}
+
+bcache_buf_t* bcache_get(block_device_t* dev, uint32_t block) {
+	return bcache_get_int(dev, block, true);
+}
+
+void bcache_release(bcache_buf_t* buf) {
+	if (!buf) return;
+
+	lock(bcache_lock);
+	if (buf->refcount) {
+		buf->refcount--;
+	}
+	unlock(bcache_lock);
+}
+
+void bcache_mark_dirty(bcache_buf_t* buf) {
+	if (!buf) return;
+
+	lock(bcache_lock);
+	if (!(buf->flags & BCACHE_DIRTY)) {
+		buf->dirty_date = time();
+	}
+	buf->flags |= BCACHE_DIRTY;
+	unlock(bcache_lock);
+}
+
+//clamp a transfer of size bytes at offset to the end of dev
+static uint32_t bcache_clamp(block_device_t* dev, uint32_t offset, uint32_t size) {
+	uint64_t dev_size = (uint64_t)dev->sector_count * dev->sector_size;
+	if (offset >= dev_size) return 0;
+	if (offset + (uint64_t)size > dev_size) {
+		size = dev_size - offset;
+	}
+	return size;
+}
+
+uint32_t bcache_read(block_device_t* dev, uint32_t offset, uint32_t size, uint8_t* buffer) {
+	if (!dev) return 0;
+	size = bcache_clamp(dev, offset, size);
+	dev = bcache_backing(dev, &offset);
+
+	uint32_t done = 0;
+	while (done < size) {
+		uint32_t block = (offset + done) / BCACHE_BLOCK_SIZE;
+		uint32_t block_off = (offset + done) % BCACHE_BLOCK_SIZE;
+		uint32_t chunk = MIN(size - done, BCACHE_BLOCK_SIZE - block_off);
+
+		bcache_buf_t* buf = bcache_get(dev, block);
+		if (!buf) break;
+		memcpy(buffer + done, buf->data + block_off, chunk);
+		bcache_release(buf);
+
+		done += chunk;
+	}
+	return done;
+}
+
+uint32_t bcache_write(block_device_t* dev, uint32_t offset, uint32_t size, uint8_t* buffer) {
+	if (!dev || !dev->write) return 0;
+	size = bcache_clamp(dev, offset, size);
+	dev = bcache_backing(dev, &offset);
+
+	uint32_t done = 0;
+	while (done < size) {
+		uint32_t block = (offset + done) / BCACHE_BLOCK_SIZE;
+		uint32_t block_off = (offset + done) % BCACHE_BLOCK_SIZE;
+		uint32_t chunk = MIN(size - done, BCACHE_BLOCK_SIZE - block_off);
+
+		//no need to read a block we're about to overwrite entirely
+		bool whole = (block_off == 0 && chunk == BCACHE_BLOCK_SIZE);
+		bcache_buf_t* buf = bcache_get_int(dev, block, !whole);
+		if (!buf) break;
+		memcpy(buf->data + block_off, buffer + done, chunk);
+		bcache_mark_dirty(buf);
+		bcache_release(buf);
+
+		done += chunk;
+	}
+	return done;
+}
+
+int bcache_sync(block_device_t* dev) {
+	int err = 0;
+
+	lock(bcache_lock);
+	for (int i = 0; i < BCACHE_MAX_BUFS; i++) {
+		bcache_buf_t* buf = &bufs[i];
+		if (!buf->dev || (dev && !bcache_buf_of(buf, dev))) continue;
+		if (bcache_writeback_locked(buf)) {
+			err = -1;
+		}
+	}
+	unlock(bcache_lock);
+
+	//only now ask devices to commit their write caches
+	if (dev) {
+		if (block_flush(dev)) err = -1;
+	}
+	else {
+		for (uint32_t i = 0; i < block_device_count(); i++) {
+			if (block_flush(block_device_get(i))) err = -1;
+		}
+	}
+	return err;
+}
+
+void bcache_invalidate(block_device_t* dev) {
+	lock(bcache_lock);
+	for (int i = 0; i < BCACHE_MAX_BUFS; i++) {
+		bcache_buf_t* buf = &bufs[i];
+		if (!buf->dev || !bcache_buf_of(buf, dev)) continue;
+		if (buf->refcount || (buf->flags & (BCACHE_DIRTY | BCACHE_BUSY | BCACHE_WRITEBACK))) continue;
+
+		bcache_hash_remove(buf);
+		buf->dev = NULL;
+		buf->flags = 0;
+	}
+	uint32_t start = 0;
+	readahead[bcache_backing(dev, &start)->id].window = 0;
+	unlock(bcache_lock);
+}
+
+//write back blocks which have been dirty for too long
+//the device write cache is left alone, that only happens on sync
+static void bcache_flush_expired() {
+	lock(bcache_lock);
+	uint32_t now = time();
+	for (int i = 0; i < BCACHE_MAX_BUFS; i++) {
+		bcache_buf_t* buf = &bufs[i];
+		if (!(buf->flags & BCACHE_DIRTY)) continue;
+		if (now - buf->dirty_date < BCACHE_DIRTY_EXPIRE) continue;
+
+		bcache_writeback_locked(buf);
+	}
+	unlock(bcache_lock);
+}
+
+static void bflush() {
+	while (1) {
+		sleep(BCACHE_FLUSH_INTERVAL);
+		bcache_flush_expired();
+	}
+}
+
+void bcache_install() {
+	printf_info("Initializing block cache...");
+
+	bcache_lock = lock_create();
+	readahead_buf = kmalloc_a(BCACHE_BLOCK_SIZE * BCACHE_MAX_READAHEAD);
+	memset(bufs, 0, sizeof(bufs));
+	memset(hash_table, 0, sizeof(hash_table));
+	memset(readahead, 0, sizeof(readahead));
+
+	//background writeback of dirty blocks
+	if (!fork("bflush")) {
+		bflush();
+	}
+}
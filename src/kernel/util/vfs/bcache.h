@@ -0,0 +1,61 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include <std/std.h>
+#include "block.h"
+#include <kernel/util/multitasking/tasks/wait.h>
+
+//size of a cached block. one page, so buffers can later be mapped directly
+#define BCACHE_BLOCK_SIZE 0x1000
+//maximum number of blocks held in memory at once
+#define BCACHE_MAX_BUFS 512
+//maximum number of blocks fetched by a single read-ahead
+#define BCACHE_MAX_READAHEAD 16u
+//how often the flusher task wakes up, and how long a block may stay dirty
+#define BCACHE_FLUSH_INTERVAL 1000
+#define BCACHE_DIRTY_EXPIRE 5000
+
+#define BCACHE_VALID		0x01 //data matches (or is newer than) the device
+#define BCACHE_DIRTY		0x02 //data must be written back before eviction
+#define BCACHE_REFERENCED	0x04 //used since the clock hand last passed
+#define BCACHE_BUSY			0x08 //being read from the device, data isn't there yet
+#define BCACHE_WRITEBACK	0x10 //being written to the device
+
+typedef struct bcache_buf {
+	block_device_t* dev;
+	uint32_t block;			//block number, in units of BCACHE_BLOCK_SIZE
+	uint8_t* data;
+	uint32_t flags;
+	uint32_t refcount;		//buffers in use are never evicted
+	uint32_t dirty_date;	//tick count when buffer was first dirtied
+	wait_queue_t waiters;	//tasks waiting for the device I/O on this buffer to finish
+	struct bcache_buf* hash_next;
+} bcache_buf_t;
+
+//set up the buffer pool and start the background flusher task
+void bcache_install();
+
+//returns the buffer holding block of dev, reading it from the device if necessary
+//dev must be a whole disk, partitions are cached through their disk
+//the buffer is pinned until bcache_release is called
+//returns NULL on device error or if every buffer is pinned
+bcache_buf_t* bcache_get(block_device_t* dev, uint32_t block);
+void bcache_release(bcache_buf_t* buf);
+//mark a pinned buffer as modified so it will be written back
+void bcache_mark_dirty(bcache_buf_t* buf);
+
+//byte-granular access to a block device through the cache
+//partitions share the buffers of the disk they are on
+//returns number of bytes transferred
+uint32_t bcache_read(block_device_t* dev, uint32_t offset, uint32_t size, uint8_t* buffer);
+uint32_t bcache_write(block_device_t* dev, uint32_t offset, uint32_t size, uint8_t* buffer);
+
+//write back every dirty block of dev (or of all devices if dev is NULL)
+//and flush the devices' write caches
+//returns 0 on success
+int bcache_sync(block_device_t* dev);
+
+//drop every clean, unpinned block of dev from the cache
+void bcache_invalidate(block_device_t* dev);
+
+#endif
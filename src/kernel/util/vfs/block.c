@@ -0,0 +1,110 @@
+#include "block.h"
+#include "partition.h"
+#include "devfs.h"
+#include <std/array_m.h>
+
+static array_m* block_devices = 0;
+
+bool block_device_register(block_device_t* dev) {
+	if (!block_devices) {
+		block_devices = array_m_create(MAX_BLOCK_DEVICES);
+	}
+	if (block_devices->size >= MAX_BLOCK_DEVICES) {
+		printf_err("Not registering block device %s, too many in use!", dev->name);
+		return false;
+	}
+
+	dev->id = block_devices->size;
+	array_m_insert(block_devices, dev);
+
+	printf_info("Registered block device %s (%d sectors of %d bytes)", dev->name, dev->sector_count, dev->sector_size);
+	devfs_register_block_device(dev);
+
+	if (!dev->parent) {
+		partition_scan(dev);
+	}
+	return true;
+}
+
+//partitions forward requests to their disk, offset by the partition start
+static int partition_read(block_device_t* dev, uint32_t lba, uint32_t count, uint8_t* buffer) {
+	return block_read(dev->parent, dev->start_lba + lba, count, buffer);
+}
+
+static int partition_write(block_device_t* dev, uint32_t lba, uint32_t count, uint8_t* buffer) {
+	return block_write(dev->parent, dev->start_lba + lba, count, buffer);
+}
+
+static int partition_flush(block_device_t* dev) {
+	return block_flush(dev->parent);
+}
+
+block_device_t* block_partition_register(block_device_t* parent, int index, uint32_t start, uint32_t count) {
+	if (start >= parent->sector_count || count > parent->sector_count - start) {
+		printf_err("Partition %d of %s lies outside the disk", index, parent->name);
+		return NULL;
+	}
+
+	block_device_t* dev = kmalloc(sizeof(block_device_t));
+	memset(dev, 0, sizeof(block_device_t));
+	sprintf(dev->name, "%s%d", parent->name, index);
+	dev->sector_size = parent->sector_size;
+	dev->sector_count = count;
+	dev->parent = parent;
+	dev->start_lba = start;
+	dev->read = partition_read;
+	if (parent->write) {
+		dev->write = partition_write;
+	}
+	dev->flush = partition_flush;
+
+	if (!block_device_register(dev)) {
+		kfree(dev);
+		return NULL;
+	}
+	return dev;
+}
+
+block_device_t* block_device_get(uint32_t id) {
+	if (!block_devices || id >= (uint32_t)block_devices->size) {
+		return NULL;
+	}
+	return array_m_lookup(block_devices, id);
+}
+
+block_device_t* block_device_find(char* name) {
+	for (uint32_t i = 0; i < block_device_count(); i++) {
+		block_device_t* dev = block_device_get(i);
+		if (!strcmp(dev->name, name)) {
+			return dev;
+		}
+	}
+	return NULL;
+}
+
+uint32_t block_device_count() {
+	if (!block_devices) return 0;
+	return block_devices->size;
+}
+
+int block_read(block_device_t* dev, uint32_t lba, uint32_t count, uint8_t* buffer) {
+	if (!dev || !dev->read) return -1;
+	//don't let drivers read past the end of the device
+	if (lba + count > dev->sector_count) return -1;
+
+	return dev->read(dev, lba, count, buffer);
+}
+
+int block_write(block_device_t* dev, uint32_t lba, uint32_t count, uint8_t* buffer) {
+	if (!dev || !dev->write) return -1;
+	if (lba + count > dev->sector_count) return -1;
+
+	return dev->write(dev, lba, count, buffer);
+}
+
+int block_flush(block_device_t* dev) {
+	//devices without a volatile cache have nothing to flush
+	if (!dev || !dev->flush) return 0;
+
+	return dev->flush(dev);
+}
@@ -0,0 +1,49 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <std/std.h>
+
+#define MAX_BLOCK_DEVICES 16
+
+struct block_device;
+
+//read/write count sectors starting at lba into/from buffer
+//return 0 on success, nonzero driver error code on failure
+typedef int (*block_read_t)(struct block_device*, uint32_t lba, uint32_t count, uint8_t* buffer);
+typedef int (*block_write_t)(struct block_device*, uint32_t lba, uint32_t count, uint8_t* buffer);
+//commit any volatile write cache on the device to stable storage
+typedef int (*block_flush_t)(struct block_device*);
+
+typedef struct block_device {
+	char name[16];			//user-printable device name, ex. hda
+	uint32_t id;			//index into block device table, used as a cache key
+	uint32_t sector_size;	//bytes per sector
+	uint32_t sector_count;	//capacity in sectors
+	void* ctx;				//driver-private data
+	struct block_device* parent;	//whole disk if this is a partition
+	uint32_t start_lba;		//first sector of partition on parent
+	block_read_t read;
+	block_write_t write;
+	block_flush_t flush;
+} block_device_t;
+
+//adds dev to the table of block devices, assigns its id, and creates its /dev node
+//whole disks are then scanned for partitions, which are registered in turn
+//returns false if the table is full
+bool block_device_register(block_device_t* dev);
+
+//registers sectors [start, start + count) of parent as a new block device
+//named after parent with index appended, ex. hda1
+block_device_t* block_partition_register(block_device_t* parent, int index, uint32_t start, uint32_t count);
+
+//look up a registered block device
+block_device_t* block_device_get(uint32_t id);
+block_device_t* block_device_find(char* name);
+uint32_t block_device_count();
+
+//pass-throughs to the device's callbacks
+int block_read(block_device_t* dev, uint32_t lba, uint32_t count, uint8_t* buffer);
+int block_write(block_device_t* dev, uint32_t lba, uint32_t count, uint8_t* buffer);
+int block_flush(block_device_t* dev);
+
+#endif
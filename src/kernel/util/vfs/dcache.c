@@ -0,0 +1,121 @@
+#include "dcache.h"
+#include <kernel/util/mutex/mutex.h>
+
+static dentry_t dentries[DCACHE_SIZE];
+static dentry_t* dcache_hash_table[DCACHE_HASH_SIZE];
+//next entry to replace, entries are recycled oldest first
+static uint32_t dcache_next = 0;
+static lock_t* dcache_lock = 0;
+
+static void dcache_acquire() {
+	if (!dcache_lock) {
+		dcache_lock = lock_create();
+	}
+	lock(dcache_lock);
+}
+
+static uint32_t dcache_hash(fs_node_t* parent, char* name) {
+	//djb2 over the name, mixed with the directory
+	uint32_t hash = 5381;
+	while (*name) {
+		hash = ((hash << 5) + hash) + (uint8_t)*name++;
+	}
+	hash ^= (uint32_t)parent >> 4;
+	return hash % DCACHE_HASH_SIZE;
+}
+
+static dentry_t* dcache_find(fs_node_t* parent, char* name) {
+	dentry_t* entry = dcache_hash_table[dcache_hash(parent, name)];
+	while (entry) {
+		if (entry->parent == parent && !strcmp(entry->name, name)) {
+			return entry;
+		}
+		entry = entry->hash_next;
+	}
+	return NULL;
+}
+
+static void dcache_unlink(dentry_t* entry) {
+	dentry_t** link = &dcache_hash_table[dcache_hash(entry->parent, entry->name)];
+	while (*link) {
+		if (*link == entry) {
+			*link = entry->hash_next;
+			break;
+		}
+		link = &(*link)->hash_next;
+	}
+	entry->used = false;
+	entry->hash_next = NULL;
+}
+
+bool dcache_lookup(fs_node_t* parent, char* name, fs_node_t** node) {
+	if (strlen(name) >= DCACHE_NAME_MAX) return false;
+
+	dcache_acquire();
+	dentry_t* entry = dcache_find(parent, name);
+	if (entry) {
+		*node = entry->node;
+	}
+	unlock(dcache_lock);
+	return entry != NULL;
+}
+
+void dcache_insert(fs_node_t* parent, char* name, fs_node_t* node) {
+	if (strlen(name) >= DCACHE_NAME_MAX) return;
+
+	dcache_acquire();
+	dentry_t* entry = dcache_find(parent, name);
+	if (entry) {
+		entry->node = node;
+		unlock(dcache_lock);
+		return;
+	}
+
+	entry = &dentries[dcache_next];
+	dcache_next = (dcache_next + 1) % DCACHE_SIZE;
+	if (entry->used) {
+		dcache_unlink(entry);
+	}
+
+	entry->parent = parent;
+	strcpy(entry->name, name);
+	entry->node = node;
+	entry->used = true;
+
+	uint32_t idx = dcache_hash(parent, name);
+	entry->hash_next = dcache_hash_table[idx];
+	dcache_hash_table[idx] = entry;
+	unlock(dcache_lock);
+}
+
+void dcache_invalidate(fs_node_t* parent, char* name) {
+	if (strlen(name) >= DCACHE_NAME_MAX) return;
+
+	dcache_acquire();
+	dentry_t* entry = dcache_find(parent, name);
+	if (entry) {
+		dcache_unlink(entry);
+	}
+	unlock(dcache_lock);
+}
+
+void dcache_invalidate_node(fs_node_t* node) {
+	dcache_acquire();
+	for (int i = 0; i < DCACHE_SIZE; i++) {
+		dentry_t* entry = &dentries[i];
+		if (entry->used && (entry->parent == node || entry->node == node)) {
+			dcache_unlink(entry);
+		}
+	}
+	unlock(dcache_lock);
+}
+
+void dcache_invalidate_all() {
+	dcache_acquire();
+	for (int i = 0; i < DCACHE_SIZE; i++) {
+		if (dentries[i].used) {
+			dcache_unlink(&dentries[i]);
+		}
+	}
+	unlock(dcache_lock);
+}
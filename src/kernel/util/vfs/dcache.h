@@ -0,0 +1,37 @@
+#ifndef DCACHE_H
+#define DCACHE_H
+
+#include <std/std.h>
+#include "fs.h"
+
+#define DCACHE_SIZE 256
+#define DCACHE_HASH_SIZE 128
+//longer names aren't cached
+#define DCACHE_NAME_MAX 64
+
+typedef struct dentry {
+	fs_node_t* parent;
+	char name[DCACHE_NAME_MAX];
+	fs_node_t* node;	//NULL for a negative entry (name known not to exist)
+	struct dentry* hash_next;
+	bool used;
+} dentry_t;
+
+//looks up name in directory parent
+//returns true on a cache hit, storing the result (possibly NULL) in node
+bool dcache_lookup(fs_node_t* parent, char* name, fs_node_t** node);
+
+//records the result of looking up name in parent
+//node may be NULL to remember that name doesn't exist
+void dcache_insert(fs_node_t* parent, char* name, fs_node_t* node);
+
+//forgets name in parent, used when a directory's contents change
+void dcache_invalidate(fs_node_t* parent, char* name);
+
+//forgets every entry for or inside node
+void dcache_invalidate_node(fs_node_t* node);
+
+//forgets everything, used when a filesystem is unmounted
+void dcache_invalidate_all();
+
+#endif
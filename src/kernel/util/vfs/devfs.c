@@ -0,0 +1,87 @@
+#include "devfs.h"
+#include "bcache.h"
+#include "dcache.h"
+#include <std/kheap.h>
+#include <std/array_m.h>
+
+static array_m* devfs_nodes = 0;
+static struct dirent devfs_dirent;
+
+static uint32_t devfs_block_read(fs_node_t* node, uint32_t offset, uint32_t size, uint8_t* buffer) {
+	return bcache_read(block_device_get(node->impl), offset, size, buffer);
+}
+
+static uint32_t devfs_block_write(fs_node_t* node, uint32_t offset, uint32_t size, uint8_t* buffer) {
+	return bcache_write(block_device_get(node->impl), offset, size, buffer);
+}
+
+static struct dirent* devfs_readdir(fs_node_t* UNUSED(node), uint32_t index) {
+	if (!devfs_nodes || index >= (uint32_t)devfs_nodes->size) {
+		return 0;
+	}
+	fs_node_t* dev = array_m_lookup(devfs_nodes, index);
+	strcpy(devfs_dirent.name, dev->name);
+	devfs_dirent.ino = dev->inode;
+	return &devfs_dirent;
+}
+
+static fs_node_t* devfs_finddir(fs_node_t* UNUSED(node), char* name) {
+	if (!devfs_nodes) return 0;
+
+	for (int i = 0; i < devfs_nodes->size; i++) {
+		fs_node_t* dev = array_m_lookup(devfs_nodes, i);
+		if (!strcmp(name, dev->name)) {
+			return dev;
+		}
+	}
+	return 0;
+}
+
+static fs_node_t* devfs_dir = 0;
+
+void devfs_install(fs_node_t* dir) {
+	if (!dir) {
+		printf_err("devfs: no /dev directory to install into");
+		return;
+	}
+	devfs_dir = dir;
+	dir->readdir = &devfs_readdir;
+	dir->finddir = &devfs_finddir;
+
+	//devices registered before now already have nodes
+	for (int i = 0; devfs_nodes && i < devfs_nodes->size; i++) {
+		fs_node_t* dev = array_m_lookup(devfs_nodes, i);
+		dev->parent = dir;
+	}
+}
+
+void devfs_register_block_device(block_device_t* dev) {
+	if (!devfs_nodes) {
+		devfs_nodes = array_m_create(MAX_DEVFS_NODES);
+	}
+	if (devfs_nodes->size >= MAX_DEVFS_NODES) {
+		printf_err("devfs: no room for /dev/%s", dev->name);
+		return;
+	}
+
+	fs_node_t* node = kmalloc(sizeof(fs_node_t));
+	memset(node, 0, sizeof(fs_node_t));
+	strcpy(node->name, dev->name);
+	node->flags = FS_BLOCKDEVICE;
+	node->inode = devfs_nodes->size;
+	node->impl = dev->id;
+	//fs_node lengths are 32 bits, so huge disks are truncated here
+	uint64_t bytes = (uint64_t)dev->sector_count * dev->sector_size;
+	node->length = (bytes > 0xFFFFFFFF) ? 0xFFFFFFFF : bytes;
+	node->read = &devfs_block_read;
+	if (dev->write) {
+		node->write = &devfs_block_write;
+	}
+	node->parent = devfs_dir;
+
+	array_m_insert(devfs_nodes, node);
+	//drop any cached miss for this name
+	if (devfs_dir) {
+		dcache_invalidate(devfs_dir, node->name);
+	}
+}
@@ -0,0 +1,17 @@
+#ifndef DEVFS_H
+#define DEVFS_H
+
+#include <std/std.h>
+#include "fs.h"
+#include "block.h"
+
+#define MAX_DEVFS_NODES 64
+
+//takes over dir (the initrd's /dev) so it lists registered device nodes
+void devfs_install(fs_node_t* dir);
+
+//adds a node for dev to /dev
+//reads and writes through the node go through the block cache
+void devfs_register_block_device(block_device_t* dev);
+
+#endif
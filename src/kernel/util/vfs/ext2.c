@@ -0,0 +1,893 @@
+#include "ext2.h"
+#include "bcache.h"
+#include "mount.h"
+#include <std/kheap.h>
+#include <std/math.h>
+#include <kernel/drivers/rtc/clock.h>
+
+static fs_node_t* ext2_get_node(ext2_fs_t* fs, uint32_t ino, char* name, fs_node_t* parent);
+static void ext2_setup_node(ext2_node_t* node);
+static void ext2_forget_node(ext2_fs_t* fs, ext2_node_t* node);
+static void ext2_release_node(ext2_fs_t* fs, ext2_node_t* node);
+
+//all disk access goes through the block cache
+//returns 0 on success
+static int ext2_read_bytes(ext2_fs_t* fs, uint32_t offset, uint32_t size, void* buf) {
+	return bcache_read(fs->dev, offset, size, buf) == size ? 0 : -1;
+}
+
+static int ext2_write_bytes(ext2_fs_t* fs, uint32_t offset, uint32_t size, void* buf) {
+	return bcache_write(fs->dev, offset, size, buf) == size ? 0 : -1;
+}
+
+static int ext2_read_block(ext2_fs_t* fs, uint32_t block, void* buf) {
+	return ext2_read_bytes(fs, block * fs->block_size, fs->block_size, buf);
+}
+
+static int ext2_write_block(ext2_fs_t* fs, uint32_t block, void* buf) {
+	return ext2_write_bytes(fs, block * fs->block_size, fs->block_size, buf);
+}
+
+//writes the superblock and group descriptors back if their counters have changed
+//allocations only update the copies in memory, so this happens on sync and unmount
+//called with the fs lock held, returns 0 on success
+static int ext2_write_meta(ext2_fs_t* fs) {
+	if (!fs->meta_dirty) return 0;
+
+	uint32_t table = (fs->sb.s_first_data_block + 1) * fs->block_size;
+	if (ext2_write_bytes(fs, EXT2_SUPERBLOCK_OFFSET, sizeof(ext2_superblock_t), &fs->sb) ||
+		ext2_write_bytes(fs, table, fs->group_count * sizeof(ext2_group_desc_t), fs->groups)) {
+		return -1;
+	}
+	fs->meta_dirty = false;
+	return 0;
+}
+
+static int ext2_sync(fs_node_t* fsnode) {
+	ext2_fs_t* fs = ((ext2_node_t*)fsnode)->fs;
+	lock(fs->lock);
+	int err = ext2_write_meta(fs);
+	unlock(fs->lock);
+	return err;
+}
+
+static uint32_t ext2_inode_offset(ext2_fs_t* fs, uint32_t ino) {
+	uint32_t group = (ino - 1) / fs->sb.s_inodes_per_group;
+	uint32_t index = (ino - 1) % fs->sb.s_inodes_per_group;
+	return fs->groups[group].bg_inode_table * fs->block_size + index * fs->inode_size;
+}
+
+static void ext2_write_inode(ext2_node_t* node) {
+	ext2_write_bytes(node->fs, ext2_inode_offset(node->fs, node->node.inode), sizeof(ext2_inode_t), &node->inode);
+}
+
+static uint32_t ext2_group_of_inode(ext2_fs_t* fs, uint32_t ino) {
+	return (ino - 1) / fs->sb.s_inodes_per_group;
+}
+
+//number of blocks in group, the last group may be short
+static uint32_t ext2_blocks_in_group(ext2_fs_t* fs, uint32_t group) {
+	uint32_t first = fs->sb.s_first_data_block + group * fs->sb.s_blocks_per_group;
+	return MIN(fs->sb.s_blocks_per_group, fs->sb.s_blocks_count - first);
+}
+
+//finds a clear bit among the first count bits of bitmap block, sets it and returns its index
+//returns -1 if every bit is set
+static int ext2_bitmap_alloc(ext2_fs_t* fs, uint32_t bitmap, uint32_t count, uint32_t first) {
+	if (ext2_read_block(fs, bitmap, fs->bitmap_buf)) return -1;
+
+	for (uint32_t bit = first; bit < count; bit++) {
+		uint8_t* byte = &fs->bitmap_buf[bit / 8];
+		if (*byte == 0xFF) {
+			bit |= 7;
+			continue;
+		}
+		if (*byte & (1 << (bit % 8))) continue;
+
+		*byte |= 1 << (bit % 8);
+		ext2_write_bytes(fs, bitmap * fs->block_size + bit / 8, 1, byte);
+		return bit;
+	}
+	return -1;
+}
+
+static void ext2_bitmap_free(ext2_fs_t* fs, uint32_t bitmap, uint32_t bit) {
+	uint8_t byte;
+	uint32_t offset = bitmap * fs->block_size + bit / 8;
+	ext2_read_bytes(fs, offset, 1, &byte);
+	byte &= ~(1 << (bit % 8));
+	ext2_write_bytes(fs, offset, 1, &byte);
+}
+
+//allocates and zeroes a block, preferring those in group goal
+//returns 0 if the filesystem is full
+static uint32_t ext2_alloc_block(ext2_fs_t* fs, uint32_t goal) {
+	for (uint32_t n = 0; n < fs->group_count; n++) {
+		uint32_t group = (goal + n) % fs->group_count;
+		ext2_group_desc_t* desc = &fs->groups[group];
+		if (!desc->bg_free_blocks_count) continue;
+
+		int bit = ext2_bitmap_alloc(fs, desc->bg_block_bitmap, ext2_blocks_in_group(fs, group), 0);
+		if (bit < 0) continue;
+
+		desc->bg_free_blocks_count--;
+		fs->sb.s_free_blocks_count--;
+		fs->meta_dirty = true;
+
+		uint32_t block = fs->sb.s_first_data_block + group * fs->sb.s_blocks_per_group + bit;
+		memset(fs->bitmap_buf, 0, fs->block_size);
+		ext2_write_block(fs, block, fs->bitmap_buf);
+		return block;
+	}
+	printf_err("ext2: %s is full", fs->dev->name);
+	return 0;
+}
+
+static void ext2_free_block(ext2_fs_t* fs, uint32_t block) {
+	uint32_t group = (block - fs->sb.s_first_data_block) / fs->sb.s_blocks_per_group;
+	uint32_t bit = (block - fs->sb.s_first_data_block) % fs->sb.s_blocks_per_group;
+	ext2_bitmap_free(fs, fs->groups[group].bg_block_bitmap, bit);
+
+	fs->groups[group].bg_free_blocks_count++;
+	fs->sb.s_free_blocks_count++;
+	fs->meta_dirty = true;
+}
+
+//allocates an inode and zeroes it on disk, preferring group goal
+//returns 0 if there are no free inodes
+static uint32_t ext2_alloc_inode(ext2_fs_t* fs, uint32_t goal, bool dir) {
+	uint32_t first_ino = fs->sb.s_rev_level ? fs->sb.s_first_ino : EXT2_GOOD_OLD_FIRST_INO;
+
+	for (uint32_t n = 0; n < fs->group_count; n++) {
+		uint32_t group = (goal + n) % fs->group_count;
+		ext2_group_desc_t* desc = &fs->groups[group];
+		if (!desc->bg_free_inodes_count) continue;
+
+		//reserved inodes all live at the start of the first group
+		uint32_t base = group * fs->sb.s_inodes_per_group;
+		uint32_t first = base + 1 < first_ino ? first_ino - 1 - base : 0;
+		int bit = ext2_bitmap_alloc(fs, desc->bg_inode_bitmap, fs->sb.s_inodes_per_group, first);
+		if (bit < 0) continue;
+
+		desc->bg_free_inodes_count--;
+		if (dir) desc->bg_used_dirs_count++;
+		fs->sb.s_free_inodes_count--;
+		fs->meta_dirty = true;
+
+		uint32_t ino = base + bit + 1;
+		memset(fs->bitmap_buf, 0, fs->inode_size);
+		ext2_write_bytes(fs, ext2_inode_offset(fs, ino), fs->inode_size, fs->bitmap_buf);
+		return ino;
+	}
+	printf_err("ext2: %s has no free inodes", fs->dev->name);
+	return 0;
+}
+
+static void ext2_free_inode(ext2_fs_t* fs, uint32_t ino, bool dir) {
+	uint32_t group = ext2_group_of_inode(fs, ino);
+	ext2_bitmap_free(fs, fs->groups[group].bg_inode_bitmap, (ino - 1) % fs->sb.s_inodes_per_group);
+
+	fs->groups[group].bg_free_inodes_count++;
+	if (dir) fs->groups[group].bg_used_dirs_count--;
+	fs->sb.s_free_inodes_count++;
+	fs->meta_dirty = true;
+}
+
+//allocates a block on behalf of node, charging it to the inode
+static uint32_t ext2_alloc_node_block(ext2_node_t* node) {
+	ext2_fs_t* fs = node->fs;
+	uint32_t block = ext2_alloc_block(fs, ext2_group_of_inode(fs, node->node.inode));
+	if (block) {
+		node->inode.i_blocks += fs->block_size / 512;
+	}
+	return block;
+}
+
+//fills a pointer slot held in memory at *slot, and on disk at slot_offset (0 if it lives in the inode)
+static uint32_t ext2_fill_slot(ext2_node_t* node, uint32_t* slot, uint32_t slot_offset) {
+	uint32_t block = ext2_alloc_node_block(node);
+	if (!block) return 0;
+	*slot = block;
+	if (slot_offset) {
+		ext2_write_bytes(node->fs, slot_offset, sizeof(uint32_t), slot);
+	}
+	ext2_write_inode(node);
+	return block;
+}
+
+//maps block fblock of a file to a disk block, allocating it (and any pointer blocks) if create is set
+//returns 0 for a hole, or if allocation failed
+static uint32_t ext2_bmap(ext2_node_t* node, uint32_t fblock, bool create) {
+	ext2_fs_t* fs = node->fs;
+	uint32_t ppb = fs->ptrs_per_block;
+
+	if (fblock < EXT2_NDIR_BLOCKS) {
+		uint32_t* slot = &node->inode.i_block[fblock];
+		if (!*slot && create) {
+			ext2_fill_slot(node, slot, 0);
+		}
+		return *slot;
+	}
+
+	//pointer block from the previous lookup covers it
+	if (node->map_block && fblock >= node->map_first && fblock - node->map_first < ppb) {
+		uint32_t idx = fblock - node->map_first;
+		uint32_t* slot = &node->map_ptrs[idx];
+		if (!*slot && create) {
+			ext2_fill_slot(node, slot, node->map_block * fs->block_size + idx * sizeof(uint32_t));
+		}
+		return *slot;
+	}
+
+	//which tree, and the offset of fblock within it
+	uint32_t rel = fblock - EXT2_NDIR_BLOCKS;
+	int depth;
+	uint32_t* root;
+	if (rel < ppb) {
+		depth = 1;
+		root = &node->inode.i_block[EXT2_IND_BLOCK];
+	}
+	else if ((rel -= ppb) < ppb * ppb) {
+		depth = 2;
+		root = &node->inode.i_block[EXT2_DIND_BLOCK];
+	}
+	else {
+		rel -= ppb * ppb;
+		depth = 3;
+		root = &node->inode.i_block[EXT2_TIND_BLOCK];
+	}
+
+	if (!*root && (!create || !ext2_fill_slot(node, root, 0))) {
+		return 0;
+	}
+	uint32_t block = *root;
+
+	//walk down to the pointer block holding fblock's entry
+	for (int level = depth - 1; level > 0; level--) {
+		uint32_t span = 1;
+		for (int i = 0; i < level; i++) span *= ppb;
+		uint32_t offset = block * fs->block_size + ((rel / span) % ppb) * sizeof(uint32_t);
+
+		uint32_t next;
+		if (ext2_read_bytes(fs, offset, sizeof(uint32_t), &next)) return 0;
+		if (!next && (!create || !ext2_fill_slot(node, &next, offset))) {
+			return 0;
+		}
+		block = next;
+	}
+
+	//remember the pointer block for the lookups which follow
+	if (ext2_read_block(fs, block, node->map_ptrs)) {
+		node->map_block = 0;
+		return 0;
+	}
+	node->map_block = block;
+	node->map_first = fblock - (rel % ppb);
+	return ext2_bmap(node, fblock, create);
+}
+
+static uint32_t ext2_read(fs_node_t* fsnode, uint32_t offset, uint32_t size, uint8_t* buffer) {
+	ext2_node_t* node = (ext2_node_t*)fsnode;
+	ext2_fs_t* fs = node->fs;
+	if (offset >= node->inode.i_size) return 0;
+	size = MIN(size, node->inode.i_size - offset);
+
+	lock(fs->lock);
+	uint32_t done = 0;
+	while (done < size) {
+		uint32_t fblock = (offset + done) / fs->block_size;
+		uint32_t block_off = (offset + done) % fs->block_size;
+		uint32_t chunk = MIN(size - done, fs->block_size - block_off);
+
+		uint32_t block = ext2_bmap(node, fblock, false);
+		if (!block) {
+			//hole
+			memset(buffer + done, 0, chunk);
+			done += chunk;
+			continue;
+		}
+
+		//extend over blocks which are contiguous on disk, so the cache sees one large read
+		uint32_t run = 1;
+		while (done + chunk < size && ext2_bmap(node, fblock + run, false) == block + run) {
+			chunk += MIN(size - done - chunk, fs->block_size);
+			run++;
+		}
+
+		if (ext2_read_bytes(fs, block * fs->block_size + block_off, chunk, buffer + done)) break;
+		done += chunk;
+	}
+	unlock(fs->lock);
+	return done;
+}
+
+static uint32_t ext2_write(fs_node_t* fsnode, uint32_t offset, uint32_t size, uint8_t* buffer) {
+	ext2_node_t* node = (ext2_node_t*)fsnode;
+	ext2_fs_t* fs = node->fs;
+	if (offset + size < offset) return 0;
+
+	lock(fs->lock);
+	uint32_t done = 0;
+	while (done < size) {
+		uint32_t fblock = (offset + done) / fs->block_size;
+		uint32_t block_off = (offset + done) % fs->block_size;
+		uint32_t chunk = MIN(size - done, fs->block_size - block_off);
+
+		uint32_t block = ext2_bmap(node, fblock, true);
+		if (!block) break;
+		if (ext2_write_bytes(fs, block * fs->block_size + block_off, chunk, buffer + done)) break;
+		done += chunk;
+	}
+
+	if (offset + done > node->inode.i_size) {
+		node->inode.i_size = offset + done;
+		fsnode->length = node->inode.i_size;
+	}
+	ext2_write_inode(node);
+	unlock(fs->lock);
+	return done;
+}
+
+//frees every block at or past file block keep in the tree rooted at *slot
+//the tree has depth levels of pointer blocks and covers file blocks from first
+static void ext2_truncate_tree(ext2_node_t* node, uint32_t* slot, int depth, uint64_t first, uint32_t keep) {
+	ext2_fs_t* fs = node->fs;
+	if (!*slot) return;
+
+	//file blocks covered by each pointer in this block, and by the whole tree
+	uint64_t child_span = 1;
+	for (int i = 1; i < depth; i++) child_span *= fs->ptrs_per_block;
+	uint64_t span = depth ? child_span * fs->ptrs_per_block : 1;
+	//all of it stays
+	if (first + span <= keep) return;
+
+	if (depth) {
+		uint32_t* ptrs = kmalloc(fs->block_size);
+		if (ext2_read_block(fs, *slot, ptrs)) {
+			kfree(ptrs);
+			return;
+		}
+		bool changed = false;
+		for (uint32_t i = 0; i < fs->ptrs_per_block; i++) {
+			uint32_t before = ptrs[i];
+			ext2_truncate_tree(node, &ptrs[i], depth - 1, first + i * child_span, keep);
+			changed |= before != ptrs[i];
+		}
+		//a pointer block which still maps something is kept
+		if (changed && first < keep) {
+			ext2_write_block(fs, *slot, ptrs);
+		}
+		kfree(ptrs);
+	}
+
+	if (first >= keep) {
+		ext2_free_block(fs, *slot);
+		node->inode.i_blocks -= fs->block_size / 512;
+		*slot = 0;
+	}
+}
+
+//called with the fs lock held
+static void ext2_do_truncate(ext2_node_t* node, uint32_t length) {
+	ext2_fs_t* fs = node->fs;
+	uint32_t ppb = fs->ptrs_per_block;
+
+	if (length < node->inode.i_size) {
+		uint32_t keep = (length + fs->block_size - 1) / fs->block_size;
+		for (uint32_t i = 0; i < EXT2_NDIR_BLOCKS; i++) {
+			ext2_truncate_tree(node, &node->inode.i_block[i], 0, i, keep);
+		}
+		uint64_t first = EXT2_NDIR_BLOCKS;
+		ext2_truncate_tree(node, &node->inode.i_block[EXT2_IND_BLOCK], 1, first, keep);
+		first += ppb;
+		ext2_truncate_tree(node, &node->inode.i_block[EXT2_DIND_BLOCK], 2, first, keep);
+		first += (uint64_t)ppb * ppb;
+		ext2_truncate_tree(node, &node->inode.i_block[EXT2_TIND_BLOCK], 3, first, keep);
+		node->map_block = 0;
+
+		//zero the rest of the last block, so growing the file again reads back zeroes
+		uint32_t tail = length % fs->block_size;
+		uint32_t block = tail ? ext2_bmap(node, length / fs->block_size, false) : 0;
+		if (block) {
+			memset(fs->bitmap_buf, 0, fs->block_size - tail);
+			ext2_write_bytes(fs, block * fs->block_size + tail, fs->block_size - tail, fs->bitmap_buf);
+		}
+	}
+	//growing leaves a hole
+	node->inode.i_size = length;
+	node->node.length = length;
+	ext2_write_inode(node);
+}
+
+static int ext2_truncate(fs_node_t* fsnode, uint32_t length) {
+	ext2_node_t* node = (ext2_node_t*)fsnode;
+	lock(node->fs->lock);
+	ext2_do_truncate(node, length);
+	unlock(node->fs->lock);
+	return 0;
+}
+
+//calls visit for every entry in a directory, until it returns true
+//the entry's block is left in fs->dir_buf, and its disk block and offset in *block, *offset
+typedef bool (*ext2_dir_visit_t)(ext2_dir_entry_t* entry, ext2_dir_entry_t* prev, void* ctx);
+
+static ext2_dir_entry_t* ext2_dir_walk(ext2_node_t* dir, ext2_dir_visit_t visit, void* ctx, uint32_t* block_out) {
+	ext2_fs_t* fs = dir->fs;
+	uint32_t blocks = dir->inode.i_size / fs->block_size;
+	for (uint32_t i = 0; i < blocks; i++) {
+		uint32_t block = ext2_bmap(dir, i, false);
+		if (!block || ext2_read_block(fs, block, fs->dir_buf)) continue;
+
+		ext2_dir_entry_t* prev = NULL;
+		uint32_t off = 0;
+		while (off + sizeof(ext2_dir_entry_t) <= fs->block_size) {
+			ext2_dir_entry_t* entry = (ext2_dir_entry_t*)(fs->dir_buf + off);
+			//a corrupt entry ends the block
+			if (entry->rec_len < sizeof(ext2_dir_entry_t) || off + entry->rec_len > fs->block_size) break;
+
+			if (visit(entry, prev, ctx)) {
+				if (block_out) *block_out = block;
+				return entry;
+			}
+			prev = entry;
+			off += entry->rec_len;
+		}
+	}
+	return NULL;
+}
+
+static bool ext2_entry_is(ext2_dir_entry_t* entry, char* name) {
+	uint32_t len = strlen(name);
+	return entry->inode && entry->name_len == len && !memcmp(entry->name, name, len);
+}
+
+static bool ext2_entry_dot(ext2_dir_entry_t* entry) {
+	return ext2_entry_is(entry, ".") || ext2_entry_is(entry, "..");
+}
+
+static bool ext2_visit_index(ext2_dir_entry_t* entry, ext2_dir_entry_t* UNUSED(prev), void* ctx) {
+	uint32_t* index = ctx;
+	//. and .. are handled by path lookup, so they aren't listed
+	if (!entry->inode || ext2_entry_dot(entry)) return false;
+	return (*index)-- == 0;
+}
+
+static bool ext2_visit_name(ext2_dir_entry_t* entry, ext2_dir_entry_t* UNUSED(prev), void* ctx) {
+	return ext2_entry_is(entry, ctx);
+}
+
+static struct dirent* ext2_readdir(fs_node_t* fsnode, uint32_t index) {
+	ext2_node_t* dir = (ext2_node_t*)fsnode;
+	ext2_fs_t* fs = dir->fs;
+
+	lock(fs->lock);
+	ext2_dir_entry_t* entry = ext2_dir_walk(dir, ext2_visit_index, &index, NULL);
+	if (!entry) {
+		unlock(fs->lock);
+		return 0;
+	}
+	memcpy(fs->dirent.name, entry->name, entry->name_len);
+	fs->dirent.name[entry->name_len] = '\0';
+	fs->dirent.ino = entry->inode;
+	unlock(fs->lock);
+	return &fs->dirent;
+}
+
+//called with the fs lock held
+static fs_node_t* ext2_do_finddir(ext2_node_t* dir, char* name) {
+	ext2_dir_entry_t* entry = ext2_dir_walk(dir, ext2_visit_name, name, NULL);
+	if (!entry) return 0;
+	return ext2_get_node(dir->fs, entry->inode, name, &dir->node);
+}
+
+static fs_node_t* ext2_finddir(fs_node_t* fsnode, char* name) {
+	ext2_node_t* dir = (ext2_node_t*)fsnode;
+	lock(dir->fs->lock);
+	fs_node_t* node = ext2_do_finddir(dir, name);
+	unlock(dir->fs->lock);
+	return node;
+}
+
+static uint32_t ext2_entry_size(uint32_t name_len) {
+	return (sizeof(ext2_dir_entry_t) + name_len + 3) & ~3;
+}
+
+typedef struct {
+	uint32_t needed;
+} ext2_space_ctx_t;
+
+static bool ext2_visit_space(ext2_dir_entry_t* entry, ext2_dir_entry_t* UNUSED(prev), void* ctx) {
+	ext2_space_ctx_t* space = ctx;
+	uint32_t used = entry->inode ? ext2_entry_size(entry->name_len) : 0;
+	return entry->rec_len - used >= space->needed;
+}
+
+//adds an entry for ino to dir, growing the directory if no block has room
+static bool ext2_add_entry(ext2_node_t* dir, char* name, uint32_t ino, uint8_t type) {
+	ext2_fs_t* fs = dir->fs;
+	uint32_t name_len = strlen(name);
+	ext2_space_ctx_t space = {ext2_entry_size(name_len)};
+
+	uint32_t block;
+	ext2_dir_entry_t* entry = ext2_dir_walk(dir, ext2_visit_space, &space, &block);
+	if (entry && entry->inode) {
+		//split the entry, the new one takes the space it isn't using
+		uint32_t used = ext2_entry_size(entry->name_len);
+		ext2_dir_entry_t* split = (ext2_dir_entry_t*)((uint8_t*)entry + used);
+		split->rec_len = entry->rec_len - used;
+		entry->rec_len = used;
+		entry = split;
+	}
+	else if (!entry) {
+		//append a fresh block
+		block = ext2_bmap(dir, dir->inode.i_size / fs->block_size, true);
+		if (!block) return false;
+		memset(fs->dir_buf, 0, fs->block_size);
+		entry = (ext2_dir_entry_t*)fs->dir_buf;
+		entry->rec_len = fs->block_size;
+		dir->inode.i_size += fs->block_size;
+		dir->node.length = dir->inode.i_size;
+		ext2_write_inode(dir);
+	}
+
+	entry->inode = ino;
+	entry->name_len = name_len;
+	entry->file_type = (fs->sb.s_feature_incompat & EXT2_FEATURE_INCOMPAT_FILETYPE) ? type : 0;
+	memcpy(entry->name, name, name_len);
+	return !ext2_write_block(fs, block, fs->dir_buf);
+}
+
+static fs_node_t* ext2_create(fs_node_t* fsnode, char* name, uint32_t type) {
+	ext2_node_t* dir = (ext2_node_t*)fsnode;
+	ext2_fs_t* fs = dir->fs;
+	if (type != FS_FILE && type != FS_DIRECTORY) return 0;
+	if (!*name || strlen(name) > 255 || strchr(name, '/')) return 0;
+
+	lock(fs->lock);
+	fs_node_t* existing = ext2_do_finddir(dir, name);
+	if (existing) {
+		unlock(fs->lock);
+		//creating a file which is already there just opens it
+		return (existing->flags & 0x7) == type ? existing : 0;
+	}
+
+	bool is_dir = type == FS_DIRECTORY;
+	uint32_t ino = ext2_alloc_inode(fs, ext2_group_of_inode(fs, fsnode->inode), is_dir);
+	if (!ino) {
+		unlock(fs->lock);
+		return 0;
+	}
+
+	ext2_node_t* node = (ext2_node_t*)ext2_get_node(fs, ino, name, fsnode);
+	if (!node) {
+		ext2_free_inode(fs, ino, is_dir);
+		unlock(fs->lock);
+		return 0;
+	}
+	node->inode.i_mode = is_dir ? (EXT2_S_IFDIR | 0755) : (EXT2_S_IFREG | 0644);
+	node->inode.i_links_count = is_dir ? 2 : 1;
+
+	if (is_dir) {
+		//first block holds . and ..
+		uint32_t block = ext2_alloc_node_block(node);
+		if (!block) {
+			//nothing was written for the new inode yet, so it only has to be given back
+			ext2_forget_node(fs, node);
+			kfree(node->map_ptrs);
+			kfree(node);
+			ext2_free_inode(fs, ino, is_dir);
+			unlock(fs->lock);
+			return 0;
+		}
+		node->inode.i_block[0] = block;
+		node->inode.i_size = fs->block_size;
+
+		memset(fs->dir_buf, 0, fs->block_size);
+		ext2_dir_entry_t* dot = (ext2_dir_entry_t*)fs->dir_buf;
+		dot->inode = ino;
+		dot->rec_len = ext2_entry_size(1);
+		dot->name_len = 1;
+		dot->name[0] = '.';
+		ext2_dir_entry_t* dotdot = (ext2_dir_entry_t*)(fs->dir_buf + dot->rec_len);
+		dotdot->inode = fsnode->inode;
+		dotdot->rec_len = fs->block_size - dot->rec_len;
+		dotdot->name_len = 2;
+		dotdot->name[0] = dotdot->name[1] = '.';
+		if (fs->sb.s_feature_incompat & EXT2_FEATURE_INCOMPAT_FILETYPE) {
+			dot->file_type = dotdot->file_type = EXT2_FT_DIR;
+		}
+		ext2_write_block(fs, block, fs->dir_buf);
+
+		//the new .. links back to the parent
+		dir->inode.i_links_count++;
+		ext2_write_inode(dir);
+	}
+
+	ext2_setup_node(node);
+	ext2_write_inode(node);
+
+	if (!ext2_add_entry(dir, name, ino, is_dir ? EXT2_FT_DIR : EXT2_FT_REG_FILE)) {
+		if (is_dir) {
+			dir->inode.i_links_count--;
+			ext2_write_inode(dir);
+		}
+		ext2_forget_node(fs, node);
+		ext2_release_node(fs, node);
+		unlock(fs->lock);
+		return 0;
+	}
+	unlock(fs->lock);
+	return &node->node;
+}
+
+static bool ext2_visit_not_dot(ext2_dir_entry_t* entry, ext2_dir_entry_t* UNUSED(prev), void* UNUSED(ctx)) {
+	return entry->inode && !ext2_entry_dot(entry);
+}
+
+typedef struct {
+	char* name;
+	ext2_dir_entry_t* prev;
+} ext2_unlink_ctx_t;
+
+static bool ext2_visit_unlink(ext2_dir_entry_t* entry, ext2_dir_entry_t* prev, void* ctx) {
+	ext2_unlink_ctx_t* unlink = ctx;
+	if (!ext2_entry_is(entry, unlink->name)) return false;
+	unlink->prev = prev;
+	return true;
+}
+
+static void ext2_forget_node(ext2_fs_t* fs, ext2_node_t* node) {
+	ext2_node_t** link = &fs->inode_hash[node->node.inode % EXT2_INODE_HASH_SIZE];
+	while (*link) {
+		if (*link == node) {
+			*link = node->hash_next;
+			break;
+		}
+		link = &(*link)->hash_next;
+	}
+	node->hash_next = NULL;
+}
+
+//gives back the blocks and inode of a node with no links left, then frees the node
+//called with the fs lock held
+static void ext2_release_node(ext2_fs_t* fs, ext2_node_t* node) {
+	ext2_do_truncate(node, 0);
+	//fsck reads small dtimes as orphan list links, so this must be a real timestamp
+	node->inode.i_dtime = epoch_time();
+	ext2_write_inode(node);
+	ext2_free_inode(fs, node->node.inode, (node->node.flags & 0x7) == FS_DIRECTORY);
+	kfree(node->map_ptrs);
+	kfree(node);
+}
+
+static void ext2_open(fs_node_t* fsnode) {
+	ext2_node_t* node = (ext2_node_t*)fsnode;
+	lock(node->fs->lock);
+	node->open_count++;
+	unlock(node->fs->lock);
+}
+
+static void ext2_close(fs_node_t* fsnode) {
+	ext2_node_t* node = (ext2_node_t*)fsnode;
+	ext2_fs_t* fs = node->fs;
+	lock(fs->lock);
+	if (node->open_count) node->open_count--;
+	//the last close of an unlinked node gives its space back
+	if (!node->open_count && node->unlinked) {
+		ext2_release_node(fs, node);
+	}
+	unlock(fs->lock);
+}
+
+static int ext2_unlink(fs_node_t* fsnode, char* name) {
+	ext2_node_t* dir = (ext2_node_t*)fsnode;
+	ext2_fs_t* fs = dir->fs;
+	if (!strcmp(name, ".") || !strcmp(name, "..")) return -1;
+
+	lock(fs->lock);
+	ext2_node_t* victim = (ext2_node_t*)ext2_do_finddir(dir, name);
+	if (!victim) {
+		unlock(fs->lock);
+		return -1;
+	}
+	bool is_dir = (victim->node.flags & 0x7) == FS_DIRECTORY;
+	//directories have to be emptied first
+	if (is_dir && ext2_dir_walk(victim, ext2_visit_not_dot, NULL, NULL)) {
+		unlock(fs->lock);
+		return -1;
+	}
+
+	ext2_unlink_ctx_t ctx = {name, NULL};
+	uint32_t block;
+	ext2_dir_entry_t* entry = ext2_dir_walk(dir, ext2_visit_unlink, &ctx, &block);
+	if (!entry) {
+		unlock(fs->lock);
+		return -1;
+	}
+	if (ctx.prev) {
+		//the previous entry swallows this one
+		ctx.prev->rec_len += entry->rec_len;
+	}
+	else {
+		entry->inode = 0;
+	}
+	ext2_write_block(fs, block, fs->dir_buf);
+
+	if (is_dir) {
+		//its .. no longer refers to us, and its . goes with it
+		dir->inode.i_links_count--;
+		ext2_write_inode(dir);
+		victim->inode.i_links_count = 0;
+	}
+	else if (victim->inode.i_links_count) {
+		victim->inode.i_links_count--;
+	}
+
+	if (!victim->inode.i_links_count) {
+		//lookups can't find it any more, but anyone with it open keeps using it until they close it
+		ext2_forget_node(fs, victim);
+		victim->unlinked = true;
+		if (victim->open_count) {
+			ext2_write_inode(victim);
+		}
+		else {
+			ext2_release_node(fs, victim);
+		}
+	}
+	else {
+		ext2_write_inode(victim);
+	}
+	unlock(fs->lock);
+	return 0;
+}
+
+//sets a node's type and callbacks from its inode's mode
+static void ext2_setup_node(ext2_node_t* node) {
+	ext2_fs_t* fs = node->fs;
+	fs_node_t* fsnode = &node->node;
+	fsnode->mask = node->inode.i_mode & 0xFFF;
+	fsnode->length = node->inode.i_size;
+	fsnode->open = &ext2_open;
+	fsnode->close = &ext2_close;
+	fsnode->read = 0;
+	fsnode->write = 0;
+	fsnode->truncate = 0;
+	fsnode->readdir = 0;
+	fsnode->finddir = 0;
+	fsnode->create = 0;
+	fsnode->unlink = 0;
+
+	switch (node->inode.i_mode & EXT2_S_IFMT) {
+		case EXT2_S_IFDIR:
+			fsnode->flags = FS_DIRECTORY;
+			break;
+		case EXT2_S_IFCHR:
+			fsnode->flags = FS_CHARDEVICE;
+			break;
+		case EXT2_S_IFBLK:
+			fsnode->flags = FS_BLOCKDEVICE;
+			break;
+		case EXT2_S_IFIFO:
+			fsnode->flags = FS_PIPE;
+			break;
+		case EXT2_S_IFLNK:
+			fsnode->flags = FS_SYMLINK;
+			break;
+		default:
+			fsnode->flags = FS_FILE;
+			break;
+	}
+
+	if (fsnode->flags == FS_DIRECTORY) {
+		fsnode->readdir = &ext2_readdir;
+		fsnode->finddir = &ext2_finddir;
+		if (!fs->read_only) {
+			fsnode->create = &ext2_create;
+			fsnode->unlink = &ext2_unlink;
+		}
+	}
+	else if (fsnode->flags == FS_FILE) {
+		fsnode->read = &ext2_read;
+		if (!fs->read_only) {
+			fsnode->write = &ext2_write;
+			fsnode->truncate = &ext2_truncate;
+		}
+	}
+}
+
+//returns the in-memory node for ino, reading the inode if it isn't cached
+//called with the fs lock held
+static fs_node_t* ext2_get_node(ext2_fs_t* fs, uint32_t ino, char* name, fs_node_t* parent) {
+	for (ext2_node_t* node = fs->inode_hash[ino % EXT2_INODE_HASH_SIZE]; node; node = node->hash_next) {
+		if (node->node.inode == ino) {
+			return &node->node;
+		}
+	}
+
+	ext2_node_t* node = kmalloc(sizeof(ext2_node_t));
+	memset(node, 0, sizeof(ext2_node_t));
+	node->fs = fs;
+	node->map_ptrs = kmalloc(fs->block_size);
+	if (ext2_read_bytes(fs, ext2_inode_offset(fs, ino), sizeof(ext2_inode_t), &node->inode)) {
+		kfree(node->map_ptrs);
+		kfree(node);
+		return 0;
+	}
+
+	fs_node_t* fsnode = &node->node;
+	strcpy(fsnode->name, name);
+	fsnode->inode = ino;
+	fsnode->uid = node->inode.i_uid;
+	fsnode->gid = node->inode.i_gid;
+	fsnode->parent = parent;
+
+	ext2_setup_node(node);
+
+	node->hash_next = fs->inode_hash[ino % EXT2_INODE_HASH_SIZE];
+	fs->inode_hash[ino % EXT2_INODE_HASH_SIZE] = node;
+	return fsnode;
+}
+
+static fs_node_t* ext2_mount(block_device_t* dev) {
+	ext2_fs_t* fs = kmalloc(sizeof(ext2_fs_t));
+	memset(fs, 0, sizeof(ext2_fs_t));
+	fs->dev = dev;
+
+	if (bcache_read(dev, EXT2_SUPERBLOCK_OFFSET, sizeof(ext2_superblock_t), (uint8_t*)&fs->sb) != sizeof(ext2_superblock_t) ||
+		fs->sb.s_magic != EXT2_MAGIC) {
+		goto fail;
+	}
+
+	ext2_superblock_t* sb = &fs->sb;
+	if (sb->s_rev_level && (sb->s_feature_incompat & ~EXT2_SUPPORTED_INCOMPAT)) {
+		printf_err("ext2: %s uses unsupported features %x", dev->name, sb->s_feature_incompat & ~EXT2_SUPPORTED_INCOMPAT);
+		goto fail;
+	}
+	if (sb->s_log_block_size > 2 || !sb->s_blocks_per_group || !sb->s_inodes_per_group ||
+		sb->s_blocks_count <= sb->s_first_data_block) {
+		printf_err("ext2: %s has a bad superblock", dev->name);
+		goto fail;
+	}
+
+	fs->block_size = 1024 << sb->s_log_block_size;
+	fs->inode_size = sb->s_rev_level ? sb->s_inode_size : EXT2_GOOD_OLD_INODE_SIZE;
+	fs->ptrs_per_block = fs->block_size / sizeof(uint32_t);
+	fs->group_count = (sb->s_blocks_count - sb->s_first_data_block + sb->s_blocks_per_group - 1) / sb->s_blocks_per_group;
+	fs->read_only = !dev->write || (sb->s_rev_level && (sb->s_feature_ro_compat & ~EXT2_SUPPORTED_RO_COMPAT));
+	if (!fs->group_count) {
+		printf_err("ext2: %s has no block groups", dev->name);
+		goto fail;
+	}
+
+	uint32_t table_size = fs->group_count * sizeof(ext2_group_desc_t);
+	fs->groups = kmalloc(table_size);
+	if (ext2_read_bytes(fs, (sb->s_first_data_block + 1) * fs->block_size, table_size, fs->groups)) {
+		goto fail;
+	}
+
+	fs->bitmap_buf = kmalloc(fs->block_size);
+	fs->dir_buf = kmalloc(fs->block_size);
+	fs->lock = lock_create();
+
+	fs_node_t* root = ext2_get_node(fs, EXT2_ROOT_INO, "ext2", 0);
+	if (!root) {
+		printf_err("ext2: couldn't read root directory of %s", dev->name);
+		goto fail;
+	}
+	root->sync = &ext2_sync;
+
+	printf_info("ext2: %s has %d blocks of %d bytes in %d groups%s", dev->name, sb->s_blocks_count, fs->block_size, fs->group_count, fs->read_only ? ", read-only" : "");
+	return root;
+
+fail:
+	if (fs->lock) kfree(fs->lock);
+	if (fs->dir_buf) kfree(fs->dir_buf);
+	if (fs->bitmap_buf) kfree(fs->bitmap_buf);
+	if (fs->groups) kfree(fs->groups);
+	kfree(fs);
+	return NULL;
+}
+
+void ext2_install() {
+	fs_type_register("ext2", &ext2_mount);
+}
@@ -0,0 +1,162 @@
+#ifndef EXT2_H
+#define EXT2_H
+
+#include <std/std.h>
+#include "fs.h"
+#include "block.h"
+#include <kernel/util/mutex/mutex.h>
+
+#define EXT2_SUPERBLOCK_OFFSET	1024
+#define EXT2_MAGIC				0xEF53
+#define EXT2_ROOT_INO			2
+#define EXT2_GOOD_OLD_FIRST_INO	11
+#define EXT2_GOOD_OLD_INODE_SIZE 128
+
+#define EXT2_NDIR_BLOCKS	12
+#define EXT2_IND_BLOCK		12
+#define EXT2_DIND_BLOCK		13
+#define EXT2_TIND_BLOCK		14
+#define EXT2_N_BLOCKS		15
+
+#define EXT2_FEATURE_INCOMPAT_FILETYPE		0x0002
+#define EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER	0x0001
+#define EXT2_FEATURE_RO_COMPAT_LARGE_FILE	0x0002
+//features we can handle, anything else is refused or mounted read-only
+#define EXT2_SUPPORTED_INCOMPAT		EXT2_FEATURE_INCOMPAT_FILETYPE
+#define EXT2_SUPPORTED_RO_COMPAT	(EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER | EXT2_FEATURE_RO_COMPAT_LARGE_FILE)
+
+#define EXT2_S_IFMT		0xF000
+#define EXT2_S_IFIFO	0x1000
+#define EXT2_S_IFCHR	0x2000
+#define EXT2_S_IFDIR	0x4000
+#define EXT2_S_IFBLK	0x6000
+#define EXT2_S_IFREG	0x8000
+#define EXT2_S_IFLNK	0xA000
+
+#define EXT2_FT_REG_FILE	1
+#define EXT2_FT_DIR			2
+
+//in-memory inodes are kept in a hash table for as long as the filesystem is mounted
+#define EXT2_INODE_HASH_SIZE 64
+
+typedef struct ext2_superblock {
+	uint32_t s_inodes_count;
+	uint32_t s_blocks_count;
+	uint32_t s_r_blocks_count;
+	uint32_t s_free_blocks_count;
+	uint32_t s_free_inodes_count;
+	uint32_t s_first_data_block;
+	uint32_t s_log_block_size;
+	uint32_t s_log_frag_size;
+	uint32_t s_blocks_per_group;
+	uint32_t s_frags_per_group;
+	uint32_t s_inodes_per_group;
+	uint32_t s_mtime;
+	uint32_t s_wtime;
+	uint16_t s_mnt_count;
+	uint16_t s_max_mnt_count;
+	uint16_t s_magic;
+	uint16_t s_state;
+	uint16_t s_errors;
+	uint16_t s_minor_rev_level;
+	uint32_t s_lastcheck;
+	uint32_t s_checkinterval;
+	uint32_t s_creator_os;
+	uint32_t s_rev_level;
+	uint16_t s_def_resuid;
+	uint16_t s_def_resgid;
+	//revision 1 and up
+	uint32_t s_first_ino;
+	uint16_t s_inode_size;
+	uint16_t s_block_group_nr;
+	uint32_t s_feature_compat;
+	uint32_t s_feature_incompat;
+	uint32_t s_feature_ro_compat;
+	uint8_t s_uuid[16];
+	char s_volume_name[16];
+	char s_last_mounted[64];
+	uint32_t s_algo_bitmap;
+	uint8_t s_padding[820];
+} __attribute__((packed)) ext2_superblock_t;
+
+typedef struct ext2_group_desc {
+	uint32_t bg_block_bitmap;
+	uint32_t bg_inode_bitmap;
+	uint32_t bg_inode_table;
+	uint16_t bg_free_blocks_count;
+	uint16_t bg_free_inodes_count;
+	uint16_t bg_used_dirs_count;
+	uint16_t bg_pad;
+	uint8_t bg_reserved[12];
+} __attribute__((packed)) ext2_group_desc_t;
+
+typedef struct ext2_inode {
+	uint16_t i_mode;
+	uint16_t i_uid;
+	uint32_t i_size;
+	uint32_t i_atime;
+	uint32_t i_ctime;
+	uint32_t i_mtime;
+	uint32_t i_dtime;
+	uint16_t i_gid;
+	uint16_t i_links_count;
+	uint32_t i_blocks;		//in 512 byte units
+	uint32_t i_flags;
+	uint32_t i_osd1;
+	uint32_t i_block[EXT2_N_BLOCKS];
+	uint32_t i_generation;
+	uint32_t i_file_acl;
+	uint32_t i_dir_acl;		//high 32 bits of size for large files
+	uint32_t i_faddr;
+	uint8_t i_osd2[12];
+} ext2_inode_t;	//naturally aligned, not packed so i_block entries can be pointed at
+
+typedef struct ext2_dir_entry {
+	uint32_t inode;			//0 if entry is unused
+	uint16_t rec_len;		//distance to next entry
+	uint8_t name_len;
+	uint8_t file_type;		//only with EXT2_FEATURE_INCOMPAT_FILETYPE
+	char name[];
+} __attribute__((packed)) ext2_dir_entry_t;
+
+struct ext2_node;
+
+typedef struct ext2_fs {
+	block_device_t* dev;
+	ext2_superblock_t sb;
+	ext2_group_desc_t* groups;
+	uint32_t group_count;
+	uint32_t block_size;
+	uint32_t inode_size;
+	uint32_t ptrs_per_block;
+	bool read_only;
+	bool meta_dirty;		//sb or groups differ from what's on disk
+	uint8_t* bitmap_buf;	//scratch block for allocation
+	uint8_t* dir_buf;		//scratch block for directory walks
+	struct dirent dirent;
+	struct ext2_node* inode_hash[EXT2_INODE_HASH_SIZE];
+	lock_t* lock;
+} ext2_fs_t;
+
+typedef struct ext2_node {
+	fs_node_t node;			//must come first, callbacks are passed a pointer to it
+	ext2_fs_t* fs;
+	ext2_inode_t inode;
+
+	//pointer block used by the last block lookup past the direct blocks
+	//sequential access then costs one pointer block read per ptrs_per_block blocks
+	uint32_t map_block;		//disk block the pointers came from, 0 if none cached
+	uint32_t map_first;		//file block mapped by map_ptrs[0]
+	uint32_t* map_ptrs;
+
+	//an unlinked inode keeps its blocks until whoever still has it open closes it
+	uint32_t open_count;
+	bool unlinked;
+
+	struct ext2_node* hash_next;
+} ext2_node_t;
+
+//registers the ext2 driver with the mount layer
+void ext2_install();
+
+#endif
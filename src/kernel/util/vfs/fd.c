@@ -0,0 +1,281 @@
+#include "fd.h"
+#include "pipe.h"
+#include <std/kheap.h>
+#include <kernel/util/multitasking/tasks/task.h>
+#include <kernel/drivers/terminal/terminal.h>
+#include <kernel/drivers/kb/kb.h>
+
+extern task_t* current_task;
+
+static fs_node_t console;
+
+//blocks until at least one key is available, then hands back whatever else is buffered
+static uint32_t console_read(fs_node_t* UNUSED(node), uint32_t UNUSED(offset), uint32_t size, uint8_t* buffer) {
+	if (!size) return 0;
+
+	uint32_t count = 0;
+	//only sleep if nothing's waiting already
+	buffer[count++] = haskey() ? kgetch() : getchar();
+	while (count < size && haskey()) {
+		buffer[count++] = kgetch();
+	}
+	return count;
+}
+
+static uint32_t console_write(fs_node_t* UNUSED(node), uint32_t UNUSED(offset), uint32_t size, uint8_t* buffer) {
+	for (uint32_t i = 0; i < size; i++) {
+		terminal_putchar(buffer[i]);
+	}
+	return size;
+}
+
+static uint32_t console_poll(fs_node_t* UNUSED(node), uint32_t events) {
+	uint32_t ready = POLL_OUT;
+	if (haskey()) ready |= POLL_IN;
+	return ready & events;
+}
+
+static open_file_t* file_create(fs_node_t* node, int flags) {
+	open_file_t* file = kmalloc(sizeof(open_file_t));
+	memset(file, 0, sizeof(open_file_t));
+	file->node = node;
+	file->flags = flags;
+	file->refcount = 1;
+	file->lock = lock_create();
+	return file;
+}
+
+static void file_retain(open_file_t* file) {
+	lock(file->lock);
+	file->refcount++;
+	unlock(file->lock);
+}
+
+void file_release(open_file_t* file) {
+	lock(file->lock);
+	int remaining = --file->refcount;
+	unlock(file->lock);
+	if (remaining) return;
+
+	close_fs(file->node);
+	kfree(file->lock);
+	kfree(file);
+}
+
+fd_table_t* fd_table_create() {
+	if (!console.read) {
+		strcpy(console.name, "console");
+		console.flags = FS_CHARDEVICE;
+		console.read = console_read;
+		console.write = console_write;
+		console.poll = console_poll;
+	}
+
+	fd_table_t* table = kmalloc(sizeof(fd_table_t));
+	memset(table, 0, sizeof(fd_table_t));
+
+	//all three standard streams share one open file, as if dup'd
+	open_file_t* file = file_create(&console, O_RDWR);
+	table->files[STDIN_FILENO] = file;
+	file_retain(file);
+	table->files[STDOUT_FILENO] = file;
+	file_retain(file);
+	table->files[STDERR_FILENO] = file;
+	return table;
+}
+
+fd_table_t* fd_table_clone(fd_table_t* table) {
+	fd_table_t* clone = kmalloc(sizeof(fd_table_t));
+	memset(clone, 0, sizeof(fd_table_t));
+	for (int i = 0; i < FD_MAX; i++) {
+		if (!table->files[i]) continue;
+		file_retain(table->files[i]);
+		clone->files[i] = table->files[i];
+	}
+	return clone;
+}
+
+void fd_table_destroy(fd_table_t* table) {
+	for (int i = 0; i < FD_MAX; i++) {
+		if (table->files[i]) {
+			file_release(table->files[i]);
+		}
+	}
+	kfree(table);
+}
+
+static fd_table_t* current_table() {
+	if (!current_task) return NULL;
+	return current_task->files;
+}
+
+static open_file_t* fd_lookup(int fd) {
+	fd_table_t* table = current_table();
+	if (!table || fd < 0 || fd >= FD_MAX) return NULL;
+	return table->files[fd];
+}
+
+//puts file in the lowest free slot of the current table
+static int fd_install(open_file_t* file) {
+	fd_table_t* table = current_table();
+	if (!table) return -1;
+	for (int i = 0; i < FD_MAX; i++) {
+		if (!table->files[i]) {
+			table->files[i] = file;
+			return i;
+		}
+	}
+	return -1;
+}
+
+int open(const char* path, int flags) {
+	if (!path || !current_table()) return -1;
+
+	int mode = flags & O_ACCMODE;
+	bool writing = mode == O_WRONLY || mode == O_RDWR;
+
+	//tasks have no working directory, so paths are taken from the root
+	fs_node_t* node = fs_lookup(fs_root, (char*)path);
+	if (!node && (flags & O_CREAT)) {
+		node = fs_create(fs_root, (char*)path, FS_FILE);
+	}
+	if (!node) return -1;
+	if ((node->flags & 0x7) == FS_DIRECTORY && writing) return -1;
+
+	if (writing && (flags & O_TRUNC) && node->length) {
+		if (truncate_fs(node, 0)) return -1;
+	}
+
+	//opened before anything can release it, every close_fs() has a matching open_fs()
+	open_fs(node, mode != O_WRONLY, writing);
+	open_file_t* file = file_create(node, flags);
+	int fd = fd_install(file);
+	if (fd < 0) {
+		file_release(file);
+		return -1;
+	}
+	return fd;
+}
+
+int file_read(open_file_t* file, void* buf, uint32_t count, uint32_t offset) {
+	if ((file->flags & O_ACCMODE) == O_WRONLY) return -1;
+	if (offset != FD_OFFSET_CURRENT) {
+		return read_fs(file->node, offset, count, buf);
+	}
+
+	lock(file->lock);
+	uint32_t got = read_fs(file->node, file->offset, count, buf);
+	file->offset += got;
+	unlock(file->lock);
+	return got;
+}
+
+int file_write(open_file_t* file, void* buf, uint32_t count, uint32_t offset) {
+	if ((file->flags & O_ACCMODE) == O_RDONLY) return -1;
+	if (offset != FD_OFFSET_CURRENT) {
+		return write_fs(file->node, offset, count, buf);
+	}
+
+	lock(file->lock);
+	if (file->flags & O_APPEND) {
+		file->offset = file->node->length;
+	}
+	uint32_t wrote = write_fs(file->node, file->offset, count, buf);
+	file->offset += wrote;
+	unlock(file->lock);
+	return wrote;
+}
+
+uint32_t file_poll(open_file_t* file, uint32_t events) {
+	return poll_fs(file->node, events);
+}
+
+open_file_t* fd_acquire(int fd) {
+	open_file_t* file = fd_lookup(fd);
+	if (file) file_retain(file);
+	return file;
+}
+
+int read(int fd, void* buf, uint32_t count) {
+	open_file_t* file = fd_lookup(fd);
+	if (!file) return -1;
+	return file_read(file, buf, count, FD_OFFSET_CURRENT);
+}
+
+int write(int fd, void* buf, uint32_t count) {
+	open_file_t* file = fd_lookup(fd);
+	if (!file) return -1;
+	return file_write(file, buf, count, FD_OFFSET_CURRENT);
+}
+
+int lseek(int fd, int offset, int whence) {
+	open_file_t* file = fd_lookup(fd);
+	if (!file || (file->node->flags & 0x7) == FS_PIPE) return -1;
+
+	lock(file->lock);
+	int64_t base;
+	switch (whence) {
+		case SEEK_SET:
+			base = 0;
+			break;
+		case SEEK_CUR:
+			base = file->offset;
+			break;
+		case SEEK_END:
+			base = file->node->length;
+			break;
+		default:
+			unlock(file->lock);
+			return -1;
+	}
+	int64_t pos = base + offset;
+	//offsets past the end are fine, writing there leaves a hole
+	if (pos < 0 || pos > 0x7FFFFFFF) {
+		unlock(file->lock);
+		return -1;
+	}
+	file->offset = pos;
+	unlock(file->lock);
+	return pos;
+}
+
+int close(int fd) {
+	open_file_t* file = fd_lookup(fd);
+	if (!file) return -1;
+
+	current_table()->files[fd] = NULL;
+	file_release(file);
+	return 0;
+}
+
+int dup(int fd) {
+	open_file_t* file = fd_lookup(fd);
+	if (!file) return -1;
+
+	file_retain(file);
+	int new_fd = fd_install(file);
+	if (new_fd < 0) {
+		file_release(file);
+	}
+	return new_fd;
+}
+
+int pipe(int fds[2]) {
+	if (!current_table()) return -1;
+
+	pipe_t* new_pipe = pipe_create();
+	open_file_t* read_end = file_create(&new_pipe->read_end, O_RDONLY);
+	open_file_t* write_end = file_create(&new_pipe->write_end, O_WRONLY);
+	fds[0] = fd_install(read_end);
+	fds[1] = fds[0] < 0 ? -1 : fd_install(write_end);
+	if (fds[1] < 0) {
+		if (fds[0] >= 0) {
+			current_table()->files[fds[0]] = NULL;
+		}
+		//closing both ends frees the pipe
+		file_release(read_end);
+		file_release(write_end);
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef FD_H
+#define FD_H
+
+#include <std/std.h>
+#include "fs.h"
+#include <kernel/util/mutex/mutex.h>
+
+//descriptors available to each task
+#define FD_MAX 32
+
+#define STDIN_FILENO	0
+#define STDOUT_FILENO	1
+#define STDERR_FILENO	2
+
+//open() flags
+#define O_RDONLY	0x0000
+#define O_WRONLY	0x0001
+#define O_RDWR		0x0002
+#define O_ACCMODE	0x0003
+#define O_CREAT		0x0040
+#define O_TRUNC		0x0200
+#define O_APPEND	0x0400
+
+//offset argument meaning use and advance the open file's own offset
+#define FD_OFFSET_CURRENT 0xFFFFFFFF
+
+//an opened file
+//every descriptor made from it by dup() or fork() shares its offset
+typedef struct open_file {
+	fs_node_t* node;
+	uint32_t offset;
+	int flags;
+	int refcount;	//descriptors pointing at this, in any task
+	lock_t* lock;	//serializes offset updates between sharers
+} open_file_t;
+
+typedef struct fd_table {
+	open_file_t* files[FD_MAX];	//NULL if descriptor is free
+} fd_table_t;
+
+//empty table, with stdin/stdout/stderr attached to the console
+fd_table_t* fd_table_create();
+//copy of table for a forked task, sharing every open file with it
+fd_table_t* fd_table_clone(fd_table_t* table);
+//closes every descriptor and frees table
+void fd_table_destroy(fd_table_t* table);
+
+//takes a reference on the current task's open file for fd, which outlives a close() of fd
+//returns NULL if fd isn't open
+open_file_t* fd_acquire(int fd);
+//drops a reference taken by fd_acquire
+void file_release(open_file_t* file);
+
+//reads or writes file at offset, or at its own offset if offset is FD_OFFSET_CURRENT
+//returns bytes transferred, or -1 if file wasn't opened for it
+int file_read(open_file_t* file, void* buf, uint32_t count, uint32_t offset);
+int file_write(open_file_t* file, void* buf, uint32_t count, uint32_t offset);
+//returns which of the POLL_* events asked for wouldn't block on file
+uint32_t file_poll(open_file_t* file, uint32_t events);
+
+//descriptor based file access for the current task
+//these back the syscalls of the same names
+//all return -1 on error
+int open(const char* path, int flags);
+int read(int fd, void* buf, uint32_t count);
+int write(int fd, void* buf, uint32_t count);
+int lseek(int fd, int offset, int whence);
+int close(int fd);
+int dup(int fd);
+//makes a pipe, fds[0] is its read end and fds[1] its write end
+int pipe(int fds[2]);
+
+#endif
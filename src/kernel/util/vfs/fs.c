@@ -1,5 +1,9 @@
 #include "fs.h"
 #include <std/std.h>
+#include <std/math.h>
+#include "dcache.h"
+#include <kernel/util/paging/paging.h>
+#include "mount.h"
 
 fs_node_t* fs_root = 0; //filesystem root
 
@@ -52,10 +56,176 @@ fs_node_t* finddir_fs(fs_node_t* node, char* name) {
 	return 0;
 }
 
+void* mmap_fs(fs_node_t* node, uint32_t offset, uint32_t size) {
+	//does the node have an mmap callback?
+	if (!node->mmap || offset >= node->length) {
+		return NULL;
+	}
+	size = MIN(size, node->length - offset);
+
+	uint32_t phys = node->mmap(node, offset);
+	if (!phys) return NULL;
+	return map_shared(phys, size);
+}
+
+void munmap_fs(void* addr, uint32_t size) {
+	unmap_shared(addr, size);
+}
+
+fs_node_t* create_fs(fs_node_t* node, char* name, uint32_t type) {
+	//is the node a directory, and does it have a callback?
+	if ((node->flags & 0x7) != FS_DIRECTORY || !node->create) {
+		return 0;
+	}
+	fs_node_t* created = node->create(node, name, type);
+	//replaces any cached miss
+	dcache_invalidate(node, name);
+	return created;
+}
+
+int unlink_fs(fs_node_t* node, char* name) {
+	//is the node a directory, and does it have a callback?
+	if ((node->flags & 0x7) != FS_DIRECTORY || !node->unlink) {
+		return -1;
+	}
+	//forget the victim before its node goes away
+	fs_node_t* victim = finddir_fs(node, name);
+	if (victim) {
+		dcache_invalidate_node(victim);
+	}
+	dcache_invalidate(node, name);
+	return node->unlink(node, name);
+}
+
+int truncate_fs(fs_node_t* node, uint32_t length) {
+	//does the node have a truncate callback?
+	if (node->truncate) {
+		return node->truncate(node, length);
+	}
+	return -1;
+}
+
+uint32_t poll_fs(fs_node_t* node, uint32_t events) {
+	//does the node have a poll callback?
+	if (node->poll) {
+		return node->poll(node, events);
+	}
+	return events;
+}
+
+int sync_fs(fs_node_t* root) {
+	//does the node have a sync callback?
+	if (root->sync) {
+		return root->sync(root);
+	}
+	return 0;
+}
+
+//descends into whatever is mounted over node
+static fs_node_t* fs_follow_mounts(fs_node_t* node) {
+	while ((node->flags & FS_MOUNTPOINT) && node->ptr) {
+		node = node->ptr;
+	}
+	return node;
+}
+
+static fs_node_t* fs_lookup_parent(fs_node_t* node) {
+	//the root of a mounted filesystem leads back out to the directory it covers
+	mount_t* mount;
+	while ((mount = mount_find_root(node))) {
+		node = mount->mountpoint;
+	}
+	//.. of the root is the root
+	return node->parent ? node->parent : node;
+}
+
+static fs_node_t* fs_lookup_component(fs_node_t* dir, char* name) {
+	fs_node_t* node;
+	if (dcache_lookup(dir, name, &node)) {
+		return node;
+	}
+	node = finddir_fs(dir, name);
+	//misses are remembered too, so probing for missing files stays cheap
+	dcache_insert(dir, name, node);
+	return node;
+}
+
+fs_node_t* fs_lookup(fs_node_t* cwd, char* path) {
+	if (!path || !fs_root) return NULL;
+
+	fs_node_t* node = (*path == '/' || !cwd) ? fs_root : cwd;
+	node = fs_follow_mounts(node);
+
+	char component[sizeof(node->name)];
+	while (*path) {
+		while (*path == '/') path++;
+		if (!*path) break;
+
+		uint32_t len = 0;
+		while (path[len] && path[len] != '/') len++;
+		if (len >= sizeof(component)) return NULL;
+		memcpy(component, path, len);
+		component[len] = '\0';
+		path += len;
+
+		if (!strcmp(component, ".")) continue;
+		if (!strcmp(component, "..")) {
+			node = fs_follow_mounts(fs_lookup_parent(node));
+			continue;
+		}
+
+		node = fs_lookup_component(node, component);
+		if (!node) return NULL;
+		node = fs_follow_mounts(node);
+	}
+	return node;
+}
+
+//finds the directory holding the last component of path
+//the component is copied into leaf
+static fs_node_t* fs_lookup_leaf(fs_node_t* cwd, char* path, char* leaf) {
+	int len = strlen(path);
+	//ignore trailing slashes
+	while (len > 1 && path[len - 1] == '/') len--;
+	int start = len;
+	while (start > 0 && path[start - 1] != '/') start--;
+
+	if (len - start <= 0 || len - start >= (int)sizeof(((fs_node_t*)0)->name)) {
+		return NULL;
+	}
+	memcpy(leaf, path + start, len - start);
+	leaf[len - start] = '\0';
+	if (!strcmp(leaf, ".") || !strcmp(leaf, "..")) {
+		return NULL;
+	}
+
+	//lookup of the directory part, keeping a leading / for absolute paths
+	char* dir = kmalloc(start + 2);
+	memcpy(dir, path, start);
+	dir[start] = '\0';
+	fs_node_t* parent = fs_lookup(cwd, start ? dir : ".");
+	kfree(dir);
+	return parent;
+}
+
+fs_node_t* fs_create(fs_node_t* cwd, char* path, uint32_t type) {
+	char leaf[sizeof(((fs_node_t*)0)->name)];
+	fs_node_t* parent = fs_lookup_leaf(cwd, path, leaf);
+	if (!parent) return NULL;
+	return create_fs(parent, leaf, type);
+}
+
+int fs_unlink(fs_node_t* cwd, char* path) {
+	char leaf[sizeof(((fs_node_t*)0)->name)];
+	fs_node_t* parent = fs_lookup_leaf(cwd, path, leaf);
+	if (!parent) return -1;
+	return unlink_fs(parent, leaf);
+}
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 FILE* fopen(char* filename, char* mode) {
-	fs_node_t* file = finddir_fs(fs_root, filename);
+	fs_node_t* file = fs_lookup(fs_root, filename);
 	if (!file) {
 		printf_err("Couldn't find file %s", filename);
 		return NULL;
@@ -64,23 +234,43 @@ FILE* fopen(char* filename, char* mode) {
 	memset(stream, 0, sizeof(FILE));
 	stream->node = file;
 	stream->fpos = 0;
+	open_fs(file, 1, 0);
+	stream->buf = (uint8_t*)kmalloc(FILE_BUFFER_SIZE);
 	return stream;
 }
 #pragma GCC diagnostic pop
 
 void fclose(FILE* stream) {
+	close_fs(stream->node);
+	kfree(stream->buf);
 	kfree(stream);
 }
 
-uint8_t fgetc(FILE* stream) {
-	uint8_t ch;
-	uint32_t sz = read_fs(stream->node, stream->fpos++, 1, &ch);
-	if ((int8_t)ch == EOF || !sz) return EOF;
-	return ch;
+//refills the stream buffer starting at the current position
+//returns number of bytes now available
+static uint32_t fill_buffer(FILE* stream) {
+	stream->buf_start = stream->fpos;
+	stream->buf_len = read_fs(stream->node, stream->fpos, FILE_BUFFER_SIZE, stream->buf);
+	return stream->buf_len;
+}
+
+//number of buffered bytes at the current position
+static uint32_t buffered(FILE* stream) {
+	if (stream->fpos < stream->buf_start || stream->fpos >= stream->buf_start + stream->buf_len) {
+		return 0;
+	}
+	return stream->buf_start + stream->buf_len - stream->fpos;
+}
+
+int fgetc(FILE* stream) {
+	if (!buffered(stream) && !fill_buffer(stream)) {
+		return EOF;
+	}
+	return stream->buf[stream->fpos++ - stream->buf_start];
 }
 
 char* fgets(char* buf, int count, FILE* stream) {
-	int c;
+	int c = 0;
 	char* cs = buf;
 	while (--count > 0 && (c = fgetc(stream)) != EOF) {
 		//place input char in current position, then increment
@@ -92,13 +282,58 @@ char* fgets(char* buf, int count, FILE* stream) {
 }
 
 uint32_t fread(void* buffer, uint32_t size, uint32_t count, FILE* stream) {
-	unsigned char* chbuf = (unsigned char*)buffer;
-	uint32_t sum;
-	for (uint32_t i = 0; i < count; i++) {
-		unsigned char buf;
-		sum += read_fs(stream->node, stream->fpos++, size, (uint8_t*)&buf);
-		//TODO check for eof and break early
-		chbuf[i] = buf;
-	}
-	return sum;
+	if (!size) return 0;
+
+	uint8_t* out = (uint8_t*)buffer;
+	uint32_t total = size * count;
+	uint32_t done = 0;
+
+	//whatever's already buffered
+	uint32_t avail = buffered(stream);
+	if (avail) {
+		uint32_t chunk = MIN(avail, total);
+		memcpy(out, stream->buf + (stream->fpos - stream->buf_start), chunk);
+		stream->fpos += chunk;
+		done += chunk;
+	}
+
+	if (total - done >= FILE_BUFFER_SIZE) {
+		//large reads go straight into the caller's buffer in one call
+		uint32_t got = read_fs(stream->node, stream->fpos, total - done, out + done);
+		stream->fpos += got;
+		done += got;
+	}
+	else if (done < total && fill_buffer(stream)) {
+		uint32_t chunk = MIN(stream->buf_len, total - done);
+		memcpy(out + done, stream->buf, chunk);
+		stream->fpos += chunk;
+		done += chunk;
+	}
+	return done / size;
+}
+
+int fseek(FILE* stream, int32_t offset, int whence) {
+	int32_t base;
+	switch (whence) {
+		case SEEK_SET:
+			base = 0;
+			break;
+		case SEEK_CUR:
+			base = stream->fpos;
+			break;
+		case SEEK_END:
+			base = stream->node->length;
+			break;
+		default:
+			return -1;
+	}
+	if (base + offset < 0) return -1;
+
+	//the buffer is kept, it's still valid if we seek back into it
+	stream->fpos = base + offset;
+	return 0;
+}
+
+uint32_t ftell(FILE* stream) {
+	return stream->fpos;
 }
@@ -13,6 +13,9 @@
 
 #define EOF (-1)
 
+#define POLL_IN		0x1	//read won't block
+#define POLL_OUT	0x4	//write won't block
+
 struct fs_node;
 
 typedef uint32_t (*read_type_t)(struct fs_node*, uint32_t, uint32_t, uint8_t*);
@@ -21,6 +24,20 @@ typedef void (*open_type_t)(struct fs_node*);
 typedef void (*close_type_t)(struct fs_node*);
 typedef struct dirent * (*readdir_type_t)(struct fs_node*, uint32_t);
 typedef struct fs_node * (*finddir_type_t)(struct fs_node*, char* name);
+//returns the physical address of the byte at offset, or 0 if it can't be mapped
+//the file's memory must be physically contiguous from there to the end of the file
+typedef uint32_t (*mmap_type_t)(struct fs_node*, uint32_t offset);
+//makes a new FS_FILE or FS_DIRECTORY called name in a directory
+typedef struct fs_node * (*create_type_t)(struct fs_node*, char* name, uint32_t type);
+//removes name from a directory, returns 0 on success
+typedef int (*unlink_type_t)(struct fs_node*, char* name);
+//sets a file's length, returns 0 on success
+typedef int (*truncate_type_t)(struct fs_node*, uint32_t length);
+//returns which of the POLL_* events asked for can be handled now without blocking
+typedef uint32_t (*poll_type_t)(struct fs_node*, uint32_t events);
+//writes back whatever the filesystem holds only in memory, returns 0 on success
+//only set on the root of a filesystem
+typedef int (*sync_type_t)(struct fs_node*);
 
 typedef struct fs_node {
 	char name[128]; 	//filename
@@ -37,13 +54,29 @@ typedef struct fs_node {
 	close_type_t close;
 	readdir_type_t readdir;
 	finddir_type_t finddir;
+	mmap_type_t mmap;
+	create_type_t create;
+	unlink_type_t unlink;
+	truncate_type_t truncate;
+	poll_type_t poll;
+	sync_type_t sync;
 	struct fs_node* ptr;	//used by mountpoints and symlinks
 	struct fs_node* parent; //parent directory of this node
 } fs_node_t;
 
+//bytes read ahead into each stream's buffer
+#define FILE_BUFFER_SIZE 4096
+
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
 typedef struct file_t {
-	uint32_t fpos;
+	uint32_t fpos;		//offset of the next byte handed out
 	fs_node_t* node;
+	uint8_t* buf;		//bytes of the file starting at buf_start
+	uint32_t buf_start;
+	uint32_t buf_len;	//number of valid bytes in buf
 } FILE;
 
 struct dirent {
@@ -63,10 +96,39 @@ void close_fs(fs_node_t* node);
 struct dirent* readdir_fs(fs_node_t* node, uint32_t index);
 fs_node_t* finddir_fs(fs_node_t* node, char* name);
 
+//maps size bytes of node starting at offset into the current address space,
+//read-only and shared with the filesystem's own copy
+//returns NULL if the filesystem doesn't support mapping
+void* mmap_fs(fs_node_t* node, uint32_t offset, uint32_t size);
+fs_node_t* create_fs(fs_node_t* node, char* name, uint32_t type);
+int unlink_fs(fs_node_t* node, char* name);
+int truncate_fs(fs_node_t* node, uint32_t length);
+//nodes without a poll callback never block, so are always ready
+uint32_t poll_fs(fs_node_t* node, uint32_t events);
+//filesystems that write everything through straight away have nothing to sync
+int sync_fs(fs_node_t* root);
+void munmap_fs(void* addr, uint32_t size);
+
+//resolves path one component at a time, relative to cwd unless path starts with /
+//handles . and .., crosses mountpoints, and caches every component looked up
+//returns NULL if any component doesn't exist
+fs_node_t* fs_lookup(fs_node_t* cwd, char* path);
+
+//path based versions of create_fs and unlink_fs
+//the directory containing the last component must already exist
+fs_node_t* fs_create(fs_node_t* cwd, char* path, uint32_t type);
+int fs_unlink(fs_node_t* cwd, char* path);
+
 FILE* fopen(char* filename, char* mode);
 void fclose(FILE* stream);
 
-uint8_t fgetc(FILE* stream);
+int fgetc(FILE* stream);
+char* fgets(char* buf, int count, FILE* stream);
+//returns number of whole elements read
 uint32_t fread(void* buffer, uint32_t size, uint32_t count, FILE* stream);
 
+//returns 0 on success, -1 if the new position would be invalid
+int fseek(FILE* stream, int32_t offset, int whence);
+uint32_t ftell(FILE* stream);
+
 #endif
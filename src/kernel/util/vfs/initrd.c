@@ -1,117 +1,193 @@
 #include "initrd.h"
 #include <std/std.h>
+#include <std/math.h>
+#include <std/lz4.h>
+#include <kernel/util/paging/paging.h>
+#include <kernel/util/mutex/mutex.h>
 
-initrd_header_t* initrd_header;		//header
-initrd_file_header_t* file_headers;	//list of file headers
-fs_node_t* initrd_root;			//root directory node
-fs_node_t* initrd_dev;			//add directory node for /dev so we can mount devfs later on
-fs_node_t* root_nodes;			//list of file nodes
-uint8_t nroot_nodes;			//number of file nodes
+//decompressed blocks kept around for reads which don't cover a whole block
+#define INITRD_CACHE_BLOCKS 4
 
-struct dirent dirent;
+typedef struct {
+	uint32_t block;			//index into block table, 0xFFFFFFFF if unused
+	uint8_t* data;
+	uint32_t size;
+} initrd_cached_block_t;
 
-static uint32_t initrd_read(fs_node_t* node, uint32_t offset, uint32_t size, uint8_t* buffer) {
-	initrd_file_header_t header = file_headers[node->inode];
-	if (offset >= header.length) {
-		*buffer = EOF;
-		return 0;
+static uint8_t* initrd_base;			//start of image in memory
+static initrd_header_t* initrd_header;	//header
+static initrd_node_t* initrd_nodes;		//node table
+static uint32_t* initrd_index;			//name index buckets
+static initrd_block_t* initrd_blocks;	//block table
+static char* initrd_names;				//name strings
+static fs_node_t* fs_nodes;				//fs node for every initrd node
+
+static initrd_cached_block_t block_cache[INITRD_CACHE_BLOCKS];
+static uint32_t block_cache_next = 0;
+static lock_t* initrd_lock;
+
+static struct dirent dirent;
+
+//uncompressed size of the nth block of node
+static uint32_t initrd_block_length(initrd_node_t* node, uint32_t n) {
+	uint32_t start = n * initrd_header->block_size;
+	return MIN(initrd_header->block_size, node->length - start);
+}
+
+//decodes block into dst, which has room for size bytes
+static bool initrd_decode(uint32_t block, uint8_t* dst, uint32_t size) {
+	initrd_block_t* entry = &initrd_blocks[block];
+	uint8_t* src = initrd_base + entry->offset;
+	if (entry->size & INITRD_BLOCK_STORED) {
+		memcpy(dst, src, size);
+		return true;
 	}
-	if (offset + size > header.length) {
-		size = header.length - offset;
+	if (lz4_decompress(src, entry->size, dst, size) != (int)size) {
+		printf_err("initrd: block %d is corrupt", block);
+		return false;
 	}
-	memcpy(buffer, (uint8_t*)(header.offset + offset), size);
-	return size;
+	return true;
 }
 
-static struct dirent* initrd_readdir(fs_node_t* node, uint32_t index) {
-	if (node == initrd_root && index == 0) {
-		strcpy(dirent.name, "dev");
-		dirent.name[3] = 0; //null terminate string
-		dirent.ino = 0;
-		return &dirent;
+//returns decoded contents of block, decompressing it if it isn't cached
+//called with initrd_lock held
+static uint8_t* initrd_cached_block(uint32_t block, uint32_t size) {
+	for (int i = 0; i < INITRD_CACHE_BLOCKS; i++) {
+		if (block_cache[i].block == block) {
+			return block_cache[i].data;
+		}
 	}
 
-	if (index - 1 >= nroot_nodes) {
+	initrd_cached_block_t* slot = &block_cache[block_cache_next];
+	block_cache_next = (block_cache_next + 1) % INITRD_CACHE_BLOCKS;
+	slot->block = 0xFFFFFFFF;
+	if (!initrd_decode(block, slot->data, size)) {
+		return NULL;
+	}
+	slot->block = block;
+	return slot->data;
+}
+
+static uint32_t initrd_read(fs_node_t* fsnode, uint32_t offset, uint32_t size, uint8_t* buffer) {
+	initrd_node_t* node = &initrd_nodes[fsnode->inode];
+	if (offset >= node->length) {
 		return 0;
 	}
-	char* name = root_nodes[index - 1].name;
-	strcpy(dirent.name, name);
-	dirent.name[strlen(name)] = 0; //null terminate string
-	dirent.ino = root_nodes[index-1].inode;
-	return &dirent;
+	if (offset + size > node->length) {
+		size = node->length - offset;
+	}
+
+	uint32_t block_size = initrd_header->block_size;
+	uint32_t done = 0;
+	lock(initrd_lock);
+	while (done < size) {
+		uint32_t n = (offset + done) / block_size;
+		uint32_t block_off = (offset + done) % block_size;
+		uint32_t block_len = initrd_block_length(node, n);
+		uint32_t chunk = MIN(size - done, block_len - block_off);
+		uint32_t block = node->first_block + n;
+		initrd_block_t* entry = &initrd_blocks[block];
+
+		if (entry->size & INITRD_BLOCK_STORED) {
+			memcpy(buffer + done, initrd_base + entry->offset + block_off, chunk);
+		}
+		else if (chunk == block_len) {
+			//whole block wanted, decompress straight into the caller's buffer
+			if (!initrd_decode(block, buffer + done, chunk)) break;
+		}
+		else {
+			uint8_t* data = initrd_cached_block(block, block_len);
+			if (!data) break;
+			memcpy(buffer + done, data + block_off, chunk);
+		}
+		done += chunk;
+	}
+	unlock(initrd_lock);
+	return done;
 }
 
-static fs_node_t* initrd_finddir(fs_node_t* node, char* name) {
-	if (node == initrd_root && !strcmp(name, "dev")) {
-		return initrd_dev;
+static uint32_t initrd_mmap(fs_node_t* fsnode, uint32_t offset) {
+	initrd_node_t* node = &initrd_nodes[fsnode->inode];
+	//only files kept uncompressed can be used in place
+	if (!(node->flags & INITRD_NODE_STORED)) {
+		return 0;
 	}
+	//stored blocks of a file are laid out back to back
+	return virt_to_phys((uint32_t)initrd_base + initrd_blocks[node->first_block].offset + offset);
+}
 
-	for (int i = 0; i < nroot_nodes; i++) {
-		if (!strcmp(name, root_nodes[i].name)) {
-			return &root_nodes[i];
+static struct dirent* initrd_readdir(fs_node_t* fsnode, uint32_t index) {
+	uint32_t child = initrd_nodes[fsnode->inode].first_child;
+	while (child && index--) {
+		child = initrd_nodes[child].next_sibling;
+	}
+	if (!child) {
+		return 0;
+	}
+	strcpy(dirent.name, fs_nodes[child].name);
+	dirent.ino = child;
+	return &dirent;
+}
+
+static fs_node_t* initrd_finddir(fs_node_t* fsnode, char* name) {
+	uint32_t parent = fsnode->inode;
+	uint32_t bucket = initrd_name_hash(parent, name) & (initrd_header->hash_size - 1);
+	for (uint32_t i = initrd_index[bucket]; i; i = initrd_nodes[i].hash_next) {
+		if (initrd_nodes[i].parent == parent && !strcmp(name, fs_nodes[i].name)) {
+			return &fs_nodes[i];
 		}
 	}
 	return 0;
 }
 
 fs_node_t* initrd_install(uint32_t location) {
-	//initialize main and file header pointers and populate root directory
+	initrd_base = (uint8_t*)location;
 	initrd_header = (initrd_header_t*)location;
-	file_headers = (initrd_file_header_t*)(location + sizeof(initrd_header_t));
-
-	//initialize root directory
-	initrd_root = (fs_node_t*)kmalloc(sizeof(fs_node_t));
-	strcpy(initrd_root->name, "initrd");
-	initrd_root->mask = initrd_root->uid = initrd_root->gid = initrd_root->inode = initrd_root->length = 0;
-	initrd_root->flags = FS_DIRECTORY;
-	initrd_root->read = 0;
-	initrd_root->write = 0;
-	initrd_root->open = 0;
-	initrd_root->close = 0;
-	initrd_root->readdir = &initrd_readdir;
-	initrd_root->finddir = &initrd_finddir;
-	initrd_root->ptr = 0;
-	initrd_root->impl = 0;
-
-	//initializes /dev directory
-	initrd_dev = (fs_node_t*)kmalloc(sizeof(fs_node_t));
-	strcpy(initrd_dev->name, "dev");
-	initrd_dev->mask = initrd_dev->uid = initrd_dev->gid = initrd_dev->inode = initrd_dev->length = 0;
-	initrd_dev->flags = FS_DIRECTORY;
-	initrd_dev->read = 0;
-	initrd_dev->write = 0;
-	initrd_dev->open = 0;
-	initrd_dev->close = 0;
-	initrd_dev->readdir = &initrd_readdir;
-	initrd_dev->finddir = &initrd_finddir;
-	initrd_dev->ptr = 0;
-	initrd_dev->impl = 0;
-	initrd_dev->parent = initrd_root;
-
-	root_nodes = (fs_node_t*)kmalloc(sizeof(fs_node_t) * initrd_header->nfiles);
-	nroot_nodes = initrd_header->nfiles;
-
-	//for every file
-	for (uint8_t i = 0 ; i < initrd_header->nfiles; i++) {
-		//edit every file's header
-		//currently, holds file offset relative to start of ramdisk
-		//we want it relative to the start of memory
-		file_headers[i].offset += location;
-		//create new file node
-		strcpy(root_nodes[i].name, (const char*)&file_headers[i].name);
-		root_nodes[i].mask = root_nodes[i].uid = root_nodes[i].gid = 0;
-		root_nodes[i].length = file_headers[i].length;
-		root_nodes[i].inode = i;
-		root_nodes[i].flags = FS_FILE;
-		root_nodes[i].read = &initrd_read;
-		root_nodes[i].write = 0;
-		root_nodes[i].open = 0;
-		root_nodes[i].close = 0;
-		root_nodes[i].readdir = 0;
-		root_nodes[i].finddir = 0;
-		root_nodes[i].impl = 0;
-		root_nodes[i].parent = initrd_root;
+	ASSERT(initrd_header->magic == INITRD_MAGIC && initrd_header->version == INITRD_VERSION, "initrd image has unknown format");
+
+	initrd_nodes = (initrd_node_t*)(initrd_base + initrd_header->nodes_offset);
+	initrd_index = (uint32_t*)(initrd_base + initrd_header->hash_offset);
+	initrd_blocks = (initrd_block_t*)(initrd_base + initrd_header->blocks_offset);
+	initrd_names = (char*)(initrd_base + initrd_header->names_offset);
+	initrd_lock = lock_create();
+
+	for (int i = 0; i < INITRD_CACHE_BLOCKS; i++) {
+		block_cache[i].block = 0xFFFFFFFF;
+		block_cache[i].data = kmalloc(initrd_header->block_size);
+	}
+
+	uint32_t count = initrd_header->node_count;
+	fs_nodes = (fs_node_t*)kmalloc(sizeof(fs_node_t) * count);
+	memset(fs_nodes, 0, sizeof(fs_node_t) * count);
+
+	uint32_t compressed = 0;
+	uint32_t uncompressed = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		initrd_node_t* node = &initrd_nodes[i];
+		fs_node_t* fsnode = &fs_nodes[i];
+
+		strcpy(fsnode->name, i ? initrd_names + node->name : "initrd");
+		fsnode->inode = i;
+		fsnode->flags = node->flags & 0x7;
+		fsnode->parent = i ? &fs_nodes[node->parent] : 0;
+
+		if (fsnode->flags == FS_DIRECTORY) {
+			fsnode->readdir = &initrd_readdir;
+			fsnode->finddir = &initrd_finddir;
+			continue;
+		}
+
+		fsnode->length = node->length;
+		fsnode->read = &initrd_read;
+		fsnode->mmap = &initrd_mmap;
+
+		uint32_t blocks = (node->length + initrd_header->block_size - 1) / initrd_header->block_size;
+		for (uint32_t b = 0; b < blocks; b++) {
+			compressed += initrd_blocks[node->first_block + b].size & ~INITRD_BLOCK_STORED;
+		}
+		uncompressed += node->length;
 	}
+	printf_info("initrd: %d nodes, %dkb of files in %dkb", count, uncompressed / 1024, compressed / 1024);
 
-	return initrd_root;
+	return &fs_nodes[0];
 }
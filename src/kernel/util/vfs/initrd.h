@@ -4,16 +4,57 @@
 #include <std/common.h>
 #include "fs.h"
 
+//image layout, as written by fsgen:
+//header, node table, name index, block table, name strings, file data
+//all offsets are from the start of the image
+#define INITRD_MAGIC	0x44525841 //"AXRD"
+#define INITRD_VERSION	2
+
+//node flags, besides the FS_FILE/FS_DIRECTORY type
+#define INITRD_NODE_STORED	0x100 //every block of the file is stored uncompressed
+
+//set in a block's size if it was stored uncompressed
+#define INITRD_BLOCK_STORED	0x80000000
+
 typedef struct {
-	uint32_t nfiles;	//# of files in ramdisk
+	uint32_t magic;
+	uint32_t version;
+	uint32_t node_count;	//node 0 is the root directory
+	uint32_t hash_size;		//buckets in the name index, a power of 2
+	uint32_t block_size;	//uncompressed size of every block except a file's last
+	uint32_t nodes_offset;
+	uint32_t hash_offset;
+	uint32_t blocks_offset;
+	uint32_t names_offset;
 } initrd_header_t;
 
 typedef struct {
-	uint8_t magic;	//magic number
-	int8_t name[64]; //filename
-	uint32_t offset; //offset in initrd that file starts
-	uint32_t length; //length of file
-} initrd_file_header_t;
+	uint32_t name;			//offset into name strings
+	uint32_t flags;
+	uint32_t parent;		//index of containing directory
+	uint32_t length;		//uncompressed length of file
+	uint32_t first_block;	//index into block table
+	uint32_t first_child;	//first entry of a directory, 0 if empty
+	uint32_t next_sibling;	//next entry in the same directory, 0 at the end
+	uint32_t hash_next;		//next node in the same index bucket, 0 at the end
+} initrd_node_t;
+
+typedef struct {
+	uint32_t offset;
+	uint32_t size;			//compressed size, with INITRD_BLOCK_STORED if kept as is
+} initrd_block_t;
+
+//hash of a name within directory parent, used to index the name table
+//fsgen uses the same function to build it
+static inline uint32_t initrd_name_hash(uint32_t parent, const char* name) {
+	//FNV-1a seeded with the directory
+	uint32_t hash = 2166136261u ^ parent;
+	while (*name) {
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
 
 //initializes initial ramdisk
 //gets passed address of multiboot module,
@@ -0,0 +1,134 @@
+#include "mount.h"
+#include <std/kheap.h>
+#include <std/array_m.h>
+#include "dcache.h"
+#include "bcache.h"
+
+static array_m* fs_types = 0;
+static array_m* mounts = 0;
+
+bool fs_type_register(char* name, fs_mount_t mount) {
+	if (!fs_types) {
+		fs_types = array_m_create(MAX_FS_TYPES);
+	}
+	if (fs_types->size >= MAX_FS_TYPES) {
+		printf_err("Not registering filesystem %s, too many in use!", name);
+		return false;
+	}
+
+	if (strlen(name) >= sizeof(((fs_type_t*)0)->name)) {
+		printf_err("Filesystem name %s is too long", name);
+		return false;
+	}
+
+	fs_type_t* type = kmalloc(sizeof(fs_type_t));
+	memset(type, 0, sizeof(fs_type_t));
+	strcpy(type->name, name);
+	type->mount = mount;
+	array_m_insert(fs_types, type);
+	return true;
+}
+
+fs_node_t* fs_mount_device(block_device_t* dev, char* type) {
+	if (!dev || !fs_types) return NULL;
+
+	for (int i = 0; i < fs_types->size; i++) {
+		fs_type_t* fs = array_m_lookup(fs_types, i);
+		if (type && strcmp(fs->name, type)) continue;
+
+		fs_node_t* root = fs->mount(dev);
+		if (root) {
+			printf_info("Mounted %s as %s", dev->name, fs->name);
+			return root;
+		}
+	}
+	printf_err("No filesystem recognized on %s", dev->name);
+	return NULL;
+}
+
+bool vfs_mount(fs_node_t* mountpoint, fs_node_t* root, block_device_t* dev) {
+	if (!mountpoint || !root) return false;
+	if ((mountpoint->flags & 0x7) != FS_DIRECTORY) {
+		printf_err("Can't mount over %s, not a directory", mountpoint->name);
+		return false;
+	}
+	if (mountpoint->flags & FS_MOUNTPOINT) {
+		printf_err("%s is already a mountpoint", mountpoint->name);
+		return false;
+	}
+
+	if (!mounts) {
+		mounts = array_m_create(MAX_MOUNTS);
+	}
+	if (mounts->size >= MAX_MOUNTS) {
+		printf_err("Not mounting over %s, mount table full", mountpoint->name);
+		return false;
+	}
+
+	mount_t* mount = kmalloc(sizeof(mount_t));
+	mount->mountpoint = mountpoint;
+	mount->root = root;
+	mount->dev = dev;
+	array_m_insert(mounts, mount);
+
+	//lookups cache what finddir returns and follow mountpoints afterwards,
+	//so existing dentries stay valid
+	mountpoint->ptr = root;
+	mountpoint->flags |= FS_MOUNTPOINT;
+	return true;
+}
+
+bool vfs_umount(fs_node_t* mountpoint) {
+	if (!mounts || !mountpoint) return false;
+
+	for (int i = 0; i < mounts->size; i++) {
+		mount_t* mount = array_m_lookup(mounts, i);
+		if (mount->mountpoint != mountpoint) continue;
+
+		if (sync_fs(mount->root)) {
+			printf_err("Couldn't write back %s before unmounting", mount->dev ? mount->dev->name : mountpoint->name);
+		}
+		if (mount->dev) {
+			bcache_sync(mount->dev);
+		}
+
+		array_m_remove(mounts, i);
+		mountpoint->flags &= ~FS_MOUNTPOINT;
+		mountpoint->ptr = 0;
+		//nodes of the unmounted filesystem may be freed by its driver
+		dcache_invalidate_all();
+		kfree(mount);
+		return true;
+	}
+	return false;
+}
+
+int vfs_sync() {
+	int err = 0;
+	for (uint32_t i = 0; i < mount_count(); i++) {
+		if (sync_fs(mount_get(i)->root)) err = -1;
+	}
+	if (bcache_sync(NULL)) err = -1;
+	return err;
+}
+
+mount_t* mount_find_root(fs_node_t* root) {
+	if (!mounts) return NULL;
+
+	for (int i = 0; i < mounts->size; i++) {
+		mount_t* mount = array_m_lookup(mounts, i);
+		if (mount->root == root) {
+			return mount;
+		}
+	}
+	return NULL;
+}
+
+mount_t* mount_get(uint32_t index) {
+	if (!mounts || index >= (uint32_t)mounts->size) return NULL;
+	return array_m_lookup(mounts, index);
+}
+
+uint32_t mount_count() {
+	return mounts ? mounts->size : 0;
+}
@@ -0,0 +1,52 @@
+#ifndef MOUNT_H
+#define MOUNT_H
+
+#include <std/std.h>
+#include "fs.h"
+#include "block.h"
+
+#define MAX_FS_TYPES 8
+#define MAX_MOUNTS 16
+
+//reads the filesystem on dev and returns its root directory node
+//returns NULL if dev doesn't hold this kind of filesystem
+typedef fs_node_t* (*fs_mount_t)(block_device_t* dev);
+
+typedef struct fs_type {
+	char name[16];
+	fs_mount_t mount;
+} fs_type_t;
+
+typedef struct mount {
+	fs_node_t* mountpoint;	//directory covered by the mounted filesystem
+	fs_node_t* root;		//root directory of the mounted filesystem
+	block_device_t* dev;	//backing device, NULL for virtual filesystems
+} mount_t;
+
+//makes a filesystem driver available for mounting
+bool fs_type_register(char* name, fs_mount_t mount);
+
+//mounts the filesystem on dev with the driver called type
+//if type is NULL, every registered driver is tried in turn
+//returns the root node of the filesystem, or NULL on failure
+fs_node_t* fs_mount_device(block_device_t* dev, char* type);
+
+//attaches the filesystem rooted at root over the directory mountpoint
+//path lookups entering mountpoint continue in root instead
+bool vfs_mount(fs_node_t* mountpoint, fs_node_t* root, block_device_t* dev);
+
+//detaches whatever is mounted over mountpoint, writing its filesystem back first
+bool vfs_umount(fs_node_t* mountpoint);
+
+//writes back every mounted filesystem, then every dirty cached block
+//returns 0 on success
+int vfs_sync();
+
+//finds the mount whose filesystem root is root, or NULL
+mount_t* mount_find_root(fs_node_t* root);
+
+//iterate the mount table
+mount_t* mount_get(uint32_t index);
+uint32_t mount_count();
+
+#endif
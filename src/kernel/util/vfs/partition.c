@@ -0,0 +1,129 @@
+#include "partition.h"
+#include <std/kheap.h>
+#include <std/math.h>
+
+//limit on logical partitions, in case an extended partition chain loops
+#define MAX_LOGICAL_PARTITIONS 32
+
+//clamps a 64 bit sector range to what a 32 bit block device can address
+static bool partition_range(block_device_t* disk, uint64_t first, uint64_t last, uint32_t* start, uint32_t* count) {
+	if (last < first || first >= disk->sector_count) return false;
+	if (last >= disk->sector_count) last = disk->sector_count - 1;
+
+	*start = first;
+	*count = last - first + 1;
+	return true;
+}
+
+static bool gpt_entry_used(gpt_entry_t* entry) {
+	for (int i = 0; i < 16; i++) {
+		if (entry->type_guid[i]) return true;
+	}
+	return false;
+}
+
+static bool gpt_scan(block_device_t* disk, uint8_t* sector) {
+	if (block_read(disk, 1, 1, sector)) return false;
+
+	gpt_header_t* header = (gpt_header_t*)sector;
+	if (memcmp(header->signature, GPT_SIGNATURE, 8)) {
+		return false;
+	}
+	if (header->entry_size < sizeof(gpt_entry_t) || header->entry_size > disk->sector_size) {
+		printf_err("%s: unsupported GPT entry size %d", disk->name, header->entry_size);
+		return false;
+	}
+
+	uint32_t entries_lba = header->entries_lba;
+	uint32_t entry_size = header->entry_size;
+	uint32_t entry_count = MIN(header->entry_count, (uint32_t)GPT_MAX_ENTRIES);
+	uint32_t per_sector = disk->sector_size / entry_size;
+
+	int index = 1;
+	for (uint32_t i = 0; i < entry_count; i++) {
+		//entries are read a sector at a time
+		if (i % per_sector == 0) {
+			if (block_read(disk, entries_lba + (i / per_sector), 1, sector)) return true;
+		}
+		gpt_entry_t* entry = (gpt_entry_t*)(sector + (i % per_sector) * entry_size);
+		if (!gpt_entry_used(entry)) continue;
+
+		uint32_t start, count;
+		if (partition_range(disk, entry->first_lba, entry->last_lba, &start, &count)) {
+			block_partition_register(disk, index, start, count);
+		}
+		index++;
+	}
+	return true;
+}
+
+//walks the chain of extended boot records starting at extended_start
+static void mbr_scan_logical(block_device_t* disk, uint8_t* sector, uint32_t extended_start) {
+	uint32_t ebr = extended_start;
+	for (int i = 0; i < MAX_LOGICAL_PARTITIONS; i++) {
+		if (block_read(disk, ebr, 1, sector)) return;
+		if (*(uint16_t*)(sector + 510) != MBR_SIGNATURE) return;
+
+		//first entry is the logical partition relative to this EBR,
+		//second points at the next EBR relative to the start of the extended partition
+		mbr_partition_t* table = (mbr_partition_t*)(sector + MBR_PARTITION_OFFSET);
+		mbr_partition_t logical = table[0];
+		mbr_partition_t next = table[1];
+
+		if (logical.type != MBR_TYPE_EMPTY && logical.sector_count) {
+			uint32_t start, count;
+			uint64_t first = (uint64_t)ebr + logical.lba_first;
+			if (partition_range(disk, first, first + logical.sector_count - 1, &start, &count)) {
+				block_partition_register(disk, 5 + i, start, count);
+			}
+		}
+
+		if (next.type == MBR_TYPE_EMPTY || !next.lba_first) return;
+		ebr = extended_start + next.lba_first;
+	}
+}
+
+void partition_scan(block_device_t* disk) {
+	//MBR and GPT headers both live in 512 byte structures at the start of a sector
+	if (disk->sector_size < 512 || !disk->sector_count) return;
+
+	uint8_t* sector = kmalloc(disk->sector_size);
+	if (block_read(disk, 0, 1, sector)) {
+		kfree(sector);
+		return;
+	}
+	if (*(uint16_t*)(sector + 510) != MBR_SIGNATURE) {
+		//no partition table
+		kfree(sector);
+		return;
+	}
+
+	//copy the table out, the sector buffer gets reused below
+	mbr_partition_t table[4];
+	memcpy(table, sector + MBR_PARTITION_OFFSET, sizeof(table));
+
+	for (int i = 0; i < 4; i++) {
+		if (table[i].type == MBR_TYPE_GPT_PROTECTIVE) {
+			if (gpt_scan(disk, sector)) {
+				kfree(sector);
+				return;
+			}
+		}
+	}
+
+	for (int i = 0; i < 4; i++) {
+		mbr_partition_t* part = &table[i];
+		if (part->type == MBR_TYPE_EMPTY || !part->sector_count) continue;
+
+		if (part->type == MBR_TYPE_EXTENDED_CHS || part->type == MBR_TYPE_EXTENDED_LBA) {
+			mbr_scan_logical(disk, sector, part->lba_first);
+			continue;
+		}
+
+		uint32_t start, count;
+		if (partition_range(disk, part->lba_first, (uint64_t)part->lba_first + part->sector_count - 1, &start, &count)) {
+			block_partition_register(disk, i + 1, start, count);
+		}
+	}
+	kfree(sector);
+}
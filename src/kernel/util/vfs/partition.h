@@ -0,0 +1,58 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <std/std.h>
+#include "block.h"
+
+#define MBR_SIGNATURE			0xAA55
+#define MBR_PARTITION_OFFSET	446
+#define MBR_TYPE_EMPTY			0x00
+#define MBR_TYPE_EXTENDED_CHS	0x05
+#define MBR_TYPE_EXTENDED_LBA	0x0F
+#define MBR_TYPE_GPT_PROTECTIVE	0xEE
+
+#define GPT_SIGNATURE "EFI PART"
+//keep the number of entries we'll look at bounded
+#define GPT_MAX_ENTRIES 128
+
+typedef struct mbr_partition {
+	uint8_t status;		//0x80 if bootable
+	uint8_t chs_first[3];
+	uint8_t type;
+	uint8_t chs_last[3];
+	uint32_t lba_first;
+	uint32_t sector_count;
+} __attribute__((packed)) mbr_partition_t;
+
+typedef struct gpt_header {
+	char signature[8];
+	uint32_t revision;
+	uint32_t header_size;
+	uint32_t header_crc;
+	uint32_t reserved;
+	uint64_t current_lba;
+	uint64_t backup_lba;
+	uint64_t first_usable_lba;
+	uint64_t last_usable_lba;
+	uint8_t disk_guid[16];
+	uint64_t entries_lba;	//first sector of partition entry array
+	uint32_t entry_count;
+	uint32_t entry_size;
+	uint32_t entries_crc;
+} __attribute__((packed)) gpt_header_t;
+
+typedef struct gpt_entry {
+	uint8_t type_guid[16];	//all zero if entry is unused
+	uint8_t unique_guid[16];
+	uint64_t first_lba;
+	uint64_t last_lba;		//inclusive
+	uint64_t attributes;
+	uint16_t name[36];		//UTF-16LE
+} __attribute__((packed)) gpt_entry_t;
+
+//reads the partition table of a whole disk, if any,
+//and registers a block device for every partition found
+//MBR primaries are numbered 1-4, logical partitions from 5, GPT entries from 1
+void partition_scan(block_device_t* disk);
+
+#endif
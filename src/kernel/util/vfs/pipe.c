@@ -0,0 +1,187 @@
+#include "pipe.h"
+#include <std/kheap.h>
+#include <std/math.h>
+#include <kernel/util/paging/paging.h>
+
+//copies up to size bytes of the pending loan into buffer
+static uint32_t pipe_take_loan(pipe_t* pipe, uint8_t* buffer, uint32_t size) {
+	pipe_loan_t* loan = pipe->loan;
+	uint32_t count = 0;
+	while (count < size && loan->done < loan->size) {
+		uint32_t virt = loan->base + loan->done;
+		uint32_t page = (virt >> 12) - (loan->base >> 12);
+		uint32_t len = MIN(0x1000 - (virt & 0xFFF), MIN(size - count, loan->size - loan->done));
+		uint32_t phys = loan->frames[page] + (virt & 0xFFF);
+
+		//the kernel heap and anything else mapped the same way in both address spaces
+		//can be read directly, otherwise borrow the page for the copy
+		if (virt_to_phys(virt) == phys) {
+			memcpy(buffer + count, (void*)virt, len);
+		}
+		else {
+			void* src = map_shared(phys, len);
+			if (!src) break;
+			memcpy(buffer + count, src, len);
+			unmap_shared(src, len);
+		}
+		count += len;
+		loan->done += len;
+	}
+	return count;
+}
+
+static uint32_t pipe_read(fs_node_t* node, uint32_t UNUSED(offset), uint32_t size, uint8_t* buffer) {
+	pipe_t* pipe = (pipe_t*)node->impl;
+	if (!size) return 0;
+
+	kernel_begin_critical();
+	while (pipe->head == pipe->tail && !pipe->loan && pipe->writer_open) {
+		wait_queue_sleep(&pipe->read_wait);
+	}
+
+	uint32_t count = 0;
+	//buffered bytes were written before any pending loan
+	while (count < size && pipe->head != pipe->tail) {
+		uint32_t start = pipe->tail % PIPE_BUFFER_SIZE;
+		uint32_t len = MIN(pipe->head - pipe->tail, PIPE_BUFFER_SIZE - start);
+		len = MIN(len, size - count);
+		memcpy(buffer + count, pipe->buf + start, len);
+		pipe->tail += len;
+		count += len;
+	}
+	if (count < size && pipe->loan) {
+		count += pipe_take_loan(pipe, buffer + count, size - count);
+	}
+
+	wait_queue_wake(&pipe->write_wait);
+	kernel_end_critical();
+	return count;
+}
+
+//lends buffer to the reader and waits for it to be drained
+//returns bytes taken, or -1 if buffer couldn't be lent
+static int pipe_write_loan(pipe_t* pipe, uint32_t size, uint8_t* buffer) {
+	uint32_t base = (uint32_t)buffer;
+	uint32_t pages = ((base + size - 1) >> 12) - (base >> 12) + 1;
+	uint32_t* frames = kmalloc(pages * sizeof(uint32_t));
+	for (uint32_t i = 0; i < pages; i++) {
+		frames[i] = virt_to_phys((base & ~0xFFF) + i * 0x1000);
+		if (!frames[i]) {
+			kfree(frames);
+			return -1;
+		}
+	}
+
+	//lives on the heap so the reader can see it from its own address space
+	pipe_loan_t* loan = kmalloc(sizeof(pipe_loan_t));
+	loan->base = base;
+	loan->frames = frames;
+	loan->size = size;
+	loan->done = 0;
+
+	pipe->loan = loan;
+	wait_queue_wake(&pipe->read_wait);
+	while (loan->done < loan->size && pipe->reader_open) {
+		wait_queue_sleep(&pipe->write_wait);
+	}
+	pipe->loan = NULL;
+	//let other writers waiting for the loan slot in
+	wait_queue_wake(&pipe->write_wait);
+
+	int done = loan->done;
+	kfree(frames);
+	kfree(loan);
+	return done;
+}
+
+static uint32_t pipe_write(fs_node_t* node, uint32_t UNUSED(offset), uint32_t size, uint8_t* buffer) {
+	pipe_t* pipe = (pipe_t*)node->impl;
+	uint32_t written = 0;
+
+	kernel_begin_critical();
+	//one loan at a time, and buffered bytes can't overtake one
+	while (pipe->loan && pipe->reader_open) {
+		wait_queue_sleep(&pipe->write_wait);
+	}
+	if (size >= PIPE_LOAN_THRESHOLD && pipe->reader_open) {
+		int lent = pipe_write_loan(pipe, size, buffer);
+		if (lent >= 0) {
+			kernel_end_critical();
+			return lent;
+		}
+	}
+
+	while (written < size) {
+		while ((pipe->loan || pipe->head - pipe->tail == PIPE_BUFFER_SIZE) && pipe->reader_open) {
+			wait_queue_sleep(&pipe->write_wait);
+		}
+		if (!pipe->reader_open) break;
+
+		uint32_t start = pipe->head % PIPE_BUFFER_SIZE;
+		uint32_t len = MIN(PIPE_BUFFER_SIZE - (pipe->head - pipe->tail), PIPE_BUFFER_SIZE - start);
+		len = MIN(len, size - written);
+		memcpy(pipe->buf + start, buffer + written, len);
+		pipe->head += len;
+		written += len;
+		wait_queue_wake(&pipe->read_wait);
+	}
+	kernel_end_critical();
+	return written;
+}
+
+static uint32_t pipe_poll(fs_node_t* node, uint32_t events) {
+	pipe_t* pipe = (pipe_t*)node->impl;
+	uint32_t ready = 0;
+	//a closed other end doesn't block either, the call returns straight away
+	if (node == &pipe->read_end) {
+		if (pipe->head != pipe->tail || pipe->loan || !pipe->writer_open) ready |= POLL_IN;
+	}
+	else {
+		if ((!pipe->loan && pipe->head - pipe->tail < PIPE_BUFFER_SIZE) || !pipe->reader_open) ready |= POLL_OUT;
+	}
+	return ready & events;
+}
+
+static void pipe_close(fs_node_t* node) {
+	pipe_t* pipe = (pipe_t*)node->impl;
+
+	kernel_begin_critical();
+	if (node == &pipe->read_end) {
+		pipe->reader_open = false;
+		wait_queue_wake(&pipe->write_wait);
+	}
+	else {
+		pipe->writer_open = false;
+		wait_queue_wake(&pipe->read_wait);
+	}
+	bool unused = !pipe->reader_open && !pipe->writer_open;
+	kernel_end_critical();
+
+	if (unused) {
+		kfree(pipe->buf);
+		kfree(pipe);
+	}
+}
+
+pipe_t* pipe_create() {
+	pipe_t* pipe = kmalloc(sizeof(pipe_t));
+	memset(pipe, 0, sizeof(pipe_t));
+	pipe->buf = kmalloc(PIPE_BUFFER_SIZE);
+	pipe->reader_open = true;
+	pipe->writer_open = true;
+
+	strcpy(pipe->read_end.name, "pipe");
+	pipe->read_end.flags = FS_PIPE;
+	pipe->read_end.impl = (uint32_t)pipe;
+	pipe->read_end.read = pipe_read;
+	pipe->read_end.close = pipe_close;
+	pipe->read_end.poll = pipe_poll;
+
+	strcpy(pipe->write_end.name, "pipe");
+	pipe->write_end.flags = FS_PIPE;
+	pipe->write_end.impl = (uint32_t)pipe;
+	pipe->write_end.write = pipe_write;
+	pipe->write_end.close = pipe_close;
+	pipe->write_end.poll = pipe_poll;
+	return pipe;
+}
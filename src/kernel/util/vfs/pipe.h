@@ -0,0 +1,44 @@
+#ifndef PIPE_H
+#define PIPE_H
+
+#include <std/std.h>
+#include "fs.h"
+#include <kernel/util/multitasking/tasks/wait.h>
+
+//bytes buffered between writer and reader
+#define PIPE_BUFFER_SIZE 0x4000
+//writes at least this big lend their pages to the reader instead of going through the buffer
+#define PIPE_LOAN_THRESHOLD 0x4000
+
+//a write in progress whose bytes the reader copies straight out of the writer's memory
+typedef struct pipe_loan {
+	uint32_t base;		//writer's buffer, in the writer's address space
+	uint32_t* frames;	//physical address of each page of the buffer
+	uint32_t size;
+	uint32_t done;		//bytes the reader has taken so far
+} pipe_loan_t;
+
+typedef struct pipe {
+	fs_node_t read_end;
+	fs_node_t write_end;
+
+	uint8_t* buf;
+	//running byte counts, their difference is the number of bytes buffered
+	uint32_t head;
+	uint32_t tail;
+
+	pipe_loan_t* loan;	//writer blocked until the reader drains this, if any
+	bool reader_open;
+	bool writer_open;
+
+	wait_queue_t read_wait;		//readers waiting for data
+	wait_queue_t write_wait;	//writers waiting for room
+} pipe_t;
+
+//creates a pipe whose two ends are pipe->read_end and pipe->write_end
+//reads block until data arrives, and return 0 once the write end is closed and the pipe is empty
+//writes block until every byte is taken, or return short if the read end is closed
+//the pipe is freed once both ends are closed
+pipe_t* pipe_create();
+
+#endif
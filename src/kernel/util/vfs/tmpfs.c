@@ -0,0 +1,251 @@
+#include "tmpfs.h"
+#include <std/kheap.h>
+#include <std/math.h>
+#include <kernel/util/mutex/mutex.h>
+
+static lock_t* tmpfs_lock = 0;
+static uint32_t tmpfs_next_inode = 1;
+static struct dirent tmpfs_dirent;
+
+static void tmpfs_init_node(tmpfs_inode_t* inode, char* name, uint32_t type, fs_node_t* parent);
+
+static uint32_t tmpfs_read(fs_node_t* node, uint32_t offset, uint32_t size, uint8_t* buffer) {
+	tmpfs_inode_t* inode = (tmpfs_inode_t*)node;
+	lock(tmpfs_lock);
+	if (offset >= node->length) {
+		unlock(tmpfs_lock);
+		return 0;
+	}
+	size = MIN(size, node->length - offset);
+
+	uint32_t done = 0;
+	while (done < size) {
+		uint32_t page = (offset + done) / TMPFS_PAGE_SIZE;
+		uint32_t page_off = (offset + done) % TMPFS_PAGE_SIZE;
+		uint32_t chunk = MIN(size - done, TMPFS_PAGE_SIZE - page_off);
+
+		if (page < inode->page_slots && inode->pages[page]) {
+			memcpy(buffer + done, inode->pages[page] + page_off, chunk);
+		}
+		else {
+			memset(buffer + done, 0, chunk);
+		}
+		done += chunk;
+	}
+	unlock(tmpfs_lock);
+	return size;
+}
+
+//makes sure the page table can hold at least count slots
+static void tmpfs_reserve_slots(tmpfs_inode_t* inode, uint32_t count) {
+	if (count <= inode->page_slots) return;
+
+	uint32_t slots = inode->page_slots ? inode->page_slots : 8;
+	while (slots < count) slots *= 2;
+
+	uint8_t** pages = kmalloc(slots * sizeof(uint8_t*));
+	memset(pages, 0, slots * sizeof(uint8_t*));
+	if (inode->pages) {
+		memcpy(pages, inode->pages, inode->page_slots * sizeof(uint8_t*));
+		kfree(inode->pages);
+	}
+	inode->pages = pages;
+	inode->page_slots = slots;
+}
+
+static uint32_t tmpfs_write(fs_node_t* node, uint32_t offset, uint32_t size, uint8_t* buffer) {
+	tmpfs_inode_t* inode = (tmpfs_inode_t*)node;
+	if (!size) return 0;
+	//lengths are 32 bit
+	if (offset + size < offset) return 0;
+
+	lock(tmpfs_lock);
+	tmpfs_reserve_slots(inode, (offset + size + TMPFS_PAGE_SIZE - 1) / TMPFS_PAGE_SIZE);
+
+	//only the pages written to are allocated, skipped ranges stay holes
+	uint32_t done = 0;
+	while (done < size) {
+		uint32_t page = (offset + done) / TMPFS_PAGE_SIZE;
+		uint32_t page_off = (offset + done) % TMPFS_PAGE_SIZE;
+		uint32_t chunk = MIN(size - done, TMPFS_PAGE_SIZE - page_off);
+
+		if (!inode->pages[page]) {
+			inode->pages[page] = kmalloc_a(TMPFS_PAGE_SIZE);
+			memset(inode->pages[page], 0, TMPFS_PAGE_SIZE);
+		}
+		memcpy(inode->pages[page] + page_off, buffer + done, chunk);
+		done += chunk;
+	}
+	node->length = MAX(node->length, offset + size);
+	unlock(tmpfs_lock);
+	return size;
+}
+
+static int tmpfs_truncate(fs_node_t* node, uint32_t length) {
+	tmpfs_inode_t* inode = (tmpfs_inode_t*)node;
+	if ((node->flags & 0x7) != FS_FILE) return -1;
+
+	lock(tmpfs_lock);
+	if (length < node->length) {
+		//free whole pages past the new end
+		uint32_t keep = (length + TMPFS_PAGE_SIZE - 1) / TMPFS_PAGE_SIZE;
+		for (uint32_t i = keep; i < inode->page_slots; i++) {
+			if (inode->pages[i]) {
+				kfree(inode->pages[i]);
+				inode->pages[i] = NULL;
+			}
+		}
+		//and zero the tail of the last one, so growing again reads zeroes
+		uint32_t tail = length % TMPFS_PAGE_SIZE;
+		if (tail && keep - 1 < inode->page_slots && inode->pages[keep - 1]) {
+			memset(inode->pages[keep - 1] + tail, 0, TMPFS_PAGE_SIZE - tail);
+		}
+	}
+	//growing just moves the end, the new range is a hole
+	node->length = length;
+	unlock(tmpfs_lock);
+	return 0;
+}
+
+static struct dirent* tmpfs_readdir(fs_node_t* node, uint32_t index) {
+	tmpfs_inode_t* dir = (tmpfs_inode_t*)node;
+	lock(tmpfs_lock);
+	tmpfs_inode_t* child = dir->children;
+	while (child && index--) {
+		child = child->next_sibling;
+	}
+	if (!child) {
+		unlock(tmpfs_lock);
+		return 0;
+	}
+	strcpy(tmpfs_dirent.name, child->node.name);
+	tmpfs_dirent.ino = child->node.inode;
+	unlock(tmpfs_lock);
+	return &tmpfs_dirent;
+}
+
+static tmpfs_inode_t* tmpfs_find_child(tmpfs_inode_t* dir, char* name) {
+	for (tmpfs_inode_t* child = dir->children; child; child = child->next_sibling) {
+		if (!strcmp(child->node.name, name)) {
+			return child;
+		}
+	}
+	return NULL;
+}
+
+static fs_node_t* tmpfs_finddir(fs_node_t* node, char* name) {
+	lock(tmpfs_lock);
+	tmpfs_inode_t* child = tmpfs_find_child((tmpfs_inode_t*)node, name);
+	unlock(tmpfs_lock);
+	return child ? &child->node : 0;
+}
+
+static fs_node_t* tmpfs_create_child(fs_node_t* node, char* name, uint32_t type) {
+	tmpfs_inode_t* dir = (tmpfs_inode_t*)node;
+	if (type != FS_FILE && type != FS_DIRECTORY) return 0;
+	if (!*name || strlen(name) >= sizeof(node->name) || strchr(name, '/')) return 0;
+
+	lock(tmpfs_lock);
+	tmpfs_inode_t* existing = tmpfs_find_child(dir, name);
+	if (existing) {
+		unlock(tmpfs_lock);
+		//creating a file which is already there just opens it
+		return (existing->node.flags & 0x7) == type ? &existing->node : 0;
+	}
+
+	tmpfs_inode_t* child = kmalloc(sizeof(tmpfs_inode_t));
+	tmpfs_init_node(child, name, type, node);
+	child->next_sibling = dir->children;
+	dir->children = child;
+	unlock(tmpfs_lock);
+	return &child->node;
+}
+
+//frees an inode and everything it holds
+//must be called with tmpfs_lock held
+static void tmpfs_free_inode(tmpfs_inode_t* inode) {
+	for (uint32_t i = 0; i < inode->page_slots; i++) {
+		if (inode->pages[i]) {
+			kfree(inode->pages[i]);
+		}
+	}
+	if (inode->pages) {
+		kfree(inode->pages);
+	}
+	kfree(inode);
+}
+
+static void tmpfs_open(fs_node_t* node) {
+	lock(tmpfs_lock);
+	((tmpfs_inode_t*)node)->open_count++;
+	unlock(tmpfs_lock);
+}
+
+static void tmpfs_close(fs_node_t* node) {
+	tmpfs_inode_t* inode = (tmpfs_inode_t*)node;
+	lock(tmpfs_lock);
+	if (inode->open_count) inode->open_count--;
+	//the last close of an unlinked inode frees it
+	if (!inode->open_count && inode->unlinked) {
+		tmpfs_free_inode(inode);
+	}
+	unlock(tmpfs_lock);
+}
+
+static int tmpfs_unlink(fs_node_t* node, char* name) {
+	tmpfs_inode_t* dir = (tmpfs_inode_t*)node;
+
+	lock(tmpfs_lock);
+	tmpfs_inode_t** link = &dir->children;
+	while (*link && strcmp((*link)->node.name, name)) {
+		link = &(*link)->next_sibling;
+	}
+	tmpfs_inode_t* victim = *link;
+	//directories have to be emptied first
+	if (!victim || victim->children) {
+		unlock(tmpfs_lock);
+		return -1;
+	}
+	*link = victim->next_sibling;
+	victim->next_sibling = NULL;
+
+	//anyone with it open keeps reading and writing it until they close it
+	victim->unlinked = true;
+	if (!victim->open_count) {
+		tmpfs_free_inode(victim);
+	}
+	unlock(tmpfs_lock);
+	return 0;
+}
+
+static void tmpfs_init_node(tmpfs_inode_t* inode, char* name, uint32_t type, fs_node_t* parent) {
+	memset(inode, 0, sizeof(tmpfs_inode_t));
+	fs_node_t* node = &inode->node;
+	strcpy(node->name, name);
+	node->flags = type;
+	node->inode = tmpfs_next_inode++;
+	node->parent = parent;
+	node->open = &tmpfs_open;
+	node->close = &tmpfs_close;
+
+	if (type == FS_DIRECTORY) {
+		node->readdir = &tmpfs_readdir;
+		node->finddir = &tmpfs_finddir;
+		node->create = &tmpfs_create_child;
+		node->unlink = &tmpfs_unlink;
+	}
+	else {
+		node->read = &tmpfs_read;
+		node->write = &tmpfs_write;
+		node->truncate = &tmpfs_truncate;
+	}
+}
+
+fs_node_t* tmpfs_create() {
+	if (!tmpfs_lock) {
+		tmpfs_lock = lock_create();
+	}
+	tmpfs_inode_t* root = kmalloc(sizeof(tmpfs_inode_t));
+	tmpfs_init_node(root, "tmpfs", FS_DIRECTORY, 0);
+	return &root->node;
+}
@@ -0,0 +1,30 @@
+#ifndef TMPFS_H
+#define TMPFS_H
+
+#include <std/std.h>
+#include "fs.h"
+
+#define TMPFS_PAGE_SIZE 0x1000
+
+typedef struct tmpfs_inode {
+	fs_node_t node;		//must come first, callbacks are passed a pointer to it
+
+	//file contents, one page per slot
+	//slots are NULL for holes, which read back as zeroes
+	uint8_t** pages;
+	uint32_t page_slots;
+
+	//directory contents
+	struct tmpfs_inode* children;
+	struct tmpfs_inode* next_sibling;
+
+	//an unlinked inode stays around until whoever still has it open closes it
+	uint32_t open_count;
+	bool unlinked;
+} tmpfs_inode_t;
+
+//creates an empty tmpfs and returns its root directory,
+//ready to be passed to vfs_mount
+fs_node_t* tmpfs_create();
+
+#endif
@@ -0,0 +1,57 @@
+#include "lz4.h"
+
+//a sequence is a token, literal bytes, then a back reference:
+//  token: high nibble literal count, low nibble match length - 4
+//  a nibble of 15 is extended by following bytes until one is less than 255
+//  match offset is 2 bytes little endian, counting back from the output position
+//the last sequence of a block is literals only
+#define LZ4_MIN_MATCH 4
+
+//reads an extended length, returns false if it runs off the end of src
+static int lz4_length(const uint8_t** ip, const uint8_t* end, uint32_t* len) {
+	uint8_t b;
+	do {
+		if (*ip >= end) return 0;
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+	return 1;
+}
+
+int lz4_decompress(const uint8_t* src, uint32_t src_size, uint8_t* dst, uint32_t dst_capacity) {
+	const uint8_t* ip = src;
+	const uint8_t* ip_end = src + src_size;
+	uint8_t* op = dst;
+	uint8_t* op_end = dst + dst_capacity;
+
+	while (ip < ip_end) {
+		uint8_t token = *ip++;
+
+		uint32_t lit = token >> 4;
+		if (lit == 15 && !lz4_length(&ip, ip_end, &lit)) return -1;
+		if (lit > (uint32_t)(ip_end - ip) || lit > (uint32_t)(op_end - op)) return -1;
+		for (uint32_t i = 0; i < lit; i++) {
+			*op++ = *ip++;
+		}
+
+		//end of block
+		if (ip == ip_end) break;
+
+		if (ip_end - ip < 2) return -1;
+		uint32_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (!offset || offset > (uint32_t)(op - dst)) return -1;
+
+		uint32_t len = token & 0xF;
+		if (len == 15 && !lz4_length(&ip, ip_end, &len)) return -1;
+		len += LZ4_MIN_MATCH;
+		if (len > (uint32_t)(op_end - op)) return -1;
+
+		//byte at a time, matches may overlap their own output
+		const uint8_t* match = op - offset;
+		for (uint32_t i = 0; i < len; i++) {
+			*op++ = *match++;
+		}
+	}
+	return op - dst;
+}
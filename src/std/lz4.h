@@ -0,0 +1,11 @@
+#ifndef STD_LZ4_H
+#define STD_LZ4_H
+
+#include <stdint.h>
+
+//decodes one LZ4 block (no frame header) of src_size bytes from src into dst
+//never reads past src + src_size or writes past dst + dst_capacity
+//returns number of bytes written, or -1 if the block is malformed
+int lz4_decompress(const uint8_t* src, uint32_t src_size, uint8_t* dst, uint32_t dst_capacity);
+
+#endif
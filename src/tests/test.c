@@ -1,9 +1,17 @@
 #include "test.h"
 #include <std/std.h>
+#include <std/math.h>
 #include <kernel/drivers/terminal/terminal.h>
 #include <kernel/drivers/vesa/vesa.h>
 #include <kernel/drivers/rtc/clock.h>
 #include <crypto/crypto.h>
+#include <kernel/util/vfs/bcache.h>
+#include <kernel/util/syscall/sysfuncs.h>
+#include <kernel/util/multitasking/tasks/task.h>
+#include <gfx/lib/region.h>
+#include <gfx/lib/pixels.h>
+#include <kernel/util/fpu/fpu.h>
+#include <kernel/util/paging/pat.h>
 
 void test_colors() {
 	printf_info("Testing colors...");
@@ -104,3 +112,478 @@ void test_crypto() {
 	printf_info("Testing AES...");
 	printf_info("AES test %s", aes_test() ? "passed":"failed");
 }
+
+#define RAMDISK_SECTORS 64
+static uint8_t ramdisk[RAMDISK_SECTORS * 512];
+static int ramdisk_reads = 0;
+
+static int ramdisk_read(block_device_t* UNUSED(dev), uint32_t lba, uint32_t count, uint8_t* buffer) {
+	ramdisk_reads++;
+	memcpy(buffer, ramdisk + lba * 512, count * 512);
+	return 0;
+}
+
+static int ramdisk_write(block_device_t* UNUSED(dev), uint32_t lba, uint32_t count, uint8_t* buffer) {
+	memcpy(ramdisk + lba * 512, buffer, count * 512);
+	return 0;
+}
+
+void test_bcache() {
+	printf_info("Testing block cache...");
+
+	static block_device_t* dev = 0;
+	if (!dev) {
+		dev = kmalloc(sizeof(block_device_t));
+		memset(dev, 0, sizeof(block_device_t));
+		strcpy(dev->name, "ram0");
+		dev->sector_size = 512;
+		dev->sector_count = RAMDISK_SECTORS;
+		dev->read = ramdisk_read;
+		dev->write = ramdisk_write;
+		block_device_register(dev);
+	}
+	for (uint32_t i = 0; i < sizeof(ramdisk); i++) {
+		ramdisk[i] = i % 251;
+	}
+	bcache_invalidate(dev);
+
+	//write across a block boundary, then read it back
+	uint8_t pattern[600];
+	uint8_t readback[600];
+	memset(pattern, 0xAB, sizeof(pattern));
+	bcache_write(dev, 0x1000 - 300, sizeof(pattern), pattern);
+	if (ramdisk[0x1000 - 300] == 0xAB) {
+		printf_err("Block cache test failed, write was not deferred");
+		return;
+	}
+	bcache_read(dev, 0x1000 - 300, sizeof(readback), readback);
+	if (memcmp(pattern, readback, sizeof(pattern))) {
+		printf_err("Block cache test failed, read back wrong data");
+		return;
+	}
+
+	//repeated reads should never touch the device
+	int reads = ramdisk_reads;
+	for (int i = 0; i < 4; i++) {
+		bcache_read(dev, 0x1000 - 300, sizeof(readback), readback);
+	}
+	if (ramdisk_reads != reads) {
+		printf_err("Block cache test failed, repeated reads went to device");
+		return;
+	}
+
+	bcache_sync(dev);
+	if (memcmp(ramdisk + 0x1000 - 300, pattern, sizeof(pattern))) {
+		printf_err("Block cache test failed, sync did not write back");
+		return;
+	}
+	printf_info("Block cache test passed");
+}
+
+void test_fds() {
+	printf_info("Testing file descriptors...");
+
+	//goes through int 0x80, so this also checks return values make it back
+	int fd = sys_open("/tmp/fdtest", O_RDWR | O_CREAT | O_TRUNC);
+	if (fd < 0) {
+		printf_err("File descriptor test failed, couldn't open file");
+		return;
+	}
+	char* msg = "hello, descriptors";
+	int len = strlen(msg);
+	if (sys_write(fd, msg, len) != len) {
+		printf_err("File descriptor test failed, short write");
+		sys_close(fd);
+		return;
+	}
+
+	//a dup shares the offset of the original
+	int copy = sys_dup(fd);
+	if (copy < 0 || copy == fd || sys_lseek(copy, 0, SEEK_CUR) != len) {
+		printf_err("File descriptor test failed, dup didn't share offset");
+		sys_close(fd);
+		return;
+	}
+	//an unlinked file stays readable through descriptors opened before
+	if (fs_unlink(fs_root, "/tmp/fdtest") || fs_lookup(fs_root, "/tmp/fdtest")) {
+		printf_err("File descriptor test failed, couldn't unlink file");
+		sys_close(fd);
+		sys_close(copy);
+		return;
+	}
+	sys_lseek(fd, 7, SEEK_SET);
+	char buf[32];
+	memset(buf, 0, sizeof(buf));
+	int got = sys_read(copy, buf, sizeof(buf) - 1);
+	sys_close(fd);
+	sys_close(copy);
+	if (got != len - 7 || strcmp(buf, msg + 7)) {
+		printf_err("File descriptor test failed, read back %d bytes: %s", got, buf);
+		return;
+	}
+	if (sys_read(fd, buf, 1) != -1) {
+		printf_err("File descriptor test failed, closed descriptor still readable");
+		return;
+	}
+	printf_info("File descriptor test passed");
+}
+
+//cats path through a pipe to the calling task, passes times over, chunk bytes per write
+//returns the throughput the reading end saw, in KB/s
+static uint32_t pipe_throughput(char* path, uint32_t chunk, int passes) {
+	int fds[2];
+	if (sys_pipe(fds)) return 0;
+
+	if (!fork("pipebench")) {
+		sys_close(fds[0]);
+		uint8_t* buf = kmalloc(chunk);
+		int file = sys_open(path, O_RDONLY);
+		for (int i = 0; i < passes && file >= 0; i++) {
+			sys_lseek(file, 0, SEEK_SET);
+			int got;
+			while ((got = sys_read(file, buf, chunk)) > 0) {
+				sys_write(fds[1], buf, got);
+			}
+		}
+		sys_close(file);
+		sys_close(fds[1]);
+		kfree(buf);
+		_kill();
+	}
+
+	sys_close(fds[1]);
+	uint8_t* buf = kmalloc(chunk);
+	uint32_t start = time();
+	uint32_t total = 0;
+	int got;
+	while ((got = sys_read(fds[0], buf, chunk)) > 0) {
+		total += got;
+	}
+	uint32_t elapsed = MAX(time() - start, 1u);
+	sys_close(fds[0]);
+	kfree(buf);
+
+	printf_info("%d byte writes: %d KB in %d ms", chunk, total / 1024, elapsed);
+	return (total / 1024) * 1000 / elapsed;
+}
+
+void test_pipe() {
+	printf_info("Benchmarking pipes...");
+	//small writes go through the pipe's buffer, large ones are lent to the reader
+	uint32_t buffered = pipe_throughput("/Lenna.bmp", 512, 8);
+	uint32_t lent = pipe_throughput("/Lenna.bmp", 0x10000, 8);
+	printf_info("Buffered: %d KB/s, page loan: %d KB/s", buffered, lent);
+}
+
+#define IPC_TEST_QUIT	0
+#define IPC_TEST_PING	1
+#define IPC_TEST_SUM	2
+
+//answers pings, and sums the words of shm regions it's sent
+static void ipc_test_server() {
+	int port = sys_ipc_port_create("ipctest");
+	while (port >= 0) {
+		ipc_message_t msg;
+		ipc_message_t reply;
+		memset(&reply, 0, sizeof(reply));
+		int sender = sys_ipc_receive(port, &msg);
+
+		if (msg.type == IPC_TEST_PING) {
+			reply.data[0] = msg.data[0] + 1;
+		}
+		else if (msg.type == IPC_TEST_SUM) {
+			uint32_t* words = (uint32_t*)sys_shm_map(msg.data[0]);
+			for (uint32_t i = 0; words && i < msg.data[1]; i++) {
+				reply.data[0] += words[i];
+			}
+			sys_shm_unmap(msg.data[0], words);
+		}
+		sys_ipc_reply(port, sender, &reply);
+		if (msg.type == IPC_TEST_QUIT) break;
+	}
+	sys_ipc_port_destroy(port);
+	_kill();
+}
+
+void test_ipc() {
+	printf_info("Testing IPC...");
+	if (!fork("ipctest")) {
+		ipc_test_server();
+	}
+	int port;
+	while ((port = sys_ipc_port_lookup("ipctest")) < 0) {
+		sys_yield(RUNNABLE);
+	}
+
+	ipc_message_t msg;
+	ipc_message_t reply;
+	memset(&msg, 0, sizeof(msg));
+
+	//round trips, each handing the cpu straight to the server and back
+	const int rounds = 1000;
+	msg.type = IPC_TEST_PING;
+	uint32_t start = time();
+	for (int i = 0; i < rounds; i++) {
+		msg.data[0] = i;
+		if (sys_ipc_send(port, &msg, &reply) || reply.data[0] != (uint32_t)i + 1) {
+			printf_err("IPC test failed, bad reply to ping %d", i);
+			return;
+		}
+	}
+	uint32_t elapsed = time() - start;
+	printf_info("%d round trips in %d ms", rounds, elapsed);
+
+	//the server sees our writes through its own mapping of the region
+	const uint32_t count = 4096;
+	int shm = sys_shm_create(count * sizeof(uint32_t));
+	uint32_t* words = (uint32_t*)sys_shm_map(shm);
+	uint32_t sum = 0;
+	for (uint32_t i = 0; i < count && words; i++) {
+		words[i] = i;
+		sum += i;
+	}
+	msg.type = IPC_TEST_SUM;
+	msg.data[0] = shm;
+	msg.data[1] = count;
+	bool passed = words && !sys_ipc_send(port, &msg, &reply) && reply.data[0] == sum;
+	sys_shm_unmap(shm, words);
+	sys_shm_destroy(shm);
+
+	msg.type = IPC_TEST_QUIT;
+	sys_ipc_send(port, &msg, &reply);
+
+	if (!passed) {
+		printf_err("IPC test failed, server saw a different shm region");
+		return;
+	}
+	printf_info("IPC test passed");
+}
+
+static void io_ring_push(io_ring_t* ring, uint8_t op, int fd, void* buf, uint32_t len, uint32_t user_data) {
+	io_sqe_t* sqe = &ring->sqes[ring->sq_tail & ring->sq_mask];
+	memset(sqe, 0, sizeof(io_sqe_t));
+	sqe->op = op;
+	sqe->fd = fd;
+	sqe->events = POLL_IN;
+	sqe->addr = (uint32_t)buf;
+	sqe->len = len;
+	sqe->offset = FD_OFFSET_CURRENT;
+	sqe->user_data = user_data;
+	ring->sq_tail++;
+}
+
+void test_io_ring() {
+	printf_info("Testing io rings...");
+
+	//a task gets one ring, so keep it around for later runs
+	static io_ring_t* ring = 0;
+	if (!ring) ring = (io_ring_t*)sys_io_ring_setup(8);
+	int fds[2];
+	if (!ring || sys_pipe(fds)) {
+		printf_err("io ring test failed, couldn't set up");
+		return;
+	}
+
+	//nothing's been written yet, so the timer has to complete before the poll
+	io_ring_push(ring, IO_OP_POLL, fds[0], NULL, 0, 1);
+	io_ring_push(ring, IO_OP_TIMER, -1, NULL, 20, 2);
+	sys_io_ring_enter(2, 1);
+	io_cqe_t* first = &ring->cqes[ring->cq_head & ring->cq_mask];
+	bool passed = first->user_data == 2 && first->result == 0;
+	ring->cq_head++;
+
+	//the write completes straight away, and readies the poll
+	io_ring_push(ring, IO_OP_WRITE, fds[1], "ping", 4, 3);
+	sys_io_ring_enter(1, 2);
+	char in[8];
+	memset(in, 0, sizeof(in));
+	io_ring_push(ring, IO_OP_READ, fds[0], in, sizeof(in), 4);
+	sys_io_ring_enter(1, 3);
+
+	//reaped straight out of shared memory
+	int seen = 0;
+	while (ring->cq_head != ring->cq_tail) {
+		io_cqe_t* cqe = &ring->cqes[ring->cq_head & ring->cq_mask];
+		switch (cqe->user_data) {
+			case 1:
+				passed &= cqe->result == POLL_IN;
+				break;
+			case 3:
+			case 4:
+				passed &= cqe->result == 4;
+				break;
+			default:
+				passed = false;
+				break;
+		}
+		seen++;
+		ring->cq_head++;
+	}
+	sys_close(fds[0]);
+	sys_close(fds[1]);
+
+	if (!passed || seen != 3 || strcmp(in, "ping")) {
+		printf_err("io ring test failed, read back %s", in);
+		return;
+	}
+	printf_info("io ring test passed");
+}
+
+static int region_area(Region* region) {
+	int area = 0;
+	for (int i = 0; i < region->count; i++) {
+		Rect r = region_rect(region, i);
+		area += r.size.width * r.size.height;
+	}
+	return area;
+}
+
+void test_region() {
+	printf_info("Testing regions...");
+
+	//two overlapping squares need 3 bands
+	Region a;
+	region_init_rect(&a, rect_make(point_make(0, 0), size_make(10, 10)));
+	region_union_rect(&a, &a, rect_make(point_make(5, 5), size_make(10, 10)));
+	bool passed = a.count == 3 && region_area(&a) == 175;
+
+	//where they overlap, bands with identical spans are merged back into one box
+	Region b;
+	region_init(&b);
+	region_intersect_rect(&b, &a, rect_make(point_make(8, 8), size_make(4, 4)));
+	passed &= b.count == 1 && region_area(&b) == 16;
+
+	//punching a hole leaves a box above, one either side, and one below
+	region_free(&a);
+	region_init_rect(&a, rect_make(point_make(0, 0), size_make(8, 8)));
+	region_subtract_rect(&a, &a, rect_make(point_make(2, 2), size_make(4, 4)));
+	passed &= a.count == 4 && region_area(&a) == 48;
+
+	//and filling it in again gets back the original square
+	region_union_rect(&a, &a, rect_make(point_make(2, 2), size_make(4, 4)));
+	passed &= a.count == 1 && region_area(&a) == 64;
+
+	region_free(&a);
+	region_free(&b);
+	if (!passed) {
+		printf_err("Region test failed");
+		return;
+	}
+	printf_info("Region test passed");
+}
+
+//runs op through both the scalar and SSE2 pixel loops on the same random data
+//returns false if they wrote anything different
+static bool pixels_match(int op, uint32_t* scalar, uint32_t* simd, uint32_t* src, int count, uint32_t alpha) {
+	//a few words past count, so an overrun shows up too
+	int len = count + 8;
+	for (int i = 0; i < len; i++) {
+		scalar[i] = simd[i] = rand();
+		src[i] = rand();
+	}
+	switch (op) {
+		case 0:
+			pixels_fill_scalar(scalar, src[0], count);
+			pixels_fill_sse2(simd, src[0], count);
+			break;
+		case 1:
+			pixels_copy_scalar(scalar, src, count);
+			pixels_copy_sse2(simd, src, count);
+			break;
+		case 2:
+			pixels_blend_scalar(scalar, src, count, alpha);
+			pixels_blend_sse2(simd, src, count, alpha);
+			break;
+		case 3:
+			pixels_src_scalar(scalar, src, count, alpha, PIXEL_ALPHA_OPAQUE);
+			pixels_src_sse2(simd, src, count, alpha, PIXEL_ALPHA_OPAQUE);
+			break;
+		case 4:
+			pixels_over_scalar(scalar, src, count, alpha, 0);
+			pixels_over_sse2(simd, src, count, alpha, 0);
+			break;
+		default:
+			pixels_in_scalar(scalar, src, count, alpha, 0);
+			pixels_in_sse2(simd, src, count, alpha, 0);
+			break;
+	}
+	for (int i = 0; i < len; i++) {
+		if (scalar[i] != simd[i]) return false;
+	}
+	return true;
+}
+
+void test_pixels() {
+	printf_info("Testing pixel loops...");
+	if (!cpu_has(CPUID_FEAT_EDX_SSE2)) {
+		printf_info("No SSE2, only the scalar pixel loops are in use");
+		return;
+	}
+
+	//room for every alignment of both buffers
+	const int max_count = 64;
+	uint32_t* scalar = kmalloc((max_count + 12) * sizeof(uint32_t));
+	uint32_t* simd = kmalloc((max_count + 12) * sizeof(uint32_t));
+	uint32_t* src = kmalloc((max_count + 12) * sizeof(uint32_t));
+	uint32_t alphas[] = {0, 1, 127, 128, 255, 256};
+
+	bool passed = true;
+	for (int op = 0; op < 6 && passed; op++) {
+		for (int count = 0; count <= max_count && passed; count++) {
+			//cover the head and tail of every dest and src alignment
+			for (int offset = 0; offset < 16 && passed; offset++) {
+				int dest_offset = offset % 4;
+				int src_offset = offset / 4;
+				uint32_t alpha = alphas[(count + offset) % (sizeof(alphas) / sizeof(alphas[0]))];
+				passed = pixels_match(op, scalar + dest_offset, simd + dest_offset, src + src_offset, count, alpha);
+				if (!passed) {
+					printf_err("Pixel loop %d differs at count %d, offsets %d/%d", op, count, dest_offset, src_offset);
+				}
+			}
+		}
+	}
+
+	kfree(scalar);
+	kfree(simd);
+	kfree(src);
+	if (!passed) {
+		printf_err("Pixel loop test failed");
+		return;
+	}
+	printf_info("Pixel loop test passed");
+}
+
+//copies a buffer over the framebuffer passes times, returns KB/s
+static uint32_t lfb_throughput(cache_type type, uint32_t* buf, uint32_t buf_words, int passes) {
+	lfb_set_cache(type);
+	uint32_t* lfb = (uint32_t*)VESA_LFB_ADDRESS;
+	//one 1024x768x32 screen
+	uint32_t words = 1024 * 768;
+
+	uint32_t start = time();
+	for (int i = 0; i < passes; i++) {
+		for (uint32_t off = 0; off < words; off += buf_words) {
+			pixels_copy(lfb + off, buf, MIN(buf_words, words - off));
+		}
+	}
+	uint32_t elapsed = MAX(time() - start, 1u);
+	return (words * 4 / 1024) * passes * 1000 / elapsed;
+}
+
+void test_lfb_bandwidth() {
+	printf_info("Benchmarking framebuffer writes...");
+	uint32_t buf_words = 0x4000;
+	uint32_t* buf = kmalloc(buf_words * sizeof(uint32_t));
+	for (uint32_t i = 0; i < buf_words; i++) {
+		buf[i] = i * 0x010101;
+	}
+
+	uint32_t uncached = lfb_throughput(CACHE_UNCACHED, buf, buf_words, 4);
+	uint32_t combining = lfb_throughput(CACHE_WRITE_COMBINING, buf, buf_words, 4);
+	kfree(buf);
+
+	printf_info("Uncached: %d KB/s, write-combining: %d KB/s", uncached, combining);
+	if (!pat_enabled()) {
+		printf_info("No PAT, write-combining depends on the MTRRs");
+	}
+}
@@ -11,5 +11,13 @@ void test_printf();
 void test_time_unique();
 void test_malloc();
 void test_crypto();
+void test_bcache();
+void test_fds();
+void test_pipe();
+void test_ipc();
+void test_io_ring();
+void test_region();
+void test_pixels();
+void test_lfb_bandwidth();
 
 #endif
@@ -315,7 +315,7 @@ void rexle_int(int mode) {
 		char buf[32];
 		itoa(real_fps, (char*)&buf);
 		strcat(buf, " FPS");
-		fps->text = buf;
+		set_text(fps, buf);
 		draw_label(screen->vmem, fps);
 
 		write_screen(screen);
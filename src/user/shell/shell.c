@@ -11,6 +11,7 @@
 #include <kernel/kernel.h>
 #include <kernel/util/multitasking/tasks/task.h>
 #include <kernel/util/vfs/fs.h>
+#include <kernel/util/vfs/mount.h>
 #include <kernel/drivers/kb/kb.h>
 #include <kernel/drivers/pci/pci_detect.h>
 #include <kernel/drivers/pit/pit.h>
@@ -343,9 +344,9 @@ void cat_command(int argc, char** argv) {
 		return;
 	}
 	char* file = argv[1];
-	fs_node_t* node = finddir_fs(current_dir, file);
+	fs_node_t* node = fs_lookup(current_dir, file);
 	if (!node) {
-		printf_err("File %s not found");
+		printf_err("File %s not found", file);
 		return;
 	}
 	uint8_t filebuf[2048];
@@ -362,9 +363,9 @@ void hex_command(int argc, char** argv) {
 		return;
 	}
 	char* file = argv[1];
-	fs_node_t* node = finddir_fs(current_dir, file);
+	fs_node_t* node = fs_lookup(current_dir, file);
 	if (!node) {
-		printf_err("File %s not found");
+		printf_err("File %s not found", file);
 		return;
 	}
 	uint8_t filebuf[8];
@@ -382,8 +383,8 @@ void cd_command(int argc, char** argv) {
 	}
 
 	char* dest = argv[1];
-	fs_node_t* new_dir = finddir_fs(current_dir, dest);
-	if (new_dir) {
+	fs_node_t* new_dir = fs_lookup(current_dir, dest);
+	if (new_dir && (new_dir->flags & 0x7) == FS_DIRECTORY) {
 		current_dir = new_dir;
 		return;
 	}
@@ -418,7 +419,7 @@ void open_command(int argc, char** argv) {
 	// elf_init();
 
 	char* name = argv[1];
-	fs_node_t* file = finddir_fs(current_dir, name);
+	fs_node_t* file = fs_lookup(current_dir, name);
 	if (file) {
 		uint8_t* filebuf = (uint8_t*)kmalloc(8192);
 		memset(filebuf, 0, 8192);
@@ -442,6 +443,95 @@ void hypervisor_command() {
 	printf("--- cpu state: R0 = 1 R1 = 2 R2 = 5 R3 = 1 ---\n");
 }
 
+void lsblk_command() {
+	for (uint32_t i = 0; i < block_device_count(); i++) {
+		block_device_t* dev = block_device_get(i);
+		printf("%s: %d sectors of %d bytes", dev->name, dev->sector_count, dev->sector_size);
+		if (dev->parent) {
+			printf(" (%s from sector %d)", dev->parent->name, dev->start_lba);
+		}
+		printf("\n");
+	}
+}
+
+void mkdir_command(int argc, char** argv) {
+	if (argc < 2) {
+		printf_err("Please specify a directory");
+		return;
+	}
+	if (!fs_create(current_dir, argv[1], FS_DIRECTORY)) {
+		printf_err("Couldn't create directory %s", argv[1]);
+	}
+}
+
+void touch_command(int argc, char** argv) {
+	if (argc < 2) {
+		printf_err("Please specify a file");
+		return;
+	}
+	if (!fs_create(current_dir, argv[1], FS_FILE)) {
+		printf_err("Couldn't create file %s", argv[1]);
+	}
+}
+
+void rm_command(int argc, char** argv) {
+	if (argc < 2) {
+		printf_err("Please specify a file");
+		return;
+	}
+	if (fs_unlink(current_dir, argv[1])) {
+		printf_err("Couldn't remove %s", argv[1]);
+	}
+}
+
+void mount_command(int argc, char** argv) {
+	if (argc < 2) {
+		for (uint32_t i = 0; i < mount_count(); i++) {
+			mount_t* mount = mount_get(i);
+			printf("%s on %s\n", mount->dev ? mount->dev->name : "none", mount->mountpoint->name);
+		}
+		return;
+	}
+	if (argc < 3) {
+		printf_err("Usage: mount <device> <directory> [type]");
+		return;
+	}
+
+	block_device_t* dev = block_device_find(argv[1]);
+	if (!dev) {
+		printf_err("No block device %s", argv[1]);
+		return;
+	}
+	fs_node_t* dir = fs_lookup(current_dir, argv[2]);
+	if (!dir) {
+		printf_err("Directory %s not found", argv[2]);
+		return;
+	}
+	fs_node_t* root = fs_mount_device(dev, argc > 3 ? argv[3] : NULL);
+	if (root) {
+		vfs_mount(dir, root, dev);
+	}
+}
+
+void umount_command(int argc, char** argv) {
+	if (argc < 2) {
+		printf_err("Please specify a directory");
+		return;
+	}
+	fs_node_t* dir = fs_lookup(current_dir, argv[1]);
+	//lookup lands inside the mounted filesystem, step back out to the mountpoint
+	mount_t* mount = dir ? mount_find_root(dir) : NULL;
+	if (!mount || !vfs_umount(mount->mountpoint)) {
+		printf_err("Nothing mounted on %s", argv[1]);
+	}
+}
+
+void sync_command() {
+	if (vfs_sync()) {
+		printf_err("Some blocks could not be written back");
+	}
+}
+
 void proc_command() {
 	proc();
 	printf_info("Process state logged");
@@ -476,6 +566,21 @@ void shell_init() {
 	add_new_command("open", "Load file", (void(*)())open_command);
 	add_new_command("proc", "List running processes", proc_command);
 	add_new_command("pci", "List PCI devices", pci_list);
+	add_new_command("lsblk", "List block devices and partitions", lsblk_command);
+	add_new_command("mkdir", "Create a directory", (void(*)())mkdir_command);
+	add_new_command("touch", "Create an empty file", (void(*)())touch_command);
+	add_new_command("rm", "Remove a file or empty directory", (void(*)())rm_command);
+	add_new_command("mount", "Mount a filesystem, or list mounts", (void(*)())mount_command);
+	add_new_command("umount", "Unmount a filesystem", (void(*)())umount_command);
+	add_new_command("sync", "Write cached disk blocks back to disk", sync_command);
+	add_new_command("bcache", "Run block cache test", test_bcache);
+	add_new_command("fdtest", "Run file descriptor test", test_fds);
+	add_new_command("pipebench", "Measure pipe throughput", test_pipe);
+	add_new_command("ipctest", "Run shared memory and message passing test", test_ipc);
+	add_new_command("iotest", "Run io ring test", test_io_ring);
+	add_new_command("regiontest", "Run region algebra test", test_region);
+	add_new_command("pixeltest", "Compare SSE2 pixel loops against scalar ones", test_pixels);
+	add_new_command("fbbench", "Measure framebuffer write bandwidth", test_lfb_bandwidth);
 	add_new_command("hypervisor", "Run VM", hypervisor_command);
 	add_new_command("", "", empty_command);
 
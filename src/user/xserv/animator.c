@@ -17,7 +17,7 @@ void finalize_animation(Window* window, ca_animation* anim) {
 			set_alpha((View*)window, anim->alpha_to);
 			break;
 		case POS_ANIM:
-			window->frame.origin = anim->pos_to;
+			set_frame((View*)window, rect_make(anim->pos_to, window->frame.size));
 			break;
 		case COLOR_ANIM:
 		default:
@@ -54,8 +54,11 @@ void update_alpha_anim(Window* window, ca_animation* anim, float frame_time) {
 
 void update_pos_anim(Window* window, ca_animation* anim, float frame_time) {
 	float step = frame_time * 2 * (1 / anim->duration);
-	window->frame.origin.x = (int)lerp(window->frame.origin.x, anim->pos_to.x, 1.0 * step);
-	window->frame.origin.y = (int)lerp(window->frame.origin.y, anim->pos_to.y, 1.0 * step);
+	Rect frame = window->frame;
+	frame.origin.x = (int)lerp(window->frame.origin.x, anim->pos_to.x, 1.0 * step);
+	frame.origin.y = (int)lerp(window->frame.origin.y, anim->pos_to.y, 1.0 * step);
+	//set_frame damages both the old and new position
+	set_frame((View*)window, frame);
 }
 
 void update_color_anim(Window* window, ca_animation* anim, float frame_time) {
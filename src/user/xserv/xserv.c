@@ -5,6 +5,8 @@
 #include <std/panic.h>
 #include <std/std.h>
 #include <gfx/lib/gfx.h>
+#include <gfx/lib/region.h>
+#include <gfx/font/text_layout.h>
 #include <kernel/util/syscall/sysfuncs.h>
 #include <kernel/util/multitasking/tasks/task.h>
 #include <kernel/drivers/rtc/clock.h>
@@ -35,11 +37,9 @@ void draw_bmp(ca_layer* dest, Bmp* bmp) {
 	bmp->needs_redraw = 0;
 }
 
-void draw_label(ca_layer* dest, Label* label) {
-	if (!label) return;
-
+//draws label's text into its own layer
+static void render_label(Label* label) {
 	View* superview = label->superview;
-	Rect frame = label->frame;
 
 	Color background_color = color_white();
 	//try to match text bounding box to superview's background color
@@ -55,13 +55,28 @@ void draw_label(ca_layer* dest, Label* label) {
 		origin.y = CHAR_HEIGHT;
 	}
 	*/
-	draw_string(label->layer, label->text, origin, label->text_color, label->font_size);
-
-	blit_layer(dest, label->layer, rect_make(label->frame.origin, label->layer->size), rect_make(point_zero(), label->layer->size));
+	//only lay the text out again if something it depends on changed
+	Font* font = font_find(label->font_size.height);
+	int scale = font_scale(font, label->font_size.height);
+	if (!label->layout || !text_layout_matches(label->layout, font, scale, label->layer->size)) {
+		text_layout_destroy(label->layout);
+		label->layout = text_layout_create(label->text, font, scale, label->layer->size);
+	}
+	text_layout_draw(label->layer, label->layout, origin, label->text_color);
 
 	label->needs_redraw = 0;
 }
 
+void draw_label(ca_layer* dest, Label* label) {
+	if (!label) return;
+
+	//the layer still holds the text from last time unless something changed
+	if (label->needs_redraw) {
+		render_label(label);
+	}
+	blit_layer(dest, label->layer, rect_make(label->frame.origin, label->layer->size), rect_make(point_zero(), label->layer->size));
+}
+
 void draw_button(ca_layer* dest, Button* button) {
 	if (!button || !dest) return;
 
@@ -82,6 +97,8 @@ void draw_button(ca_layer* dest, Button* button) {
 
 void draw_view(View* view) {
 	if (!view) return;
+	//a view that hasn't been marked still holds what it drew last time in its layer
+	if (!view->needs_redraw) return;
 
 	//inform subviews that we're being redrawn
 	dirtied = 1;
@@ -112,6 +129,7 @@ void draw_view(View* view) {
 	}
 
 	//draw each subview of this view
+	//only those which were marked are drawn again, the rest are copied from their layers as they are
 	for (int i = 0; i < view->subviews->size; i++) {
 		View* subview = (View*)array_m_lookup(view->subviews, i);
 		draw_view(subview);
@@ -133,6 +151,8 @@ bool draw_window(Screen* UNUSED(screen), Window* window) {
 			redraw(window, NULL);
 			blit_layer(window->layer, window->content_view->layer, rect_make(window->content_view->frame.origin, window->layer->size), rect_make(point_zero(), window->content_view->frame.size));
 
+			//no telling what the callback drew, so all of it has to go back on screen
+			mark_damaged(window->frame);
 			return true;
 		}
 		return false;
@@ -147,7 +167,9 @@ bool draw_window(Screen* UNUSED(screen), Window* window) {
 	if (window->title_view) {
 		//update title label of window
 		Label* title_label = (Label*)array_m_lookup(window->title_view->labels, 0);
-		title_label->text = window->title;
+		if (strcmp(title_label->text, window->title)) {
+			set_text(title_label, window->title);
+		}
 		draw_view(window->title_view);
 		blit_layer(window->layer, window->title_view->layer, rect_make(point_zero(), window->layer->size), window->title_view->frame);
 		draw_rect(window->layer, window->title_view->frame, color_gray(), 2);
@@ -233,71 +255,112 @@ void add_status_bar(Screen* screen) {
 	add_subview(status_bar, border);
 }
 
-static Point last_grabbed_window_pos;
-static void draw_window_shadow(Screen* screen, Window* window, Point new) {
-	Point old = last_grabbed_window_pos;
-	float actual_shadow_count = shadow_count;
-	if (window->layer->alpha < 1.0) actual_shadow_count = 2.0;
-	for (float i = 0; i < actual_shadow_count; i++) {
-		int lerp_x = lerp(old.x, new.x, (1 / actual_shadow_count) * i);
-		int lerp_y = lerp(old.y, new.y, (1 / actual_shadow_count) * i);
-		/*
-		if (abs(old.x - new.x) < 2 || abs(old.y - new.y) < 2) {
-			continue;
+static Label* fps;
+static double last_frame_time;
+static void draw_fps(Screen* screen) {
+	//no frame has been timed yet
+	if (last_frame_time <= 0) return;
+
+	double fps_conv = 1 / last_frame_time / 10;
+
+	//update frame time tracker
+	char buf[32];
+	itoa(fps_conv, (char*)&buf);
+	strcat(buf, " FPS");
+	set_text(fps, buf);
+	draw_label(screen->window->layer, fps);
+
+	mark_damaged(fps->frame);
+}
+
+//composites every rect of region, in screen coordinates, from src positioned at origin
+static void composite_region(ca_layer* dest, ca_layer* src, Region* region, Point origin, composite_op op) {
+	for (int i = 0; i < region->count; i++) {
+		Rect r = region_rect(region, i);
+		//convert rect to src's coordinate space
+		Point local = point_make(rect_min_x(r) - origin.x, rect_min_y(r) - origin.y);
+		composite_layer(dest, src, r, rect_make(local, r.size), op);
+	}
+}
+
+//recomposites the damaged parts of the screen
+//each window's visible region is found front to back, so nothing hidden behind an opaque window gets painted,
+//then windows are painted back to front so translucent ones blend over whatever is beneath them
+//drop shadows are translucent too, so they never hide anything and are painted just before their window
+static void composite_damage(Screen* screen) {
+	array_m* windows = screen->window->subviews;
+
+	//damaged area which isn't behind any opaque window yet
+	Region exposed;
+	region_init(&exposed);
+	for (int i = 0; i < screen->damage.count; i++) {
+		region_union_rect(&exposed, &exposed, screen->damage.rects[i]);
+	}
+
+	Region* visible = NULL;
+	Region* shadowed = NULL;
+	if (windows->size) {
+		visible = kmalloc(windows->size * sizeof(Region));
+		shadowed = kmalloc(windows->size * sizeof(Region));
+	}
+	for (int i = windows->size - 1; i >= 0; i--) {
+		Window* win = (Window*)array_m_lookup(windows, i);
+		region_init(&visible[i]);
+		region_init(&shadowed[i]);
+		if (win->layer->alpha <= 0) continue;
+
+		//the shadow only shows around the window, not through it
+		if (window_shadow(win)) {
+			region_intersect_rect(&shadowed[i], &exposed, window_shadow_frame(win));
+			region_subtract_rect(&shadowed[i], &shadowed[i], win->frame);
 		}
-		*/
-		Point shadow_loc = point_make(lerp_x, lerp_y);
 
-		//draw snapshot of window
-		blit_layer(screen->vmem, window->layer, rect_make(shadow_loc, window->layer->size), rect_make(point_zero(), window->layer->size));
+		region_intersect_rect(&visible[i], &exposed, win->frame);
+		//translucent windows still show what's beneath them
+		if (win->layer->alpha >= 1.0) {
+			region_subtract_rect(&exposed, &exposed, win->frame);
+		}
+	}
+
+	//whatever no window covers shows the desktop
+	composite_region(screen->vmem, screen->window->layer, &exposed, point_zero(), COMPOSITE_OP_OVER);
+	region_free(&exposed);
+
+	for (int i = 0; i < windows->size; i++) {
+		Window* win = (Window*)array_m_lookup(windows, i);
+		if (shadowed[i].count) {
+			//fades along with its window
+			ca_layer* shadow = window_shadow(win);
+			shadow->alpha = win->layer->alpha;
+			composite_region(screen->vmem, shadow, &shadowed[i], window_shadow_frame(win).origin, COMPOSITE_OP_OVER);
+		}
+		composite_region(screen->vmem, win->layer, &visible[i], win->frame.origin, COMPOSITE_OP_OVER);
+		region_free(&visible[i]);
+		region_free(&shadowed[i]);
 	}
+	kfree(visible);
+	kfree(shadowed);
 }
 
 static Window* grabbed_window = NULL;
 void draw_desktop(Screen* screen) {
-	//paint root desktop
+	//bring every window's layer up to date
+	//whatever changed was added to the screen's damage when it was marked
 	draw_window(screen, screen->window);
-	blit_layer(screen->vmem, screen->window->layer, screen->window->frame, screen->window->frame);
-
-	if (screen->window->subviews->size) {
-		Window* highest = array_m_lookup(screen->window->subviews, screen->window->subviews->size - 1);
-
-		//find clipping intersections with every window below the highest one
-		//redraw every child window at the same time if necessary
-		for (int i = 0; i < screen->window->subviews->size - 1; i++) {
-			Window* win = (Window*)(array_m_lookup(screen->window->subviews, i));
-			draw_window(screen, win);
-
-			//Rect* visible_rects = rect_clip(win->frame, highest->frame);
-			//if (!visible_rects || highest->layer->alpha < 1.0) {
-				//not occluded by highest at all
-				//draw view normally, composite onto vmem
-				blit_layer(screen->vmem, win->layer, win->frame, rect_make(point_zero(), win->frame.size));
-				/*
-			}
-			else {
-				//maximum 4 sub-rects
-				for (int j = 0; j < 4; j++) {
-					Rect r = visible_rects[j];
-					if (r.size.width == 0 && r.size.height == 0) break;
-
-					Point origin_offset;
-					origin_offset.x = abs(win->frame.origin.x - r.origin.x);
-					origin_offset.y = abs(win->frame.origin.y - r.origin.y);
-					blit_layer(screen->vmem, win->layer, r, rect_make(origin_offset, r.size));
-				}
-			}
-			*/
-		}
-		
-		//finally, composite highest window
-		draw_window(screen, highest);
-		blit_layer(screen->vmem, highest->layer, highest->frame, rect_make(point_zero(), highest->layer->size));
-
+	for (int i = 0; i < screen->window->subviews->size; i++) {
+		Window* win = (Window*)(array_m_lookup(screen->window->subviews, i));
+		draw_window(screen, win);
 	}
-	if (grabbed_window) {
-		draw_window_shadow(screen, grabbed_window, grabbed_window->frame.origin);
+
+	//frame time tracker only changes when there's a frame to time
+	if (screen->damage.count) {
+		draw_fps(screen);
 	}
+
+	//nothing changed, so vmem already matches what's on screen
+	if (!screen->damage.count) return;
+
+	composite_damage(screen);
 }
 
 static void display_about_window(Point origin) {
@@ -326,6 +389,17 @@ void desktop_setup(Screen* screen) {
 	//display_usage_monitor(point_make(350, 500));
 }
 
+static Rect cursor_rect(Point p) {
+	return rect_make(p, size_make(10, 12));
+}
+
+//positions the cursor's motion trail was last drawn between
+static Point cursor_trail_from;
+static Point cursor_trail_to;
+static Rect cursor_trail() {
+	return rect_union(cursor_rect(cursor_trail_from), cursor_rect(cursor_trail_to));
+}
+
 static void draw_mouse_shadow(Screen* screen, Point old, Point new) {
 	for (float i = 0; i < shadow_count; i++) {
 		int lerp_x = lerp(old.x, new.x, (1 / shadow_count) * i);
@@ -333,9 +407,22 @@ static void draw_mouse_shadow(Screen* screen, Point old, Point new) {
 		Point shadow_loc = point_make(lerp_x, lerp_y);
 
 		//draw cursor shadow
-		draw_rect(screen->vmem, rect_make(shadow_loc, size_make(10, 12)), color_make(200, 200, 230), THICKNESS_FILLED);
+		draw_rect(screen->vmem, cursor_rect(shadow_loc), color_make(200, 200, 230), THICKNESS_FILLED);
 		//draw border
-		draw_rect(screen->vmem, rect_make(shadow_loc, size_make(10, 12)), color_dark_gray(), 1);
+		draw_rect(screen->vmem, cursor_rect(shadow_loc), color_dark_gray(), 1);
+	}
+}
+
+//damages the cursor's old trail so it's erased, and its new one so it's drawn
+static void move_cursor(Point old, Point new) {
+	Rect prev = cursor_trail();
+	cursor_trail_from = old;
+	cursor_trail_to = new;
+	Rect trail = cursor_trail();
+
+	if (memcmp(&prev, &trail, sizeof(Rect))) {
+		mark_damaged(prev);
+		mark_damaged(trail);
 	}
 }
 
@@ -367,7 +454,10 @@ void draw_cursor(Screen* screen) {
 		//draw_rect(screen->vmem, rect_make(mouse_point(), size_make(10, 12)), color_green(), THICKNESS_FILLED);
 	}
 
-	draw_mouse_shadow(screen, last_mouse_pos, mouse_point());
+	//if nothing under the cursor was recomposited, it's still intact in vmem
+	if (damage_intersects(&screen->damage, cursor_trail())) {
+		draw_mouse_shadow(screen, cursor_trail_from, cursor_trail_to);
+	}
 
 	dirtied = prev_dirtied;
 }
@@ -515,10 +605,14 @@ static void process_kb_events(Screen* screen) {
 		}
 		else if (ch == 'r') {
 			//force everything to refresh
+			mark_damaged(screen->window->frame);
 			screen->window->needs_redraw = 1;
+			mark_tree_needs_redraw(screen->window->content_view);
 			for (int i = 0; i < screen->window->subviews->size; i++) {
 				Window* w = array_m_lookup(screen->window->subviews, i);
 				w->needs_redraw = 1;
+				mark_tree_needs_redraw(w->title_view);
+				mark_tree_needs_redraw(w->content_view);
 			}
 		}
 		else if (ch == 'a') {
@@ -564,11 +658,12 @@ static void process_mouse_events(Screen* screen) {
 				//bring this window to forefont
 				array_m_remove(screen->window->subviews, array_m_index(screen->window->subviews, (type_t)active_window));
 				array_m_insert(screen->window->subviews, (type_t)active_window);
+				//its shadow now falls over the windows it was behind
+				mark_damaged(window_shadow_frame((Window*)active_window));
 
 				//only move window if title view was selected
 				if (local_owner == owner->title_view) {
 					grabbed_window = owner;
-					last_grabbed_window_pos = grabbed_window->frame.origin;
 				}
 			}
 		}
@@ -581,7 +676,6 @@ static void process_mouse_events(Screen* screen) {
 				new_frame.origin.y -= (last_mouse_pos.y - p.y);
 
 				set_frame((View*)grabbed_window, new_frame);
-				last_grabbed_window_pos = old_frame.origin;
 			}
 		}
 	}
@@ -617,13 +711,12 @@ static void process_mouse_events(Screen* screen) {
 		launcher_invoke(p);
 	}
 
-	draw_mouse_shadow(screen, last_mouse_pos, p);
+	move_cursor(last_mouse_pos, p);
 
 	last_mouse_pos = p;
 	last_event = events;
 }
 
-static Label* fps;
 void xserv_refresh(Screen* screen) {
 	//if (!screen->finished_drawing) return;
 	
@@ -636,22 +729,17 @@ void xserv_refresh(Screen* screen) {
 	//main refresh loop
 	//traverse view hierarchy,
 	//redraw views if necessary,
-	//composite everything onto root layer
-	xserv_draw(screen);
-
-	double frame_time = (time() - time_start) / 1000.0;
-	double fps_conv = 1 / frame_time / 10;
+	//composite damaged areas onto root layer
+	bool idle = !xserv_draw(screen) && !screen->damage.count;
 
 	//update_all_animations(screen, frame_time);
 
-	//update frame time tracker
-	char buf[32];
-	itoa(fps_conv, (char*)&buf);
-	strcat(buf, " FPS");
-	fps->text = buf;
-	draw_label(screen->window->layer, fps);
+	write_screen_damage(screen);
 
-	write_screen(screen);
+	//idle frames would skew the frame time tracker
+	if (!idle) {
+		last_frame_time = (time() - time_start) / 1000.0;
+	}
 
 	dirtied = 0;
 }
@@ -660,8 +748,15 @@ void xserv_pause() {
 	switch_to_text();
 }
 
+//VESA mode xserv runs in
+static uint32_t xserv_mode;
+
 void xserv_resume() {
-	switch_to_vesa(0x118, false);
+	Screen* screen = gfx_screen();
+	switch_to_vesa(xserv_mode, false);
+	//switching modes forgets the current screen and wipes the framebuffer
+	process_gfx_switch(screen, screen->depth);
+	mark_damaged(screen->window->frame);
 }
 
 void xserv_temp_stop(uint32_t pause_length) {
@@ -673,7 +768,13 @@ void xserv_temp_stop(uint32_t pause_length) {
 void xserv_init() {
 	become_first_responder();
 	//switch to VESA for xserv
-	Screen* screen = switch_to_vesa(0x118, true);
+	//prefer 32bpp, so layers can be copied to the framebuffer without packing them down to 24bpp
+	xserv_mode = vesa_find_mode(1024, 768, 32);
+	if (!xserv_mode) {
+		//1024x768x24
+		xserv_mode = 0x118;
+	}
+	Screen* screen = switch_to_vesa(xserv_mode, true);
 	desktop_setup(screen);
 
 	//add FPS tracker